@@ -0,0 +1,50 @@
+#include "asyncwork.h"
+
+#include "engine_p.h"
+
+#include <private/qv4scopedvalue_p.h>
+
+using namespace NodeQml;
+
+AsyncWork::AsyncWork(QV4::ExecutionEngine *v4, QV4::ReturnedValue callback) :
+    m_engine(EnginePrivate::get(v4)),
+    m_callback(v4, callback)
+{
+    // Ownership stays with the engine, which deletes the work after the callback has been called
+    setAutoDelete(false);
+}
+
+AsyncWork::~AsyncWork()
+{
+}
+
+void AsyncWork::run()
+{
+    execute();
+    m_engine->workDone(this);
+}
+
+void AsyncWork::complete(QV4::ExecutionEngine *v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedFunctionObject cb(scope, m_callback.value());
+    if (!cb)
+        return;
+
+    const int argc = errorNo ? 1 : resultCount() + 1;
+    QV4::ScopedCallData callData(scope, argc);
+    callData->thisObject = v4->globalObject();
+    if (errorNo) {
+        callData->args[0] = m_engine->newErrnoException(errorNo, syscall, path);
+    } else {
+        callData->args[0] = QV4::Primitive::nullValue();
+        results(v4, callData->args + 1);
+    }
+    cb->call(callData);
+}
+
+void AsyncWork::results(QV4::ExecutionEngine *v4, QV4::Value *args)
+{
+    Q_UNUSED(v4)
+    Q_UNUSED(args)
+}
@@ -0,0 +1,49 @@
+#ifndef ASYNCWORK_H
+#define ASYNCWORK_H
+
+#include <QRunnable>
+#include <QString>
+
+#include <private/qv4persistent_p.h>
+
+namespace NodeQml {
+
+class EnginePrivate;
+
+/*!
+  \internal
+  Base class for operations executed on the engine thread pool.
+
+  execute() runs on a worker thread and must not touch the JS heap. Once it returns, the work is
+  handed back to the engine thread and complete() is called. By default it invokes the callback
+  with an error (or \c null) as the first argument, followed by the values produced by results().
+  The work object is created and destroyed on the engine thread.
+*/
+class AsyncWork : public QRunnable
+{
+public:
+    AsyncWork(QV4::ExecutionEngine *v4, QV4::ReturnedValue callback);
+    virtual ~AsyncWork();
+
+    void run() override;
+
+    virtual void execute() = 0;
+    virtual void complete(QV4::ExecutionEngine *v4);
+
+    virtual int resultCount() const { return 0; }
+    virtual void results(QV4::ExecutionEngine *v4, QV4::Value *args);
+
+    QV4::PersistentValue callback() const { return m_callback; }
+
+    int errorNo = 0;
+    QString syscall;
+    QString path;
+
+private:
+    EnginePrivate * const m_engine;
+    QV4::PersistentValue m_callback;
+};
+
+} // namespace NodeQml
+
+#endif // ASYNCWORK_H
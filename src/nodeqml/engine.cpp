@@ -1,16 +1,29 @@
 #include "engine.h"
 #include "engine_p.h"
 
+#include "asyncwork.h"
 #include "globalextensions.h"
+#include "iouring.h"
 #include "moduleobject.h"
+#include "modules/childprocess.h"
+#include "modules/events.h"
 #include "modules/filesystem.h"
+#include "modules/fsdir.h"
+#include "modules/fsstream.h"
+#include "modules/fswatcher.h"
 #include "modules/os.h"
 #include "modules/path.h"
+#include "modules/stringdecoder.h"
 #include "modules/util.h"
+#include "modules/workerthreads.h"
 #include "types/buffer.h"
+#include "types/direntry.h"
 #include "types/errnoexception.h"
+#include "types/stats.h"
 
+#include <QAtomicInt>
 #include <QCoreApplication>
+#include <QFileInfo>
 #include <QJSEngine>
 #include <QTimerEvent>
 
@@ -37,17 +50,39 @@ public:
 
     static QEvent::Type eventType()
     {
-        if (m_type == QEvent::None)
-            m_type = static_cast<QEvent::Type>(QEvent::registerEventType());
-        return m_type;
+        static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+        return type;
     }
 
 private:
-    static QEvent::Type m_type;
     QV4::PersistentValue m_callback;
 };
 
-QEvent::Type NextTickEvent::m_type = QEvent::None;
+namespace {
+const int DefaultThreadPoolSize = 4;
+
+// Changed whenever an engine is registered or removed, which invalidates the lookup caches
+QAtomicInt engineGeneration(1);
+
+// The engine last looked up on this thread, usually the only one the thread runs
+struct EngineCache {
+    QV4::ExecutionEngine *v4 = nullptr;
+    EnginePrivate *engine = nullptr;
+    int generation = 0;
+};
+thread_local EngineCache engineCache;
+
+// How often slices waiting for compaction are checked, in milliseconds
+const int CompactionInterval = 1000;
+// Checks after which a slice whose allocation is still shared is given up on
+const int MaxCompactionPasses = 8;
+
+QEvent::Type workDoneEventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+}
 
 Engine::Engine(QJSEngine *jsEngine, QObject *parent) :
     QObject(parent),
@@ -56,6 +91,12 @@ Engine::Engine(QJSEngine *jsEngine, QObject *parent) :
 
 }
 
+QJSEngine *Engine::jsEngine() const
+{
+    Q_D(const Engine);
+    return d->m_jsEngine;
+}
+
 QJSValue Engine::require(const QString &id)
 {
     Q_D(Engine);
@@ -70,20 +111,117 @@ bool Engine::hasException() const
     return d->m_v4->hasException;
 }
 
+/*!
+  Configures compaction of Buffer slices. A slice of an allocation of at least
+  \a minAllocationSize bytes that covers no more than \a maxSliceRatio of it is checked
+  periodically from the event loop. Once it is the only holder of the allocation, it is copied
+  out so that the allocation can be freed. A slice whose allocation stays shared for several checks
+  is given up on. Setting \a minAllocationSize to 0 disables compaction.
+*/
+void Engine::setSliceCompaction(int minAllocationSize, qreal maxSliceRatio)
+{
+    Q_D(Engine);
+    d->sliceCompactionMinSize = minAllocationSize;
+    d->sliceCompactionRatio = maxSliceRatio;
+}
+
+/*!
+  Returns the total number of bytes released by Buffer slice compaction.
+*/
+qint64 Engine::sliceCompactionReclaimed() const
+{
+    Q_D(const Engine);
+    return d->sliceCompactionReclaimed;
+}
+
+/*!
+  Sets the maximum number of threads used for asynchronous operations, such as \c fs callbacks.
+  The default can be changed with the \c UV_THREADPOOL_SIZE environment variable.
+*/
+void Engine::setThreadPoolSize(int size)
+{
+    Q_D(Engine);
+    d->setThreadPoolSize(size);
+}
+
+/*!
+  Enables or disables executing file system operations through io_uring. When enabled, support
+  is detected at runtime and operations the kernel cannot handle still use the thread pool.
+  Returns whether io_uring is in use. It is enabled by default unless the
+  \c NODEQML_DISABLE_IO_URING environment variable is set.
+*/
+bool Engine::setIoUringEnabled(bool enabled)
+{
+    Q_D(Engine);
+    return d->setIoUringEnabled(enabled);
+}
+
+/*!
+  Enables or disables hot reloading of modules. While enabled, the directories of loaded modules
+  are watched, and a module whose file changes is removed from the module cache, so that the next
+  require() loads it again. \l moduleInvalidated() is emitted for every such module.
+*/
+void Engine::setModuleReloadEnabled(bool enabled)
+{
+    Q_D(Engine);
+    d->setModuleReloadEnabled(enabled);
+}
+
+/*!
+  Prepares the engine for running another script, as done by \l EnginePool. Timers, pending
+  \c process.nextTick() callbacks, the module cache and an uncaught exception are dropped. Globals
+  and core modules are left as they are.
+
+  Returns false if operations that cannot be cancelled are still pending, such as file system
+  requests, watchers, child processes or workers, in which case the engine should not be reused.
+  This includes unref'd handles, which no longer keep the engine running.
+*/
+bool Engine::reset()
+{
+    Q_D(Engine);
+    return d->reset();
+}
+
+QReadWriteLock EnginePrivate::m_nodeEnginesLock;
 QHash<QV4::ExecutionEngine *, EnginePrivate*> EnginePrivate::m_nodeEngines;
 
+/*!
+  \internal
+  Returns the Node engine of \a v4, or null if it has been destroyed. Repeated lookups of the same
+  engine on a thread are served from a thread-local cache without locking.
+*/
 EnginePrivate *EnginePrivate::get(QV4::ExecutionEngine *v4)
 {
-    return m_nodeEngines.value(v4);
+    EngineCache &cache = engineCache;
+    if (cache.v4 == v4 && cache.generation == engineGeneration.loadAcquire())
+        return cache.engine;
+
+    QReadLocker locker(&m_nodeEnginesLock);
+    // Cannot change while the lock is held
+    cache.generation = engineGeneration.load();
+    cache.v4 = v4;
+    cache.engine = m_nodeEngines.value(v4);
+    return cache.engine;
 }
 
 EnginePrivate::EnginePrivate(QJSEngine *jsEngine, Engine *engine) :
     QObject(engine),
     q_ptr(engine),
-    m_v4(QV8Engine::getV4(jsEngine))
+    m_jsEngine(jsEngine),
+    m_v4(QV8Engine::getV4(jsEngine)),
+    m_outputSink(new OutputSink(this))
 {
-    /// TODO: Mutex
-    m_nodeEngines.insert(m_v4, this);
+    {
+        QWriteLocker locker(&m_nodeEnginesLock);
+        m_nodeEngines.insert(m_v4, this);
+        engineGeneration.fetchAndAddRelease(1);
+    }
+
+    bool ok;
+    const int threadPoolSize = qgetenv("UV_THREADPOOL_SIZE").toInt(&ok);
+    setThreadPoolSize(ok ? threadPoolSize : DefaultThreadPoolSize);
+    if (qEnvironmentVariableIsEmpty("NODEQML_DISABLE_IO_URING"))
+        setIoUringEnabled(true);
 
     NodeQml::GlobalExtensions::init(m_v4);
     registerTypes();
@@ -93,7 +231,15 @@ EnginePrivate::EnginePrivate(QJSEngine *jsEngine, Engine *engine) :
 
 EnginePrivate::~EnginePrivate()
 {
+    m_threadPool.waitForDone();
+    delete m_ioUring;
+    qDeleteAll(m_doneWork);
+    delete m_outputSink;
+
+    QWriteLocker locker(&m_nodeEnginesLock);
     m_nodeEngines.remove(m_v4);
+    // A new engine could reuse the address of m_v4
+    engineGeneration.fetchAndAddRelease(1);
 }
 
 /*!
@@ -105,8 +251,11 @@ void EnginePrivate::doneCheck()
 {
     Q_Q(Engine);
     qApp->processEvents();
-    if (m_intervalCallbacks.isEmpty() && m_timeoutCallbacks.isEmpty())
+    if (m_intervalCallbacks.isEmpty() && m_timeoutCallbacks.isEmpty() && !m_pendingWork
+            && !m_activeHandles) {
+        m_outputSink->waitForWritten();
         emit q->quit();
+    }
 }
 
 void EnginePrivate::exceptionCheck()
@@ -118,12 +267,23 @@ void EnginePrivate::exceptionCheck()
 
     QV4::Scope scope(m_v4);
     QV4::StackTrace stackTrace;
-    QV4::ScopedObject ex(scope, m_v4->catchException(&stackTrace));
+    QV4::ScopedValue exception(scope, m_v4->catchException(&stackTrace));
+
+    // The parent of a worker gets the exception as an 'error' event
+    if (workerThread) {
+        workerThread->reportError(m_v4, exception);
+        emit q->quit(1);
+        return;
+    }
+
+    QV4::ScopedObject ex(scope, exception);
 
     /// TODO: Move output to nodeqml binary
     QV4::ScopedString id_message(scope, m_v4->newString(QStringLiteral("message")));
     QV4::ScopedValue message(scope, ex->get(id_message));
 
+    // Keep console output ahead of the exception
+    m_outputSink->waitForWritten();
     qDebug("Exception: %s", qPrintable(message->toQStringNoThrow()));
     foreach (const QV4::StackFrame &frame, stackTrace) {
         qDebug("    at %s (%s:%d:%d)",
@@ -154,6 +314,9 @@ void EnginePrivate::cacheModule(const QString &id, Heap::ModuleObject *module)
     QV4::Scope scope(m_v4);
     QV4::ScopedObject o(scope, module);
     m_cachedModules[id].set(m_v4, o);
+
+    if (m_moduleReload)
+        watchModuleDirectory(id);
 }
 
 bool EnginePrivate::hasCachedModule(const QString &id) const
@@ -168,6 +331,74 @@ Heap::ModuleObject *EnginePrivate::cachedModule(const QString &id) const
     return module->d();
 }
 
+void EnginePrivate::uncacheModule(const QString &id)
+{
+    m_cachedModules.remove(id);
+}
+
+void EnginePrivate::setModuleReloadEnabled(bool enabled)
+{
+    if (enabled == m_moduleReload)
+        return;
+    m_moduleReload = enabled;
+
+    if (enabled) {
+        foreach (const QString &id, m_cachedModules.keys())
+            watchModuleDirectory(id);
+        return;
+    }
+
+    if (m_fileWatcher) {
+        foreach (const QString &directory, m_moduleDirectories)
+            m_fileWatcher->unwatch(directory, this);
+    }
+    m_moduleDirectories.clear();
+}
+
+/*!
+  \internal
+  Watches the directory containing the module \a filename rather than the file itself, so that
+  editors replacing the file on save are noticed as well.
+*/
+void EnginePrivate::watchModuleDirectory(const QString &filename)
+{
+    // Bundled modules cannot change
+    if (filename.startsWith(QLatin1Char(':')))
+        return;
+
+    const QString directory = QFileInfo(filename).absolutePath();
+    if (m_moduleDirectories.contains(directory))
+        return;
+
+    FileWatcher *watcher = fileWatcher();
+    if (!watcher)
+        return;
+
+    const int error = watcher->watch(directory, this);
+    if (error) {
+        qWarning("Cannot watch module directory %s: %s", qPrintable(directory), strerror(error));
+        return;
+    }
+    m_moduleDirectories.insert(directory);
+}
+
+void EnginePrivate::fileChanged(const QString &path, const QString &name, int events)
+{
+    Q_Q(Engine);
+
+    if (events & FileWatcher::Removed) {
+        m_moduleDirectories.remove(path);
+        return;
+    }
+
+    const QString filename = path + QLatin1Char('/') + name;
+    if (name.isEmpty() || !m_cachedModules.contains(filename))
+        return;
+
+    uncacheModule(filename);
+    emit q->moduleInvalidated(filename);
+}
+
 QV4::ReturnedValue EnginePrivate::require(const QString &id)
 {
     QV4::ReturnedValue returnValue(ModuleObject::require(m_v4, id));
@@ -177,6 +408,32 @@ QV4::ReturnedValue EnginePrivate::require(const QString &id)
     return returnValue;
 }
 
+bool EnginePrivate::reset()
+{
+    foreach (int timerId, m_timeoutCallbacks.keys())
+        killTimer(timerId);
+    m_timeoutCallbacks.clear();
+    foreach (int timerId, m_intervalCallbacks.keys())
+        killTimer(timerId);
+    m_intervalCallbacks.clear();
+    QCoreApplication::removePostedEvents(this, NextTickEvent::eventType());
+
+    // Reloading stays enabled for the modules loaded next
+    if (m_fileWatcher) {
+        foreach (const QString &directory, m_moduleDirectories)
+            m_fileWatcher->unwatch(directory, this);
+    }
+    m_moduleDirectories.clear();
+    m_cachedModules.clear();
+
+    if (m_v4->hasException)
+        m_v4->catchException();
+    m_outputSink->waitForWritten();
+
+    // Unref'd handles do not keep the engine running, but would still call into it
+    return !m_pendingWork && !m_openHandles;
+}
+
 QV4::ReturnedValue EnginePrivate::setTimeout(QV4::CallContext *ctx)
 {
     NODE_CTX_CALLDATA(ctx);
@@ -289,17 +546,240 @@ QV4::ReturnedValue EnginePrivate::nextTick(QV4::CallContext *ctx)
     return QV4::Encode::undefined();
 }
 
-QV4::ReturnedValue EnginePrivate::throwErrnoException(int errorNo, const QString &syscall)
+QV4::ReturnedValue EnginePrivate::newErrnoException(int errorNo, const QString &syscall,
+                                                     const QString &path)
 {
     const QString message = QString::fromLocal8Bit(strerror(errorNo));
 
     QV4::Scope scope(m_v4);
-    QV4::ScopedObject o(scope, m_v4->memoryManager->alloc<ErrnoExceptionObject>(m_v4, message, errorNo, syscall));
+    QV4::ScopedObject o(scope, m_v4->memoryManager->alloc<ErrnoExceptionObject>(m_v4, message, errorNo, syscall, path));
+    return o.asReturnedValue();
+}
+
+QV4::ReturnedValue EnginePrivate::throwErrnoException(int errorNo, const QString &syscall,
+                                                       const QString &path)
+{
+    QV4::Scope scope(m_v4);
+    QV4::ScopedObject o(scope, newErrnoException(errorNo, syscall, path));
     return m_v4->throwError(o);
 }
 
+/*!
+  \internal
+  Starts \a work on the thread pool. The engine takes ownership of \a work.
+*/
+void EnginePrivate::queueWork(AsyncWork *work)
+{
+    ++m_pendingWork;
+    m_threadPool.start(work);
+}
+
+/*!
+  \internal
+  Starts \a request through io_uring if available and supported for this request, or on the
+  thread pool otherwise.
+*/
+void EnginePrivate::queueFsRequest(FsRequest *request)
+{
+    if (m_ioUring && m_ioUring->submit(request)) {
+        ++m_pendingWork;
+        return;
+    }
+    queueWork(request);
+}
+
+/*!
+  \internal
+  Called from a worker thread once \a work has been executed. Finished work is collected in a
+  queue and a single event is posted for the whole batch, so that completions arriving close to
+  each other are delivered in one pass of the event loop.
+*/
+void EnginePrivate::workDone(AsyncWork *work)
+{
+    QMutexLocker locker(&m_doneWorkMutex);
+    const bool wasEmpty = m_doneWork.isEmpty();
+    m_doneWork.append(work);
+    if (wasEmpty)
+        qApp->postEvent(this, new QEvent(workDoneEventType()));
+}
+
+void EnginePrivate::setThreadPoolSize(int size)
+{
+    m_threadPool.setMaxThreadCount(qMax(1, size));
+}
+
+/*!
+  \internal
+  Returns the inotify watcher shared by fs.watch(), fs.watchFile() and module reloading, or null if
+  file watching is not available.
+*/
+FileWatcher *EnginePrivate::fileWatcher()
+{
+    if (!m_fileWatcher)
+        m_fileWatcher = new FileWatcher(this);
+    return m_fileWatcher->isValid() ? m_fileWatcher : nullptr;
+}
+
+/*!
+  \internal
+  Counts a handle, such as a file watcher, from its start until it is closed, whether it keeps the
+  engine running or not. An engine with open handles cannot be reset.
+*/
+void EnginePrivate::openHandle()
+{
+    ++m_openHandles;
+}
+
+void EnginePrivate::closeHandle()
+{
+    Q_ASSERT(m_openHandles > 0);
+    --m_openHandles;
+}
+
+/*!
+  \internal
+  Keeps the engine from quitting while a handle, such as a persistent file watcher, is active.
+*/
+void EnginePrivate::refHandle()
+{
+    ++m_activeHandles;
+}
+
+void EnginePrivate::unrefHandle()
+{
+    Q_ASSERT(m_activeHandles > 0);
+    --m_activeHandles;
+}
+
+/*!
+  \internal
+  Accounts for a Buffer referencing \a data. The allocation is added to the external memory by
+  the first Buffer referencing it.
+*/
+void EnginePrivate::retainBufferData(const QTypedArrayDataSlice<char> &data)
+{
+    if (data.isNull())
+        return;
+
+    int &count = m_bufferAllocations[data.arrayData()];
+    if (!count++)
+        bufferExternalSize += data.allocatedSize();
+}
+
+/*!
+  \internal
+  Reverts \l retainBufferData() for \a data. The allocation is subtracted from the external
+  memory once the last Buffer referencing it is gone.
+*/
+void EnginePrivate::releaseBufferData(const QTypedArrayDataSlice<char> &data)
+{
+    if (data.isNull())
+        return;
+
+    QHash<const void *, int>::iterator it = m_bufferAllocations.find(data.arrayData());
+    if (it == m_bufferAllocations.end())
+        return;
+    if (!--*it) {
+        bufferExternalSize -= data.allocatedSize();
+        m_bufferAllocations.erase(it);
+    }
+}
+
+/*!
+  \internal
+  Queues \a slice, a small slice of a large allocation, for compaction by \l compactSlices().
+  Only the most recent slice of an allocation is kept, so slicing one Buffer in a loop does not
+  grow the queue.
+*/
+void EnginePrivate::addCompactionCandidate(Heap::Buffer *slice)
+{
+    CompactionCandidate &candidate = m_compactionCandidates[slice->data.arrayData()];
+    candidate.slice.set(m_v4, slice);
+    if (!m_compactionTimer)
+        m_compactionTimer = startTimer(CompactionInterval);
+}
+
+/*!
+  \internal
+  Copies queued slices that have become the only holder of their allocation into memory of their
+  own, so the allocation is released. Runs from the event loop, where no native code holds
+  pointers into Buffer data. Collected slices are dropped. Those still sharing their allocation
+  are checked again later, up to MaxCompactionPasses times, as the parent may be long-lived.
+*/
+void EnginePrivate::compactSlices()
+{
+    QV4::Scope scope(m_v4);
+    QV4::Scoped<Buffer> buffer(scope);
+
+    QHash<const void *, CompactionCandidate>::iterator it = m_compactionCandidates.begin();
+    while (it != m_compactionCandidates.end()) {
+        buffer = it->slice.value();
+        if (buffer && buffer->d()->data.isShared() && ++it->passes < MaxCompactionPasses) {
+            ++it;
+            continue;
+        }
+
+        if (buffer && !buffer->d()->data.isShared()) {
+            QTypedArrayDataSlice<char> &data = buffer->d()->data;
+            const int allocatedSize = data.allocatedSize();
+            releaseBufferData(data);
+            if (data.detach())
+                sliceCompactionReclaimed += allocatedSize - data.size();
+            retainBufferData(data);
+        }
+        it = m_compactionCandidates.erase(it);
+    }
+
+    if (m_compactionCandidates.isEmpty()) {
+        killTimer(m_compactionTimer);
+        m_compactionTimer = 0;
+    }
+}
+
+bool EnginePrivate::setIoUringEnabled(bool enabled)
+{
+    if (!enabled) {
+        delete m_ioUring;
+        m_ioUring = nullptr;
+        return false;
+    }
+
+    if (!m_ioUring) {
+        m_ioUring = new IoUring(this);
+        if (!m_ioUring->isValid()) {
+            delete m_ioUring;
+            m_ioUring = nullptr;
+        }
+    }
+    return m_ioUring;
+}
+
+void EnginePrivate::processDoneWork()
+{
+    QList<AsyncWork *> doneWork;
+    {
+        QMutexLocker locker(&m_doneWorkMutex);
+        doneWork.swap(m_doneWork);
+    }
+
+    foreach (AsyncWork *work, doneWork) {
+        --m_pendingWork;
+        work->complete(m_v4);
+        delete work;
+        exceptionCheck();
+    }
+
+    doneCheck();
+}
+
 void EnginePrivate::customEvent(QEvent *event)
 {
+    if (event->type() == workDoneEventType()) {
+        event->accept();
+        processDoneWork();
+        return;
+    }
+
     if (event->type() != NextTickEvent::eventType()) {
         QObject::customEvent(event);
         return;
@@ -319,6 +799,12 @@ void EnginePrivate::timerEvent(QTimerEvent *event)
 {
     const int timerId = event->timerId();
 
+    if (timerId == m_compactionTimer) {
+        event->accept();
+        compactSlices();
+        return;
+    }
+
     QV4::Scope scope(m_v4);
     QV4::ScopedFunctionObject cb(scope);
 
@@ -353,14 +839,60 @@ void EnginePrivate::registerTypes()
     bufferCtor = m_v4->memoryManager->alloc<BufferCtor>(rootContext);
     bufferPrototype = m_v4->memoryManager->alloc<BufferPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
     static_cast<BufferPrototype *>(bufferPrototype.asObject())->init(m_v4, bufferCtor.asObject());
+
+    eventEmitterCtor = m_v4->memoryManager->alloc<EventEmitterCtor>(rootContext);
+    eventEmitterPrototype = m_v4->memoryManager->alloc<EventEmitterPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<EventEmitterPrototype *>(eventEmitterPrototype.asObject())->init(m_v4, eventEmitterCtor.asObject());
+
+    statsPrototype = m_v4->memoryManager->alloc<StatsPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<StatsPrototype *>(statsPrototype.asObject())->init(m_v4);
+
+    direntPrototype = m_v4->memoryManager->alloc<DirentPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<DirentPrototype *>(direntPrototype.asObject())->init(m_v4);
+
+    directoryWalkerPrototype = m_v4->memoryManager->alloc<DirectoryWalkerPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<DirectoryWalkerPrototype *>(directoryWalkerPrototype.asObject())->init(m_v4);
+
+    fileReadStreamPrototype = m_v4->memoryManager->alloc<FileReadStreamPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<FileReadStreamPrototype *>(fileReadStreamPrototype.asObject())->init(m_v4);
+
+    fileWriteStreamPrototype = m_v4->memoryManager->alloc<FileWriteStreamPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<FileWriteStreamPrototype *>(fileWriteStreamPrototype.asObject())->init(m_v4);
+
+    fsWatcherPrototype = m_v4->memoryManager->alloc<FSWatcherPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<FSWatcherPrototype *>(fsWatcherPrototype.asObject())->init(m_v4);
+
+    statWatcherPrototype = m_v4->memoryManager->alloc<StatWatcherPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<StatWatcherPrototype *>(statWatcherPrototype.asObject())->init(m_v4);
+
+    childProcessPrototype = m_v4->memoryManager->alloc<ChildProcessPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<ChildProcessPrototype *>(childProcessPrototype.asObject())->init(m_v4);
+
+    childPipePrototype = m_v4->memoryManager->alloc<ChildPipePrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<ChildPipePrototype *>(childPipePrototype.asObject())->init(m_v4);
+
+    stringDecoderCtor = m_v4->memoryManager->alloc<StringDecoderCtor>(rootContext);
+    stringDecoderPrototype = m_v4->memoryManager->alloc<StringDecoderPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<StringDecoderPrototype *>(stringDecoderPrototype.asObject())->init(m_v4, stringDecoderCtor.asObject());
+
+    workerCtor = m_v4->memoryManager->alloc<WorkerCtor>(rootContext);
+    workerPrototype = m_v4->memoryManager->alloc<WorkerPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<WorkerPrototype *>(workerPrototype.asObject())->init(m_v4, workerCtor.asObject());
+
+    messagePortPrototype = m_v4->memoryManager->alloc<MessagePortPrototype>(m_v4->emptyClass, m_v4->objectPrototype.asObject());
+    static_cast<MessagePortPrototype *>(messagePortPrototype.asObject())->init(m_v4);
 }
 
 void EnginePrivate::registerModules()
 {
     QV4::Scope scope(m_v4);
     QV4::ScopedObject o(scope);
+    m_coreModules[QStringLiteral("child_process")].set(m_v4, (o = m_v4->memoryManager->alloc<ChildProcessModule>(m_v4)).asReturnedValue());
+    m_coreModules[QStringLiteral("events")].set(m_v4, eventEmitterCtor);
     m_coreModules[QStringLiteral("fs")].set(m_v4, (o = m_v4->memoryManager->alloc<FileSystemModule>(m_v4)).asReturnedValue());
     m_coreModules[QStringLiteral("os")].set(m_v4, (o = m_v4->memoryManager->alloc<OsModule>(m_v4)).asReturnedValue());
     m_coreModules[QStringLiteral("path")].set(m_v4, (o = m_v4->memoryManager->alloc<PathModule>(m_v4)).asReturnedValue());
+    m_coreModules[QStringLiteral("string_decoder")].set(m_v4, (o = m_v4->memoryManager->alloc<StringDecoderModule>(m_v4)).asReturnedValue());
     m_coreModules[QStringLiteral("util")].set(m_v4, (o = m_v4->memoryManager->alloc<UtilModule>(m_v4)).asReturnedValue());
+    m_coreModules[QStringLiteral("worker_threads")].set(m_v4, (o = m_v4->memoryManager->alloc<WorkerThreadsModule>(m_v4)).asReturnedValue());
 }
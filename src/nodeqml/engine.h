@@ -19,13 +19,26 @@ public:
 
     explicit Engine(QJSEngine *jsEngine, QObject *parent = nullptr);
 
+    QJSEngine *jsEngine() const;
+
     QJSValue require(const QString &id);
     /// TODO: QJSValue evaluate(const QString &code);
 
     bool hasException() const;
 
+    void setSliceCompaction(int minAllocationSize, qreal maxSliceRatio);
+    qint64 sliceCompactionReclaimed() const;
+
+    void setThreadPoolSize(int size);
+    bool setIoUringEnabled(bool enabled);
+
+    void setModuleReloadEnabled(bool enabled);
+
+    bool reset();
+
 signals:
     void quit(int returnCode = 0);
+    void moduleInvalidated(const QString &filename);
 
 private:
     EnginePrivate * const d_ptr;
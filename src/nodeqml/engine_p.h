@@ -1,8 +1,18 @@
 #ifndef ENGINE_P_H
 #define ENGINE_P_H
 
+#include "filewatcher.h"
+#include "outputsink.h"
+#include "util/bufferpool.h"
+#include "util/formatcache.h"
+
 #include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
 #include <QObject>
+#include <QThreadPool>
 
 #include <private/qv4engine_p.h>
 #include <private/qv4persistent_p.h>
@@ -12,13 +22,18 @@ class QJSEngine;
 namespace NodeQml {
 
 namespace Heap {
+struct Buffer;
 struct ModuleObject;
 }
 
+class AsyncWork;
 class Engine;
+class FsRequest;
+class IoUring;
 struct ModuleObject;
+class WorkerThread;
 
-class EnginePrivate : public QObject
+class EnginePrivate : public QObject, private FileWatcher::Listener
 {
     Q_OBJECT
 public:
@@ -36,8 +51,11 @@ public:
     void cacheModule(const QString& id, Heap::ModuleObject *module);
     bool hasCachedModule(const QString &id) const;
     Heap::ModuleObject *cachedModule(const QString &id) const;
+    void uncacheModule(const QString &id);
+    void setModuleReloadEnabled(bool enabled);
 
     QV4::ReturnedValue require(const QString &id);
+    bool reset();
 
     QV4::ReturnedValue setTimeout(QV4::CallContext *ctx);
     QV4::ReturnedValue clearTimeout(QV4::CallContext *ctx);
@@ -47,7 +65,27 @@ public:
 
     QV4::ReturnedValue nextTick(QV4::CallContext *ctx);
 
-    QV4::ReturnedValue throwErrnoException(int errorNo, const QString &syscall);
+    QV4::ReturnedValue newErrnoException(int errorNo, const QString &syscall,
+                                         const QString &path = QString());
+    QV4::ReturnedValue throwErrnoException(int errorNo, const QString &syscall,
+                                           const QString &path = QString());
+
+    void queueWork(AsyncWork *work);
+    void queueFsRequest(FsRequest *request);
+    void workDone(AsyncWork *work);
+    void setThreadPoolSize(int size);
+    bool setIoUringEnabled(bool enabled);
+
+    FileWatcher *fileWatcher();
+    OutputSink *outputSink() const { return m_outputSink; }
+    void openHandle();
+    void closeHandle();
+    void refHandle();
+    void unrefHandle();
+
+    void retainBufferData(const QTypedArrayDataSlice<char> &data);
+    void releaseBufferData(const QTypedArrayDataSlice<char> &data);
+    void addCompactionCandidate(Heap::Buffer *slice);
 
 public:
     QV4::Value bufferCtor;
@@ -55,6 +93,46 @@ public:
 
     QV4::Value errnoExceptionPrototype;
 
+    QV4::Value eventEmitterCtor;
+    QV4::Value eventEmitterPrototype;
+
+    QV4::Value statsPrototype;
+    QV4::Value direntPrototype;
+    QV4::Value directoryWalkerPrototype;
+
+    QV4::Value fileReadStreamPrototype;
+    QV4::Value fileWriteStreamPrototype;
+    // Memory for chunks read by file streams
+    BufferPool streamBufferPool;
+
+    // Tokenized util.format() strings
+    FormatCache formatCache;
+
+    QV4::Value fsWatcherPrototype;
+    QV4::Value statWatcherPrototype;
+    // fs.watchFile() watchers by absolute path
+    QHash<QString, QV4::PersistentValue> statWatchers;
+
+    QV4::Value childProcessPrototype;
+    QV4::Value childPipePrototype;
+
+    QV4::Value stringDecoderCtor;
+    QV4::Value stringDecoderPrototype;
+
+    QV4::Value workerCtor;
+    QV4::Value workerPrototype;
+    QV4::Value messagePortPrototype;
+    // Set if this engine runs a worker_threads Worker
+    WorkerThread *workerThread = nullptr;
+
+    // Buffer slice compaction, see compactSlices()
+    int sliceCompactionMinSize = 1024 * 1024;
+    qreal sliceCompactionRatio = 0.125;
+    qint64 sliceCompactionReclaimed = 0;
+    // Bytes of the allocations referenced by live Buffers, the external memory of
+    // process.memoryUsage(). Slices and views of an allocation count it once.
+    qint64 bufferExternalSize = 0;
+
 protected:
     void customEvent(QEvent *event) override;
     void timerEvent(QTimerEvent *event) override;
@@ -66,6 +144,13 @@ private:
     void registerTypes();
     void registerModules();
 
+    void processDoneWork();
+    void compactSlices();
+
+    void fileChanged(const QString &path, const QString &name, int events) override;
+    void watchModuleDirectory(const QString &filename);
+
+    QJSEngine * const m_jsEngine;
     QV4::ExecutionEngine *m_v4;
 
     QHash<QString, QV4::PersistentValue> m_coreModules;
@@ -74,6 +159,37 @@ private:
     QHash<int, QV4::PersistentValue> m_timeoutCallbacks;
     QHash<int, QV4::PersistentValue> m_intervalCallbacks;
 
+    QThreadPool m_threadPool;
+    int m_pendingWork = 0;
+    QMutex m_doneWorkMutex;
+    QList<AsyncWork *> m_doneWork;
+    IoUring *m_ioUring = nullptr;
+
+    FileWatcher *m_fileWatcher = nullptr;
+    OutputSink *m_outputSink;
+    // Watchers and other handles that exist, whether they keep the engine running or not
+    int m_openHandles = 0;
+    // Open handles keeping the engine from quitting, i.e. not unref'd
+    int m_activeHandles = 0;
+    bool m_moduleReload = false;
+
+    // Number of live Buffers per allocation, see retainBufferData()
+    QHash<const void *, int> m_bufferAllocations;
+
+    struct CompactionCandidate {
+        // The most recent small slice of the allocation
+        QV4::WeakValue slice;
+        // Checks that found the allocation still shared
+        int passes = 0;
+    };
+    // Keyed by allocation, checked for compaction by m_compactionTimer
+    QHash<const void *, CompactionCandidate> m_compactionCandidates;
+    int m_compactionTimer = 0;
+    QSet<QString> m_moduleDirectories;
+
+    // Engines can be created and destroyed on worker threads. Only lookups missing the
+    // thread-local cache of get() take the lock.
+    static QReadWriteLock m_nodeEnginesLock;
     static QHash<QV4::ExecutionEngine *, EnginePrivate*> m_nodeEngines;
 };
 
@@ -0,0 +1,156 @@
+#include "enginepool.h"
+
+#include "engine.h"
+
+#include <QJSEngine>
+#include <QList>
+#include <QSet>
+
+using namespace NodeQml;
+
+namespace NodeQml {
+
+class EnginePoolPrivate
+{
+public:
+    Engine *create();
+    void destroy(Engine *engine);
+
+    int maxEngines;
+    QList<Engine *> idle;
+    QSet<Engine *> active;
+    EnginePool::Statistics statistics;
+};
+
+}
+
+Engine *EnginePoolPrivate::create()
+{
+    return new Engine(new QJSEngine());
+}
+
+void EnginePoolPrivate::destroy(Engine *engine)
+{
+    // The Node engine goes first, as it refers to the JS engine
+    QJSEngine *jsEngine = engine->jsEngine();
+    delete engine;
+    delete jsEngine;
+}
+
+/*!
+  \class NodeQml::EnginePool
+  Hands out initialized engines for short jobs, each with its own QJSEngine, and takes them back
+  for reuse, which saves setting up the global object, native types and core modules per job.
+  At most \a maxEngines engines exist at a time.
+
+  A released engine is reset with \l {Engine::reset}, which clears its module cache, timers and
+  pending callbacks. Changes a job made to globals or core modules are not undone. An engine whose
+  job left operations running, such as watchers or child processes, is destroyed instead.
+
+  The pool and its engines belong to the thread that created the pool.
+*/
+EnginePool::EnginePool(int maxEngines) :
+    d_ptr(new EnginePoolPrivate)
+{
+    Q_D(EnginePool);
+    d->maxEngines = qMax(1, maxEngines);
+}
+
+EnginePool::~EnginePool()
+{
+    Q_D(EnginePool);
+    if (!d->active.isEmpty())
+        qWarning("EnginePool: destroyed with %d engines in use", d->active.size());
+    foreach (Engine *engine, d->idle)
+        d->destroy(engine);
+    foreach (Engine *engine, d->active)
+        d->destroy(engine);
+    delete d;
+}
+
+int EnginePool::maxEngines() const
+{
+    Q_D(const EnginePool);
+    return d->maxEngines;
+}
+
+/*!
+  Returns the number of engines acquired and not yet released.
+*/
+int EnginePool::activeCount() const
+{
+    Q_D(const EnginePool);
+    return d->active.size();
+}
+
+/*!
+  Returns the number of initialized engines waiting to be acquired.
+*/
+int EnginePool::idleCount() const
+{
+    Q_D(const EnginePool);
+    return d->idle.size();
+}
+
+/*!
+  Initializes idle engines until \a count are available, as far as the limit allows, so that the
+  first jobs do not pay for initialization.
+*/
+void EnginePool::warmUp(int count)
+{
+    Q_D(EnginePool);
+    count = qMin(count, d->maxEngines - d->active.size());
+    while (d->idle.size() < count)
+        d->idle.append(d->create());
+}
+
+/*!
+  Returns an idle engine, or a new one if there is none. Returns null if the limit of engines in
+  use has been reached. The engine must be handed back with \l release().
+*/
+Engine *EnginePool::acquire()
+{
+    Q_D(EnginePool);
+
+    Engine *engine = nullptr;
+    if (!d->idle.isEmpty()) {
+        engine = d->idle.takeLast();
+        ++d->statistics.hits;
+    } else if (d->active.size() < d->maxEngines) {
+        engine = d->create();
+        ++d->statistics.misses;
+    } else {
+        ++d->statistics.rejected;
+        return nullptr;
+    }
+
+    d->active.insert(engine);
+    return engine;
+}
+
+/*!
+  Takes back \a engine once its job is done. Connections to its signals are removed.
+*/
+void EnginePool::release(Engine *engine)
+{
+    Q_D(EnginePool);
+
+    if (!d->active.remove(engine)) {
+        qWarning("EnginePool: releasing an engine not acquired from this pool");
+        return;
+    }
+
+    QObject::disconnect(engine, nullptr, nullptr, nullptr);
+    if (!engine->reset()) {
+        ++d->statistics.discarded;
+        d->destroy(engine);
+        return;
+    }
+    d->idle.append(engine);
+}
+
+EnginePool::Statistics EnginePool::statistics() const
+{
+    Q_D(const EnginePool);
+    return d->statistics;
+}
@@ -0,0 +1,50 @@
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include "nodeqml_global.h"
+
+#include <QtGlobal>
+
+namespace NodeQml {
+
+class Engine;
+class EnginePoolPrivate;
+
+class NODEQMLSHARED_EXPORT EnginePool
+{
+public:
+    struct Statistics {
+        // acquire() calls served by an idle engine
+        int hits = 0;
+        // acquire() calls that had to initialize a new engine
+        int misses = 0;
+        // acquire() calls refused because all engines were in use
+        int rejected = 0;
+        // Released engines destroyed because they could not be reset
+        int discarded = 0;
+    };
+
+    explicit EnginePool(int maxEngines);
+    ~EnginePool();
+
+    int maxEngines() const;
+    int activeCount() const;
+    int idleCount() const;
+
+    void warmUp(int count);
+
+    Engine *acquire();
+    void release(Engine *engine);
+
+    Statistics statistics() const;
+
+private:
+    Q_DISABLE_COPY(EnginePool)
+
+    EnginePoolPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(EnginePool)
+};
+
+}
+
+#endif // ENGINEPOOL_H
@@ -0,0 +1,241 @@
+#include "filewatcher.h"
+
+#include "engine_p.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QFile>
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#  include <sys/inotify.h>
+#endif
+
+using namespace NodeQml;
+
+namespace {
+
+QEvent::Type flushEventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+#ifdef Q_OS_LINUX
+// Same set of events libuv watches for
+const uint32_t WatchMask = IN_ATTRIB | IN_CREATE | IN_MODIFY | IN_DELETE | IN_DELETE_SELF
+        | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO;
+
+int toEvents(uint32_t mask)
+{
+    int events = 0;
+    if (mask & (IN_ATTRIB | IN_MODIFY))
+        events |= FileWatcher::Change;
+    if (mask & ~(IN_ATTRIB | IN_MODIFY))
+        events |= FileWatcher::Rename;
+    return events;
+}
+#endif
+
+} // namespace
+
+FileWatcher::FileWatcher(EnginePrivate *engine) :
+    QObject(engine),
+    m_engine(engine)
+{
+#ifdef Q_OS_LINUX
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd == -1) {
+        qWarning("Cannot initialize inotify: %s", strerror(errno));
+        return;
+    }
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &FileWatcher::readEvents);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (m_fd != -1)
+        ::close(m_fd);
+}
+
+/*!
+  \internal
+  Starts delivering events for \a path to \a listener. Several listeners may watch the same path,
+  which is still watched only once. Returns 0 on success or an errno value.
+*/
+int FileWatcher::watch(const QString &path, Listener *listener)
+{
+#ifdef Q_OS_LINUX
+    if (m_fd == -1)
+        return ENOSYS;
+
+    const int wd = inotify_add_watch(m_fd, QFile::encodeName(path).constData(), WatchMask);
+    if (wd == -1)
+        return errno;
+
+    // Paths resolving to the same inode share the watch descriptor
+    Watch &watch = m_watches[wd];
+    const Subscription subscription { listener, path };
+    if (!watch.subscriptions.contains(subscription))
+        watch.subscriptions.append(subscription);
+    m_paths.insert(path, wd);
+    return 0;
+#else
+    Q_UNUSED(path)
+    Q_UNUSED(listener)
+    return ENOSYS;
+#endif
+}
+
+void FileWatcher::unwatch(const QString &path, Listener *listener)
+{
+    const int wd = m_paths.value(path, -1);
+    if (wd == -1)
+        return;
+
+    QHash<int, Watch>::iterator it = m_watches.find(wd);
+    if (it == m_watches.end())
+        return;
+
+    it->subscriptions.removeOne(Subscription { listener, path });
+    if (!it->subscriptions.isEmpty()) {
+        bool pathWatched = false;
+        foreach (const Subscription &subscription, it->subscriptions)
+            pathWatched |= subscription.path == path;
+        if (!pathWatched)
+            m_paths.remove(path);
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    inotify_rm_watch(m_fd, wd);
+#endif
+    removeWatch(wd);
+}
+
+void FileWatcher::customEvent(QEvent *event)
+{
+    if (event->type() != flushEventType()) {
+        QObject::customEvent(event);
+        return;
+    }
+
+    event->accept();
+    m_flushPosted = false;
+    flush();
+}
+
+void FileWatcher::postFlush()
+{
+    // A flush in progress posts the next one when it is done
+    if (m_pending.isEmpty() || m_flushPosted || m_flushing)
+        return;
+
+    m_flushPosted = true;
+    qApp->postEvent(this, new QEvent(flushEventType()));
+}
+
+void FileWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        const ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (const char *p = buffer; p < buffer + length; ) {
+            const struct inotify_event *e = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + e->len;
+
+            if (e->mask & IN_Q_OVERFLOW) {
+                // Events were lost, let every listener rescan
+                foreach (int wd, m_watches.keys())
+                    queueEvent(wd, QString(), Rename | Change);
+                continue;
+            }
+
+            if (!m_watches.contains(e->wd))
+                continue;
+
+            if (e->mask & IN_IGNORED) {
+                queueEvent(e->wd, QString(), Removed);
+                continue;
+            }
+
+            const QString name = e->len ? QFile::decodeName(e->name) : QString();
+            queueEvent(e->wd, name, toEvents(e->mask));
+        }
+    }
+#endif
+
+    postFlush();
+}
+
+void FileWatcher::queueEvent(int wd, const QString &name, int events)
+{
+    const QPair<int, QString> key(wd, name);
+    const int index = m_pendingIndex.value(key, -1);
+    if (index != -1) {
+        m_pending[index].events |= events;
+        return;
+    }
+
+    m_pendingIndex.insert(key, m_pending.size());
+    m_pending.append(PendingEvent { wd, name, events });
+}
+
+void FileWatcher::removeWatch(int wd)
+{
+    m_watches.remove(wd);
+    QHash<QString, int>::iterator it = m_paths.begin();
+    while (it != m_paths.end()) {
+        if (it.value() == wd)
+            it = m_paths.erase(it);
+        else
+            ++it;
+    }
+}
+
+/*!
+  \internal
+  Delivers the events merged since the last flush. Listeners may stop watching, or start watching
+  other paths, while events are delivered. Events read while delivering, e.g. when a callback
+  processes events, are left for the next flush, and the engine only checks for completion once
+  all events have been delivered.
+*/
+void FileWatcher::flush()
+{
+    QList<PendingEvent> pending;
+    pending.swap(m_pending);
+    m_pendingIndex.clear();
+    m_flushing = true;
+
+    foreach (const PendingEvent &event, pending) {
+        if (!m_watches.contains(event.wd))
+            continue;
+
+        const QList<Subscription> subscriptions = m_watches.value(event.wd).subscriptions;
+        foreach (const Subscription &subscription, subscriptions) {
+            // Skip listeners removed by an earlier callback
+            if (!m_watches.value(event.wd).subscriptions.contains(subscription))
+                continue;
+            subscription.listener->fileChanged(subscription.path, event.name, event.events);
+            m_engine->exceptionCheck();
+        }
+
+        if (event.events & Removed)
+            removeWatch(event.wd);
+    }
+
+    m_flushing = false;
+    postFlush();
+    m_engine->doneCheck();
+}
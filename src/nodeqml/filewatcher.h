@@ -0,0 +1,104 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+
+class QSocketNotifier;
+
+namespace NodeQml {
+
+class EnginePrivate;
+
+/*!
+  \internal
+  Watches files and directories through a single inotify descriptor integrated into the event
+  loop.
+
+  Events read from the descriptor are not delivered right away: they are merged per watched path
+  and entry name, and delivered once the event loop gets to the posted flush event. A file saved
+  with several writes is thus reported once rather than once per write.
+*/
+class FileWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    enum Event {
+        Rename = 0x1,  // Entry created, deleted or moved
+        Change = 0x2,  // Contents or attributes modified
+        Removed = 0x4  // The watched path itself is gone, no more events follow
+    };
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        /*!
+          Called with the path passed to watch(), the name of the affected entry for directories
+          (empty for the watched path itself), and a combination of Event flags.
+        */
+        virtual void fileChanged(const QString &path, const QString &name, int events) = 0;
+    };
+
+    explicit FileWatcher(EnginePrivate *engine);
+    ~FileWatcher();
+
+    bool isValid() const { return m_fd != -1; }
+
+    int watch(const QString &path, Listener *listener);
+    void unwatch(const QString &path, Listener *listener);
+
+protected:
+    void customEvent(QEvent *event) override;
+
+private slots:
+    void readEvents();
+
+private:
+    // A listener and the path it passed to watch()
+    struct Subscription {
+        Listener *listener;
+        QString path;
+
+        bool operator==(const Subscription &other) const
+        {
+            return listener == other.listener && path == other.path;
+        }
+    };
+
+    struct Watch {
+        // Paths resolving to the same inode share the watch descriptor, but each listener gets
+        // events with its own path
+        QList<Subscription> subscriptions;
+    };
+
+    struct PendingEvent {
+        int wd;
+        QString name;
+        int events;
+    };
+
+    void queueEvent(int wd, const QString &name, int events);
+    void postFlush();
+    void removeWatch(int wd);
+    void flush();
+
+    EnginePrivate * const m_engine;
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+
+    QHash<int, Watch> m_watches;
+    QHash<QString, int> m_paths;
+
+    // Events waiting for the flush, with an index to merge events for the same entry
+    QList<PendingEvent> m_pending;
+    QHash<QPair<int, QString>, int> m_pendingIndex;
+    bool m_flushPosted = false;
+    // Set while flush() delivers events, a nested flush waits until it is done
+    bool m_flushing = false;
+};
+
+} // namespace NodeQml
+
+#endif // FILEWATCHER_H
@@ -0,0 +1,594 @@
+#include "iouring.h"
+
+#include "engine_p.h"
+#include "modules/fsrequest.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QSocketNotifier>
+#include <QTimerEvent>
+#include <QVarLengthArray>
+
+#ifdef NODEQML_HAVE_IO_URING
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <linux/io_uring.h>
+#  include <string.h>
+#  include <sys/eventfd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/syscall.h>
+#  include <sys/sysmacros.h>
+#  include <unistd.h>
+#endif
+
+using namespace NodeQml;
+
+#ifdef NODEQML_HAVE_IO_URING
+
+namespace {
+const unsigned QueueDepth = 256;
+// Milliseconds before submitting again when the kernel was out of resources
+const int RetryInterval = 10;
+
+QEvent::Type flushEventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+int ioUringSetup(unsigned entries, io_uring_params *params)
+{
+    return ::syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned argc)
+{
+    return ::syscall(__NR_io_uring_register, fd, opcode, arg, argc);
+}
+
+inline void fromStatxTimestamp(struct timespec *ts, const struct statx_timestamp &stx)
+{
+    ts->tv_sec = stx.tv_sec;
+    ts->tv_nsec = stx.tv_nsec;
+}
+
+void fromStatx(struct stat *st, const struct statx &stx)
+{
+    memset(st, 0, sizeof(*st));
+    st->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    st->st_ino = stx.stx_ino;
+    st->st_mode = stx.stx_mode;
+    st->st_nlink = stx.stx_nlink;
+    st->st_uid = stx.stx_uid;
+    st->st_gid = stx.stx_gid;
+    st->st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+    st->st_size = stx.stx_size;
+    st->st_blksize = stx.stx_blksize;
+    st->st_blocks = stx.stx_blocks;
+    fromStatxTimestamp(&st->st_atim, stx.stx_atime);
+    fromStatxTimestamp(&st->st_mtim, stx.stx_mtime);
+    fromStatxTimestamp(&st->st_ctim, stx.stx_ctime);
+}
+
+int opcode(FsRequest::Type type)
+{
+    switch (type) {
+    case FsRequest::Open:
+        return IORING_OP_OPENAT;
+    case FsRequest::Close:
+        return IORING_OP_CLOSE;
+    case FsRequest::Read:
+        return IORING_OP_READ;
+    case FsRequest::Write:
+        return IORING_OP_WRITE;
+    case FsRequest::Readv:
+        return IORING_OP_READV;
+    case FsRequest::Writev:
+        return IORING_OP_WRITEV;
+    case FsRequest::Stat:
+    case FsRequest::Lstat:
+    case FsRequest::Fstat:
+        return IORING_OP_STATX;
+    case FsRequest::Fsync:
+        return IORING_OP_FSYNC;
+    default:
+        return -1;
+    }
+}
+
+const char *syscallName(FsRequest::Type type)
+{
+    switch (type) {
+    case FsRequest::Open:
+        return "open";
+    case FsRequest::Close:
+        return "close";
+    case FsRequest::Read:
+    case FsRequest::Readv:
+        return "read";
+    case FsRequest::Write:
+    case FsRequest::Writev:
+        return "write";
+    case FsRequest::Stat:
+        return "stat";
+    case FsRequest::Lstat:
+        return "lstat";
+    case FsRequest::Fstat:
+        return "fstat";
+    case FsRequest::Fsync:
+        return "fsync";
+    default:
+        return "";
+    }
+}
+}
+
+struct IoUring::Ring
+{
+    ~Ring();
+
+    bool setup();
+
+    int fd = -1;
+    int eventFd = -1;
+    unsigned sqEntries = 0;
+    unsigned cqEntries = 0;
+
+    void *sqMap = MAP_FAILED;
+    size_t sqMapSize = 0;
+    void *cqMap = MAP_FAILED;
+    size_t cqMapSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    // Bit set of the supported IORING_OP_* opcodes
+    quint64 supportedOps = 0;
+};
+
+struct IoUring::Operation
+{
+    FsRequest *request;
+    // Bytes written so far, short writes are resubmitted
+    qint64 transferred = 0;
+    // First vector of writev() not written completely
+    int vectorIndex = 0;
+    struct statx statxBuf;
+};
+
+IoUring::Ring::~Ring()
+{
+    if (sqes != MAP_FAILED)
+        ::munmap(sqes, sqesSize);
+    if (cqMap != MAP_FAILED && cqMap != sqMap)
+        ::munmap(cqMap, cqMapSize);
+    if (sqMap != MAP_FAILED)
+        ::munmap(sqMap, sqMapSize);
+    if (eventFd >= 0)
+        ::close(eventFd);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool IoUring::Ring::setup()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    fd = ioUringSetup(QueueDepth, &params);
+    if (fd < 0)
+        return false;
+
+    sqEntries = params.sq_entries;
+    cqEntries = params.cq_entries;
+
+    sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap)
+        sqMapSize = cqMapSize = qMax(sqMapSize, cqMapSize);
+
+    sqMap = ::mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                   IORING_OFF_SQ_RING);
+    if (sqMap == MAP_FAILED)
+        return false;
+
+    cqMap = singleMap ? sqMap : ::mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cqMap == MAP_FAILED)
+        return false;
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED)
+        return false;
+
+    char *sq = static_cast<char *>(sqMap);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char *>(cqMap);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // The probe, and all opcodes used here, need Linux 5.6
+    const unsigned probeOps = 64;
+    QByteArray probeData(sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op), 0);
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(probeData.data());
+    if (ioUringRegister(fd, IORING_REGISTER_PROBE, probe, probeOps) < 0)
+        return false;
+    for (unsigned i = 0; i < probe->ops_len && i < probeOps; ++i) {
+        if ((probe->ops[i].flags & IO_URING_OP_SUPPORTED) && probe->ops[i].op < 64)
+            supportedOps |= Q_UINT64_C(1) << probe->ops[i].op;
+    }
+
+    eventFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (eventFd < 0)
+        return false;
+    if (ioUringRegister(fd, IORING_REGISTER_EVENTFD, &eventFd, 1) < 0)
+        return false;
+
+    return true;
+}
+
+IoUring::IoUring(EnginePrivate *engine) :
+    m_engine(engine),
+    m_ring(new Ring)
+{
+    if (!m_ring->setup()) {
+        m_ring.reset();
+        return;
+    }
+
+    m_notifier = new QSocketNotifier(m_ring->eventFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &IoUring::drainCompletions);
+}
+
+IoUring::~IoUring()
+{
+    // The kernel may still write into request buffers, wait for everything submitted
+    while (m_ring && m_inFlight) {
+        flush();
+        // What never reached the kernel is not written to, and would be waited for forever
+        if (m_inFlight == m_unsubmitted)
+            break;
+        if (ioUringEnter(m_ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            break;
+        drainCompletions();
+    }
+}
+
+bool IoUring::isValid() const
+{
+    return !m_ring.isNull();
+}
+
+/*!
+  \internal
+  Queues \a request for submission at the end of the current event loop pass. Returns \c false
+  if the operation is not supported or the ring is full, in which case the caller should execute
+  the request on the thread pool.
+*/
+bool IoUring::submit(FsRequest *request)
+{
+    if (!m_ring)
+        return false;
+
+    const int op = opcode(request->type);
+    if (op < 0 || !(m_ring->supportedOps & (Q_UINT64_C(1) << op)))
+        return false;
+    if (m_inFlight >= m_ring->cqEntries)
+        return false;
+
+    Operation *operation = new Operation;
+    operation->request = request;
+    if (!prepare(operation)) {
+        delete operation;
+        return false;
+    }
+
+    ++m_inFlight;
+    if (!m_flushPosted) {
+        m_flushPosted = true;
+        qApp->postEvent(this, new QEvent(flushEventType()));
+    }
+    return true;
+}
+
+void IoUring::customEvent(QEvent *event)
+{
+    if (event->type() != flushEventType()) {
+        QObject::customEvent(event);
+        return;
+    }
+
+    event->accept();
+    m_flushPosted = false;
+    flush();
+}
+
+void IoUring::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_retryTimer) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    killTimer(m_retryTimer);
+    m_retryTimer = 0;
+    flush();
+}
+
+bool IoUring::prepare(Operation *operation)
+{
+    Ring *ring = m_ring.data();
+    const unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    const unsigned tail = *ring->sqTail;
+    if (tail - head >= ring->sqEntries)
+        return false;
+
+    const unsigned index = tail & *ring->sqMask;
+    io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    FsRequest *request = operation->request;
+    sqe->opcode = opcode(request->type);
+    sqe->user_data = reinterpret_cast<quintptr>(operation);
+
+    switch (request->type) {
+    case FsRequest::Open:
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<quintptr>(request->encodedPath.constData());
+        sqe->len = request->mode;
+        sqe->open_flags = request->flags | O_CLOEXEC;
+        break;
+    case FsRequest::Close:
+    case FsRequest::Fsync:
+        sqe->fd = request->fd;
+        break;
+    case FsRequest::Read:
+        sqe->fd = request->fd;
+        sqe->addr = reinterpret_cast<quintptr>(request->data.data());
+        sqe->len = request->data.size();
+        sqe->off = request->position < 0 ? quint64(-1) : quint64(request->position);
+        break;
+    case FsRequest::Write:
+        sqe->fd = request->fd;
+        sqe->addr = reinterpret_cast<quintptr>(request->data.constData() + operation->transferred);
+        sqe->len = request->data.size() - operation->transferred;
+        sqe->off = request->position < 0 ? quint64(-1)
+                                         : quint64(request->position + operation->transferred);
+        break;
+    case FsRequest::Readv:
+    case FsRequest::Writev:
+        sqe->fd = request->fd;
+        sqe->addr = reinterpret_cast<quintptr>(request->vectors.constData() + operation->vectorIndex);
+        sqe->len = qMin(request->vectors.size() - operation->vectorIndex, int(FsRequest::MaxVectors));
+        sqe->off = request->position < 0 ? quint64(-1)
+                                         : quint64(request->position + operation->transferred);
+        break;
+    case FsRequest::Stat:
+    case FsRequest::Lstat:
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<quintptr>(request->encodedPath.constData());
+        sqe->statx_flags = request->type == FsRequest::Lstat ? AT_SYMLINK_NOFOLLOW : 0;
+        sqe->len = STATX_BASIC_STATS;
+        sqe->off = reinterpret_cast<quintptr>(&operation->statxBuf);
+        break;
+    case FsRequest::Fstat:
+        sqe->fd = request->fd;
+        sqe->addr = reinterpret_cast<quintptr>("");
+        sqe->statx_flags = AT_EMPTY_PATH;
+        sqe->len = STATX_BASIC_STATS;
+        sqe->off = reinterpret_cast<quintptr>(&operation->statxBuf);
+        break;
+    default:
+        return false;
+    }
+
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++m_unsubmitted;
+    return true;
+}
+
+// Hands all prepared operations to the kernel with a single system call
+void IoUring::flush()
+{
+    while (m_unsubmitted) {
+        const int submitted = ioUringEnter(m_ring->fd, m_unsubmitted, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR)
+                continue;
+            // Out of kernel resources. Draining completions flushes again, but without any
+            // operation in flight no completion comes, so a timer does
+            if (errno == EAGAIN || errno == EBUSY) {
+                if (m_inFlight == m_unsubmitted && !m_retryTimer)
+                    m_retryTimer = startTimer(RetryInterval);
+                return;
+            }
+            failUnsubmitted(errno);
+            return;
+        }
+        m_unsubmitted -= submitted;
+    }
+}
+
+/*!
+  \internal
+  Completes the operations that the kernel refused to take with \a error. Their entries are
+  taken back from the submission queue first, as completion callbacks may submit again.
+*/
+void IoUring::failUnsubmitted(int error)
+{
+    Ring *ring = m_ring.data();
+    const unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    const unsigned tail = *ring->sqTail;
+
+    QVarLengthArray<Operation *, 32> operations;
+    for (unsigned i = head; i != tail; ++i) {
+        const io_uring_sqe &sqe = ring->sqes[ring->sqArray[i & *ring->sqMask]];
+        operations.append(reinterpret_cast<Operation *>(static_cast<quintptr>(sqe.user_data)));
+    }
+    __atomic_store_n(ring->sqTail, head, __ATOMIC_RELEASE);
+    m_unsubmitted = 0;
+
+    for (Operation *operation : operations)
+        complete(operation, -error);
+}
+
+void IoUring::drainCompletions()
+{
+    Ring *ring = m_ring.data();
+
+    quint64 counter;
+    while (::read(ring->eventFd, &counter, sizeof(counter)) < 0 && errno == EINTR) { }
+
+    unsigned head = *ring->cqHead;
+    for (;;) {
+        const unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+            break;
+
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = ring->cqes[head & *ring->cqMask];
+            Operation *operation = reinterpret_cast<Operation *>(static_cast<quintptr>(cqe.user_data));
+            const int result = cqe.res;
+            // Release the entry before completing, completion may prepare new operations
+            __atomic_store_n(ring->cqHead, head + 1, __ATOMIC_RELEASE);
+            complete(operation, result);
+        }
+    }
+
+    flush();
+}
+
+void IoUring::complete(Operation *operation, int result)
+{
+    FsRequest *request = operation->request;
+
+    if (result < 0) {
+        request->errorNo = -result;
+        request->syscall = QString::fromLatin1(syscallName(request->type));
+    } else {
+        switch (request->type) {
+        case FsRequest::Open:
+        case FsRequest::Read:
+        case FsRequest::Readv:
+            request->result = result;
+            break;
+        case FsRequest::Writev:
+            operation->transferred += result;
+            operation->vectorIndex += FsRequest::consumeVectors(
+                        request->vectors.data() + operation->vectorIndex,
+                        request->vectors.size() - operation->vectorIndex, result);
+            if (result && operation->vectorIndex < request->vectors.size() && prepare(operation))
+                return;
+            request->result = operation->transferred;
+            break;
+        case FsRequest::Write:
+            operation->transferred += result;
+            if (result && operation->transferred < request->data.size() && prepare(operation))
+                return;
+            request->result = operation->transferred;
+            break;
+        case FsRequest::Stat:
+        case FsRequest::Lstat:
+        case FsRequest::Fstat:
+            fromStatx(&request->statBuf, operation->statxBuf);
+            break;
+        default:
+            break;
+        }
+    }
+
+    delete operation;
+    --m_inFlight;
+    m_engine->workDone(request);
+}
+
+#else // NODEQML_HAVE_IO_URING
+
+struct IoUring::Ring
+{
+};
+
+struct IoUring::Operation
+{
+};
+
+IoUring::IoUring(EnginePrivate *engine) :
+    m_engine(engine)
+{
+}
+
+IoUring::~IoUring()
+{
+}
+
+bool IoUring::isValid() const
+{
+    return false;
+}
+
+bool IoUring::submit(FsRequest *request)
+{
+    Q_UNUSED(request)
+    return false;
+}
+
+void IoUring::customEvent(QEvent *event)
+{
+    QObject::customEvent(event);
+}
+
+void IoUring::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+}
+
+bool IoUring::prepare(Operation *operation)
+{
+    Q_UNUSED(operation)
+    return false;
+}
+
+void IoUring::flush()
+{
+}
+
+void IoUring::failUnsubmitted(int error)
+{
+    Q_UNUSED(error)
+}
+
+void IoUring::drainCompletions()
+{
+}
+
+void IoUring::complete(Operation *operation, int result)
+{
+    Q_UNUSED(operation)
+    Q_UNUSED(result)
+}
+
+#endif // NODEQML_HAVE_IO_URING
@@ -0,0 +1,63 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <QObject>
+#include <QScopedPointer>
+
+class QSocketNotifier;
+
+namespace NodeQml {
+
+class EnginePrivate;
+class FsRequest;
+
+/*!
+  \internal
+  Executes file system requests through io_uring instead of the thread pool.
+
+  Requests submitted during one pass of the event loop are handed to the kernel together, and
+  all completions signaled through the eventfd are delivered to the engine in one batch. Only
+  operations reported by the kernel probe are accepted; submit() returns \c false for everything
+  else, and the request then goes to the thread pool.
+*/
+class IoUring : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IoUring(EnginePrivate *engine);
+    ~IoUring();
+
+    bool isValid() const;
+    bool submit(FsRequest *request);
+
+protected:
+    void customEvent(QEvent *event) override;
+    void timerEvent(QTimerEvent *event) override;
+
+private slots:
+    void drainCompletions();
+
+private:
+    struct Ring;
+    struct Operation;
+
+    bool prepare(Operation *operation);
+    void flush();
+    void failUnsubmitted(int error);
+    void complete(Operation *operation, int result);
+
+    EnginePrivate * const m_engine;
+    QScopedPointer<Ring> m_ring;
+    QSocketNotifier *m_notifier = nullptr;
+
+    // Operations prepared but not yet handed to the kernel
+    unsigned m_unsubmitted = 0;
+    unsigned m_inFlight = 0;
+    bool m_flushPosted = false;
+    // Retries a flush the kernel refused while none of our operations were in flight
+    int m_retryTimer = 0;
+};
+
+} // namespace NodeQml
+
+#endif // IOURING_H
@@ -0,0 +1,1674 @@
+#include "childprocess.h"
+
+#include "events.h"
+#include "stringdecoder.h"
+#include "../engine_p.h"
+#include "../util/eventemitter.h"
+
+#include <QFile>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QTimer>
+#include <QTimerEvent>
+#include <QVarLengthArray>
+
+#include <private/qv4context_p.h>
+#include <private/qv4mm_p.h>
+#include <private/qv4objectiterator_p.h>
+#include <private/qv4persistent_p.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+// posix_spawn_file_actions_addchdir_np() appeared in glibc 2.29
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define NODEQML_HAVE_SPAWN_CHDIR
+#endif
+
+extern char **environ;
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(ChildProcessModule);
+DEFINE_OBJECT_VTABLE(ChildProcess);
+DEFINE_OBJECT_VTABLE(ChildPipe);
+
+namespace {
+// Same read size as Node uses for pipes
+const int ReadSize = 64 * 1024;
+// Bounds the reads per wakeup, so that a chatty child cannot starve other event sources
+const int MaxReadsPerWakeup = 8;
+const int InputHighWaterMark = 16 * 1024;
+// Output held back for a 'data' listener stops reading at this size, like a paused stream
+const int OutputHighWaterMark = 64 * 1024;
+const int MinPollInterval = 1;
+const int MaxPollInterval = 50;
+
+struct SignalName {
+    const char *name;
+    int number;
+};
+
+const SignalName signalNames[] = {
+    { "SIGHUP", SIGHUP },
+    { "SIGINT", SIGINT },
+    { "SIGQUIT", SIGQUIT },
+    { "SIGILL", SIGILL },
+    { "SIGTRAP", SIGTRAP },
+    { "SIGABRT", SIGABRT },
+    { "SIGBUS", SIGBUS },
+    { "SIGFPE", SIGFPE },
+    { "SIGKILL", SIGKILL },
+    { "SIGUSR1", SIGUSR1 },
+    { "SIGSEGV", SIGSEGV },
+    { "SIGUSR2", SIGUSR2 },
+    { "SIGPIPE", SIGPIPE },
+    { "SIGALRM", SIGALRM },
+    { "SIGTERM", SIGTERM },
+    { "SIGCHLD", SIGCHLD },
+    { "SIGCONT", SIGCONT },
+    { "SIGSTOP", SIGSTOP },
+    { "SIGTSTP", SIGTSTP },
+    { "SIGTTIN", SIGTTIN },
+    { "SIGTTOU", SIGTTOU },
+    { "SIGURG", SIGURG },
+    { "SIGXCPU", SIGXCPU },
+    { "SIGXFSZ", SIGXFSZ },
+    { "SIGVTALRM", SIGVTALRM },
+    { "SIGPROF", SIGPROF },
+    { "SIGWINCH", SIGWINCH },
+    { "SIGIO", SIGIO },
+    { "SIGSYS", SIGSYS }
+};
+
+#ifndef NODEQML_HAVE_SPAWN_CHDIR
+/*
+  fork() and exec() for the options posix_spawn() cannot express. A failing exec() is reported
+  through a close-on-exec pipe, which is closed without data once exec() has succeeded.
+ */
+int forkExec(const SpawnOptions &options, char *const argv[], char *const envp[],
+             const int childFds[3], pid_t *pid)
+{
+    int errorPipe[2];
+    if (::pipe(errorPipe) < 0)
+        return errno;
+    ::fcntl(errorPipe[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(errorPipe[1], F_SETFD, FD_CLOEXEC);
+
+    const pid_t child = ::fork();
+    if (child < 0) {
+        const int error = errno;
+        ::close(errorPipe[0]);
+        ::close(errorPipe[1]);
+        return error;
+    }
+
+    if (!child) {
+        // Only async-signal-safe calls from here on
+        if (options.detached)
+            ::setsid();
+        for (int fd = 0; fd < 3; ++fd) {
+            if (childFds[fd] != -1)
+                ::dup2(childFds[fd], fd);
+        }
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = SIG_DFL;
+        for (int signal = 1; signal < NSIG; ++signal)
+            ::sigaction(signal, &action, nullptr);
+        sigset_t mask;
+        sigemptyset(&mask);
+        ::sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+        int error;
+        if (::chdir(options.cwd.constData()) < 0) {
+            error = errno;
+        } else {
+            environ = const_cast<char **>(envp);
+            ::execvp(options.file.constData(), argv);
+            error = errno;
+        }
+        ssize_t n;
+        do {
+            n = ::write(errorPipe[1], &error, sizeof(error));
+        } while (n < 0 && errno == EINTR);
+        ::_exit(127);
+    }
+
+    ::close(errorPipe[1]);
+    int error = 0;
+    ssize_t n;
+    do {
+        n = ::read(errorPipe[0], &error, sizeof(error));
+    } while (n < 0 && errno == EINTR);
+    ::close(errorPipe[0]);
+
+    if (n == sizeof(error)) {
+        ::waitpid(child, nullptr, 0);
+        return error;
+    }
+    *pid = child;
+    return 0;
+}
+#endif
+
+/*
+  Starts the child with posix_spawnp(), which glibc implements with a vfork-style clone: the
+  parent's memory is not copied and exec errors such as ENOENT are reported synchronously.
+ */
+int startProcess(const SpawnOptions &options, char *const argv[], char *const envp[],
+                 const int childFds[3], pid_t *pid)
+{
+#ifndef NODEQML_HAVE_SPAWN_CHDIR
+    if (!options.cwd.isEmpty())
+        return forkExec(options, argv, envp, childFds, pid);
+#endif
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (int fd = 0; fd < 3; ++fd) {
+        if (childFds[fd] != -1)
+            posix_spawn_file_actions_adddup2(&actions, childFds[fd], fd);
+    }
+#ifdef NODEQML_HAVE_SPAWN_CHDIR
+    if (!options.cwd.isEmpty())
+        posix_spawn_file_actions_addchdir_np(&actions, options.cwd.constData());
+#endif
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+    if (options.detached) {
+#ifdef POSIX_SPAWN_SETSID
+        flags |= POSIX_SPAWN_SETSID;
+#else
+        flags |= POSIX_SPAWN_SETPGROUP;
+#endif
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    // Signal handlers and the signal mask of the parent are not inherited
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigfillset(&signals);
+    sigdelset(&signals, SIGKILL);
+    sigdelset(&signals, SIGSTOP);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+
+    const int error = ::posix_spawnp(pid, options.file.constData(), &actions, &attr, argv, envp);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return error;
+}
+}
+
+namespace NodeQml {
+
+/*
+  Owns the stdio pipes and the exit notification of a child process. Everything is driven by the
+  event loop: the parent's ends of the pipes are watched by socket notifiers and the exit by a
+  pidfd, so no thread waits for the child. Output is read into chunks of the engine's stream
+  buffer pool. The handle keeps the ChildProcess object alive until 'close' has been emitted.
+ */
+class ChildProcessHandle : public QObject
+{
+public:
+    ChildProcessHandle(QV4::ExecutionEngine *v4, Heap::ChildProcess *process) :
+        m_v4(v4),
+        m_engine(EnginePrivate::get(v4)),
+        m_process(process),
+        m_keepAlive(v4, process->asReturnedValue())
+    {
+    }
+
+    ~ChildProcessHandle()
+    {
+        for (int fd = 0; fd < 3; ++fd)
+            closePipe(fd);
+        stopWatchingExit();
+    }
+
+    /*
+      Starts the child, returns an errno value if that failed. The pipes must be set up before
+      they are handed to the child, the streams are set afterwards with setStream().
+     */
+    int spawn(const SpawnOptions &options)
+    {
+        int childFds[3] = { -1, -1, -1 };
+        int error = 0;
+        for (int fd = 0; fd < 3 && !error; ++fd) {
+            switch (options.stdio[fd]) {
+            case SpawnOptions::Pipe: {
+                int fds[2];
+                if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+                    error = errno;
+                    break;
+                }
+                ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+                m_pipes[fd].fd = fds[0];
+                childFds[fd] = fds[1];
+                break;
+            }
+            case SpawnOptions::Ignore:
+                childFds[fd] = ::open("/dev/null", (fd ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+                if (childFds[fd] < 0)
+                    error = errno;
+                break;
+            case SpawnOptions::Fd:
+                // A copy above the stdio range cannot be replaced by the other dup2() calls
+                childFds[fd] = ::fcntl(options.stdioFds[fd], F_DUPFD_CLOEXEC, 3);
+                if (childFds[fd] < 0)
+                    error = errno;
+                break;
+            case SpawnOptions::Inherit:
+                break;
+            }
+        }
+
+        pid_t pid = 0;
+        if (!error) {
+            QVarLengthArray<char *, 16> argv;
+            foreach (const QByteArray &arg, options.args)
+                argv.append(const_cast<char *>(arg.constData()));
+            argv.append(nullptr);
+
+            QVarLengthArray<char *, 64> envp;
+            if (options.hasEnv) {
+                foreach (const QByteArray &variable, options.env)
+                    envp.append(const_cast<char *>(variable.constData()));
+                envp.append(nullptr);
+            }
+
+            error = startProcess(options, argv.data(), options.hasEnv ? envp.data() : environ,
+                                 childFds, &pid);
+        }
+
+        // The child has its own copies now
+        for (int fd = 0; fd < 3; ++fd) {
+            if (childFds[fd] != -1)
+                ::close(childFds[fd]);
+        }
+
+        if (error) {
+            for (int fd = 0; fd < 3; ++fd)
+                closePipe(fd);
+            spawnFailed(error, QFile::decodeName(options.file));
+            return error;
+        }
+
+        m_process->pid = pid;
+        for (int fd = 0; fd < 3; ++fd) {
+            Pipe &pipe = m_pipes[fd];
+            if (pipe.fd == -1)
+                continue;
+            if (fd == 0) {
+                // Only enabled while writes are pending
+                pipe.notifier = new QSocketNotifier(pipe.fd, QSocketNotifier::Write, this);
+                pipe.notifier->setEnabled(false);
+                connect(pipe.notifier, &QSocketNotifier::activated, this, [this]() {
+                    flushInput();
+                    m_engine->doneCheck();
+                });
+            } else {
+                pipe.notifier = new QSocketNotifier(pipe.fd, QSocketNotifier::Read, this);
+                connect(pipe.notifier, &QSocketNotifier::activated, this, [this, fd]() {
+                    readPipe(fd);
+                    finishIfDone();
+                    m_engine->doneCheck();
+                });
+            }
+        }
+
+        watchExit();
+        activate();
+        return 0;
+    }
+
+    void setStream(int fd, Heap::ChildPipe *stream)
+    {
+        m_pipes[fd].stream.set(m_v4, stream->asReturnedValue());
+    }
+
+    // Buffers the output for the callback of exec() and execFile()
+    void collectOutput(const QString &command, const QV4::Value &callback, BufferEncoding encoding,
+                       int maxBuffer)
+    {
+        m_collecting = true;
+        m_command = command;
+        m_callback.set(m_v4, callback);
+        m_encoding = encoding;
+        m_maxBuffer = maxBuffer;
+    }
+
+    void setTimeout(int msecs, int signal)
+    {
+        if (!m_active || m_process->exited)
+            return;
+        m_killSignal = signal;
+        m_timeoutTimer = startTimer(msecs);
+    }
+
+    bool isActive() const { return m_active; }
+
+    // Returns an errno value, ESRCH once the child has been reaped and its pid may be reused
+    int kill(int signal)
+    {
+        if (!m_process->pid || m_process->exited)
+            return ESRCH;
+        if (::kill(m_process->pid, signal) < 0)
+            return errno;
+        if (signal)
+            m_process->killed = true;
+        return 0;
+    }
+
+    void setReading(int fd, bool reading)
+    {
+        m_pipes[fd].reading = reading;
+        updateNotifier(fd);
+    }
+
+    /*
+      Delivers the output held back until a 'data' listener was attached to stream. This happens
+      from the event loop, like a Node stream starts flowing on the next tick.
+     */
+    void startFlowing(int fd, Heap::ChildPipe *stream)
+    {
+        if (m_pipes[fd].pending.isEmpty())
+            return;
+
+        const QV4::PersistentValue keepAlive(m_v4, stream->asReturnedValue());
+        QTimer::singleShot(0, this, [this, fd, keepAlive]() {
+            QV4::Scope scope(m_v4);
+            QV4::Scoped<ChildPipe> stream(scope, keepAlive.value());
+            Pipe &pipe = m_pipes[fd];
+            QList<QTypedArrayDataSlice<char> > pending;
+            pending.swap(pipe.pending);
+            pipe.pendingSize = 0;
+            // A listener removing itself has the rest held back again
+            foreach (const QTypedArrayDataSlice<char> &chunk, pending)
+                emitData(fd, stream->d(), chunk);
+            updateNotifier(fd);
+
+            if (pipe.endPending && pipe.pending.isEmpty()) {
+                pipe.endPending = false;
+                endStream(fd, stream->d());
+            }
+            if (m_closePending && !isOutputHeldBack())
+                emitClose();
+            m_engine->doneCheck();
+        });
+    }
+
+    bool isInputOpen() const { return m_pipes[0].fd != -1 && !m_inputEnding; }
+
+    // Returns false once the queued input has reached the high water mark
+    bool write(const QTypedArrayDataSlice<char> &data, const QV4::Value &callback)
+    {
+        Chunk chunk;
+        chunk.data = data;
+        if (callback.asFunctionObject())
+            chunk.callback.set(m_v4, callback);
+        m_input.append(chunk);
+        m_inputBuffered += data.size();
+
+        // Otherwise the write notifier is already waiting for the pipe to drain
+        if (!m_pipes[0].notifier->isEnabled())
+            flushInput();
+
+        if (m_inputBuffered < InputHighWaterMark)
+            return true;
+        m_needDrain = true;
+        return false;
+    }
+
+    void endInput()
+    {
+        m_inputEnding = true;
+        if (m_input.isEmpty() && m_pipes[0].fd != -1) {
+            closePipe(0);
+            endStream(0);
+        }
+    }
+
+protected:
+    void timerEvent(QTimerEvent *event) override
+    {
+        if (event->timerId() == m_timeoutTimer) {
+            killTimer(m_timeoutTimer);
+            m_timeoutTimer = 0;
+            kill(m_killSignal);
+        } else if (event->timerId() == m_pollTimer) {
+            reap();
+        }
+    }
+
+private:
+    struct Pipe {
+        int fd = -1;
+        QSocketNotifier *notifier = nullptr;
+        QV4::PersistentValue stream;
+        bool reading = true;
+        // Output read while the stream had no 'data' listener, and whether it ended meanwhile
+        QList<QTypedArrayDataSlice<char> > pending;
+        int pendingSize = 0;
+        bool endPending = false;
+    };
+
+    struct Chunk {
+        QTypedArrayDataSlice<char> data;
+        QV4::PersistentValue callback;
+    };
+
+    void activate()
+    {
+        m_active = true;
+        m_engine->openHandle();
+        if (m_process->referenced)
+            m_engine->refHandle();
+    }
+
+    // The 'error' event is emitted from the event loop, as in Node
+    void spawnFailed(int error, const QString &file)
+    {
+        m_spawnError = error;
+        m_file = file;
+        m_process->exited = true;
+        m_process->exitCode = -error;
+        activate();
+
+        QTimer::singleShot(0, this, [this]() {
+            if (!m_collecting) {
+                QV4::Scope scope(m_v4);
+                QV4::ScopedValue error(scope, m_engine->newErrnoException(
+                                           m_spawnError, QStringLiteral("spawn ") + m_file, m_file));
+                emitEvent(m_v4, m_process, QStringLiteral("error"), error.asReturnedValue(), 1);
+                m_engine->exceptionCheck();
+            }
+            finishIfDone();
+            m_engine->doneCheck();
+        });
+    }
+
+    void watchExit()
+    {
+#if defined(Q_OS_LINUX) && defined(SYS_pidfd_open)
+        // Readable once the child has exited, pidfds are always close-on-exec
+        m_pidFd = int(::syscall(SYS_pidfd_open, m_process->pid, 0));
+        if (m_pidFd != -1) {
+            m_exitNotifier = new QSocketNotifier(m_pidFd, QSocketNotifier::Read, this);
+            connect(m_exitNotifier, &QSocketNotifier::activated, this, [this]() { reap(); });
+            return;
+        }
+#endif
+        // Without pidfds (Linux < 5.3 and other systems) waitpid() is polled, frequently at first
+        // since most children are short-lived
+        m_pollInterval = MinPollInterval;
+        m_pollTimer = startTimer(m_pollInterval);
+    }
+
+    void stopWatchingExit()
+    {
+        if (m_exitNotifier) {
+            m_exitNotifier->setEnabled(false);
+            m_exitNotifier->deleteLater();
+            m_exitNotifier = nullptr;
+        }
+        if (m_pidFd != -1) {
+            ::close(m_pidFd);
+            m_pidFd = -1;
+        }
+        if (m_pollTimer) {
+            killTimer(m_pollTimer);
+            m_pollTimer = 0;
+        }
+    }
+
+    void reap()
+    {
+        int status = 0;
+        pid_t result;
+        do {
+            result = ::waitpid(m_process->pid, &status, WNOHANG);
+        } while (result < 0 && errno == EINTR);
+
+        if (!result) {
+            if (m_pollTimer) {
+                killTimer(m_pollTimer);
+                m_pollInterval = qMin(m_pollInterval * 2, MaxPollInterval);
+                m_pollTimer = startTimer(m_pollInterval);
+            }
+            return;
+        }
+
+        stopWatchingExit();
+        m_process->exited = true;
+        // Otherwise the child has been reaped elsewhere and its status is lost
+        if (result == m_process->pid) {
+            if (WIFSIGNALED(status))
+                m_process->signalCode = WTERMSIG(status);
+            else
+                m_process->exitCode = WEXITSTATUS(status);
+        }
+
+        QV4::Scope scope(m_v4);
+        QV4::ScopedCallData callData(scope, 2);
+        exitArguments(callData->args);
+        emitEvent(m_v4, m_process, QStringLiteral("exit"), callData->args, 2);
+        m_engine->exceptionCheck();
+
+        finishIfDone();
+        m_engine->doneCheck();
+    }
+
+    // The (code, signal) arguments of 'exit' and 'close'
+    void exitArguments(QV4::Value *args) const
+    {
+        if (m_process->signalCode) {
+            args[0] = QV4::Primitive::nullValue();
+            args[1] = m_v4->newString(ChildProcess::signalName(m_process->signalCode))->asReturnedValue();
+        } else {
+            args[0] = QV4::Primitive::fromInt32(m_process->exitCode);
+            args[1] = QV4::Primitive::nullValue();
+        }
+    }
+
+    void readPipe(int fd)
+    {
+        Pipe &pipe = m_pipes[fd];
+        BufferPool &pool = m_engine->streamBufferPool;
+        for (int reads = 0; reads < MaxReadsPerWakeup && isReading(fd); ++reads) {
+            QTypedArrayDataSlice<char> chunk = pool.reserve(ReadSize);
+            if (chunk.isNull())
+                return; // Out of memory, the notifier tries again
+
+            ssize_t n;
+            do {
+                n = ::read(pipe.fd, chunk.data(), chunk.size());
+            } while (n < 0 && errno == EINTR);
+            pool.release(chunk, n > 0 ? int(n) : 0);
+
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return;
+            if (n <= 0) {
+                // End of file, or an error such as ECONNRESET that ends the output as well
+                closePipe(fd);
+                endStream(fd);
+                return;
+            }
+            deliver(fd, QTypedArrayDataSlice<char>(chunk, 0, int(n)));
+        }
+    }
+
+    void deliver(int fd, const QTypedArrayDataSlice<char> &chunk)
+    {
+        if (m_collecting) {
+            QByteArray &output = m_output[fd];
+            output.append(chunk.constData(), chunk.size());
+            if (output.size() > m_maxBuffer) {
+                output.truncate(m_maxBuffer);
+                m_maxBufferExceeded = fd;
+                kill(SIGTERM);
+                for (int i = 1; i < 3; ++i) {
+                    closePipe(i);
+                    endStream(i);
+                }
+                return;
+            }
+        }
+
+        QV4::Scope scope(m_v4);
+        QV4::Scoped<ChildPipe> stream(scope, m_pipes[fd].stream.value());
+        if (stream)
+            emitData(fd, stream->d(), chunk);
+    }
+
+    // Emits 'data', or holds the chunk back until a listener is attached
+    void emitData(int fd, Heap::ChildPipe *pipeStream, const QTypedArrayDataSlice<char> &chunk)
+    {
+        QV4::Scope scope(m_v4);
+        QV4::Scoped<ChildPipe> stream(scope, pipeStream);
+        if (!EventEmitter::listenerCount(m_v4, stream, QStringLiteral("data"))) {
+            // The output of exec() and execFile() has been collected already
+            if (m_collecting)
+                return;
+            Pipe &pipe = m_pipes[fd];
+            pipe.pending.append(chunk);
+            pipe.pendingSize += chunk.size();
+            if (pipe.pendingSize >= OutputHighWaterMark)
+                updateNotifier(fd);
+            return;
+        }
+
+        QV4::ScopedValue data(scope);
+        if (stream->d()->decoder) {
+            const QString str = StringDecoder::decode(stream->d()->decoder, chunk.constData(),
+                                                      chunk.size());
+            if (str.isEmpty())
+                return;
+            data = m_v4->newString(str)->asReturnedValue();
+        } else {
+            data = m_v4->memoryManager->alloc<Buffer>(m_v4, chunk)->asReturnedValue();
+        }
+        emitEvent(m_v4, stream->d(), QStringLiteral("data"), data.asReturnedValue(), 1);
+        m_engine->exceptionCheck();
+    }
+
+    // Output is read unless paused, or while too much is held back for a 'data' listener
+    bool isReading(int fd) const
+    {
+        const Pipe &pipe = m_pipes[fd];
+        return pipe.fd != -1 && pipe.reading && pipe.pendingSize < OutputHighWaterMark;
+    }
+
+    void updateNotifier(int fd)
+    {
+        if (m_pipes[fd].notifier)
+            m_pipes[fd].notifier->setEnabled(isReading(fd));
+    }
+
+    void closePipe(int fd)
+    {
+        Pipe &pipe = m_pipes[fd];
+        if (pipe.notifier) {
+            // This may run from the notifier's own signal
+            pipe.notifier->setEnabled(false);
+            pipe.notifier->deleteLater();
+            pipe.notifier = nullptr;
+        }
+        if (pipe.fd != -1) {
+            ::close(pipe.fd);
+            pipe.fd = -1;
+        }
+    }
+
+    void endStream(int fd)
+    {
+        QV4::Scope scope(m_v4);
+        QV4::Scoped<ChildPipe> stream(scope, m_pipes[fd].stream.value());
+        if (stream)
+            endStream(fd, stream->d());
+    }
+
+    // Emits 'end' for stdout and stderr or 'finish' for stdin, and then 'close'. Output held back
+    // for a 'data' listener is delivered first.
+    void endStream(int fd, Heap::ChildPipe *pipeStream)
+    {
+        if (pipeStream->ended)
+            return;
+        if (!m_pipes[fd].pending.isEmpty()) {
+            m_pipes[fd].endPending = true;
+            return;
+        }
+
+        QV4::Scope scope(m_v4);
+        QV4::Scoped<ChildPipe> stream(scope, pipeStream);
+        stream->d()->ended = true;
+
+        if (fd && stream->d()->decoder) {
+            const QString rest = StringDecoder::flush(stream->d()->decoder);
+            if (!rest.isEmpty()) {
+                QV4::ScopedValue data(scope, m_v4->newString(rest));
+                emitEvent(m_v4, stream->d(), QStringLiteral("data"), data.asReturnedValue(), 1);
+                m_engine->exceptionCheck();
+            }
+        }
+
+        emitEvent(m_v4, stream->d(), fd ? QStringLiteral("end") : QStringLiteral("finish"));
+        m_engine->exceptionCheck();
+        emitEvent(m_v4, stream->d(), QStringLiteral("close"));
+        m_engine->exceptionCheck();
+    }
+
+    void flushInput()
+    {
+        Pipe &pipe = m_pipes[0];
+        QList<QV4::PersistentValue> callbacks;
+        int error = 0;
+        while (pipe.fd != -1 && !m_input.isEmpty()) {
+            const Chunk &chunk = m_input.first();
+            ssize_t n;
+            do {
+                // MSG_NOSIGNAL: a child that closed its stdin must not raise SIGPIPE here
+                n = ::send(pipe.fd, chunk.data.constData() + m_inputOffset,
+                           chunk.data.size() - m_inputOffset, MSG_NOSIGNAL);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    error = errno;
+                break;
+            }
+
+            m_inputOffset += n;
+            m_inputBuffered -= n;
+            if (m_inputOffset < chunk.data.size())
+                continue;
+            callbacks.append(chunk.callback);
+            m_input.removeFirst();
+            m_inputOffset = 0;
+        }
+        if (pipe.notifier)
+            pipe.notifier->setEnabled(!error && !m_input.isEmpty());
+
+        // Callbacks may write again, the queue is consistent by now
+        QV4::Scope scope(m_v4);
+        QV4::ScopedFunctionObject cb(scope);
+        foreach (const QV4::PersistentValue &callback, callbacks) {
+            cb = callback.value();
+            if (!cb)
+                continue;
+            QV4::ScopedCallData callData(scope, 1);
+            callData->thisObject = m_v4->globalObject();
+            callData->args[0] = QV4::Primitive::nullValue();
+            cb->call(callData);
+            m_engine->exceptionCheck();
+        }
+
+        if (error) {
+            inputFailed(error);
+            return;
+        }
+        if (!m_input.isEmpty() || m_pipes[0].fd == -1)
+            return;
+
+        if (m_needDrain) {
+            m_needDrain = false;
+            QV4::Scoped<ChildPipe> stream(scope, m_pipes[0].stream.value());
+            emitEvent(m_v4, stream->d(), QStringLiteral("drain"));
+            m_engine->exceptionCheck();
+        }
+        if (m_inputEnding && m_input.isEmpty() && m_pipes[0].fd != -1) {
+            closePipe(0);
+            endStream(0);
+        }
+    }
+
+    // Typically EPIPE, the child has closed its stdin
+    void inputFailed(int error)
+    {
+        m_input.clear();
+        m_inputBuffered = 0;
+        closePipe(0);
+
+        QV4::Scope scope(m_v4);
+        QV4::Scoped<ChildPipe> stream(scope, m_pipes[0].stream.value());
+        stream->d()->ended = true;
+        QV4::ScopedValue exception(scope, m_engine->newErrnoException(error, QStringLiteral("write")));
+        emitEvent(m_v4, stream->d(), QStringLiteral("error"), exception.asReturnedValue(), 1);
+        m_engine->exceptionCheck();
+        emitEvent(m_v4, stream->d(), QStringLiteral("close"));
+        m_engine->exceptionCheck();
+    }
+
+    bool isOutputHeldBack() const
+    {
+        for (int fd = 1; fd < 3; ++fd) {
+            if (!m_pipes[fd].pending.isEmpty() || m_pipes[fd].endPending)
+                return true;
+        }
+        return false;
+    }
+
+    /*
+      Releases the handle once the child has exited and its output has been read completely, and
+      emits 'close'. Like in Node, 'close' waits until stdout and stderr have ended, which output
+      held back for a 'data' listener delays. The engine may quit in the meantime.
+     */
+    void finishIfDone()
+    {
+        if (!m_active || !m_process->exited || m_pipes[1].fd != -1 || m_pipes[2].fd != -1)
+            return;
+
+        m_active = false;
+        if (m_timeoutTimer) {
+            killTimer(m_timeoutTimer);
+            m_timeoutTimer = 0;
+        }
+
+        // Nothing can be written to an exited child
+        if (m_pipes[0].fd != -1) {
+            m_input.clear();
+            m_inputBuffered = 0;
+            closePipe(0);
+            QV4::Scope scope(m_v4);
+            QV4::Scoped<ChildPipe> stream(scope, m_pipes[0].stream.value());
+            stream->d()->ended = true;
+            emitEvent(m_v4, stream->d(), QStringLiteral("close"));
+            m_engine->exceptionCheck();
+        }
+
+        if (m_collecting)
+            callExecCallback();
+
+        if (isOutputHeldBack())
+            m_closePending = true;
+        else
+            emitClose();
+
+        m_engine->closeHandle();
+        if (m_process->referenced)
+            m_engine->unrefHandle();
+        m_callback = QV4::PersistentValue();
+    }
+
+    void emitClose()
+    {
+        m_closePending = false;
+
+        QV4::Scope scope(m_v4);
+        QV4::ScopedCallData callData(scope, 2);
+        exitArguments(callData->args);
+        emitEvent(m_v4, m_process, QStringLiteral("close"), callData->args, 2);
+        m_engine->exceptionCheck();
+
+        for (int fd = 0; fd < 3; ++fd)
+            m_pipes[fd].stream = QV4::PersistentValue();
+        m_keepAlive = QV4::PersistentValue();
+    }
+
+    QV4::ReturnedValue output(int fd) const
+    {
+        const QByteArray &data = m_output[fd];
+        if (m_encoding == BufferEncoding::Raw)
+            return m_v4->memoryManager->alloc<Buffer>(m_v4, data)->asReturnedValue();
+        return m_v4->newString(Buffer::encodeData(data.constData(), data.size(), m_encoding))
+                ->asReturnedValue();
+    }
+
+    void setProperty(QV4::Object *o, const QString &name, const QV4::Value &value)
+    {
+        QV4::Scope scope(m_v4);
+        QV4::ScopedString s(scope, m_v4->newString(name));
+        o->put(s, value);
+    }
+
+    // callback(error, stdout, stderr)
+    void callExecCallback()
+    {
+        QV4::Scope scope(m_v4);
+        QV4::ScopedFunctionObject callback(scope, m_callback.value());
+        if (!callback)
+            return;
+
+        QV4::ScopedCallData callData(scope, 3);
+        callData->thisObject = m_v4->globalObject();
+        callData->args[1] = output(1);
+        callData->args[2] = output(2);
+
+        const Heap::ChildProcess *process = m_process;
+        QV4::ScopedObject error(scope);
+        QV4::ScopedValue v(scope);
+        if (m_spawnError) {
+            error = m_engine->newErrnoException(m_spawnError, QStringLiteral("spawn ") + m_file,
+                                                m_file);
+        } else if (m_maxBufferExceeded) {
+            const QString stream = m_maxBufferExceeded == 1 ? QStringLiteral("stdout")
+                                                            : QStringLiteral("stderr");
+            error = m_v4->newErrorObject(QStringLiteral("%1 maxBuffer length exceeded").arg(stream))
+                    ->asReturnedValue();
+            setProperty(error, QStringLiteral("code"),
+                        (v = m_v4->newString(QStringLiteral("ERR_CHILD_PROCESS_STDIO_MAXBUFFER"))));
+        } else if (process->exitCode || process->signalCode) {
+            const QString stderrText = Buffer::encodeData(m_output[2].constData(), m_output[2].size(),
+                                                          BufferEncoding::Utf8);
+            error = m_v4->newErrorObject(QStringLiteral("Command failed: %1\n%2")
+                                         .arg(m_command, stderrText))->asReturnedValue();
+            QV4::ScopedCallData exitArgs(scope, 2);
+            exitArguments(exitArgs->args);
+            setProperty(error, QStringLiteral("code"), exitArgs->args[0]);
+            setProperty(error, QStringLiteral("killed"), (v = QV4::Primitive::fromBoolean(process->killed)));
+            setProperty(error, QStringLiteral("signal"), exitArgs->args[1]);
+            setProperty(error, QStringLiteral("cmd"), (v = m_v4->newString(m_command)));
+        }
+        if (error)
+            callData->args[0] = error.asReturnedValue();
+        else
+            callData->args[0] = QV4::Primitive::nullValue();
+
+        callback->call(callData);
+        m_engine->exceptionCheck();
+    }
+
+    QV4::ExecutionEngine * const m_v4;
+    EnginePrivate * const m_engine;
+    Heap::ChildProcess * const m_process;
+    QV4::PersistentValue m_keepAlive;
+    bool m_active = false;
+    // The child has finished, but output is held back for a 'data' listener
+    bool m_closePending = false;
+
+    Pipe m_pipes[3];
+    QList<Chunk> m_input;
+    int m_inputOffset = 0;
+    qint64 m_inputBuffered = 0;
+    bool m_needDrain = false;
+    bool m_inputEnding = false;
+
+    int m_pidFd = -1;
+    QSocketNotifier *m_exitNotifier = nullptr;
+    int m_pollTimer = 0;
+    int m_pollInterval = MinPollInterval;
+
+    int m_spawnError = 0;
+    QString m_file;
+
+    int m_timeoutTimer = 0;
+    int m_killSignal = SIGTERM;
+
+    bool m_collecting = false;
+    QString m_command;
+    QV4::PersistentValue m_callback;
+    BufferEncoding m_encoding = BufferEncoding::Utf8;
+    int m_maxBuffer = 1024 * 1024;
+    int m_maxBufferExceeded = 0; // The fd whose output was cut off
+    QByteArray m_output[3];
+};
+
+} // namespace NodeQml
+
+namespace {
+QV4::ReturnedValue option(QV4::ExecutionEngine *v4, const QV4::Value &options, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    if (!o)
+        return QV4::Encode::undefined();
+    QV4::ScopedString s(scope, v4->newString(name));
+    return o->get(s);
+}
+
+bool parseEncodingOption(QV4::ExecutionEngine *v4, const QV4::Value &value, BufferEncoding *encoding)
+{
+    if (value.isNullOrUndefined())
+        return true;
+    *encoding = Buffer::parseEncoding(value.toQStringNoThrow());
+    if (*encoding == BufferEncoding::Invalid) {
+        v4->throwTypeError(QString("Unknown encoding: %1").arg(value.toQStringNoThrow()));
+        return false;
+    }
+    return true;
+}
+
+// The signal given as a name or a number, -1 after throwing if the name is unknown
+int parseSignal(QV4::ExecutionEngine *v4, const QV4::Value &value, int defaultSignal)
+{
+    if (value.isNullOrUndefined())
+        return defaultSignal;
+    if (value.isNumber())
+        return value.toInt32();
+
+    const QString name = value.toQStringNoThrow();
+    const int signal = ChildProcess::signalNumber(name);
+    if (signal == -1)
+        v4->throwTypeError(QStringLiteral("Unknown signal: %1").arg(name));
+    return signal;
+}
+
+bool parseArgs(QV4::ExecutionEngine *v4, const QV4::Value &args, SpawnOptions *options)
+{
+    options->args.append(options->file);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject array(scope, args);
+    if (!array)
+        return true;
+
+    QV4::ScopedValue v(scope);
+    const uint length = array->getLength();
+    for (uint i = 0; i < length; ++i) {
+        v = array->getIndexed(i);
+        if (v4->hasException)
+            return false;
+        options->args.append(v->toQStringNoThrow().toLocal8Bit());
+    }
+    return true;
+}
+
+bool parseEnv(QV4::ExecutionEngine *v4, const QV4::Value &env, SpawnOptions *options)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, env);
+    QV4::ObjectIterator it(scope, o, QV4::ObjectIterator::EnumerableOnly);
+    QV4::ScopedValue name(scope);
+    QV4::ScopedString key(scope);
+    QV4::ScopedValue value(scope);
+
+    options->hasEnv = true;
+    for (;;) {
+        name = it.nextPropertyNameAsString(value);
+        key = name;
+        if (v4->hasException)
+            return false;
+        if (!key)
+            return true;
+        if (value->isUndefined())
+            continue;
+        options->env.append(key->toQString().toLocal8Bit() + '='
+                            + value->toQStringNoThrow().toLocal8Bit());
+    }
+}
+
+bool parseStdioEntry(QV4::ExecutionEngine *v4, const QV4::Value &value, int fd,
+                     SpawnOptions *options)
+{
+    if (value.isNullOrUndefined()) {
+        options->stdio[fd] = SpawnOptions::Pipe;
+    } else if (value.isNumber()) {
+        const int n = value.toInt32();
+        if (n < 0) {
+            v4->throwTypeError(QStringLiteral("Invalid stdio file descriptor: %1").arg(n));
+            return false;
+        }
+        options->stdio[fd] = n == fd ? SpawnOptions::Inherit : SpawnOptions::Fd;
+        options->stdioFds[fd] = n;
+    } else {
+        const QString s = value.toQStringNoThrow();
+        if (s == QStringLiteral("pipe")) {
+            options->stdio[fd] = SpawnOptions::Pipe;
+        } else if (s == QStringLiteral("inherit")) {
+            options->stdio[fd] = SpawnOptions::Inherit;
+        } else if (s == QStringLiteral("ignore")) {
+            options->stdio[fd] = SpawnOptions::Ignore;
+        } else {
+            v4->throwTypeError(QStringLiteral("Unsupported stdio value: %1").arg(s));
+            return false;
+        }
+    }
+    return true;
+}
+
+// 'pipe', 'inherit', 'ignore' or an array of those and file descriptors. Only the first three
+// entries can be set up, 'ipc' and extra pipes are not supported.
+bool parseStdio(QV4::ExecutionEngine *v4, const QV4::Value &stdio, SpawnOptions *options)
+{
+    if (stdio.isNullOrUndefined())
+        return true;
+
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject array(scope, stdio);
+    if (!array) {
+        for (int fd = 0; fd < 3; ++fd) {
+            if (!parseStdioEntry(v4, stdio, fd, options))
+                return false;
+        }
+        return true;
+    }
+
+    QV4::ScopedValue v(scope);
+    const uint length = array->getLength();
+    for (uint i = 0; i < length; ++i) {
+        v = array->getIndexed(i);
+        if (v4->hasException)
+            return false;
+        if (i < 3) {
+            if (!parseStdioEntry(v4, v, i, options))
+                return false;
+        } else if (!v->isNullOrUndefined() && v->toQStringNoThrow() != QStringLiteral("ignore")) {
+            v4->throwTypeError(QStringLiteral("Only stdin, stdout and stderr can be set up"));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseSpawnOptions(QV4::ExecutionEngine *v4, const QV4::Value &options, bool withStdio,
+                       SpawnOptions *spawnOptions)
+{
+    if (options.isNullOrUndefined())
+        return true;
+    if (!options.isObject()) {
+        v4->throwTypeError(QStringLiteral("options must be an object"));
+        return false;
+    }
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue v(scope, option(v4, options, QStringLiteral("cwd")));
+    if (v->isString())
+        spawnOptions->cwd = QFile::encodeName(v->toQStringNoThrow());
+    v = option(v4, options, QStringLiteral("env"));
+    if (v->isObject() && !parseEnv(v4, v, spawnOptions))
+        return false;
+    v = option(v4, options, QStringLiteral("detached"));
+    spawnOptions->detached = v->toBoolean();
+    if (withStdio) {
+        v = option(v4, options, QStringLiteral("stdio"));
+        if (!parseStdio(v4, v, spawnOptions))
+            return false;
+    }
+    return !v4->hasException;
+}
+
+// Shared by exec() and execFile(), the output is buffered natively for \a callback
+QV4::ReturnedValue execute(QV4::ExecutionEngine *v4, SpawnOptions &spawnOptions,
+                           const QV4::Value &options, const QV4::Value &callback,
+                           const QString &command)
+{
+    if (!parseSpawnOptions(v4, options, false, &spawnOptions))
+        return QV4::Encode::undefined();
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    int timeout = 0;
+    int killSignal = SIGTERM;
+    int maxBuffer = 1024 * 1024;
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue v(scope, option(v4, options, QStringLiteral("encoding")));
+    if (v->isString() && v->toQStringNoThrow() == QStringLiteral("buffer"))
+        encoding = BufferEncoding::Raw;
+    else if (!parseEncodingOption(v4, v, &encoding))
+        return QV4::Encode::undefined();
+    v = option(v4, options, QStringLiteral("timeout"));
+    if (v->isNumber())
+        timeout = v->toInt32();
+    v = option(v4, options, QStringLiteral("killSignal"));
+    if ((killSignal = parseSignal(v4, v, SIGTERM)) == -1)
+        return QV4::Encode::undefined();
+    v = option(v4, options, QStringLiteral("maxBuffer"));
+    if (v->isNumber() && v->toNumber() > 0)
+        maxBuffer = int(qMin<double>(v->toNumber(), INT_MAX));
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
+    QV4::Scoped<ChildProcess> process(scope, ChildProcess::spawn(v4, spawnOptions));
+    if (!process)
+        return QV4::Encode::undefined();
+
+    ChildProcessHandle *handle = process->d()->handle;
+    if (callback.asFunctionObject())
+        handle->collectOutput(command, callback, encoding, maxBuffer);
+    if (timeout > 0)
+        handle->setTimeout(timeout, killSignal);
+    return process.asReturnedValue();
+}
+
+QTypedArrayDataSlice<char> chunkData(QV4::ExecutionEngine *v4, const QV4::Value &value,
+                                     BufferEncoding encoding)
+{
+    QV4::Scope scope(v4);
+    QV4::Scoped<Buffer> buffer(scope, value);
+    if (buffer)
+        return buffer->d()->data;
+
+    QTypedArrayData<char> *arrayData
+            = Buffer::fromString(Buffer::decodeString(value.toQStringNoThrow(), encoding));
+    if (!arrayData)
+        return QTypedArrayDataSlice<char>();
+    const QTypedArrayDataSlice<char> slice(arrayData);
+    arrayData->ref.deref(); // Disown data
+    return slice;
+}
+}
+
+Heap::ChildProcessModule::ChildProcessModule(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+
+    self->defineDefaultProperty(QStringLiteral("spawn"), NodeQml::ChildProcessModule::method_spawn, 3);
+    self->defineDefaultProperty(QStringLiteral("exec"), NodeQml::ChildProcessModule::method_exec, 3);
+    self->defineDefaultProperty(QStringLiteral("execFile"), NodeQml::ChildProcessModule::method_execFile, 4);
+}
+
+Heap::ChildProcess::ChildProcess(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->childProcessPrototype.asObject())
+{
+}
+
+Heap::ChildPipe::ChildPipe(QV4::ExecutionEngine *v4, ChildProcess *process, int fd) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->childPipePrototype.asObject()),
+    process(process),
+    fd(fd)
+{
+}
+
+// spawn(command, [args], [options])
+QV4::ReturnedValue ChildProcessModule::method_spawn(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue command(scope, callData->argument(0));
+    QV4::ScopedValue args(scope, callData->argument(1));
+    QV4::ScopedValue options(scope, callData->argument(2));
+    if (!command->isString())
+        return v4->throwTypeError(QStringLiteral("command must be a string"));
+    if (!args->asArrayObject() && options->isUndefined()) {
+        options = args;
+        args = QV4::Primitive::undefinedValue();
+    }
+
+    SpawnOptions spawnOptions;
+    spawnOptions.file = QFile::encodeName(command->toQStringNoThrow());
+    if (!parseArgs(v4, args, &spawnOptions) || !parseSpawnOptions(v4, options, true, &spawnOptions))
+        return QV4::Encode::undefined();
+
+    return ChildProcess::spawn(v4, spawnOptions);
+}
+
+// exec(command, [options], [callback])
+QV4::ReturnedValue ChildProcessModule::method_exec(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue command(scope, callData->argument(0));
+    QV4::ScopedValue options(scope, callData->argument(1));
+    QV4::ScopedValue callback(scope, callData->argument(2));
+    if (!command->isString())
+        return v4->throwTypeError(QStringLiteral("command must be a string"));
+    if (options->asFunctionObject()) {
+        callback = options;
+        options = QV4::Primitive::undefinedValue();
+    }
+
+    QString shell = QStringLiteral("/bin/sh");
+    QV4::ScopedValue v(scope, option(v4, options, QStringLiteral("shell")));
+    if (v->isString())
+        shell = v->toQStringNoThrow();
+
+    SpawnOptions spawnOptions;
+    spawnOptions.file = QFile::encodeName(shell);
+    spawnOptions.args << spawnOptions.file << QByteArrayLiteral("-c")
+                      << command->toQStringNoThrow().toLocal8Bit();
+    return execute(v4, spawnOptions, options, callback, command->toQStringNoThrow());
+}
+
+// execFile(file, [args], [options], [callback])
+QV4::ReturnedValue ChildProcessModule::method_execFile(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue file(scope, callData->argument(0));
+    if (!file->isString())
+        return v4->throwTypeError(QStringLiteral("file must be a string"));
+
+    QV4::ScopedValue args(scope);
+    QV4::ScopedValue options(scope);
+    QV4::ScopedValue callback(scope);
+    QV4::ScopedValue v(scope);
+    for (int i = 1; i < callData->argc; ++i) {
+        v = callData->args[i];
+        if (v->asFunctionObject()) {
+            callback = v;
+            break;
+        }
+        if (v->asArrayObject() && args->isUndefined() && options->isUndefined())
+            args = v;
+        else if (options->isUndefined())
+            options = v;
+    }
+
+    SpawnOptions spawnOptions;
+    spawnOptions.file = QFile::encodeName(file->toQStringNoThrow());
+    if (!parseArgs(v4, args, &spawnOptions))
+        return QV4::Encode::undefined();
+
+    QStringList command;
+    foreach (const QByteArray &arg, spawnOptions.args)
+        command.append(QString::fromLocal8Bit(arg));
+    return execute(v4, spawnOptions, options, callback, command.join(QLatin1Char(' ')));
+}
+
+void ChildProcess::destroy(QV4::Heap::Base *that)
+{
+    Heap::ChildProcess *process = static_cast<Heap::ChildProcess *>(that);
+    // The handle keeps a running child alive, so this only happens on engine teardown
+    delete process->handle;
+    process->~ChildProcess();
+}
+
+/*!
+  \internal
+  Implements child_process.spawn(). A child that cannot be started still gets a ChildProcess
+  object, which emits 'error' from the event loop.
+*/
+QV4::ReturnedValue ChildProcess::spawn(QV4::ExecutionEngine *v4, const SpawnOptions &options)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (!initEmitterPrototype(v4, engine->childProcessPrototype)
+            || !initEmitterPrototype(v4, engine->childPipePrototype)) {
+        return QV4::Encode::undefined();
+    }
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<ChildProcess> process(scope, v4->memoryManager->alloc<ChildProcess>(v4));
+    Heap::ChildProcess *d = process->d();
+    d->handle = new ChildProcessHandle(v4, d);
+    d->handle->spawn(options);
+
+    static const char *const streamNames[] = { "stdin", "stdout", "stderr" };
+    QV4::Scoped<ChildPipe> pipe(scope);
+    QV4::ScopedValue stream(scope);
+    QV4::ScopedArrayObject stdio(scope, v4->newArrayObject());
+    QV4::ScopedString s(scope, v4->newString(QStringLiteral("newListener")));
+    QV4::ScopedValue newListener(scope, s);
+    QV4::ScopedContext rootContext(scope, v4->rootContext());
+    QV4::ScopedFunctionObject onNewListener(
+                scope, QV4::BuiltinFunction::create(rootContext, s, ChildPipePrototype::method_newListener));
+    for (int fd = 0; fd < 3; ++fd) {
+        if (options.stdio[fd] == SpawnOptions::Pipe) {
+            pipe = v4->memoryManager->alloc<ChildPipe>(v4, d, fd);
+            d->handle->setStream(fd, pipe->d());
+            // Covers on(), once() and listeners added by any other means
+            if (fd && !EventEmitter::addListener(v4, pipe, newListener, onNewListener, false))
+                return QV4::Encode::undefined();
+            stream = pipe.asReturnedValue();
+        } else {
+            stream = QV4::Primitive::nullValue();
+        }
+        process->defineDefaultProperty(QString::fromLatin1(streamNames[fd]), stream);
+        stdio->push_back(stream);
+    }
+    process->defineDefaultProperty(QStringLiteral("stdio"), stdio);
+
+    return process.asReturnedValue();
+}
+
+int ChildProcess::signalNumber(const QString &name)
+{
+    for (const SignalName &s : signalNames) {
+        if (name == QLatin1String(s.name))
+            return s.number;
+    }
+    return -1;
+}
+
+QString ChildProcess::signalName(int signal)
+{
+    for (const SignalName &s : signalNames) {
+        if (s.number == signal)
+            return QString::fromLatin1(s.name);
+    }
+    return QString::number(signal);
+}
+
+void ChildPipe::markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e)
+{
+    Heap::ChildPipe *pipe = static_cast<Heap::ChildPipe *>(that);
+    pipe->process->mark(e);
+    if (pipe->decoder)
+        pipe->decoder->mark(e);
+
+    QV4::Object::markObjects(that, e);
+}
+
+void ChildProcessPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("kill"), method_kill, 1);
+    defineDefaultProperty(QStringLiteral("ref"), method_ref);
+    defineDefaultProperty(QStringLiteral("unref"), method_unref);
+
+    defineAccessorProperty(QStringLiteral("pid"), property_pid_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("exitCode"), property_exitCode_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("signalCode"), property_signalCode_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("killed"), property_killed_getter, nullptr);
+}
+
+// kill([signal])
+QV4::ReturnedValue ChildProcessPrototype::method_kill(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedValue arg(scope, callData->argument(0));
+    const int signal = parseSignal(v4, arg, SIGTERM);
+    if (signal == -1)
+        return QV4::Encode::undefined();
+
+    const int error = self->d()->handle->kill(signal);
+    if (error == EINVAL)
+        return EnginePrivate::get(v4)->throwErrnoException(error, QStringLiteral("kill"));
+    return QV4::Encode(!error);
+}
+
+QV4::ReturnedValue ChildProcessPrototype::method_ref(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->handle->isActive() && !self->d()->referenced)
+        EnginePrivate::get(v4)->refHandle();
+    self->d()->referenced = true;
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue ChildProcessPrototype::method_unref(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->handle->isActive() && self->d()->referenced)
+        EnginePrivate::get(v4)->unrefHandle();
+    self->d()->referenced = false;
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue ChildProcessPrototype::property_pid_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (!self->d()->pid)
+        return QV4::Encode::undefined();
+    return QV4::Encode(self->d()->pid);
+}
+
+QV4::ReturnedValue ChildProcessPrototype::property_exitCode_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (!self->d()->exited || self->d()->signalCode)
+        return QV4::Encode::null();
+    return QV4::Encode(self->d()->exitCode);
+}
+
+QV4::ReturnedValue ChildProcessPrototype::property_signalCode_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (!self->d()->signalCode)
+        return QV4::Encode::null();
+    QV4::ScopedString s(scope, v4->newString(signalName(self->d()->signalCode)));
+    return s.asReturnedValue();
+}
+
+QV4::ReturnedValue ChildProcessPrototype::property_killed_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildProcess, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return QV4::Encode(self->d()->killed);
+}
+
+void ChildPipePrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("pause"), method_pause);
+    defineDefaultProperty(QStringLiteral("resume"), method_resume);
+    defineDefaultProperty(QStringLiteral("setEncoding"), method_setEncoding, 1);
+    defineDefaultProperty(QStringLiteral("write"), method_write, 3);
+    defineDefaultProperty(QStringLiteral("end"), method_end, 3);
+}
+
+// Listens for 'newListener' of stdout and stderr, a 'data' listener gets the output read so far
+QV4::ReturnedValue ChildPipePrototype::method_newListener(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(ChildPipe, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    // The listener is added after this notification, so the output follows from the event loop
+    if (self->d()->fd && callData->argc
+            && callData->args[0].toQStringNoThrow() == QStringLiteral("data")) {
+        self->d()->process->handle->startFlowing(self->d()->fd, self->d());
+    }
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue ChildPipePrototype::method_pause(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildPipe, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self || !self->d()->fd)
+        return v4->throwTypeError();
+
+    // Stops reading, a child writing more blocks once the socket buffer is full
+    self->d()->process->handle->setReading(self->d()->fd, false);
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue ChildPipePrototype::method_resume(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(ChildPipe, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self || !self->d()->fd)
+        return v4->throwTypeError();
+
+    self->d()->process->handle->setReading(self->d()->fd, true);
+    return self.asReturnedValue();
+}
+
+// setEncoding(encoding)
+QV4::ReturnedValue ChildPipePrototype::method_setEncoding(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(ChildPipe, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self || !self->d()->fd)
+        return v4->throwTypeError();
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    if (callData->argc && !parseEncodingOption(v4, callData->args[0], &encoding))
+        return QV4::Encode::undefined();
+
+    QV4::Scoped<StringDecoder> decoder(scope, v4->memoryManager->alloc<StringDecoder>(v4, encoding));
+    self->d()->decoder = decoder->d();
+    return self.asReturnedValue();
+}
+
+// write(chunk, [encoding], [callback])
+QV4::ReturnedValue ChildPipePrototype::method_write(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(ChildPipe, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self || self->d()->fd)
+        return v4->throwTypeError();
+
+    if (!callData->argc || callData->args[0].isNullOrUndefined())
+        return v4->throwTypeError(QStringLiteral("Invalid data"));
+
+    ChildProcessHandle *handle = self->d()->process->handle;
+    if (!handle->isInputOpen()) {
+        QV4::ScopedValue error(scope, v4->newErrorObject(QStringLiteral("write after end")));
+        emitEvent(v4, self->d(), QStringLiteral("error"), error.asReturnedValue(), 1);
+        return QV4::Encode(false);
+    }
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    QV4::ScopedValue callback(scope, QV4::Primitive::undefinedValue());
+    if (callData->argc > 1) {
+        if (callData->args[1].asFunctionObject()) {
+            callback = callData->args[1];
+        } else {
+            if (!parseEncodingOption(v4, callData->args[1], &encoding))
+                return QV4::Encode::undefined();
+            if (callData->argc > 2)
+                callback = callData->args[2];
+        }
+    }
+
+    return QV4::Encode(handle->write(chunkData(v4, callData->args[0], encoding), callback));
+}
+
+// end([chunk], [encoding], [callback])
+QV4::ReturnedValue ChildPipePrototype::method_end(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(ChildPipe, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self || self->d()->fd)
+        return v4->throwTypeError();
+
+    ChildProcessHandle *handle = self->d()->process->handle;
+    if (!handle->isInputOpen())
+        return QV4::Encode::undefined();
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    QV4::ScopedValue chunk(scope, QV4::Primitive::undefinedValue());
+    QV4::ScopedValue callback(scope, QV4::Primitive::undefinedValue());
+    for (int i = 0; i < callData->argc; ++i) {
+        if (callData->args[i].asFunctionObject()) {
+            callback = callData->args[i];
+            break;
+        }
+        if (i == 0) {
+            chunk = callData->args[0];
+        } else if (i == 1 && !parseEncodingOption(v4, callData->args[1], &encoding)) {
+            return QV4::Encode::undefined();
+        }
+    }
+
+    if (!chunk->isNullOrUndefined()) {
+        QV4::ScopedValue noCallback(scope, QV4::Primitive::undefinedValue());
+        handle->write(chunkData(v4, chunk, encoding), noCallback);
+    }
+    if (callback->asFunctionObject())
+        once(v4, self->d(), QStringLiteral("finish"), callback);
+
+    handle->endInput();
+    return QV4::Encode::undefined();
+}
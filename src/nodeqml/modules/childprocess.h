@@ -0,0 +1,133 @@
+#ifndef CHILDPROCESS_H
+#define CHILDPROCESS_H
+
+#include "../v4integration.h"
+#include "../types/buffer.h"
+
+#include <QByteArray>
+#include <QList>
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+class ChildProcessHandle;
+
+/*!
+  \internal
+  What child_process.spawn() has parsed from its arguments.
+*/
+struct SpawnOptions
+{
+    enum Stdio {
+        Pipe,
+        Inherit,
+        Ignore,
+        Fd
+    };
+
+    QByteArray file;
+    // argv, including argv[0]
+    QList<QByteArray> args;
+    QByteArray cwd;
+    bool hasEnv = false;
+    // NAME=value entries, used instead of the parent's environment if hasEnv is set
+    QList<QByteArray> env;
+    Stdio stdio[3] = { Pipe, Pipe, Pipe };
+    int stdioFds[3] = { -1, -1, -1 };
+    bool detached = false;
+};
+
+namespace Heap {
+
+struct StringDecoder;
+
+struct ChildProcessModule : QV4::Heap::Object {
+    ChildProcessModule(QV4::ExecutionEngine *v4);
+};
+
+struct ChildProcess : QV4::Heap::Object {
+    ChildProcess(QV4::ExecutionEngine *v4);
+
+    int pid = 0; // 0 if spawning failed
+    bool exited = false;
+    int exitCode = 0;
+    int signalCode = 0; // 0 unless terminated by a signal
+    bool killed = false;
+    bool referenced = true;
+    // Owned, lives as long as this object
+    ChildProcessHandle *handle = nullptr;
+};
+
+/*!
+  \internal
+  child.stdin, child.stdout or child.stderr, for stdio entries set to 'pipe'.
+*/
+struct ChildPipe : QV4::Heap::Object {
+    ChildPipe(QV4::ExecutionEngine *v4, ChildProcess *process, int fd);
+
+    ChildProcess *process;
+    int fd; // The child's side, 0 for stdin
+    StringDecoder *decoder = nullptr;
+    bool ended = false;
+};
+
+} // namespace Heap
+
+struct ChildProcessModule : QV4::Object
+{
+    NODE_V4_OBJECT(ChildProcessModule, Object)
+
+    static QV4::ReturnedValue method_spawn(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_exec(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_execFile(QV4::CallContext *ctx);
+};
+
+struct ChildProcess : QV4::Object
+{
+    NODE_V4_OBJECT(ChildProcess, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+
+    static QV4::ReturnedValue spawn(QV4::ExecutionEngine *v4, const SpawnOptions &options);
+
+    static int signalNumber(const QString &name);
+    static QString signalName(int signal);
+};
+
+struct ChildPipe : QV4::Object
+{
+    NODE_V4_OBJECT(ChildPipe, Object)
+
+    static void markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e);
+};
+
+struct ChildProcessPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_kill(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_ref(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unref(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue property_pid_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_exitCode_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_signalCode_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_killed_getter(QV4::CallContext *ctx);
+};
+
+struct ChildPipePrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_newListener(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_pause(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_resume(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_setEncoding(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_write(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_end(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // CHILDPROCESS_H
@@ -1,9 +1,8 @@
 #include "console.h"
 
+#include "process.h"
 #include "util.h"
-
-#include <QDateTime>
-#include <QTextStream>
+#include "../engine_p.h"
 
 #include <private/qv4context_p.h>
 #include <private/qv4global_p.h>
@@ -34,7 +33,7 @@ QV4::ReturnedValue ConsoleModule::method_log(QV4::CallContext *ctx)
     QV4::Scope scope(ctx);
     QV4::ScopedString s(scope, UtilModule::method_format(ctx));
 
-    QTextStream(stdout) << s->toQString() << endl;
+    EnginePrivate::get(ctx->engine())->outputSink()->writeLine(OutputSink::Stdout, s->toQString());
 
     return QV4::Encode::undefined();
 }
@@ -44,7 +43,7 @@ QV4::ReturnedValue ConsoleModule::method_error(QV4::CallContext *ctx)
     QV4::Scope scope(ctx);
     QV4::ScopedString s(scope, UtilModule::method_format(ctx));
 
-    QTextStream(stderr) << s->toQString() << endl;
+    EnginePrivate::get(ctx->engine())->outputSink()->writeLine(OutputSink::Stderr, s->toQString());
 
     return QV4::Encode::undefined();
 }
@@ -60,7 +59,7 @@ QV4::ReturnedValue ConsoleModule::method_time(QV4::CallContext *ctx)
     NODE_CTX_SELF(ConsoleModule, ctx);
 
     QV4::ScopedObject key(scope, callData->args[0]);
-    self->d()->timeMarks.insert(key.asReturnedValue(), QDateTime::currentMSecsSinceEpoch());
+    self->d()->timeMarks.insert(key.asReturnedValue(), ProcessModule::hrtime());
 
     return QV4::Encode::undefined();
 }
@@ -77,10 +76,10 @@ QV4::ReturnedValue ConsoleModule::method_timeEnd(QV4::CallContext *ctx)
         return ctx->engine()->throwError(QString("No such label: %1").arg(key->toQStringNoThrow()));
     }
 
-    const qint64 delta
-            = QDateTime::currentMSecsSinceEpoch() - self->d()->timeMarks[key.asReturnedValue()];
-    /// TODO: Use QTextStream
-    qDebug("%s: %lldms", qPrintable(callData->args[0].toQStringNoThrow()), delta);
+    const qint64 delta = ProcessModule::hrtime() - self->d()->timeMarks[key.asReturnedValue()];
+    EnginePrivate::get(ctx->engine())->outputSink()->writeLine(
+                OutputSink::Stdout, QString("%1: %2ms").arg(callData->args[0].toQStringNoThrow())
+                                                       .arg(delta / 1e6, 0, 'f', 3));
 
     return QV4::Encode::undefined();
 }
@@ -14,6 +14,7 @@ namespace Heap {
 struct ConsoleModule : QV4::Heap::Object {
     ConsoleModule(QV4::ExecutionEngine *v4);
 
+    // Start of console.time() labels, in nanoseconds of ProcessModule::hrtime()
     QHash<QV4::ReturnedValue, qint64> timeMarks;
 };
 
@@ -0,0 +1,634 @@
+#include "events.h"
+
+#include "../engine_p.h"
+#include "../util/eventemitter.h"
+
+#include <QStringList>
+
+#include <private/qv4context_p.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(EventListeners);
+DEFINE_OBJECT_VTABLE(EventEmitterCtor);
+
+namespace {
+const int DefaultMaxListeners = 10;
+
+QV4::ReturnedValue property(QV4::ExecutionEngine *v4, QV4::Object *o, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newIdentifier(name));
+    return o->get(s);
+}
+
+// Emits through emit() of the emitter, which may be overridden, like events.js does
+bool emitNotification(QV4::ExecutionEngine *v4, QV4::Object *emitter, const QString &event,
+                      const QV4::Value &type, const QV4::Value &listener)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedCallData callData(scope, 3);
+    callData->args[0] = v4->newString(event)->asReturnedValue();
+    callData->args[1] = type;
+    callData->args[2] = listener;
+    callMethod(v4, *emitter, QStringLiteral("emit"), callData->args, 3);
+    return !v4->hasException;
+}
+
+int maxListeners(QV4::ExecutionEngine *v4, QV4::Object *emitter)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedValue m(scope, property(v4, emitter, QStringLiteral("_maxListeners")));
+    if (m->isUndefined()) {
+        QV4::ScopedObject ctor(scope, EnginePrivate::get(v4)->eventEmitterCtor);
+        m = property(v4, ctor, QStringLiteral("defaultMaxListeners"));
+        if (m->isUndefined())
+            return DefaultMaxListeners;
+    }
+    return m->toInt32();
+}
+
+// Removes the listener at position of the event at index and emits 'removeListener'
+void removeAt(QV4::ExecutionEngine *v4, QV4::Object *emitter, Heap::EventListeners *listeners,
+              int index, int position)
+{
+    Heap::EventListeners::Event &event = listeners->events[index];
+    const QString type = event.type;
+    QV4::Scope scope(v4);
+    QV4::ScopedValue listenerValue(scope, event.listeners.at(position).function->asReturnedValue());
+
+    event.listeners.remove(position);
+    if (event.listeners.isEmpty())
+        listeners->events.remove(index);
+
+    if (listeners->indexOf(QStringLiteral("removeListener")) != -1) {
+        QV4::ScopedValue typeValue(scope, v4->newString(type));
+        emitNotification(v4, emitter, QStringLiteral("removeListener"), typeValue, listenerValue);
+    }
+}
+
+bool removeAllListeners(QV4::ExecutionEngine *v4, QV4::Object *emitter, const QString &type)
+{
+    Heap::EventListeners *listeners = EventListeners::of(v4, emitter, false);
+    const int index = listeners ? listeners->indexOf(type) : -1;
+    if (index == -1)
+        return true;
+
+    // Not listening for removeListener, no need to emit
+    if (listeners->indexOf(QStringLiteral("removeListener")) == -1) {
+        listeners->events.remove(index);
+        return true;
+    }
+
+    // LIFO order, listeners may add or remove others while being notified
+    for (;;) {
+        listeners = EventListeners::of(v4, emitter, false);
+        const int index = listeners ? listeners->indexOf(type) : -1;
+        if (index == -1)
+            return true;
+        QV4::Heap::FunctionObject *listener = listeners->events.at(index).listeners.last().function;
+        EventEmitter::removeListener(v4, emitter, type, listener);
+        if (v4->hasException)
+            return false;
+    }
+}
+}
+
+Heap::EventListeners::EventListeners(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+}
+
+int Heap::EventListeners::indexOf(const QString &type) const
+{
+    for (int i = 0; i < events.size(); ++i) {
+        if (events.at(i).type == type)
+            return i;
+    }
+    return -1;
+}
+
+void EventListeners::destroy(QV4::Heap::Base *that)
+{
+    static_cast<Heap::EventListeners *>(that)->~EventListeners();
+}
+
+void EventListeners::markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e)
+{
+    Heap::EventListeners *listeners = static_cast<Heap::EventListeners *>(that);
+    foreach (const Heap::EventListeners::Event &event, listeners->events) {
+        for (int i = 0; i < event.listeners.size(); ++i)
+            event.listeners.at(i).function->mark(e);
+    }
+
+    QV4::Object::markObjects(that, e);
+}
+
+/*!
+  \internal
+  Reading _events[type] gives the listener, or an array of listeners, like with events.js.
+*/
+QV4::ReturnedValue EventListeners::get(QV4::Managed *m, QV4::String *name, bool *hasProperty)
+{
+    Heap::EventListeners *listeners = static_cast<EventListeners *>(m)->d();
+    const int index = listeners->indexOf(name->toQString());
+    if (index == -1)
+        return QV4::Object::get(m, name, hasProperty);
+
+    if (hasProperty)
+        *hasProperty = true;
+
+    const Heap::EventListeners::Event &event = listeners->events.at(index);
+    if (event.listeners.size() == 1)
+        return event.listeners.at(0).function->asReturnedValue();
+
+    QV4::ExecutionEngine *v4 = static_cast<QV4::Object *>(m)->engine();
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject array(scope, v4->newArrayObject());
+    QV4::ScopedValue listener(scope);
+    array->arrayReserve(event.listeners.size());
+    for (int i = 0; i < event.listeners.size(); ++i)
+        array->arrayPut(i, (listener = event.listeners.at(i).function->asReturnedValue()));
+    array->setArrayLengthUnchecked(event.listeners.size());
+    return array.asReturnedValue();
+}
+
+/*!
+  \internal
+  Returns the listeners stored in the _events property of \a emitter. They are created if
+  \a create is true, otherwise null is returned for an emitter without listeners.
+*/
+Heap::EventListeners *EventListeners::of(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                         bool create)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newIdentifier(QStringLiteral("_events")));
+    QV4::Scoped<EventListeners> listeners(scope, emitter->get(s));
+    if (listeners || !create)
+        return listeners ? listeners->d() : nullptr;
+
+    listeners = v4->memoryManager->alloc<EventListeners>(v4);
+    emitter->put(s, listeners);
+    return listeners->d();
+}
+
+Heap::EventEmitterCtor::EventEmitterCtor(QV4::ExecutionContext *scope) :
+    QV4::Heap::FunctionObject(scope, QStringLiteral("EventEmitter"))
+{
+}
+
+// new EventEmitter()
+QV4::ReturnedValue EventEmitterCtor::construct(QV4::Managed *m, QV4::CallData *callData)
+{
+    Q_UNUSED(callData)
+    QV4::ExecutionEngine *v4 = static_cast<QV4::Object *>(m)->engine();
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject prototype(scope, EnginePrivate::get(v4)->eventEmitterPrototype);
+    QV4::ScopedObject emitter(scope, v4->newObject());
+    emitter->setPrototype(prototype);
+    EventEmitter::init(v4, emitter);
+    return emitter.asReturnedValue();
+}
+
+// EventEmitter.call(this) from the constructor of a subclass
+QV4::ReturnedValue EventEmitterCtor::call(QV4::Managed *that, QV4::CallData *callData)
+{
+    QV4::ExecutionEngine *v4 = static_cast<QV4::Object *>(that)->engine();
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self || self->d() == v4->globalObject()->d())
+        return construct(that, callData);
+
+    EventEmitter::init(v4, self);
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue EventEmitterCtor::method_init(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    EventEmitter::init(v4, self);
+    return QV4::Encode::undefined();
+}
+
+// EventEmitter.listenerCount(emitter, type)
+QV4::ReturnedValue EventEmitterCtor::method_listenerCount(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject emitter(scope, callData->argument(0));
+    if (!emitter)
+        return QV4::Encode(0);
+
+    QV4::ScopedValue type(scope, callData->argument(1));
+    return QV4::Encode(EventEmitter::listenerCount(v4, emitter, type->toQStringNoThrow()));
+}
+
+void EventEmitter::init(QV4::ExecutionEngine *v4, QV4::Object *emitter)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newIdentifier(QStringLiteral("domain")));
+    emitter->put(s, QV4::Primitive::nullValue());
+
+    // Listeners inherited from the prototype must not be shared
+    s = v4->newIdentifier(QStringLiteral("_events"));
+    QV4::Scoped<EventListeners> listeners(scope, emitter->get(s));
+    if (!listeners || !emitter->hasOwnProperty(s)) {
+        listeners = v4->memoryManager->alloc<EventListeners>(v4);
+        emitter->put(s, listeners);
+    }
+
+    s = v4->newIdentifier(QStringLiteral("_maxListeners"));
+    QV4::ScopedValue m(scope, emitter->get(s));
+    if (!m->toBoolean())
+        emitter->put(s, QV4::Primitive::undefinedValue());
+}
+
+/*!
+  \internal
+  Calls the listeners of the event named by \a args[0] with the rest of \a args. The listeners
+  are copied to the JS stack first, as listeners may add or remove listeners. Returns whether
+  there were listeners, or undefined if one of them threw.
+*/
+QV4::ReturnedValue EventEmitter::emit(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                      const QV4::Value *args, int argc)
+{
+    QV4::Scope scope(v4);
+    const QString type = argc ? args[0].toQStringNoThrow() : QStringLiteral("undefined");
+
+    Heap::EventListeners *listeners = EventListeners::of(v4, emitter, false);
+    const int index = listeners ? listeners->indexOf(type) : -1;
+    if (index == -1) {
+        // If there is no 'error' event listener then throw
+        if (type == QLatin1String("error")) {
+            if (argc > 1 && args[1].asErrorObject())
+                return v4->throwError(args[1]); // Unhandled 'error' event
+            return v4->throwError(QStringLiteral("Uncaught, unspecified \"error\" event."));
+        }
+        return QV4::Encode(false);
+    }
+
+    const Heap::EventListeners::Event &event = listeners->events.at(index);
+    const int count = event.listeners.size();
+    QV4::Value *functions = scope.alloc(count);
+    // Ids of once listeners, others are -1
+    QVarLengthArray<qint64, 8> onceIds(count);
+    for (int i = 0; i < count; ++i) {
+        const Heap::EventListeners::Listener &listener = event.listeners.at(i);
+        functions[i] = listener.function->asReturnedValue();
+        onceIds[i] = listener.once ? qint64(listener.id) : -1;
+    }
+
+    QV4::ScopedCallData callData(scope, qMax(0, argc - 1));
+    callData->thisObject = emitter->asReturnedValue();
+    QV4::ScopedFunctionObject f(scope);
+    for (int i = 0; i < count; ++i) {
+        f = functions[i];
+        // A once listener that a nested emit already called, or that was removed, is gone
+        if (onceIds[i] != -1) {
+            const bool removed = removeRegistration(v4, emitter, type, onceIds[i]);
+            if (v4->hasException)
+                return QV4::Encode::undefined();
+            if (!removed)
+                continue;
+        }
+
+        // A listener may have modified its arguments
+        for (int j = 1; j < argc; ++j)
+            callData->args[j - 1] = args[j];
+        f->call(callData);
+        if (v4->hasException)
+            return QV4::Encode::undefined();
+    }
+
+    return QV4::Encode(true);
+}
+
+bool EventEmitter::addListener(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                               const QV4::Value &type, QV4::FunctionObject *listener, bool once)
+{
+    QV4::Scope scope(v4);
+    const QString typeString = type.toQStringNoThrow();
+
+    // To avoid recursion in the case that type is 'newListener', emit it before adding
+    Heap::EventListeners *listeners = EventListeners::of(v4, emitter, true);
+    if (listeners->indexOf(QStringLiteral("newListener")) != -1) {
+        if (!emitNotification(v4, emitter, QStringLiteral("newListener"), type, *listener))
+            return false;
+        listeners = EventListeners::of(v4, emitter, true);
+    }
+
+    int index = listeners->indexOf(typeString);
+    if (index == -1) {
+        index = listeners->events.size();
+        listeners->events.append(Heap::EventListeners::Event());
+        listeners->events[index].type = typeString;
+    }
+
+    Heap::EventListeners::Event &event = listeners->events[index];
+    event.listeners.append(Heap::EventListeners::Listener { listener->d(), once,
+                                                           listeners->nextId++ });
+
+    // Check for listener leak. A getter on _maxListeners may add listeners of other types, which
+    // reallocates the events, so the event is looked up again afterwards
+    const int count = event.listeners.size();
+    if (count > 1 && !event.warned) {
+        const int m = maxListeners(v4, emitter);
+        if (v4->hasException)
+            return false;
+        if (m > 0 && count > m) {
+            listeners = EventListeners::of(v4, emitter, false);
+            index = listeners ? listeners->indexOf(typeString) : -1;
+            if (index == -1 || listeners->events.at(index).warned)
+                return true;
+            listeners->events[index].warned = true;
+            EnginePrivate::get(v4)->outputSink()->writeLine(OutputSink::Stderr,
+                    QString("(node) warning: possible EventEmitter memory leak detected. "
+                            "%1 %2 listeners added. "
+                            "Use emitter.setMaxListeners() to increase limit.")
+                    .arg(count).arg(typeString));
+        }
+    }
+
+    return true;
+}
+
+/*!
+  \internal
+  Removes the most recently added registration of \a listener for \a type and emits
+  'removeListener'. Returns whether a listener was removed.
+*/
+bool EventEmitter::removeListener(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                  const QString &type, QV4::Heap::FunctionObject *listener)
+{
+    Heap::EventListeners *listeners = EventListeners::of(v4, emitter, false);
+    const int index = listeners ? listeners->indexOf(type) : -1;
+    if (index == -1)
+        return false;
+
+    Heap::EventListeners::Event &event = listeners->events[index];
+    int position = event.listeners.size();
+    while (position-- > 0) {
+        if (event.listeners.at(position).function == listener)
+            break;
+    }
+    if (position < 0)
+        return false;
+
+    removeAt(v4, emitter, listeners, index, position);
+    return true;
+}
+
+/*!
+  \internal
+  Removes the registration with \a id for \a type and emits 'removeListener'. Returns whether it
+  was still registered.
+*/
+bool EventEmitter::removeRegistration(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                      const QString &type, quint32 id)
+{
+    Heap::EventListeners *listeners = EventListeners::of(v4, emitter, false);
+    const int index = listeners ? listeners->indexOf(type) : -1;
+    if (index == -1)
+        return false;
+
+    const Heap::EventListeners::Event &event = listeners->events.at(index);
+    for (int position = 0; position < event.listeners.size(); ++position) {
+        if (event.listeners.at(position).id == id) {
+            removeAt(v4, emitter, listeners, index, position);
+            return true;
+        }
+    }
+    return false;
+}
+
+int EventEmitter::listenerCount(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                const QString &type)
+{
+    Heap::EventListeners *listeners = EventListeners::of(v4, emitter, false);
+    const int index = listeners ? listeners->indexOf(type) : -1;
+    return index == -1 ? 0 : listeners->events.at(index).listeners.size();
+}
+
+void EventEmitterPrototype::init(QV4::ExecutionEngine *v4, QV4::Object *ctor)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope);
+
+    ctor->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(0));
+    ctor->defineReadonlyProperty(v4->id_prototype, (o = this));
+    defineDefaultProperty(QStringLiteral("constructor"), (o = ctor));
+
+    // Backwards-compat with node 0.10.x
+    ctor->defineDefaultProperty(QStringLiteral("EventEmitter"), (o = ctor));
+    // There is no domain module, so emitters never enter a domain
+    ctor->defineDefaultProperty(QStringLiteral("usingDomains"), QV4::Primitive::fromBoolean(false));
+    ctor->defineDefaultProperty(QStringLiteral("defaultMaxListeners"), QV4::Primitive::fromInt32(DefaultMaxListeners));
+    ctor->defineDefaultProperty(QStringLiteral("init"), EventEmitterCtor::method_init);
+    ctor->defineDefaultProperty(QStringLiteral("listenerCount"), EventEmitterCtor::method_listenerCount, 2);
+
+    defineDefaultProperty(QStringLiteral("domain"), QV4::Primitive::undefinedValue());
+    defineDefaultProperty(QStringLiteral("_events"), QV4::Primitive::undefinedValue());
+    defineDefaultProperty(QStringLiteral("_maxListeners"), QV4::Primitive::undefinedValue());
+
+    defineDefaultProperty(QStringLiteral("setMaxListeners"), method_setMaxListeners, 1);
+    defineDefaultProperty(QStringLiteral("emit"), method_emit, 1);
+    defineDefaultProperty(QStringLiteral("addListener"), method_addListener, 2);
+    QV4::ScopedValue addListener(scope, property(v4, this, QStringLiteral("addListener")));
+    defineDefaultProperty(QStringLiteral("on"), addListener);
+    defineDefaultProperty(QStringLiteral("once"), method_once, 2);
+    defineDefaultProperty(QStringLiteral("removeListener"), method_removeListener, 2);
+    defineDefaultProperty(QStringLiteral("removeAllListeners"), method_removeAllListeners, 1);
+    defineDefaultProperty(QStringLiteral("listeners"), method_listeners, 1);
+    defineDefaultProperty(QStringLiteral("listenerCount"), method_listenerCount, 1);
+}
+
+// setMaxListeners(n)
+QV4::ReturnedValue EventEmitterPrototype::method_setMaxListeners(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedValue n(scope, callData->argument(0));
+    if (!n->isNumber() || !(n->toNumber() >= 0))
+        return v4->throwTypeError(QStringLiteral("n must be a positive number"));
+
+    QV4::ScopedString s(scope, v4->newIdentifier(QStringLiteral("_maxListeners")));
+    self->put(s, n);
+    return self.asReturnedValue();
+}
+
+// emit(type, [args...])
+QV4::ReturnedValue EventEmitterPrototype::method_emit(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    return EventEmitter::emit(v4, self, callData->args, callData->argc);
+}
+
+// addListener(type, listener), on(type, listener)
+QV4::ReturnedValue EventEmitterPrototype::method_addListener(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedFunctionObject listener(scope, callData->argument(1));
+    if (!listener)
+        return v4->throwTypeError(QStringLiteral("listener must be a function"));
+
+    QV4::ScopedValue type(scope, callData->argument(0));
+    if (!EventEmitter::addListener(v4, self, type, listener, false))
+        return QV4::Encode::undefined();
+    return self.asReturnedValue();
+}
+
+// once(type, listener)
+QV4::ReturnedValue EventEmitterPrototype::method_once(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedFunctionObject listener(scope, callData->argument(1));
+    if (!listener)
+        return v4->throwTypeError(QStringLiteral("listener must be a function"));
+
+    QV4::ScopedValue type(scope, callData->argument(0));
+    if (!EventEmitter::addListener(v4, self, type, listener, true))
+        return QV4::Encode::undefined();
+    return self.asReturnedValue();
+}
+
+// removeListener(type, listener)
+QV4::ReturnedValue EventEmitterPrototype::method_removeListener(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedFunctionObject listener(scope, callData->argument(1));
+    if (!listener)
+        return v4->throwTypeError(QStringLiteral("listener must be a function"));
+
+    QV4::ScopedValue type(scope, callData->argument(0));
+    EventEmitter::removeListener(v4, self, type->toQStringNoThrow(), listener->d());
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+    return self.asReturnedValue();
+}
+
+// removeAllListeners([type])
+QV4::ReturnedValue EventEmitterPrototype::method_removeAllListeners(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    Heap::EventListeners *listeners = EventListeners::of(v4, self, false);
+    if (!listeners)
+        return self.asReturnedValue();
+
+    if (callData->argc) {
+        removeAllListeners(v4, self, callData->args[0].toQStringNoThrow());
+    } else if (listeners->indexOf(QStringLiteral("removeListener")) == -1) {
+        listeners->events.clear();
+    } else {
+        // Emit removeListener for all listeners on all events, itself last
+        QStringList types;
+        foreach (const Heap::EventListeners::Event &event, listeners->events)
+            types.append(event.type);
+        types.removeOne(QStringLiteral("removeListener"));
+        types.append(QStringLiteral("removeListener"));
+        foreach (const QString &type, types) {
+            if (!removeAllListeners(v4, self, type))
+                return QV4::Encode::undefined();
+        }
+
+        listeners = EventListeners::of(v4, self, false);
+        if (listeners)
+            listeners->events.clear();
+    }
+
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+    return self.asReturnedValue();
+}
+
+// listeners(type)
+QV4::ReturnedValue EventEmitterPrototype::method_listeners(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedArrayObject array(scope, v4->newArrayObject());
+    QV4::ScopedValue type(scope, callData->argument(0));
+    Heap::EventListeners *listeners = EventListeners::of(v4, self, false);
+    const int index = listeners ? listeners->indexOf(type->toQStringNoThrow()) : -1;
+    if (index == -1)
+        return array.asReturnedValue();
+
+    const Heap::EventListeners::Event &event = listeners->events.at(index);
+    QV4::ScopedValue listener(scope);
+    array->arrayReserve(event.listeners.size());
+    for (int i = 0; i < event.listeners.size(); ++i)
+        array->arrayPut(i, (listener = event.listeners.at(i).function->asReturnedValue()));
+    array->setArrayLengthUnchecked(event.listeners.size());
+    return array.asReturnedValue();
+}
+
+// listenerCount(type)
+QV4::ReturnedValue EventEmitterPrototype::method_listenerCount(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, callData->thisObject);
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedValue type(scope, callData->argument(0));
+    return QV4::Encode(EventEmitter::listenerCount(v4, self, type->toQStringNoThrow()));
+}
@@ -0,0 +1,102 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "../v4integration.h"
+
+#include <QVarLengthArray>
+#include <QVector>
+
+#include <private/qv4object_p.h>
+#include <private/qv4functionobject_p.h>
+
+namespace NodeQml {
+
+namespace Heap {
+
+/*!
+  \internal
+  Listeners of an EventEmitter, stored in its _events property. Emitters rarely listen to more
+  than a few event types, so types are searched linearly, and a single listener per type does not
+  need an allocation.
+*/
+struct EventListeners : QV4::Heap::Object {
+    EventListeners(QV4::ExecutionEngine *v4);
+
+    struct Listener {
+        QV4::Heap::FunctionObject *function;
+        bool once;
+        // Tells apart registrations of the same function
+        quint32 id;
+    };
+
+    struct Event {
+        QString type;
+        QVarLengthArray<Listener, 1> listeners;
+        bool warned = false;
+    };
+
+    int indexOf(const QString &type) const;
+
+    QVector<Event> events;
+    quint32 nextId = 0;
+};
+
+struct EventEmitterCtor : QV4::Heap::FunctionObject {
+    EventEmitterCtor(QV4::ExecutionContext *scope);
+};
+
+} // namespace Heap
+
+struct EventListeners : QV4::Object
+{
+    NODE_V4_OBJECT(EventListeners, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+    static void markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e);
+    static QV4::ReturnedValue get(QV4::Managed *m, QV4::String *name, bool *hasProperty);
+
+    static Heap::EventListeners *of(QV4::ExecutionEngine *v4, QV4::Object *emitter, bool create);
+};
+
+struct EventEmitterCtor : QV4::FunctionObject
+{
+    NODE_V4_OBJECT(EventEmitterCtor, FunctionObject)
+
+    static QV4::ReturnedValue construct(QV4::Managed *m, QV4::CallData *callData);
+    static QV4::ReturnedValue call(QV4::Managed *that, QV4::CallData *callData);
+
+    static QV4::ReturnedValue method_init(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_listenerCount(QV4::CallContext *ctx);
+};
+
+struct EventEmitter
+{
+    static void init(QV4::ExecutionEngine *v4, QV4::Object *emitter);
+    static QV4::ReturnedValue emit(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                   const QV4::Value *args, int argc);
+    static bool addListener(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                            const QV4::Value &type, QV4::FunctionObject *listener, bool once);
+    static bool removeListener(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                               const QString &type, QV4::Heap::FunctionObject *listener);
+    static bool removeRegistration(QV4::ExecutionEngine *v4, QV4::Object *emitter,
+                                   const QString &type, quint32 id);
+    static int listenerCount(QV4::ExecutionEngine *v4, QV4::Object *emitter, const QString &type);
+};
+
+struct EventEmitterPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4, QV4::Object *ctor);
+
+    static QV4::ReturnedValue method_setMaxListeners(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_emit(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_addListener(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_once(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_removeListener(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_removeAllListeners(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_listeners(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_listenerCount(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // EVENTS_H
@@ -1,9 +1,16 @@
 #include "filesystem.h"
 
+#include "fsdir.h"
+#include "fsrequest.h"
+#include "fsstream.h"
+#include "fswatcher.h"
 #include "../engine_p.h"
+#include "../types/buffer.h"
+#include "../types/stats.h"
 
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 
 #include <private/qv4context_p.h>
 
@@ -12,6 +19,173 @@
 
 using namespace NodeQml;
 
+namespace {
+// Async methods take the callback as the last argument
+QV4::ReturnedValue callbackArgument(const QV4::CallData *callData)
+{
+    if (callData->argc && callData->args[callData->argc - 1].asFunctionObject())
+        return callData->args[callData->argc - 1].asReturnedValue();
+    return QV4::Encode::undefined();
+}
+
+// Returns the number of arguments, not counting the callback
+int argumentCount(const QV4::CallData *callData)
+{
+    if (callData->argc && callData->args[callData->argc - 1].asFunctionObject())
+        return callData->argc - 1;
+    return callData->argc;
+}
+
+QV4::Value argumentAt(const QV4::CallData *callData, int index)
+{
+    return index < callData->argc ? callData->args[index] : QV4::Primitive::undefinedValue();
+}
+
+mode_t parseMode(const QV4::Value &value, mode_t defaultMode)
+{
+    if (value.isNumber())
+        return value.toUInt32();
+    if (value.isString()) {
+        bool ok;
+        const mode_t mode = value.toQString().toUInt(&ok, 8);
+        if (ok)
+            return mode;
+    }
+    return defaultMode;
+}
+
+// Reads a property of an options object, e.g. fs.readFile(path, {encoding: 'utf8'})
+QV4::ReturnedValue optionValue(QV4::ExecutionEngine *v4, const QV4::Value &options,
+                               const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    if (!o)
+        return QV4::Encode::undefined();
+    QV4::ScopedString s(scope, v4->newString(name));
+    return o->get(s);
+}
+
+// Parses the options of readFile() and readFileSync(): an encoding or {encoding, flag}
+bool parseReadFileOptions(QV4::ExecutionEngine *v4, const QV4::Value &options,
+                          BufferEncoding *encoding, int *flags)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedValue encodingValue(scope);
+    QV4::ScopedValue flagValue(scope);
+    if (options.isString()) {
+        encodingValue = options;
+    } else if (options.isObject()) {
+        encodingValue = optionValue(v4, options, QStringLiteral("encoding"));
+        flagValue = optionValue(v4, options, QStringLiteral("flag"));
+    }
+
+    *encoding = BufferEncoding::Invalid;
+    if (!encodingValue->isNullOrUndefined()) {
+        *encoding = Buffer::parseEncoding(encodingValue->toQStringNoThrow());
+        if (*encoding == BufferEncoding::Invalid) {
+            v4->throwTypeError(QString("Unknown encoding: %1").arg(encodingValue->toQStringNoThrow()));
+            return false;
+        }
+    }
+
+    *flags = O_RDONLY;
+    if (!flagValue->isNullOrUndefined()) {
+        *flags = FileSystemModule::parseFlags(flagValue);
+        if (*flags == -1) {
+            v4->throwError(QString("Unknown file open flag: %1").arg(flagValue->toQStringNoThrow()));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Whether the options of a stat call, following the path or fd, ask for the compact array form
+bool isCompactStats(QV4::ExecutionEngine *v4, const QV4::CallData *callData)
+{
+    if (argumentCount(callData) < 2)
+        return false;
+    QV4::Scope scope(v4);
+    QV4::ScopedValue compact(scope, optionValue(v4, callData->args[1], QStringLiteral("compact")));
+    return compact->toBoolean();
+}
+
+// Options of readdir() and readdirSync(): encoding, withFileTypes and recursive
+void parseReaddirOptions(QV4::ExecutionEngine *v4, const QV4::Value &options,
+                         BufferEncoding *encoding, bool *withFileTypes, bool *recursive)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedValue encodingValue(scope);
+    if (options.isString()) {
+        encodingValue = options;
+    } else if (options.isObject()) {
+        encodingValue = optionValue(v4, options, QStringLiteral("encoding"));
+        QV4::ScopedValue v(scope, optionValue(v4, options, QStringLiteral("withFileTypes")));
+        *withFileTypes = v->toBoolean();
+        v = optionValue(v4, options, QStringLiteral("recursive"));
+        *recursive = v->toBoolean();
+    }
+
+    // Names are either strings or Buffers
+    if (encodingValue->isString() && encodingValue->toQStringNoThrow() == QStringLiteral("buffer"))
+        *encoding = BufferEncoding::Raw;
+}
+
+QTypedArrayDataSlice<char> sliceFromString(const QString &str, BufferEncoding encoding)
+{
+    QTypedArrayData<char> *arrayData = Buffer::fromString(Buffer::decodeString(str, encoding));
+    if (!arrayData)
+        return QTypedArrayDataSlice<char>();
+    const QTypedArrayDataSlice<char> slice(arrayData);
+    arrayData->ref.deref(); // Disown data
+    return slice;
+}
+
+// Points one vector at each Buffer of an array passed to readv() or writev(), without copying
+bool collectVectors(QV4::ExecutionEngine *v4, const QV4::Value &value,
+                    QList<QTypedArrayDataSlice<char> > *slices, QVector<struct iovec> *vectors)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject array(scope, value);
+    if (!array) {
+        v4->throwTypeError(QStringLiteral("buffers must be an array of Buffers"));
+        return false;
+    }
+
+    const uint length = array->getLength();
+    slices->reserve(length);
+    vectors->reserve(length);
+    QV4::Scoped<Buffer> buffer(scope);
+    for (uint i = 0; i < length; ++i) {
+        buffer = array->getIndexed(i);
+        if (!buffer) {
+            v4->throwTypeError(QStringLiteral("buffers must be an array of Buffers"));
+            return false;
+        }
+        slices->append(buffer->d()->data);
+        QTypedArrayDataSlice<char> &slice = slices->last();
+        vectors->append(iovec { slice.data(), size_t(slice.size()) });
+    }
+    return true;
+}
+
+QV4::ReturnedValue queueRequest(QV4::ExecutionEngine *v4, FsRequest *request)
+{
+    EnginePrivate::get(v4)->queueFsRequest(request);
+    return QV4::Encode::undefined();
+}
+
+FsRequest *newPathRequest(QV4::ExecutionEngine *v4, FsRequest::Type type,
+                          const QV4::CallData *callData)
+{
+    FsRequest *request = new FsRequest(v4, type, callbackArgument(callData));
+    request->path = callData->args[0].toQString();
+    request->encodedPath = QFile::encodeName(request->path);
+    return request;
+}
+}
+
 Heap::FileSystemModule::FileSystemModule(QV4::ExecutionEngine *v4) :
     QV4::Heap::Object(v4)
 {
@@ -23,6 +197,46 @@ Heap::FileSystemModule::FileSystemModule(QV4::ExecutionEngine *v4) :
     self->defineDefaultProperty(QStringLiteral("renameSync"), NodeQml::FileSystemModule::method_renameSync, 2);
     self->defineDefaultProperty(QStringLiteral("rmdirSync"), NodeQml::FileSystemModule::method_rmdirSync, 2);
     self->defineDefaultProperty(QStringLiteral("truncateSync"), NodeQml::FileSystemModule::method_truncateSync, 2);
+    self->defineDefaultProperty(QStringLiteral("readFileSync"), NodeQml::FileSystemModule::method_readFileSync, 2);
+    self->defineDefaultProperty(QStringLiteral("copyFileSync"), NodeQml::FileSystemModule::method_copyFileSync, 3);
+    self->defineDefaultProperty(QStringLiteral("fsyncSync"), NodeQml::FileSystemModule::method_fsyncSync, 1);
+    self->defineDefaultProperty(QStringLiteral("readdirSync"), NodeQml::FileSystemModule::method_readdirSync, 2);
+    self->defineDefaultProperty(QStringLiteral("statSync"), NodeQml::FileSystemModule::method_statSync, 2);
+    self->defineDefaultProperty(QStringLiteral("lstatSync"), NodeQml::FileSystemModule::method_lstatSync, 2);
+    self->defineDefaultProperty(QStringLiteral("fstatSync"), NodeQml::FileSystemModule::method_fstatSync, 2);
+    self->defineDefaultProperty(QStringLiteral("readvSync"), NodeQml::FileSystemModule::method_readvSync, 3);
+    self->defineDefaultProperty(QStringLiteral("writevSync"), NodeQml::FileSystemModule::method_writevSync, 3);
+
+    self->defineDefaultProperty(QStringLiteral("open"), NodeQml::FileSystemModule::method_open, 4);
+    self->defineDefaultProperty(QStringLiteral("close"), NodeQml::FileSystemModule::method_close, 2);
+    self->defineDefaultProperty(QStringLiteral("read"), NodeQml::FileSystemModule::method_read, 6);
+    self->defineDefaultProperty(QStringLiteral("write"), NodeQml::FileSystemModule::method_write, 6);
+    self->defineDefaultProperty(QStringLiteral("readv"), NodeQml::FileSystemModule::method_readv, 4);
+    self->defineDefaultProperty(QStringLiteral("writev"), NodeQml::FileSystemModule::method_writev, 4);
+    self->defineDefaultProperty(QStringLiteral("stat"), NodeQml::FileSystemModule::method_stat, 3);
+    self->defineDefaultProperty(QStringLiteral("lstat"), NodeQml::FileSystemModule::method_lstat, 3);
+    self->defineDefaultProperty(QStringLiteral("fstat"), NodeQml::FileSystemModule::method_fstat, 3);
+    self->defineDefaultProperty(QStringLiteral("mkdir"), NodeQml::FileSystemModule::method_mkdir, 3);
+    self->defineDefaultProperty(QStringLiteral("rename"), NodeQml::FileSystemModule::method_rename, 3);
+    self->defineDefaultProperty(QStringLiteral("unlink"), NodeQml::FileSystemModule::method_unlink, 2);
+    self->defineDefaultProperty(QStringLiteral("rmdir"), NodeQml::FileSystemModule::method_rmdir, 2);
+    self->defineDefaultProperty(QStringLiteral("readdir"), NodeQml::FileSystemModule::method_readdir, 3);
+    self->defineDefaultProperty(QStringLiteral("walk"), NodeQml::FileSystemModule::method_walk, 2);
+    self->defineDefaultProperty(QStringLiteral("readFile"), NodeQml::FileSystemModule::method_readFile, 3);
+    self->defineDefaultProperty(QStringLiteral("writeFile"), NodeQml::FileSystemModule::method_writeFile, 4);
+    self->defineDefaultProperty(QStringLiteral("copyFile"), NodeQml::FileSystemModule::method_copyFile, 4);
+    self->defineDefaultProperty(QStringLiteral("fsync"), NodeQml::FileSystemModule::method_fsync, 2);
+
+    self->defineReadonlyProperty(QStringLiteral("COPYFILE_EXCL"), QV4::Primitive::fromInt32(FsRequest::CopyExclusive));
+    self->defineReadonlyProperty(QStringLiteral("COPYFILE_FICLONE"), QV4::Primitive::fromInt32(FsRequest::CopyClone));
+    self->defineReadonlyProperty(QStringLiteral("COPYFILE_FICLONE_FORCE"), QV4::Primitive::fromInt32(FsRequest::CopyCloneForce));
+
+    self->defineDefaultProperty(QStringLiteral("createReadStream"), NodeQml::FileSystemModule::method_createReadStream, 2);
+    self->defineDefaultProperty(QStringLiteral("createWriteStream"), NodeQml::FileSystemModule::method_createWriteStream, 2);
+
+    self->defineDefaultProperty(QStringLiteral("watch"), NodeQml::FileSystemModule::method_watch, 3);
+    self->defineDefaultProperty(QStringLiteral("watchFile"), NodeQml::FileSystemModule::method_watchFile, 3);
+    self->defineDefaultProperty(QStringLiteral("unwatchFile"), NodeQml::FileSystemModule::method_unwatchFile, 2);
 }
 
 QV4::ReturnedValue FileSystemModule::method_existsSync(QV4::CallContext *ctx)
@@ -103,3 +317,697 @@ QV4::ReturnedValue FileSystemModule::method_truncateSync(QV4::CallContext *ctx)
 
     return QV4::Encode::undefined();
 }
+
+// open(path, flags, [mode], callback)
+QV4::ReturnedValue FileSystemModule::method_open(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    const int flags = parseFlags(argumentAt(callData, 1));
+    if (flags == -1)
+        return v4->throwError(QString("Unknown file open flag: %1").arg(argumentAt(callData, 1).toQStringNoThrow()));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::Open, callData);
+    request->flags = flags;
+    if (argumentCount(callData) > 2)
+        request->mode = parseMode(callData->args[2], 0666);
+
+    return queueRequest(v4, request);
+}
+
+// close(fd, callback)
+QV4::ReturnedValue FileSystemModule::method_close(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    FsRequest *request = new FsRequest(v4, FsRequest::Close, callbackArgument(callData));
+    request->fd = callData->args[0].toInt32();
+    return queueRequest(v4, request);
+}
+
+// read(fd, buffer, offset, length, position, callback)
+QV4::ReturnedValue FileSystemModule::method_read(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    QV4::Scoped<Buffer> buffer(scope, callData->argument(1));
+    if (!buffer)
+        return v4->throwTypeError(QStringLiteral("Second argument needs to be a buffer"));
+
+    const int bufferSize = buffer->d()->data.size();
+    const int offset = argumentAt(callData, 2).toInt32();
+    const int length = argumentAt(callData, 3).toInt32();
+
+    if (offset < 0 || offset > bufferSize)
+        return v4->throwError(QStringLiteral("Offset is out of bounds"));
+    if (length < 0 || offset + length > bufferSize)
+        return v4->throwRangeError(QStringLiteral("Length extends beyond buffer"));
+
+    FsRequest *request = new FsRequest(v4, FsRequest::Read, callbackArgument(callData));
+    request->fd = callData->args[0].toInt32();
+    request->data = QTypedArrayDataSlice<char>(buffer->d()->data, offset, length);
+    request->buffer.set(v4, buffer.asReturnedValue());
+    if (argumentAt(callData, 4).isNumber())
+        request->position = callData->args[4].toInteger();
+
+    return queueRequest(v4, request);
+}
+
+// write(fd, buffer, offset, length, [position], callback)
+// write(fd, data, [position], [encoding], callback)
+QV4::ReturnedValue FileSystemModule::method_write(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    FsRequest *request = nullptr;
+    QV4::Scoped<Buffer> buffer(scope, callData->argument(1));
+
+    if (buffer) {
+        const int bufferSize = buffer->d()->data.size();
+        const int offset = argumentAt(callData, 2).toInt32();
+        const int length = argumentAt(callData, 3).toInt32();
+
+        if (offset < 0 || offset > bufferSize)
+            return v4->throwError(QStringLiteral("Offset is out of bounds"));
+        if (length < 0 || offset + length > bufferSize)
+            return v4->throwRangeError(QStringLiteral("Length extends beyond buffer"));
+
+        request = new FsRequest(v4, FsRequest::Write, callbackArgument(callData));
+        request->data = QTypedArrayDataSlice<char>(buffer->d()->data, offset, length);
+        request->buffer.set(v4, buffer.asReturnedValue());
+        if (argumentCount(callData) > 4 && callData->args[4].isNumber())
+            request->position = callData->args[4].toInteger();
+    } else {
+        BufferEncoding encoding = BufferEncoding::Utf8;
+        if (argumentCount(callData) > 3 && callData->args[3].isString()) {
+            encoding = Buffer::parseEncoding(callData->args[3].toQString());
+            if (encoding == BufferEncoding::Invalid)
+                return v4->throwTypeError(QString("Unknown encoding: %1").arg(callData->args[3].toQString()));
+        }
+
+        request = new FsRequest(v4, FsRequest::Write, callbackArgument(callData));
+        request->data = sliceFromString(argumentAt(callData, 1).toQStringNoThrow(), encoding);
+        request->buffer.set(v4, argumentAt(callData, 1));
+        if (argumentCount(callData) > 2 && callData->args[2].isNumber())
+            request->position = callData->args[2].toInteger();
+    }
+
+    request->fd = callData->args[0].toInt32();
+    return queueRequest(v4, request);
+}
+
+// readv(fd, buffers, [position], callback)
+QV4::ReturnedValue FileSystemModule::method_readv(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    FsRequest *request = new FsRequest(v4, FsRequest::Readv, callbackArgument(callData));
+    if (!collectVectors(v4, argumentAt(callData, 1), &request->slices, &request->vectors)) {
+        delete request;
+        return QV4::Encode::undefined();
+    }
+
+    request->fd = callData->args[0].toInt32();
+    request->buffer.set(v4, callData->args[1]);
+    if (argumentCount(callData) > 2 && callData->args[2].isNumber())
+        request->position = callData->args[2].toInteger();
+
+    return queueRequest(v4, request);
+}
+
+// writev(fd, buffers, [position], callback)
+QV4::ReturnedValue FileSystemModule::method_writev(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    FsRequest *request = new FsRequest(v4, FsRequest::Writev, callbackArgument(callData));
+    if (!collectVectors(v4, argumentAt(callData, 1), &request->slices, &request->vectors)) {
+        delete request;
+        return QV4::Encode::undefined();
+    }
+
+    request->fd = callData->args[0].toInt32();
+    request->buffer.set(v4, callData->args[1]);
+    if (argumentCount(callData) > 2 && callData->args[2].isNumber())
+        request->position = callData->args[2].toInteger();
+
+    return queueRequest(v4, request);
+}
+
+// stat(path, [options], callback)
+QV4::ReturnedValue FileSystemModule::method_stat(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::Stat, callData);
+    request->compactStats = isCompactStats(v4, callData);
+    return queueRequest(v4, request);
+}
+
+// lstat(path, [options], callback)
+QV4::ReturnedValue FileSystemModule::method_lstat(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::Lstat, callData);
+    request->compactStats = isCompactStats(v4, callData);
+    return queueRequest(v4, request);
+}
+
+// fstat(fd, [options], callback)
+QV4::ReturnedValue FileSystemModule::method_fstat(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    FsRequest *request = new FsRequest(v4, FsRequest::Fstat, callbackArgument(callData));
+    request->fd = callData->args[0].toInt32();
+    request->compactStats = isCompactStats(v4, callData);
+    return queueRequest(v4, request);
+}
+
+// statSync(path, [options])
+QV4::ReturnedValue FileSystemModule::method_statSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    const QString path = callData->args[0].toQString();
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st))
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("stat"), path);
+    return isCompactStats(v4, callData) ? StatsPrototype::createCompact(v4, st)
+                                        : StatsPrototype::create(v4, st);
+}
+
+// lstatSync(path, [options])
+QV4::ReturnedValue FileSystemModule::method_lstatSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    const QString path = callData->args[0].toQString();
+    struct stat st;
+    if (::lstat(QFile::encodeName(path).constData(), &st))
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("lstat"), path);
+    return isCompactStats(v4, callData) ? StatsPrototype::createCompact(v4, st)
+                                        : StatsPrototype::create(v4, st);
+}
+
+// fstatSync(fd, [options])
+QV4::ReturnedValue FileSystemModule::method_fstatSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    struct stat st;
+    if (::fstat(callData->args[0].toInt32(), &st))
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("fstat"));
+    return isCompactStats(v4, callData) ? StatsPrototype::createCompact(v4, st)
+                                        : StatsPrototype::create(v4, st);
+}
+
+// mkdir(path, [mode], callback)
+QV4::ReturnedValue FileSystemModule::method_mkdir(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::Mkdir, callData);
+    request->mode = argumentCount(callData) > 1 ? parseMode(callData->args[1], 0777) : 0777;
+    return queueRequest(v4, request);
+}
+
+// rename(oldPath, newPath, callback)
+QV4::ReturnedValue FileSystemModule::method_rename(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (callData->argc < 2)
+        return v4->throwError(QStringLiteral("rename: two arguments are required"));
+    if (!callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("rename: old path must be a string"));
+    if (!callData->args[1].isString())
+        return v4->throwTypeError(QStringLiteral("rename: new path must be a string"));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::Rename, callData);
+    request->encodedNewPath = QFile::encodeName(callData->args[1].toQString());
+    return queueRequest(v4, request);
+}
+
+// unlink(path, callback)
+QV4::ReturnedValue FileSystemModule::method_unlink(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    return queueRequest(v4, newPathRequest(v4, FsRequest::Unlink, callData));
+}
+
+// rmdir(path, callback)
+QV4::ReturnedValue FileSystemModule::method_rmdir(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    return queueRequest(v4, newPathRequest(v4, FsRequest::Rmdir, callData));
+}
+
+// readdir(path, [options], callback)
+QV4::ReturnedValue FileSystemModule::method_readdir(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::Readdir, callData);
+    parseReaddirOptions(v4, argumentCount(callData) > 1 ? callData->args[1] : QV4::Primitive::undefinedValue(),
+                        &request->encoding, &request->withFileTypes, &request->recursive);
+    return queueRequest(v4, request);
+}
+
+// readdirSync(path, [options])
+QV4::ReturnedValue FileSystemModule::method_readdirSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    bool withFileTypes = false;
+    bool recursive = false;
+    parseReaddirOptions(v4, argumentAt(callData, 1), &encoding, &withFileTypes, &recursive);
+
+    const QString path = callData->args[0].toQString();
+    DirectoryWalk walk(QFile::encodeName(path), recursive, withFileTypes);
+    QList<DirectoryWalk::Entry> entries;
+    int errorNo = 0;
+    QString syscall;
+    if (!walk.read(&entries, INT_MAX, &errorNo, &syscall))
+        return EnginePrivate::get(v4)->throwErrnoException(errorNo, syscall, path);
+
+    return DirectoryWalk::toArray(v4, path, entries, withFileTypes, encoding);
+}
+
+// walk(path, [options])
+QV4::ReturnedValue FileSystemModule::method_walk(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    return DirectoryWalker::create(v4, callData->args[0].toQString(), argumentAt(callData, 1));
+}
+
+// readFile(filename, [options], callback)
+QV4::ReturnedValue FileSystemModule::method_readFile(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    BufferEncoding encoding;
+    int flags;
+    if (!parseReadFileOptions(v4, argumentCount(callData) > 1 ? callData->args[1] : QV4::Primitive::undefinedValue(),
+                              &encoding, &flags)) {
+        return QV4::Encode::undefined();
+    }
+
+    FsRequest *request = newPathRequest(v4, FsRequest::ReadFile, callData);
+    request->encoding = encoding;
+    request->flags = flags;
+    return queueRequest(v4, request);
+}
+
+// readFileSync(filename, [options])
+QV4::ReturnedValue FileSystemModule::method_readFileSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    BufferEncoding encoding;
+    int flags;
+    if (!parseReadFileOptions(v4, argumentAt(callData, 1), &encoding, &flags))
+        return QV4::Encode::undefined();
+
+    const QString path = callData->args[0].toQString();
+    int errorNo = 0;
+    QString syscall;
+    QTypedArrayData<char> *fileData
+            = FsRequest::readWholeFile(QFile::encodeName(path), flags, &errorNo, &syscall);
+    if (!fileData)
+        return EnginePrivate::get(v4)->throwErrnoException(errorNo, syscall, path);
+
+    const QTypedArrayDataSlice<char> slice(fileData);
+    fileData->ref.deref(); // Disown data
+
+    if (encoding != BufferEncoding::Invalid)
+        return v4->newString(Buffer::encodeData(slice.constData(), slice.size(), encoding))->asReturnedValue();
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<Buffer> buffer(scope, v4->memoryManager->alloc<Buffer>(v4, slice));
+    return buffer.asReturnedValue();
+}
+
+// writeFile(filename, data, [options], callback)
+QV4::ReturnedValue FileSystemModule::method_writeFile(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue encodingValue(scope);
+    QV4::ScopedValue modeValue(scope);
+    QV4::ScopedValue flagValue(scope);
+    if (argumentCount(callData) > 2) {
+        if (callData->args[2].isString()) {
+            encodingValue = callData->args[2];
+        } else {
+            encodingValue = optionValue(v4, callData->args[2], QStringLiteral("encoding"));
+            modeValue = optionValue(v4, callData->args[2], QStringLiteral("mode"));
+            flagValue = optionValue(v4, callData->args[2], QStringLiteral("flag"));
+        }
+    }
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    if (!encodingValue->isNullOrUndefined()) {
+        encoding = Buffer::parseEncoding(encodingValue->toQStringNoThrow());
+        if (encoding == BufferEncoding::Invalid)
+            return v4->throwTypeError(QString("Unknown encoding: %1").arg(encodingValue->toQStringNoThrow()));
+    }
+
+    int flags = O_TRUNC | O_CREAT | O_WRONLY;
+    if (!flagValue->isNullOrUndefined()) {
+        flags = parseFlags(flagValue);
+        if (flags == -1)
+            return v4->throwError(QString("Unknown file open flag: %1").arg(flagValue->toQStringNoThrow()));
+    }
+
+    FsRequest *request = newPathRequest(v4, FsRequest::WriteFile, callData);
+    request->flags = flags;
+    request->mode = parseMode(modeValue, 0666);
+
+    QV4::Scoped<Buffer> buffer(scope, callData->argument(1));
+    if (buffer)
+        request->data = buffer->d()->data;
+    else
+        request->data = sliceFromString(argumentAt(callData, 1).toQStringNoThrow(), encoding);
+
+    return queueRequest(v4, request);
+}
+
+// copyFile(src, dest, [flags], callback)
+QV4::ReturnedValue FileSystemModule::method_copyFile(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (callData->argc < 2 || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("src must be a string"));
+    if (!callData->args[1].isString())
+        return v4->throwTypeError(QStringLiteral("dest must be a string"));
+
+    FsRequest *request = newPathRequest(v4, FsRequest::CopyFile, callData);
+    request->encodedNewPath = QFile::encodeName(callData->args[1].toQString());
+    request->flags = argumentCount(callData) > 2 ? callData->args[2].toInt32() : 0;
+    return queueRequest(v4, request);
+}
+
+// copyFileSync(src, dest, [flags])
+QV4::ReturnedValue FileSystemModule::method_copyFileSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (callData->argc < 2 || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("src must be a string"));
+    if (!callData->args[1].isString())
+        return v4->throwTypeError(QStringLiteral("dest must be a string"));
+
+    const QString source = callData->args[0].toQString();
+    const int flags = argumentAt(callData, 2).toInt32();
+    int errorNo = 0;
+    QString syscall;
+    if (!FsRequest::copyFile(QFile::encodeName(source),
+                             QFile::encodeName(callData->args[1].toQString()),
+                             flags, &errorNo, &syscall)) {
+        return EnginePrivate::get(v4)->throwErrnoException(errorNo, syscall, source);
+    }
+
+    return QV4::Encode::undefined();
+}
+
+// fsync(fd, callback)
+QV4::ReturnedValue FileSystemModule::method_fsync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    FsRequest *request = new FsRequest(v4, FsRequest::Fsync, callbackArgument(callData));
+    request->fd = callData->args[0].toInt32();
+    return queueRequest(v4, request);
+}
+
+// fsyncSync(fd)
+QV4::ReturnedValue FileSystemModule::method_fsyncSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    if (::fsync(callData->args[0].toInt32()))
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("fsync"));
+
+    return QV4::Encode::undefined();
+}
+
+// readvSync(fd, buffers, [position])
+QV4::ReturnedValue FileSystemModule::method_readvSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    QList<QTypedArrayDataSlice<char> > slices;
+    QVector<struct iovec> vectors;
+    if (!collectVectors(v4, argumentAt(callData, 1), &slices, &vectors))
+        return QV4::Encode::undefined();
+
+    const qint64 position = argumentAt(callData, 2).isNumber() ? callData->args[2].toInteger() : -1;
+    const qint64 result = FsRequest::readVectors(callData->args[0].toInt32(), vectors.constData(),
+                                                 vectors.size(), position);
+    if (result < 0)
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("read"));
+
+    return QV4::Encode(double(result));
+}
+
+// writevSync(fd, buffers, [position])
+QV4::ReturnedValue FileSystemModule::method_writevSync(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isNumber())
+        return v4->throwTypeError(QStringLiteral("Bad argument"));
+
+    QList<QTypedArrayDataSlice<char> > slices;
+    QVector<struct iovec> vectors;
+    if (!collectVectors(v4, argumentAt(callData, 1), &slices, &vectors))
+        return QV4::Encode::undefined();
+
+    const qint64 position = argumentAt(callData, 2).isNumber() ? callData->args[2].toInteger() : -1;
+    qint64 written = 0;
+    if (!FsRequest::writeVectors(callData->args[0].toInt32(), vectors.data(), vectors.size(),
+                                 position, &written)) {
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("write"));
+    }
+
+    return QV4::Encode(double(written));
+}
+
+// createReadStream(path, [options])
+QV4::ReturnedValue FileSystemModule::method_createReadStream(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    return FileReadStream::create(v4, callData->args[0].toQString(), argumentAt(callData, 1));
+}
+
+// createWriteStream(path, [options])
+QV4::ReturnedValue FileSystemModule::method_createWriteStream(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path must be a string"));
+
+    return FileWriteStream::create(v4, callData->args[0].toQString(), argumentAt(callData, 1));
+}
+
+/*!
+  \internal
+  Converts Node.js file open flags (e.g. 'r', 'w+', 'ax') to open() flags. Numeric flags are
+  passed through. Returns -1 for unknown flags.
+*/
+int FileSystemModule::parseFlags(const QV4::Value &value)
+{
+    if (value.isNumber())
+        return value.toInt32();
+
+    const static QHash<QString, int> flags = {
+        std::pair<QString, int>(QStringLiteral("r"), O_RDONLY),
+        std::pair<QString, int>(QStringLiteral("rs"), O_RDONLY | O_SYNC),
+        std::pair<QString, int>(QStringLiteral("sr"), O_RDONLY | O_SYNC),
+        std::pair<QString, int>(QStringLiteral("r+"), O_RDWR),
+        std::pair<QString, int>(QStringLiteral("rs+"), O_RDWR | O_SYNC),
+        std::pair<QString, int>(QStringLiteral("sr+"), O_RDWR | O_SYNC),
+        std::pair<QString, int>(QStringLiteral("w"), O_TRUNC | O_CREAT | O_WRONLY),
+        std::pair<QString, int>(QStringLiteral("wx"), O_TRUNC | O_CREAT | O_WRONLY | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("xw"), O_TRUNC | O_CREAT | O_WRONLY | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("w+"), O_TRUNC | O_CREAT | O_RDWR),
+        std::pair<QString, int>(QStringLiteral("wx+"), O_TRUNC | O_CREAT | O_RDWR | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("xw+"), O_TRUNC | O_CREAT | O_RDWR | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("a"), O_APPEND | O_CREAT | O_WRONLY),
+        std::pair<QString, int>(QStringLiteral("ax"), O_APPEND | O_CREAT | O_WRONLY | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("xa"), O_APPEND | O_CREAT | O_WRONLY | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("a+"), O_APPEND | O_CREAT | O_RDWR),
+        std::pair<QString, int>(QStringLiteral("ax+"), O_APPEND | O_CREAT | O_RDWR | O_EXCL),
+        std::pair<QString, int>(QStringLiteral("xa+"), O_APPEND | O_CREAT | O_RDWR | O_EXCL)
+    };
+
+    return flags.value(value.toQStringNoThrow(), -1);
+}
+
+// watch(filename, [options], [listener])
+QV4::ReturnedValue FileSystemModule::method_watch(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("filename must be a string"));
+
+    if (argumentAt(callData, 1).asFunctionObject())
+        return FSWatcher::create(v4, callData->args[0].toQString(), QV4::Primitive::undefinedValue(),
+                                 callData->args[1]);
+    return FSWatcher::create(v4, callData->args[0].toQString(), argumentAt(callData, 1),
+                             argumentAt(callData, 2));
+}
+
+// watchFile(filename, [options], listener)
+QV4::ReturnedValue FileSystemModule::method_watchFile(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("filename must be a string"));
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue listener(scope, callbackArgument(callData));
+    if (!listener->asFunctionObject())
+        return v4->throwError(QStringLiteral("watchFile requires a listener function"));
+
+    return StatWatcher::watch(v4, callData->args[0].toQString(),
+                              argumentCount(callData) > 1 ? callData->args[1]
+                                                          : QV4::Primitive::undefinedValue(),
+                              listener);
+}
+
+// unwatchFile(filename, [listener])
+QV4::ReturnedValue FileSystemModule::method_unwatchFile(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("filename must be a string"));
+
+    StatWatcher::unwatch(v4, callData->args[0].toQString(), argumentAt(callData, 1));
+    return QV4::Encode::undefined();
+}
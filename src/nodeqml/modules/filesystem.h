@@ -24,6 +24,44 @@ struct FileSystemModule : QV4::Object
     static QV4::ReturnedValue method_renameSync(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_rmdirSync(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_truncateSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_readFileSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_copyFileSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_fsyncSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_readdirSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_statSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_lstatSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_fstatSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_readvSync(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_writevSync(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue method_open(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_close(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_read(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_write(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_readv(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_writev(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_stat(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_lstat(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_fstat(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_mkdir(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_rename(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unlink(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_rmdir(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_readdir(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_walk(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_readFile(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_writeFile(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_copyFile(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_fsync(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue method_createReadStream(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_createWriteStream(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue method_watch(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_watchFile(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unwatchFile(QV4::CallContext *ctx);
+
+    static int parseFlags(const QV4::Value &value);
 };
 
 } // namespace NodeQml
@@ -0,0 +1,460 @@
+#include "fsdir.h"
+
+#include "../asyncwork.h"
+#include "../engine_p.h"
+#include "../types/direntry.h"
+#include "../util/eventemitter.h"
+
+#include <QFile>
+
+#include <private/qv4context_p.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#  include <sys/syscall.h>
+#endif
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(DirectoryWalker);
+
+namespace {
+#ifdef Q_OS_LINUX
+// Layout of the records returned by getdents64()
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// Large enough for a few hundred entries per system call
+const int DirentBufferSize = 32 * 1024;
+#endif
+
+inline bool isDotOrDotDot(const char *name)
+{
+    return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+QV4::ReturnedValue option(QV4::ExecutionEngine *v4, const QV4::Value &options, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    if (!o)
+        return QV4::Encode::undefined();
+    QV4::ScopedString s(scope, v4->newString(name));
+    return o->get(s);
+}
+}
+
+namespace NodeQml {
+
+/*
+  Reads the next batch of a DirectoryWalker on the thread pool. Only one request per walker is in
+  flight, so the walk state needs no locking.
+ */
+class DirectoryWalkRequest : public AsyncWork
+{
+public:
+    DirectoryWalkRequest(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker) :
+        AsyncWork(v4, QV4::Encode::undefined()),
+        walk(walker->walk),
+        batchSize(walker->batchSize),
+        m_walker(v4, walker->asReturnedValue())
+    {
+        path = walker->path;
+    }
+
+    void execute() override
+    {
+        walk->read(&entries, batchSize, &errorNo, &syscall);
+    }
+
+    void complete(QV4::ExecutionEngine *v4) override
+    {
+        QV4::Scope scope(v4);
+        QV4::Scoped<DirectoryWalker> walker(scope, m_walker.value());
+        DirectoryWalker::batchDone(v4, walker->d(), this);
+    }
+
+    DirectoryWalk * const walk;
+    const int batchSize;
+    QList<DirectoryWalk::Entry> entries;
+
+private:
+    QV4::PersistentValue m_walker;
+};
+
+} // namespace NodeQml
+
+/*!
+  \internal
+  Prepares reading \a root. Entries are stat'ed when d_type is unknown if \a resolveTypes is set,
+  or to find subdirectories if \a recursive is set. Symbolic links are not followed.
+*/
+DirectoryWalk::DirectoryWalk(const QByteArray &root, bool recursive, bool resolveTypes) :
+    m_root(root),
+    m_recursive(recursive),
+    m_resolveTypes(resolveTypes)
+{
+}
+
+DirectoryWalk::~DirectoryWalk()
+{
+    closeCurrent();
+    if (m_rootFd != -1)
+        ::close(m_rootFd);
+}
+
+/*!
+  \internal
+  Appends up to \a maxEntries entries to \a entries. Returns \c false and sets \a errorNo and
+  \a syscall on failure. Subdirectories disappearing during the walk are skipped.
+*/
+bool DirectoryWalk::read(QList<Entry> *entries, int maxEntries, int *errorNo, QString *syscall)
+{
+    int count = 0;
+    while (count < maxEntries && !m_atEnd) {
+        if (m_fd == -1) {
+            if (!openNext(errorNo, syscall))
+                return false;
+            continue;
+        }
+
+        const char *name;
+        unsigned char type;
+        const int result = nextEntry(&name, &type);
+        if (result < 0) {
+            *errorNo = errno;
+            *syscall = QStringLiteral("scandir");
+            return false;
+        }
+        if (!result) {
+            closeCurrent();
+            continue;
+        }
+        if (isDotOrDotDot(name))
+            continue;
+
+        if (type == DT_UNKNOWN && (m_resolveTypes || m_recursive)) {
+            struct stat st;
+            if (!::fstatat(m_fd, name, &st, AT_SYMLINK_NOFOLLOW))
+                type = IFTODT(st.st_mode);
+        }
+
+        entries->append(Entry { m_currentParent, QFile::decodeName(name), type });
+        ++count;
+
+        if (m_recursive && type == DT_DIR) {
+            m_pending.append(m_currentPath.isEmpty() ? QByteArray(name)
+                                                     : m_currentPath + '/' + name);
+        }
+    }
+    return true;
+}
+
+bool DirectoryWalk::openNext(int *errorNo, QString *syscall)
+{
+    if (m_rootFd == -1) {
+        m_rootFd = ::open(m_root.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (m_rootFd == -1) {
+            *errorNo = errno;
+            *syscall = QStringLiteral("scandir");
+            return false;
+        }
+        m_fd = ::dup(m_rootFd);
+        if (m_fd == -1) {
+            *errorNo = errno;
+            *syscall = QStringLiteral("scandir");
+            return false;
+        }
+    } else {
+        for (;;) {
+            if (m_pending.isEmpty()) {
+                m_atEnd = true;
+                return true;
+            }
+            m_currentPath = m_pending.takeFirst();
+            m_fd = ::openat(m_rootFd, m_currentPath.constData(),
+                            O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (m_fd != -1)
+                break;
+            if (errno != ENOENT && errno != ENOTDIR) {
+                *errorNo = errno;
+                *syscall = QStringLiteral("scandir");
+                return false;
+            }
+        }
+        m_currentParent = QFile::decodeName(m_currentPath);
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_buffer.isEmpty())
+        m_buffer.resize(DirentBufferSize);
+    m_bufferPos = m_bufferSize = 0;
+#else
+    m_dir = ::fdopendir(m_fd);
+    if (!m_dir) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("scandir");
+        closeCurrent();
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Returns 1 and sets name and type, 0 at the end of the directory, -1 on error
+int DirectoryWalk::nextEntry(const char **name, unsigned char *type)
+{
+#ifdef Q_OS_LINUX
+    if (m_bufferPos >= m_bufferSize) {
+        long n;
+        do {
+            n = ::syscall(SYS_getdents64, m_fd, m_buffer.data(), m_buffer.size());
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return n < 0 ? -1 : 0;
+        m_bufferPos = 0;
+        m_bufferSize = n;
+    }
+
+    const LinuxDirent64 *entry
+            = reinterpret_cast<const LinuxDirent64 *>(m_buffer.constData() + m_bufferPos);
+    m_bufferPos += entry->d_reclen;
+    *name = entry->d_name;
+    *type = entry->d_type;
+    return 1;
+#else
+    errno = 0;
+    const struct dirent *entry = ::readdir(static_cast<DIR *>(m_dir));
+    if (!entry)
+        return errno ? -1 : 0;
+    *name = entry->d_name;
+    *type = entry->d_type;
+    return 1;
+#endif
+}
+
+void DirectoryWalk::closeCurrent()
+{
+#ifndef Q_OS_LINUX
+    if (m_dir) {
+        ::closedir(static_cast<DIR *>(m_dir));
+        m_dir = nullptr;
+        m_fd = -1;
+    }
+#endif
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    if (!m_recursive && m_rootFd != -1)
+        m_atEnd = true;
+}
+
+/*!
+  \internal
+  Converts \a entries read from \a root to the result of readdir(): Dirent objects if
+  \a withFileTypes is set, paths relative to \a root otherwise, as Buffers for the Raw encoding.
+*/
+QV4::ReturnedValue DirectoryWalk::toArray(QV4::ExecutionEngine *v4, const QString &root,
+                                          const QList<Entry> &entries, bool withFileTypes,
+                                          BufferEncoding encoding)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject array(scope, v4->newArrayObject());
+    QV4::ScopedValue v(scope);
+
+    const int count = entries.size();
+    array->arrayReserve(count);
+
+    QString parent;
+    QString parentPath = root;
+    for (int i = 0; i < count; ++i) {
+        const Entry &entry = entries.at(i);
+
+        if (withFileTypes) {
+            // Entries of one directory are consecutive and share the parent string
+            if (entry.parent != parent) {
+                parent = entry.parent;
+                parentPath = parent.isEmpty() ? root : root + QLatin1Char('/') + parent;
+            }
+            v = v4->memoryManager->alloc<Dirent>(v4, entry.name, parentPath, entry.type)->asReturnedValue();
+        } else {
+            const QString path = entry.parent.isEmpty()
+                    ? entry.name : entry.parent + QLatin1Char('/') + entry.name;
+            if (encoding == BufferEncoding::Raw)
+                v = v4->memoryManager->alloc<Buffer>(v4, QFile::encodeName(path))->asReturnedValue();
+            else
+                v = v4->newString(path)->asReturnedValue();
+        }
+        array->arrayPut(i, v);
+    }
+    array->setArrayLengthUnchecked(count);
+
+    return array.asReturnedValue();
+}
+
+Heap::DirectoryWalker::DirectoryWalker(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject proto(scope, EnginePrivate::get(v4)->directoryWalkerPrototype);
+    self->setPrototype(proto);
+}
+
+void DirectoryWalker::destroy(QV4::Heap::Base *that)
+{
+    Heap::DirectoryWalker *walker = static_cast<Heap::DirectoryWalker *>(that);
+    // A pending request keeps the walker alive, so the walk is not in use here
+    delete walker->walk;
+    walker->~DirectoryWalker();
+}
+
+/*!
+  \internal
+  Implements fs.walk(). The tree below \a path is read on the thread pool, one batch at a time,
+  and each batch is emitted as a single 'data' event carrying an array of entries. The next batch
+  is only read once the previous one has been emitted, so memory use does not depend on the size
+  of the tree.
+*/
+QV4::ReturnedValue DirectoryWalker::create(QV4::ExecutionEngine *v4, const QString &path,
+                                           const QV4::Value &options)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (!initEmitterPrototype(v4, engine->directoryWalkerPrototype))
+        return QV4::Encode::undefined();
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<DirectoryWalker> walker(scope, v4->memoryManager->alloc<DirectoryWalker>(v4));
+    Heap::DirectoryWalker *d = walker->d();
+    d->path = path;
+
+    QV4::ScopedValue v(scope, option(v4, options, QStringLiteral("withFileTypes")));
+    d->withFileTypes = v->toBoolean();
+    v = option(v4, options, QStringLiteral("batchSize"));
+    if (v->isNumber() && v->toInt32() > 0)
+        d->batchSize = v->toInt32();
+    v = option(v4, options, QStringLiteral("encoding"));
+    if (v->isString() && v->toQStringNoThrow() == QStringLiteral("buffer"))
+        d->encoding = BufferEncoding::Raw;
+
+    d->walk = new DirectoryWalk(QFile::encodeName(path), true, d->withFileTypes);
+    readNext(v4, d);
+
+    return walker.asReturnedValue();
+}
+
+void DirectoryWalker::readNext(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker)
+{
+    if (walker->reading || walker->paused || walker->done)
+        return;
+
+    walker->reading = true;
+    EnginePrivate::get(v4)->queueWork(new DirectoryWalkRequest(v4, walker));
+}
+
+void DirectoryWalker::finish(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker)
+{
+    Q_UNUSED(v4)
+
+    walker->done = true;
+    if (!walker->reading) {
+        delete walker->walk;
+        walker->walk = nullptr;
+    }
+}
+
+void DirectoryWalker::batchDone(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker,
+                                DirectoryWalkRequest *request)
+{
+    walker->reading = false;
+    if (walker->done) {
+        // Closed while the batch was read
+        finish(v4, walker);
+        return;
+    }
+
+    QV4::Scope scope(v4);
+    if (!request->entries.isEmpty()) {
+        QV4::ScopedValue entries(scope, DirectoryWalk::toArray(v4, walker->path, request->entries,
+                                                               walker->withFileTypes,
+                                                               walker->encoding));
+        // Listeners may close the walker
+        if (!emitEvent(v4, walker, QStringLiteral("data"), entries.asReturnedValue(), 1)
+                || walker->done) {
+            return;
+        }
+    }
+
+    if (request->errorNo) {
+        finish(v4, walker);
+        QV4::ScopedValue error(scope, EnginePrivate::get(v4)->newErrnoException(
+                                   request->errorNo, request->syscall, request->path));
+        emitEvent(v4, walker, QStringLiteral("error"), error.asReturnedValue(), 1);
+        return;
+    }
+
+    if (request->walk->atEnd()) {
+        finish(v4, walker);
+        emitEvent(v4, walker, QStringLiteral("end"));
+        return;
+    }
+
+    readNext(v4, walker);
+}
+
+void DirectoryWalkerPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("pause"), method_pause);
+    defineDefaultProperty(QStringLiteral("resume"), method_resume);
+    defineDefaultProperty(QStringLiteral("close"), method_close);
+}
+
+QV4::ReturnedValue DirectoryWalkerPrototype::method_pause(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(DirectoryWalker, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->paused = true;
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue DirectoryWalkerPrototype::method_resume(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(DirectoryWalker, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->paused = false;
+    DirectoryWalker::readNext(v4, self->d());
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue DirectoryWalkerPrototype::method_close(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(DirectoryWalker, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    if (!self->d()->done) {
+        DirectoryWalker::finish(v4, self->d());
+        emitEvent(v4, self->d(), QStringLiteral("close"));
+    }
+    return QV4::Encode::undefined();
+}
@@ -0,0 +1,112 @@
+#ifndef FSDIR_H
+#define FSDIR_H
+
+#include "../v4integration.h"
+#include "../types/buffer.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  Reads the entries of a directory, and optionally of all its subdirectories, with getdents64()
+  on Linux. Entry types come from d_type, so entries are only stat'ed on file systems that do not
+  fill it in. Reading can be split into batches of any size, the state is kept in between.
+*/
+class DirectoryWalk
+{
+public:
+    struct Entry {
+        QString parent; // Relative to the root, empty for entries of the root itself
+        QString name;
+        unsigned char type; // DT_* value
+    };
+
+    DirectoryWalk(const QByteArray &root, bool recursive, bool resolveTypes);
+    ~DirectoryWalk();
+
+    bool read(QList<Entry> *entries, int maxEntries, int *errorNo, QString *syscall);
+    bool atEnd() const { return m_atEnd; }
+
+    static QV4::ReturnedValue toArray(QV4::ExecutionEngine *v4, const QString &root,
+                                      const QList<Entry> &entries, bool withFileTypes,
+                                      BufferEncoding encoding);
+
+private:
+    bool openNext(int *errorNo, QString *syscall);
+    int nextEntry(const char **name, unsigned char *type);
+    void closeCurrent();
+
+    const QByteArray m_root;
+    const bool m_recursive;
+    const bool m_resolveTypes;
+
+    int m_rootFd = -1;
+    int m_fd = -1;
+    QByteArray m_currentPath;
+    QString m_currentParent;
+    // Subdirectories left to read, relative to the root
+    QList<QByteArray> m_pending;
+    bool m_atEnd = false;
+
+#ifdef Q_OS_LINUX
+    QByteArray m_buffer;
+    int m_bufferPos = 0;
+    int m_bufferSize = 0;
+#else
+    void *m_dir = nullptr;
+#endif
+};
+
+class DirectoryWalkRequest;
+
+namespace Heap {
+
+struct DirectoryWalker : QV4::Heap::Object {
+    DirectoryWalker(QV4::ExecutionEngine *v4);
+
+    QString path;
+    DirectoryWalk *walk = nullptr;
+    bool withFileTypes = false;
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    int batchSize = 1024;
+
+    bool reading = false;
+    bool paused = false;
+    bool done = false;
+};
+
+} // namespace Heap
+
+struct DirectoryWalker : QV4::Object
+{
+    NODE_V4_OBJECT(DirectoryWalker, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+
+    static QV4::ReturnedValue create(QV4::ExecutionEngine *v4, const QString &path,
+                                     const QV4::Value &options);
+
+    static void readNext(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker);
+    static void finish(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker);
+    static void batchDone(QV4::ExecutionEngine *v4, Heap::DirectoryWalker *walker,
+                          DirectoryWalkRequest *request);
+};
+
+struct DirectoryWalkerPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_pause(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_resume(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_close(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // FSDIR_H
@@ -0,0 +1,582 @@
+#include "fsrequest.h"
+
+#include "../engine_p.h"
+#include "../types/stats.h"
+
+#include <QFile>
+#include <QScopedPointer>
+
+#include <private/qv4engine_p.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#  include <linux/fs.h>
+#  include <sys/ioctl.h>
+#  include <sys/sendfile.h>
+#  include <sys/syscall.h>
+#endif
+
+using namespace NodeQml;
+
+namespace {
+// Size of the buffer used to detect EOF once the expected number of bytes has been read
+const size_t ProbeSize = 4096;
+
+// Size of the per-thread buffer used by copyFile() when the kernel cannot copy by itself
+const size_t CopyBufferSize = 1024 * 1024;
+// Largest amount of data passed to copy_file_range() and sendfile() at once
+const size_t CopyChunkSize = 0x7ffff000;
+
+bool writeAll(int fd, const char *data, size_t size, qint64 position, qint64 *written)
+{
+    *written = 0;
+    while (size_t(*written) < size) {
+        const ssize_t n = position < 0
+                ? ::write(fd, data + *written, size - *written)
+                : ::pwrite(fd, data + *written, size - *written, position + *written);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        *written += n;
+    }
+    return true;
+}
+
+#ifdef Q_OS_LINUX
+// Errors meaning that the kernel cannot copy between these files, and that copying should fall
+// back to another method
+inline bool isCopyUnsupported(int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP
+            || error == EBADF || error == EPERM;
+}
+
+// Returns 1 if the whole file has been copied, 0 if copy_file_range() is not usable, -1 on error
+int copyFileRange(int in, int out, qint64 *copied)
+{
+#ifdef __NR_copy_file_range
+    for (;;) {
+        const ssize_t n = ::syscall(__NR_copy_file_range, in, nullptr, out, nullptr,
+                                    CopyChunkSize, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return *copied == 0 && isCopyUnsupported(errno) ? 0 : -1;
+        }
+        if (!n)
+            return 1;
+        *copied += n;
+    }
+#else
+    Q_UNUSED(in)
+    Q_UNUSED(out)
+    Q_UNUSED(copied)
+    return 0;
+#endif
+}
+
+// Same as copyFileRange(), using sendfile()
+int sendFile(int in, int out, qint64 *copied)
+{
+    for (;;) {
+        const ssize_t n = ::sendfile(out, in, nullptr, CopyChunkSize);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return *copied == 0 && isCopyUnsupported(errno) ? 0 : -1;
+        }
+        if (!n)
+            return 1;
+        *copied += n;
+    }
+}
+#endif
+
+bool copyLoop(int in, int out, QString *syscall)
+{
+    // Reused by all copies running on the same thread
+    static thread_local QScopedArrayPointer<char> buffer;
+    if (!buffer)
+        buffer.reset(new char[CopyBufferSize]);
+
+    for (;;) {
+        const ssize_t n = ::read(in, buffer.data(), CopyBufferSize);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            *syscall = QStringLiteral("read");
+            return false;
+        }
+        if (!n)
+            return true;
+        qint64 written;
+        if (!writeAll(out, buffer.data(), n, -1, &written)) {
+            *syscall = QStringLiteral("write");
+            return false;
+        }
+    }
+}
+}
+
+FsRequest::FsRequest(QV4::ExecutionEngine *v4, Type type, QV4::ReturnedValue callback) :
+    AsyncWork(v4, callback),
+    type(type)
+{
+}
+
+FsRequest::~FsRequest()
+{
+    if (fileData && !fileData->ref.deref())
+        QTypedArrayData<char>::deallocate(fileData);
+}
+
+void FsRequest::setError(const char *syscallName)
+{
+    errorNo = errno;
+    syscall = QString::fromLatin1(syscallName);
+}
+
+void FsRequest::execute()
+{
+    switch (type) {
+    case Open:
+        result = ::open(encodedPath.constData(), flags | O_CLOEXEC, mode);
+        if (result < 0)
+            setError("open");
+        break;
+    case Close:
+        if (::close(fd))
+            setError("close");
+        break;
+    case Read:
+        do {
+            result = position < 0
+                    ? ::read(fd, data.data(), data.size())
+                    : ::pread(fd, data.data(), data.size(), position);
+        } while (result < 0 && errno == EINTR);
+        if (result < 0)
+            setError("read");
+        break;
+    case Write:
+        if (!writeAll(fd, data.constData(), data.size(), position, &result))
+            setError("write");
+        break;
+    case Readv:
+        result = readVectors(fd, vectors.constData(), vectors.size(), position);
+        if (result < 0)
+            setError("read");
+        break;
+    case Writev:
+        if (!writeVectors(fd, vectors.data(), vectors.size(), position, &result))
+            setError("write");
+        break;
+    case Stat:
+        if (::stat(encodedPath.constData(), &statBuf))
+            setError("stat");
+        break;
+    case Lstat:
+        if (::lstat(encodedPath.constData(), &statBuf))
+            setError("lstat");
+        break;
+    case Fstat:
+        if (::fstat(fd, &statBuf))
+            setError("fstat");
+        break;
+    case Mkdir:
+        if (::mkdir(encodedPath.constData(), mode))
+            setError("mkdir");
+        break;
+    case Rename:
+        if (::rename(encodedPath.constData(), encodedNewPath.constData()))
+            setError("rename");
+        break;
+    case Unlink:
+        if (::unlink(encodedPath.constData()))
+            setError("unlink");
+        break;
+    case Rmdir:
+        if (::rmdir(encodedPath.constData()))
+            setError("rmdir");
+        break;
+    case Readdir: {
+        DirectoryWalk walk(encodedPath, recursive, withFileTypes);
+        walk.read(&entries, INT_MAX, &errorNo, &syscall);
+        break;
+    }
+    case ReadFile:
+        fileData = readWholeFile(encodedPath, flags, &errorNo, &syscall);
+        if (fileData && encoding != BufferEncoding::Invalid) {
+            // Decode on the worker thread, only the V4 string is created on the engine thread
+            text = Buffer::encodeData(fileData->data(), fileData->size, encoding);
+            if (!fileData->ref.deref())
+                QTypedArrayData<char>::deallocate(fileData);
+            fileData = nullptr;
+        }
+        break;
+    case WriteFile: {
+        const int fd = ::open(encodedPath.constData(), flags | O_CLOEXEC, mode);
+        if (fd < 0) {
+            setError("open");
+            break;
+        }
+        if (!writeAll(fd, data.constData(), data.size(), -1, &result))
+            setError("write");
+        ::close(fd);
+        break;
+    }
+    case CopyFile:
+        copyFile(encodedPath, encodedNewPath, flags, &errorNo, &syscall);
+        break;
+    case Fsync:
+        if (::fsync(fd))
+            setError("fsync");
+        break;
+    }
+}
+
+int FsRequest::resultCount() const
+{
+    switch (type) {
+    case Read:
+    case Write:
+    case Readv:
+    case Writev:
+        return 2;
+    case Open:
+    case Stat:
+    case Lstat:
+    case Fstat:
+    case Readdir:
+    case ReadFile:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void FsRequest::results(QV4::ExecutionEngine *v4, QV4::Value *args)
+{
+    QV4::Scope scope(v4);
+
+    switch (type) {
+    case Open:
+        args[0] = QV4::Primitive::fromInt32(result);
+        break;
+    case Read:
+    case Write:
+    case Readv:
+    case Writev:
+        args[0] = QV4::Primitive::fromDouble(result);
+        args[1] = buffer.value();
+        break;
+    case Stat:
+    case Lstat:
+    case Fstat:
+        args[0] = compactStats ? StatsPrototype::createCompact(v4, statBuf)
+                               : StatsPrototype::create(v4, statBuf);
+        break;
+    case Readdir:
+        args[0] = DirectoryWalk::toArray(v4, path, entries, withFileTypes, encoding);
+        break;
+    case ReadFile: {
+        if (encoding != BufferEncoding::Invalid) {
+            args[0] = v4->newString(text)->asReturnedValue();
+            break;
+        }
+
+        const QTypedArrayDataSlice<char> slice(fileData);
+        fileData->ref.deref(); // Disown data
+        fileData = nullptr;
+        args[0] = v4->memoryManager->alloc<Buffer>(v4, slice)->asReturnedValue();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/*!
+  \internal
+  Marks \a size bytes of the \a count \a vectors as transferred, adjusting the first vector not
+  transferred completely. Returns the number of vectors transferred completely.
+*/
+int FsRequest::consumeVectors(struct iovec *vectors, int count, size_t size)
+{
+    int consumed = 0;
+    while (consumed < count && size >= vectors[consumed].iov_len) {
+        size -= vectors[consumed].iov_len;
+        ++consumed;
+    }
+    if (consumed < count && size) {
+        vectors[consumed].iov_base = static_cast<char *>(vectors[consumed].iov_base) + size;
+        vectors[consumed].iov_len -= size;
+    }
+    return consumed;
+}
+
+/*!
+  \internal
+  Writes all \a vectors with as few writev() calls as possible, resubmitting the remainder after
+  short writes. \a vectors is modified to track progress.
+*/
+bool FsRequest::writeVectors(int fd, struct iovec *vectors, int count, qint64 position,
+                             qint64 *written)
+{
+    *written = 0;
+    int index = consumeVectors(vectors, count, 0);
+    while (index < count) {
+        const int n = qMin(count - index, MaxVectors);
+        const ssize_t result = position < 0
+                ? ::writev(fd, vectors + index, n)
+                : ::pwritev(fd, vectors + index, n, position + *written);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (!result)
+            break;
+        *written += result;
+        index += consumeVectors(vectors + index, count - index, result);
+    }
+    return true;
+}
+
+/*!
+  \internal
+  Reads into \a vectors with a single readv() call, as Node.js does. Only the first MaxVectors
+  vectors can be filled. Returns the number of bytes read, or -1 on error.
+*/
+qint64 FsRequest::readVectors(int fd, const struct iovec *vectors, int count, qint64 position)
+{
+    ssize_t result;
+    do {
+        result = position < 0 ? ::readv(fd, vectors, qMin(count, MaxVectors))
+                              : ::preadv(fd, vectors, qMin(count, MaxVectors), position);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+/*!
+  \internal
+  Reads the file at \a path into a single allocation sized after fstat(), laid out like the data
+  of Heap::Buffer::allocateData() so it can back a Buffer as is. Files reporting no size (e.g. in
+  /proc) or growing while being read are handled by reallocating. Returns \c nullptr and sets
+  \a errorNo and \a syscall on failure.
+*/
+QTypedArrayData<char> *FsRequest::readWholeFile(const QByteArray &path, int flags, int *errorNo,
+                                                 QString *syscall)
+{
+    const int fd = ::open(path.constData(), flags | O_CLOEXEC);
+    if (fd < 0) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("open");
+        return nullptr;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st)) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("fstat");
+        ::close(fd);
+        return nullptr;
+    }
+
+    if (S_ISREG(st.st_mode) && size_t(st.st_size) > kMaxBufferLength) {
+        *errorNo = EFBIG;
+        *syscall = QStringLiteral("read");
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t capacity = S_ISREG(st.st_mode) ? st.st_size : 0;
+    size_t size = 0;
+
+    QTypedArrayData<char> *data = QTypedArrayData<char>::allocate(capacity + 1);
+    if (!data) {
+        *errorNo = ENOMEM;
+        *syscall = QStringLiteral("read");
+        ::close(fd);
+        return nullptr;
+    }
+
+    for (;;) {
+        ssize_t n;
+        if (size < capacity) {
+            n = ::read(fd, data->data() + size, capacity - size);
+        } else {
+            // Either EOF or the file is larger than reported
+            char probe[ProbeSize];
+            n = ::read(fd, probe, sizeof(probe));
+            if (n > 0) {
+                capacity = std::max(capacity * 2, size + n);
+                if (capacity > kMaxBufferLength) {
+                    *errorNo = EFBIG;
+                    break;
+                }
+                QTypedArrayData<char> *newData
+                        = QTypedArrayData<char>::reallocateUnaligned(data, capacity + 1);
+                if (!newData) {
+                    *errorNo = ENOMEM;
+                    break;
+                }
+                data = newData;
+                ::memcpy(data->data() + size, probe, n);
+            }
+        }
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            *errorNo = errno;
+            break;
+        }
+        if (!n)
+            break;
+        size += n;
+    }
+
+    ::close(fd);
+
+    if (*errorNo) {
+        *syscall = QStringLiteral("read");
+        QTypedArrayData<char>::deallocate(data);
+        return nullptr;
+    }
+
+    data->size = size;
+    data->data()[size] = 0;
+    return data;
+}
+
+/*!
+  \internal
+  Copies \a source to \a destination without passing the data through user space when possible.
+  With CopyClone or CopyCloneForce the destination is first created as a reflink sharing the
+  blocks of the source. Otherwise, or if cloning is not supported, copy_file_range() is used,
+  then sendfile(), and finally a read/write loop with a buffer reused by the thread.
+*/
+bool FsRequest::copyFile(const QByteArray &source, const QByteArray &destination, int flags,
+                         int *errorNo, QString *syscall)
+{
+    const int in = ::open(source.constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("open");
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(in, &st)) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("fstat");
+        ::close(in);
+        return false;
+    }
+
+    // Not truncated on open, as the destination may be the source itself
+    int openFlags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    if (flags & CopyExclusive)
+        openFlags |= O_EXCL;
+    const int out = ::open(destination.constData(), openFlags, st.st_mode & 07777);
+    if (out < 0) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("open");
+        ::close(in);
+        return false;
+    }
+
+    struct stat outSt;
+    if (::fstat(out, &outSt)) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("fstat");
+        ::close(in);
+        ::close(out);
+        return false;
+    }
+
+    // As in libuv, copying a file onto itself succeeds without touching it
+    if (st.st_dev == outSt.st_dev && st.st_ino == outSt.st_ino) {
+        ::close(in);
+        ::close(out);
+        return true;
+    }
+
+    bool done = false;
+    bool ok = true;
+
+    if (::ftruncate(out, 0)) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("ftruncate");
+        ok = false;
+    }
+
+#ifdef Q_OS_LINUX
+#ifdef FICLONE
+    if (ok && (flags & (CopyClone | CopyCloneForce))) {
+        if (!::ioctl(out, FICLONE, in)) {
+            done = true;
+        } else if (flags & CopyCloneForce) {
+            *errorNo = errno;
+            *syscall = QStringLiteral("ioctl");
+            ok = false;
+        }
+    }
+#else
+    if (ok && (flags & CopyCloneForce)) {
+        *errorNo = ENOSYS;
+        *syscall = QStringLiteral("copyfile");
+        ok = false;
+    }
+#endif
+
+    qint64 copied = 0;
+    if (ok && !done) {
+        const int result = copyFileRange(in, out, &copied);
+        done = result == 1;
+        ok = result != -1;
+        if (!ok)
+            *syscall = QStringLiteral("copy_file_range");
+    }
+    if (ok && !done) {
+        const int result = sendFile(in, out, &copied);
+        done = result == 1;
+        ok = result != -1;
+        if (!ok)
+            *syscall = QStringLiteral("sendfile");
+    }
+#else
+    if (ok && (flags & CopyCloneForce)) {
+        *errorNo = ENOSYS;
+        *syscall = QStringLiteral("copyfile");
+        ok = false;
+    }
+#endif
+
+    if (ok && !done)
+        ok = copyLoop(in, out, syscall);
+
+    if (!ok && !*errorNo)
+        *errorNo = errno;
+    if (ok && ::fchmod(out, st.st_mode & 07777)) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("fchmod");
+        ok = false;
+    }
+
+    ::close(in);
+    if (::close(out) && ok) {
+        *errorNo = errno;
+        *syscall = QStringLiteral("close");
+        ok = false;
+    }
+
+    // Do not leave a partial copy behind
+    if (!ok)
+        ::unlink(destination.constData());
+    return ok;
+}
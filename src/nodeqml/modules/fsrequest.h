@@ -0,0 +1,107 @@
+#ifndef FSREQUEST_H
+#define FSREQUEST_H
+
+#include "fsdir.h"
+#include "../asyncwork.h"
+#include "../types/buffer.h"
+#include "../util/qarraydataslice.h"
+
+#include <QByteArray>
+#include <QStringList>
+
+#include <QVector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  A single file system operation executed on the engine thread pool, similar to libuv's uv_fs_t.
+*/
+class FsRequest : public AsyncWork
+{
+public:
+    enum Type {
+        Open,
+        Close,
+        Read,
+        Write,
+        Stat,
+        Lstat,
+        Fstat,
+        Mkdir,
+        Rename,
+        Unlink,
+        Rmdir,
+        Readdir,
+        ReadFile,
+        WriteFile,
+        CopyFile,
+        Fsync,
+        Readv,
+        Writev
+    };
+
+    // Flags of copyFile(), same values as in Node.js
+    enum CopyFlag {
+        CopyExclusive = 1,
+        CopyClone = 2,
+        CopyCloneForce = 4
+    };
+
+    FsRequest(QV4::ExecutionEngine *v4, Type type, QV4::ReturnedValue callback);
+    ~FsRequest();
+
+    void execute() override;
+    int resultCount() const override;
+    void results(QV4::ExecutionEngine *v4, QV4::Value *args) override;
+
+    static QTypedArrayData<char> *readWholeFile(const QByteArray &path, int flags, int *errorNo,
+                                                QString *syscall);
+    static bool copyFile(const QByteArray &source, const QByteArray &destination, int flags,
+                         int *errorNo, QString *syscall);
+
+    // Largest number of vectors passed to a single readv() or writev(), IOV_MAX on Linux
+    static const int MaxVectors = 1024;
+    static int consumeVectors(struct iovec *vectors, int count, size_t size);
+    static bool writeVectors(int fd, struct iovec *vectors, int count, qint64 position,
+                             qint64 *written);
+    static qint64 readVectors(int fd, const struct iovec *vectors, int count, qint64 position);
+
+    Type type;
+
+    QByteArray encodedPath;
+    QByteArray encodedNewPath;
+    int flags = O_RDONLY;
+    mode_t mode = 0666;
+    int fd = -1;
+    qint64 position = -1;
+    BufferEncoding encoding = BufferEncoding::Invalid;
+    bool withFileTypes = false;
+    bool recursive = false;
+    bool compactStats = false;
+
+    // Memory to read into or write from, keeps the underlying data alive
+    QTypedArrayDataSlice<char> data;
+    // Buffer passed back to the callback of read() and write(), or array of readv() and writev()
+    QV4::PersistentValue buffer;
+    // Memory of readv() and writev(), vectors point into the slices kept alive here
+    QList<QTypedArrayDataSlice<char> > slices;
+    QVector<struct iovec> vectors;
+
+    qint64 result = 0;
+    struct stat statBuf;
+    QList<DirectoryWalk::Entry> entries;
+    QTypedArrayData<char> *fileData = nullptr;
+    QString text;
+
+private:
+    void setError(const char *syscallName);
+};
+
+} // namespace NodeQml
+
+#endif // FSREQUEST_H
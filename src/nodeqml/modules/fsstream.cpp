@@ -0,0 +1,1024 @@
+#include "fsstream.h"
+
+#include "filesystem.h"
+#include "fsrequest.h"
+#include "stringdecoder.h"
+#include "../engine_p.h"
+#include "../util/eventemitter.h"
+
+#include <QFile>
+
+#include <private/qv4context_p.h>
+
+#include <unistd.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(FileReadStream);
+DEFINE_OBJECT_VTABLE(FileWriteStream);
+
+namespace {
+
+/*
+  File system request issued by a stream. Instead of calling a JS callback, the result is handed
+  to the stream, which is kept alive until the request completes.
+ */
+class StreamRequest : public FsRequest
+{
+public:
+    StreamRequest(QV4::ExecutionEngine *v4, Type type, QV4::Heap::Object *stream) :
+        FsRequest(v4, type, QV4::Encode::undefined()),
+        m_stream(v4, stream->asReturnedValue())
+    {
+    }
+
+    void complete(QV4::ExecutionEngine *v4) override
+    {
+        QV4::Scope scope(v4);
+        QV4::Scoped<FileReadStream> readStream(scope, m_stream.value());
+        if (readStream) {
+            FileReadStream::requestDone(v4, readStream->d(), this);
+            return;
+        }
+        QV4::Scoped<FileWriteStream> writeStream(scope, m_stream.value());
+        if (writeStream)
+            FileWriteStream::requestDone(v4, writeStream->d(), this);
+    }
+
+private:
+    QV4::PersistentValue m_stream;
+};
+
+StreamRequest *newStreamRequest(QV4::ExecutionEngine *v4, FsRequest::Type type,
+                                QV4::Heap::Object *stream, const QString &path)
+{
+    StreamRequest *request = new StreamRequest(v4, type, stream);
+    request->path = path;
+    return request;
+}
+
+bool emitError(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, FsRequest *request)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedValue error(scope, EnginePrivate::get(v4)->newErrnoException(
+                               request->errorNo, request->syscall, request->path));
+    return emitEvent(v4, emitter, QStringLiteral("error"), error.asReturnedValue(), 1);
+}
+
+QV4::ReturnedValue option(QV4::ExecutionEngine *v4, const QV4::Value &options, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    if (!o)
+        return QV4::Encode::undefined();
+    QV4::ScopedString s(scope, v4->newString(name));
+    return o->get(s);
+}
+
+bool parseEncodingOption(QV4::ExecutionEngine *v4, const QV4::Value &value, BufferEncoding *encoding)
+{
+    if (value.isNullOrUndefined())
+        return true;
+    *encoding = Buffer::parseEncoding(value.toQStringNoThrow());
+    if (*encoding == BufferEncoding::Invalid) {
+        v4->throwTypeError(QString("Unknown encoding: %1").arg(value.toQStringNoThrow()));
+        return false;
+    }
+    return true;
+}
+
+bool parseFlagsOption(QV4::ExecutionEngine *v4, const QV4::Value &value, int *flags)
+{
+    if (value.isNullOrUndefined())
+        return true;
+    *flags = FileSystemModule::parseFlags(value);
+    if (*flags == -1) {
+        v4->throwError(QString("Unknown file open flag: %1").arg(value.toQStringNoThrow()));
+        return false;
+    }
+    return true;
+}
+
+void parseModeOption(const QV4::Value &value, mode_t *mode)
+{
+    if (value.isNumber()) {
+        *mode = value.toUInt32();
+    } else if (value.isString()) {
+        bool ok;
+        const mode_t m = value.toQString().toUInt(&ok, 8);
+        if (ok)
+            *mode = m;
+    }
+}
+
+QTypedArrayDataSlice<char> chunkData(QV4::ExecutionEngine *v4, const QV4::Value &value,
+                                     BufferEncoding encoding)
+{
+    QV4::Scope scope(v4);
+    QV4::Scoped<Buffer> buffer(scope, value);
+    if (buffer)
+        return buffer->d()->data;
+
+    QTypedArrayData<char> *arrayData
+            = Buffer::fromString(Buffer::decodeString(value.toQStringNoThrow(), encoding));
+    if (!arrayData)
+        return QTypedArrayDataSlice<char>();
+    const QTypedArrayDataSlice<char> slice(arrayData);
+    arrayData->ref.deref(); // Disown data
+    return slice;
+}
+
+// Hands a chunk to JS, as a string if an encoding has been set
+bool emitData(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream,
+              const QTypedArrayDataSlice<char> &chunk)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, stream);
+    QV4::ScopedValue data(scope);
+
+    if (stream->decoder) {
+        const QString str = StringDecoder::decode(stream->decoder, chunk.constData(), chunk.size());
+        if (str.isEmpty())
+            return true;
+        data = v4->newString(str)->asReturnedValue();
+    } else {
+        data = v4->memoryManager->alloc<Buffer>(v4, chunk)->asReturnedValue();
+    }
+
+    if (!emitEvent(v4, stream, QStringLiteral("data"), data.asReturnedValue(), 1))
+        return false;
+
+    if (!stream->pipeDestination)
+        return true;
+
+    // Backpressure: stop reading until the destination has been drained
+    QV4::ScopedObject destination(scope, stream->pipeDestination);
+    QV4::ScopedValue written(scope, callMethod(v4, destination, QStringLiteral("write"), data, 1));
+    if (v4->hasException)
+        return false;
+    if (written->isBoolean() && !written->booleanValue()) {
+        stream->flowing = false;
+        QV4::ScopedString s(scope, v4->newString(QStringLiteral("resume")));
+        QV4::ScopedValue resume(scope, self->get(s));
+        QV4::ScopedValue boundResume(scope, callMethod(v4, resume, QStringLiteral("bind"), self, 1));
+        once(v4, destination->d(), QStringLiteral("drain"), boundResume);
+    }
+    return !v4->hasException;
+}
+
+void emitEnd(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream)
+{
+    stream->ended = true;
+
+    if (stream->decoder) {
+        const QString rest = StringDecoder::flush(stream->decoder);
+        if (!rest.isEmpty()) {
+            QV4::Scope scope(v4);
+            QV4::ScopedValue data(scope, v4->newString(rest));
+            if (!emitEvent(v4, stream, QStringLiteral("data"), data.asReturnedValue(), 1))
+                return;
+        }
+    }
+
+    if (!emitEvent(v4, stream, QStringLiteral("end")))
+        return;
+
+    if (stream->pipeDestination && stream->pipeEnd) {
+        QV4::Scope scope(v4);
+        QV4::ScopedObject destination(scope, stream->pipeDestination);
+        callMethod(v4, destination, QStringLiteral("end"));
+        if (v4->hasException)
+            return;
+    }
+
+    if (stream->autoClose)
+        FileReadStream::close(v4, stream);
+}
+
+void callChunkCallback(QV4::ExecutionEngine *v4, const Heap::FileWriteStream::Chunk &chunk,
+                       const QV4::Value &error)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedFunctionObject cb(scope, chunk.callback.value());
+    if (!cb)
+        return;
+    QV4::ScopedCallData callData(scope, 1);
+    callData->thisObject = v4->globalObject();
+    callData->args[0] = error;
+    cb->call(callData);
+}
+
+bool writeChunk(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream, const QV4::Value &value,
+                BufferEncoding encoding, const QV4::Value &callback)
+{
+    Heap::FileWriteStream::Chunk chunk;
+    chunk.data = chunkData(v4, value, encoding);
+    if (callback.asFunctionObject())
+        chunk.callback.set(v4, callback);
+
+    stream->bufferedBytes += chunk.data.size();
+    stream->queue.append(chunk);
+    FileWriteStream::writeNext(v4, stream);
+
+    const bool belowHighWaterMark = stream->bufferedBytes < stream->highWaterMark;
+    if (!belowHighWaterMark)
+        stream->needDrain = true;
+    return belowHighWaterMark;
+}
+
+} // namespace
+
+Heap::FileReadStream::FileReadStream(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->fileReadStreamPrototype.asObject()),
+    flags(O_RDONLY)
+{
+}
+
+Heap::FileWriteStream::FileWriteStream(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->fileWriteStreamPrototype.asObject()),
+    flags(O_TRUNC | O_CREAT | O_WRONLY)
+{
+}
+
+void FileReadStream::destroy(QV4::Heap::Base *that)
+{
+    Heap::FileReadStream *stream = static_cast<Heap::FileReadStream *>(that);
+    // Requests keep the stream alive, so no file operation can be in flight here
+    if (stream->fd >= 0 && stream->autoClose)
+        ::close(stream->fd);
+    stream->~FileReadStream();
+}
+
+void FileReadStream::markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e)
+{
+    Heap::FileReadStream *stream = static_cast<Heap::FileReadStream *>(that);
+    if (stream->decoder)
+        stream->decoder->mark(e);
+    if (stream->pipeDestination)
+        stream->pipeDestination->mark(e);
+
+    QV4::Object::markObjects(that, e);
+}
+
+/*!
+  \internal
+  Creates a stream reading \a path, see fs.createReadStream(). Reading starts once a 'data'
+  listener is added or the stream is resumed.
+*/
+QV4::ReturnedValue FileReadStream::create(QV4::ExecutionEngine *v4, const QString &path,
+                                          const QV4::Value &options)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (!initEmitterPrototype(v4, engine->fileReadStreamPrototype))
+        return QV4::Encode::undefined();
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<FileReadStream> stream(scope, v4->memoryManager->alloc<FileReadStream>(v4));
+    Heap::FileReadStream *d = stream->d();
+    d->path = path;
+
+    BufferEncoding encoding = BufferEncoding::Invalid;
+    QV4::ScopedValue v(scope);
+    qint64 start = -1;
+
+    if (options.isString()) {
+        if (!parseEncodingOption(v4, options, &encoding))
+            return QV4::Encode::undefined();
+    } else if (options.isObject()) {
+        if (!parseEncodingOption(v4, (v = option(v4, options, QStringLiteral("encoding"))), &encoding))
+            return QV4::Encode::undefined();
+        if (!parseFlagsOption(v4, (v = option(v4, options, QStringLiteral("flags"))), &d->flags))
+            return QV4::Encode::undefined();
+        parseModeOption((v = option(v4, options, QStringLiteral("mode"))), &d->mode);
+
+        v = option(v4, options, QStringLiteral("fd"));
+        if (v->isNumber())
+            d->fd = v->toInt32();
+        v = option(v4, options, QStringLiteral("autoClose"));
+        if (!v->isUndefined())
+            d->autoClose = v->toBoolean();
+        v = option(v4, options, QStringLiteral("highWaterMark"));
+        if (v->isNumber() && v->toInt32() > 0)
+            d->highWaterMark = v->toInt32();
+        v = option(v4, options, QStringLiteral("start"));
+        if (v->isNumber())
+            start = v->toInteger();
+        v = option(v4, options, QStringLiteral("end"));
+        if (v->isNumber())
+            d->end = v->toInteger();
+    }
+
+    if (start >= 0 || d->end >= 0) {
+        d->position = qMax<qint64>(start, 0);
+        if (d->end >= 0 && d->position > d->end)
+            return v4->throwRangeError(QStringLiteral("start must be <= end"));
+    }
+
+    if (encoding != BufferEncoding::Invalid) {
+        QV4::Scoped<StringDecoder> decoder(scope, v4->memoryManager->alloc<StringDecoder>(v4, encoding));
+        d->decoder = decoder->d();
+    }
+
+    if (d->fd < 0)
+        open(v4, d);
+
+    return stream.asReturnedValue();
+}
+
+void FileReadStream::open(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream)
+{
+    StreamRequest *request = newStreamRequest(v4, FsRequest::Open, stream, stream->path);
+    request->encodedPath = QFile::encodeName(stream->path);
+    request->flags = stream->flags;
+    request->mode = stream->mode;
+
+    stream->opening = true;
+    EnginePrivate::get(v4)->queueFsRequest(request);
+}
+
+/*!
+  \internal
+  Starts reading the next chunk into memory taken from the engine buffer pool, unless a chunk is
+  already being read or waiting to be consumed.
+*/
+void FileReadStream::readNext(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream)
+{
+    if (stream->fd < 0 || stream->reading || stream->eof || stream->closeRequested
+            || !stream->pending.isNull()) {
+        return;
+    }
+
+    int length = stream->highWaterMark;
+    if (stream->end >= 0) {
+        const qint64 left = stream->end - stream->position + 1;
+        if (left <= 0) {
+            stream->eof = true;
+            return;
+        }
+        length = qMin<qint64>(length, left);
+    }
+
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    StreamRequest *request = newStreamRequest(v4, FsRequest::Read, stream, stream->path);
+    request->fd = stream->fd;
+    request->position = stream->position;
+    request->data = engine->streamBufferPool.reserve(length);
+    if (request->data.isNull()) {
+        delete request;
+        v4->throwRangeError(QStringLiteral("Buffer: Out of memory"));
+        return;
+    }
+
+    stream->reading = true;
+    engine->queueFsRequest(request);
+}
+
+/*!
+  \internal
+  Emits the chunk read ahead, if any, and keeps reading while the stream is flowing. The next
+  chunk is requested before the current one is handed to JS, so that reading the file overlaps
+  with processing the data.
+*/
+void FileReadStream::flow(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream)
+{
+    if (!stream->flowing || stream->ended)
+        return;
+
+    if (!stream->pending.isNull()) {
+        const QTypedArrayDataSlice<char> chunk = stream->pending;
+        stream->pending.clearData();
+        readNext(v4, stream);
+        if (v4->hasException || !emitData(v4, stream, chunk))
+            return;
+    }
+
+    if (!stream->flowing)
+        return;
+
+    if (stream->eof && stream->pending.isNull() && !stream->reading)
+        emitEnd(v4, stream);
+    else
+        readNext(v4, stream);
+}
+
+void FileReadStream::close(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream)
+{
+    stream->closeRequested = true;
+    stream->flowing = false;
+
+    // Closing is resumed once the pending request completes
+    if (stream->closed || stream->closing || stream->opening || stream->reading)
+        return;
+
+    if (stream->fd < 0) {
+        stream->closed = true;
+        emitEvent(v4, stream, QStringLiteral("close"));
+        return;
+    }
+
+    StreamRequest *request = newStreamRequest(v4, FsRequest::Close, stream, stream->path);
+    request->fd = stream->fd;
+    stream->fd = -1;
+    stream->closing = true;
+    EnginePrivate::get(v4)->queueFsRequest(request);
+}
+
+void FileReadStream::requestDone(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream,
+                                 FsRequest *request)
+{
+    switch (request->type) {
+    case FsRequest::Open:
+        stream->opening = false;
+        if (request->errorNo) {
+            emitError(v4, stream, request);
+            close(v4, stream);
+            return;
+        }
+        stream->fd = request->result;
+        if (!emitEvent(v4, stream, QStringLiteral("open"), QV4::Encode(stream->fd), 1))
+            return;
+        break;
+
+    case FsRequest::Read: {
+        stream->reading = false;
+        EnginePrivate::get(v4)->streamBufferPool.release(request->data, qMax<qint64>(request->result, 0));
+
+        if (request->errorNo) {
+            if (stream->closeRequested)
+                break;
+            emitError(v4, stream, request);
+            if (stream->autoClose)
+                close(v4, stream);
+            return;
+        }
+
+        if (!request->result) {
+            stream->eof = true;
+        } else {
+            stream->pending = QTypedArrayDataSlice<char>(request->data, 0, request->result);
+            stream->bytesRead += request->result;
+            if (stream->position >= 0)
+                stream->position += request->result;
+        }
+        break;
+    }
+
+    case FsRequest::Close:
+        stream->closing = false;
+        stream->closed = true;
+        if (request->errorNo)
+            emitError(v4, stream, request);
+        else
+            emitEvent(v4, stream, QStringLiteral("close"));
+        return;
+
+    default:
+        return;
+    }
+
+    if (stream->closeRequested)
+        close(v4, stream);
+    else
+        flow(v4, stream);
+}
+
+void FileWriteStream::destroy(QV4::Heap::Base *that)
+{
+    Heap::FileWriteStream *stream = static_cast<Heap::FileWriteStream *>(that);
+    if (stream->fd >= 0 && stream->autoClose)
+        ::close(stream->fd);
+    stream->~FileWriteStream();
+}
+
+/*!
+  \internal
+  Creates a stream writing to \a path, see fs.createWriteStream(). Chunks are written one after
+  another on the thread pool; write() returns \c false once more than highWaterMark bytes are
+  waiting, and 'drain' is emitted when the queue has been written.
+*/
+QV4::ReturnedValue FileWriteStream::create(QV4::ExecutionEngine *v4, const QString &path,
+                                           const QV4::Value &options)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (!initEmitterPrototype(v4, engine->fileWriteStreamPrototype))
+        return QV4::Encode::undefined();
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<FileWriteStream> stream(scope, v4->memoryManager->alloc<FileWriteStream>(v4));
+    Heap::FileWriteStream *d = stream->d();
+    d->path = path;
+
+    QV4::ScopedValue v(scope);
+
+    if (options.isString()) {
+        if (!parseEncodingOption(v4, options, &d->defaultEncoding))
+            return QV4::Encode::undefined();
+    } else if (options.isObject()) {
+        if (!parseEncodingOption(v4, (v = option(v4, options, QStringLiteral("encoding"))), &d->defaultEncoding))
+            return QV4::Encode::undefined();
+        if (!parseEncodingOption(v4, (v = option(v4, options, QStringLiteral("defaultEncoding"))), &d->defaultEncoding))
+            return QV4::Encode::undefined();
+        if (!parseFlagsOption(v4, (v = option(v4, options, QStringLiteral("flags"))), &d->flags))
+            return QV4::Encode::undefined();
+        parseModeOption((v = option(v4, options, QStringLiteral("mode"))), &d->mode);
+
+        v = option(v4, options, QStringLiteral("fd"));
+        if (v->isNumber())
+            d->fd = v->toInt32();
+        v = option(v4, options, QStringLiteral("autoClose"));
+        if (!v->isUndefined())
+            d->autoClose = v->toBoolean();
+        v = option(v4, options, QStringLiteral("highWaterMark"));
+        if (v->isNumber() && v->toInt32() > 0)
+            d->highWaterMark = v->toInt32();
+        v = option(v4, options, QStringLiteral("start"));
+        if (v->isNumber()) {
+            d->position = v->toInteger();
+            if (d->position < 0)
+                return v4->throwRangeError(QStringLiteral("start must be >= zero"));
+        }
+    }
+
+    if (d->fd < 0)
+        open(v4, d);
+
+    return stream.asReturnedValue();
+}
+
+void FileWriteStream::open(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream)
+{
+    StreamRequest *request = newStreamRequest(v4, FsRequest::Open, stream, stream->path);
+    request->encodedPath = QFile::encodeName(stream->path);
+    request->flags = stream->flags;
+    request->mode = stream->mode;
+
+    stream->opening = true;
+    EnginePrivate::get(v4)->queueFsRequest(request);
+}
+
+void FileWriteStream::writeNext(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream)
+{
+    if (stream->fd < 0 || stream->writing || stream->closing || stream->queue.isEmpty())
+        return;
+
+    StreamRequest *request = newStreamRequest(v4, FsRequest::Write, stream, stream->path);
+    request->fd = stream->fd;
+    request->position = stream->position;
+    request->data = stream->queue.first().data;
+
+    stream->writing = true;
+    EnginePrivate::get(v4)->queueFsRequest(request);
+}
+
+void FileWriteStream::finish(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream)
+{
+    if (stream->finished)
+        return;
+
+    stream->finished = true;
+    if (!emitEvent(v4, stream, QStringLiteral("finish")))
+        return;
+
+    if (stream->autoClose)
+        close(v4, stream);
+}
+
+void FileWriteStream::close(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream)
+{
+    stream->closeRequested = true;
+
+    // Closing is resumed once the pending request completes
+    if (stream->closed || stream->closing || stream->opening || stream->writing)
+        return;
+
+    if (stream->fd < 0) {
+        stream->closed = true;
+        emitEvent(v4, stream, QStringLiteral("close"));
+        return;
+    }
+
+    StreamRequest *request = newStreamRequest(v4, FsRequest::Close, stream, stream->path);
+    request->fd = stream->fd;
+    stream->fd = -1;
+    stream->closing = true;
+    EnginePrivate::get(v4)->queueFsRequest(request);
+}
+
+void FileWriteStream::requestDone(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream,
+                                  FsRequest *request)
+{
+    QV4::Scope scope(v4);
+
+    switch (request->type) {
+    case FsRequest::Open:
+        stream->opening = false;
+        if (request->errorNo) {
+            emitError(v4, stream, request);
+            close(v4, stream);
+            return;
+        }
+        stream->fd = request->result;
+        if (!emitEvent(v4, stream, QStringLiteral("open"), QV4::Encode(stream->fd), 1))
+            return;
+        break;
+
+    case FsRequest::Write: {
+        stream->writing = false;
+        const Heap::FileWriteStream::Chunk chunk = stream->queue.takeFirst();
+        stream->bufferedBytes -= chunk.data.size();
+
+        if (request->errorNo) {
+            QV4::ScopedValue error(scope, EnginePrivate::get(v4)->newErrnoException(
+                                       request->errorNo, request->syscall, request->path));
+            callChunkCallback(v4, chunk, error);
+            if (v4->hasException)
+                return;
+            stream->queue.clear();
+            stream->bufferedBytes = 0;
+            if (!emitEvent(v4, stream, QStringLiteral("error"), error.asReturnedValue(), 1))
+                return;
+            if (stream->autoClose)
+                close(v4, stream);
+            return;
+        }
+
+        stream->bytesWritten += request->result;
+        if (stream->position >= 0)
+            stream->position += request->result;
+
+        QV4::ScopedValue null(scope, QV4::Primitive::nullValue());
+        callChunkCallback(v4, chunk, null);
+        if (v4->hasException)
+            return;
+        break;
+    }
+
+    case FsRequest::Close:
+        stream->closing = false;
+        stream->closed = true;
+        if (request->errorNo)
+            emitError(v4, stream, request);
+        else
+            emitEvent(v4, stream, QStringLiteral("close"));
+        return;
+
+    default:
+        return;
+    }
+
+    if (stream->closeRequested && !stream->ending) {
+        close(v4, stream);
+        return;
+    }
+
+    writeNext(v4, stream);
+    if (stream->writing)
+        return;
+
+    if (stream->needDrain) {
+        stream->needDrain = false;
+        if (!emitEvent(v4, stream, QStringLiteral("drain")))
+            return;
+    }
+
+    // 'drain' listeners may have written more data
+    if (stream->ending && !stream->writing && stream->queue.isEmpty())
+        finish(v4, stream);
+}
+
+void FileReadStreamPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("on"), method_on, 2);
+    defineDefaultProperty(QStringLiteral("addListener"), method_on, 2);
+    defineDefaultProperty(QStringLiteral("pause"), method_pause);
+    defineDefaultProperty(QStringLiteral("resume"), method_resume);
+    defineDefaultProperty(QStringLiteral("isPaused"), method_isPaused);
+    defineDefaultProperty(QStringLiteral("setEncoding"), method_setEncoding, 1);
+    defineDefaultProperty(QStringLiteral("pipe"), method_pipe, 2);
+    defineDefaultProperty(QStringLiteral("close"), method_close, 1);
+    defineDefaultProperty(QStringLiteral("destroy"), method_close, 1);
+
+    defineAccessorProperty(QStringLiteral("path"), property_path_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("fd"), property_fd_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("bytesRead"), property_bytesRead_getter, nullptr);
+}
+
+// on(event, listener), adding a 'data' listener starts the flow of data
+QV4::ReturnedValue FileReadStreamPrototype::method_on(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    // EventEmitter.prototype.on
+    QV4::ScopedObject emitterPrototype(scope, EnginePrivate::get(v4)->fileReadStreamPrototype.asObject()->prototype());
+    QV4::ScopedString s(scope, v4->newString(QStringLiteral("on")));
+    QV4::ScopedFunctionObject on(scope, emitterPrototype->get(s));
+    if (!on)
+        return v4->throwTypeError();
+
+    QV4::ScopedCallData args(scope, callData->argc);
+    args->thisObject = callData->thisObject;
+    for (int i = 0; i < callData->argc; ++i)
+        args->args[i] = callData->args[i];
+    QV4::ScopedValue result(scope, on->call(args));
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
+    if (callData->argc && callData->args[0].toQStringNoThrow() == QStringLiteral("data")
+            && !self->d()->explicitlyPaused) {
+        self->d()->flowing = true;
+        FileReadStream::flow(v4, self->d());
+    }
+
+    return result.asReturnedValue();
+}
+
+QV4::ReturnedValue FileReadStreamPrototype::method_pause(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->flowing = false;
+    self->d()->explicitlyPaused = true;
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue FileReadStreamPrototype::method_resume(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->flowing = true;
+    self->d()->explicitlyPaused = false;
+    FileReadStream::flow(v4, self->d());
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue FileReadStreamPrototype::method_isPaused(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return QV4::Encode(self->d()->explicitlyPaused);
+}
+
+// setEncoding(encoding)
+QV4::ReturnedValue FileReadStreamPrototype::method_setEncoding(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    if (callData->argc && !parseEncodingOption(v4, callData->args[0], &encoding))
+        return QV4::Encode::undefined();
+
+    QV4::Scoped<StringDecoder> decoder(scope, v4->memoryManager->alloc<StringDecoder>(v4, encoding));
+    self->d()->decoder = decoder->d();
+    return self.asReturnedValue();
+}
+
+// pipe(destination, [options])
+QV4::ReturnedValue FileReadStreamPrototype::method_pipe(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedObject destination(scope, callData->argc ? callData->args[0] : QV4::Primitive::undefinedValue());
+    if (!destination)
+        return v4->throwTypeError(QStringLiteral("pipe: destination must be a writable stream"));
+
+    QV4::ScopedValue end(scope, option(v4, callData->argc > 1 ? callData->args[1] : QV4::Primitive::undefinedValue(),
+                                       QStringLiteral("end")));
+    self->d()->pipeDestination = destination->d();
+    self->d()->pipeEnd = end->isUndefined() || end->toBoolean();
+
+    self->d()->flowing = true;
+    self->d()->explicitlyPaused = false;
+    FileReadStream::flow(v4, self->d());
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
+    return destination.asReturnedValue();
+}
+
+// close([callback])
+QV4::ReturnedValue FileReadStreamPrototype::method_close(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (callData->argc && callData->args[0].asFunctionObject())
+        once(v4, self->d(), QStringLiteral("close"), callData->args[0]);
+
+    FileReadStream::close(v4, self->d());
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue FileReadStreamPrototype::property_path_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return v4->newString(self->d()->path)->asReturnedValue();
+}
+
+QV4::ReturnedValue FileReadStreamPrototype::property_fd_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->fd < 0)
+        return QV4::Encode::null();
+    return QV4::Encode(self->d()->fd);
+}
+
+QV4::ReturnedValue FileReadStreamPrototype::property_bytesRead_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileReadStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return QV4::Encode(static_cast<double>(self->d()->bytesRead));
+}
+
+void FileWriteStreamPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("write"), method_write, 3);
+    defineDefaultProperty(QStringLiteral("end"), method_end, 3);
+    defineDefaultProperty(QStringLiteral("close"), method_close, 1);
+    defineDefaultProperty(QStringLiteral("destroy"), method_close, 1);
+
+    defineAccessorProperty(QStringLiteral("path"), property_path_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("fd"), property_fd_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("bytesWritten"), property_bytesWritten_getter, nullptr);
+}
+
+// write(chunk, [encoding], [callback])
+QV4::ReturnedValue FileWriteStreamPrototype::method_write(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileWriteStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (!callData->argc || callData->args[0].isNullOrUndefined())
+        return v4->throwTypeError(QStringLiteral("Invalid data"));
+
+    if (self->d()->ending) {
+        QV4::ScopedValue error(scope, v4->newErrorObject(QStringLiteral("write after end")));
+        emitEvent(v4, self->d(), QStringLiteral("error"), error.asReturnedValue(), 1);
+        return QV4::Encode(false);
+    }
+
+    BufferEncoding encoding = self->d()->defaultEncoding;
+    QV4::ScopedValue callback(scope, QV4::Primitive::undefinedValue());
+    if (callData->argc > 1) {
+        if (callData->args[1].asFunctionObject()) {
+            callback = callData->args[1];
+        } else {
+            if (!parseEncodingOption(v4, callData->args[1], &encoding))
+                return QV4::Encode::undefined();
+            if (callData->argc > 2)
+                callback = callData->args[2];
+        }
+    }
+
+    return QV4::Encode(writeChunk(v4, self->d(), callData->args[0], encoding, callback));
+}
+
+// end([chunk], [encoding], [callback])
+QV4::ReturnedValue FileWriteStreamPrototype::method_end(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileWriteStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    Heap::FileWriteStream *stream = self->d();
+    if (stream->ending)
+        return QV4::Encode::undefined();
+
+    BufferEncoding encoding = stream->defaultEncoding;
+    QV4::ScopedValue chunk(scope, QV4::Primitive::undefinedValue());
+    QV4::ScopedValue callback(scope, QV4::Primitive::undefinedValue());
+    for (int i = 0; i < callData->argc; ++i) {
+        if (callData->args[i].asFunctionObject()) {
+            callback = callData->args[i];
+            break;
+        }
+        if (i == 0) {
+            chunk = callData->args[0];
+        } else if (i == 1 && !parseEncodingOption(v4, callData->args[1], &encoding)) {
+            return QV4::Encode::undefined();
+        }
+    }
+
+    if (!chunk->isNullOrUndefined()) {
+        QV4::ScopedValue noCallback(scope, QV4::Primitive::undefinedValue());
+        writeChunk(v4, stream, chunk, encoding, noCallback);
+    }
+
+    if (callback->asFunctionObject())
+        once(v4, stream, QStringLiteral("finish"), callback);
+
+    stream->ending = true;
+    if (stream->fd >= 0 && !stream->writing && stream->queue.isEmpty())
+        FileWriteStream::finish(v4, stream);
+
+    return QV4::Encode::undefined();
+}
+
+// close([callback])
+QV4::ReturnedValue FileWriteStreamPrototype::method_close(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(FileWriteStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (callData->argc && callData->args[0].asFunctionObject())
+        once(v4, self->d(), QStringLiteral("close"), callData->args[0]);
+
+    FileWriteStream::close(v4, self->d());
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue FileWriteStreamPrototype::property_path_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileWriteStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return v4->newString(self->d()->path)->asReturnedValue();
+}
+
+QV4::ReturnedValue FileWriteStreamPrototype::property_fd_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileWriteStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->fd < 0)
+        return QV4::Encode::null();
+    return QV4::Encode(self->d()->fd);
+}
+
+QV4::ReturnedValue FileWriteStreamPrototype::property_bytesWritten_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(FileWriteStream, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return QV4::Encode(static_cast<double>(self->d()->bytesWritten));
+}
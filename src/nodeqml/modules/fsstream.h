@@ -0,0 +1,157 @@
+#ifndef FSSTREAM_H
+#define FSSTREAM_H
+
+#include "../v4integration.h"
+#include "../types/buffer.h"
+#include "../util/qarraydataslice.h"
+
+#include <QList>
+
+#include <private/qv4object_p.h>
+#include <private/qv4persistent_p.h>
+
+#include <sys/types.h>
+
+namespace NodeQml {
+
+class FsRequest;
+
+namespace Heap {
+
+struct StringDecoder;
+
+struct FileReadStream : QV4::Heap::Object {
+    FileReadStream(QV4::ExecutionEngine *v4);
+
+    QString path;
+    int fd = -1;
+    int flags = 0;
+    mode_t mode = 0666;
+    bool autoClose = true;
+    qint64 position = -1; // -1 for sequential reads
+    qint64 end = -1;      // Inclusive, -1 for no limit
+    qint64 bytesRead = 0;
+    int highWaterMark = 64 * 1024;
+
+    bool flowing = false;
+    bool explicitlyPaused = false;
+    bool opening = false;
+    bool reading = false;
+    bool eof = false;
+    bool ended = false;
+    bool closeRequested = false;
+    bool closing = false;
+    bool closed = false;
+
+    // Chunk read ahead while the stream is paused
+    QTypedArrayDataSlice<char> pending;
+
+    StringDecoder *decoder = nullptr;
+    QV4::Heap::Object *pipeDestination = nullptr;
+    bool pipeEnd = true;
+};
+
+struct FileWriteStream : QV4::Heap::Object {
+    FileWriteStream(QV4::ExecutionEngine *v4);
+
+    struct Chunk {
+        QTypedArrayDataSlice<char> data;
+        QV4::PersistentValue callback;
+    };
+
+    QString path;
+    int fd = -1;
+    int flags = 0;
+    mode_t mode = 0666;
+    bool autoClose = true;
+    qint64 position = -1; // -1 for sequential writes
+    qint64 bytesWritten = 0;
+    int highWaterMark = 16 * 1024;
+    BufferEncoding defaultEncoding = BufferEncoding::Utf8;
+
+    // Bytes accepted by write() that have not been written yet
+    qint64 bufferedBytes = 0;
+    QList<Chunk> queue;
+
+    bool opening = false;
+    bool writing = false;
+    bool needDrain = false;
+    bool ending = false;
+    bool finished = false;
+    bool closeRequested = false;
+    bool closing = false;
+    bool closed = false;
+};
+
+} // namespace Heap
+
+struct FileReadStream : QV4::Object
+{
+    NODE_V4_OBJECT(FileReadStream, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+    static void markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e);
+
+    static QV4::ReturnedValue create(QV4::ExecutionEngine *v4, const QString &path,
+                                     const QV4::Value &options);
+
+    static void open(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream);
+    static void readNext(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream);
+    static void flow(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream);
+    static void close(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream);
+
+    static void requestDone(QV4::ExecutionEngine *v4, Heap::FileReadStream *stream,
+                            FsRequest *request);
+};
+
+struct FileWriteStream : QV4::Object
+{
+    NODE_V4_OBJECT(FileWriteStream, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+
+    static QV4::ReturnedValue create(QV4::ExecutionEngine *v4, const QString &path,
+                                     const QV4::Value &options);
+
+    static void open(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream);
+    static void writeNext(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream);
+    static void finish(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream);
+    static void close(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream);
+
+    static void requestDone(QV4::ExecutionEngine *v4, Heap::FileWriteStream *stream,
+                            FsRequest *request);
+};
+
+struct FileReadStreamPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_on(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_pause(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_resume(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isPaused(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_setEncoding(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_pipe(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_close(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue property_path_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_fd_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_bytesRead_getter(QV4::CallContext *ctx);
+};
+
+struct FileWriteStreamPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_write(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_end(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_close(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue property_path_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_fd_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_bytesWritten_getter(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // FSSTREAM_H
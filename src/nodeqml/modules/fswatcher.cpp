@@ -0,0 +1,499 @@
+#include "fswatcher.h"
+
+#include "../engine_p.h"
+#include "../filewatcher.h"
+#include "../types/stats.h"
+#include "../util/eventemitter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QTimerEvent>
+
+#include <private/qv4context_p.h>
+#include <private/qv4persistent_p.h>
+
+#include <string.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(FSWatcher);
+DEFINE_OBJECT_VTABLE(StatWatcher);
+
+namespace NodeQml {
+
+/*
+  Emits the inotify events of an fs.watch() watcher. The watcher is kept alive until closed.
+ */
+class FsWatchListener : public FileWatcher::Listener
+{
+public:
+    FsWatchListener(QV4::ExecutionEngine *v4, Heap::FSWatcher *watcher) :
+        m_v4(v4),
+        m_watcher(v4, watcher->asReturnedValue())
+    {
+    }
+
+    void fileChanged(const QString &path, const QString &name, int events) override
+    {
+        // A listener may close the watcher, which deletes this object
+        QV4::ExecutionEngine *v4 = m_v4;
+        QV4::Scope scope(v4);
+        QV4::Scoped<FSWatcher> watcher(scope, m_watcher.value());
+
+        const QString filename = name.isEmpty() ? QFileInfo(path).fileName() : name;
+        QV4::ScopedValue filenameValue(scope);
+        if (watcher->d()->encoding == BufferEncoding::Raw) {
+            const QByteArray encodedName = QFile::encodeName(filename);
+            filenameValue = v4->memoryManager->alloc<Buffer>(v4, encodedName)->asReturnedValue();
+        } else {
+            filenameValue = v4->newString(filename);
+        }
+
+        QV4::ScopedCallData callData(scope, 2);
+        callData->args[1] = filenameValue;
+
+        if (events & FileWatcher::Rename) {
+            callData->args[0] = v4->newString(QStringLiteral("rename"))->asReturnedValue();
+            if (!emitEvent(v4, watcher->d(), QStringLiteral("change"), callData->args, 2)
+                    || watcher->d()->listener != this) {
+                return;
+            }
+        }
+        if (events & FileWatcher::Change) {
+            callData->args[0] = v4->newString(QStringLiteral("change"))->asReturnedValue();
+            emitEvent(v4, watcher->d(), QStringLiteral("change"), callData->args, 2);
+        }
+    }
+
+private:
+    QV4::ExecutionEngine * const m_v4;
+    QV4::PersistentValue m_watcher;
+};
+
+/*
+  Reports stat changes of an fs.watchFile() path. Instead of calling stat() every interval, the
+  parent directory is watched through inotify, so that the file is only looked at when an event
+  names it. This also covers the file being created, deleted or replaced by a rename. Stat polling
+  is only used when the directory cannot be watched.
+ */
+class StatWatchListener : public QObject, public FileWatcher::Listener
+{
+public:
+    StatWatchListener(QV4::ExecutionEngine *v4, Heap::StatWatcher *watcher) :
+        m_v4(v4),
+        m_watcher(v4, watcher->asReturnedValue())
+    {
+        const QFileInfo fi(watcher->path);
+        m_directory = fi.absolutePath();
+        m_name = fi.fileName();
+        m_encodedPath = QFile::encodeName(watcher->path);
+        m_interval = watcher->interval;
+        statPath(&m_previous);
+    }
+
+    void start()
+    {
+        FileWatcher *fileWatcher = EnginePrivate::get(m_v4)->fileWatcher();
+        if (fileWatcher && !fileWatcher->watch(m_directory, this))
+            m_watching = true;
+        else
+            m_timerId = startTimer(m_interval);
+    }
+
+    void stop()
+    {
+        if (m_watching) {
+            if (FileWatcher *fileWatcher = EnginePrivate::get(m_v4)->fileWatcher())
+                fileWatcher->unwatch(m_directory, this);
+            m_watching = false;
+        }
+        if (m_timerId) {
+            killTimer(m_timerId);
+            m_timerId = 0;
+        }
+    }
+
+    void fileChanged(const QString &path, const QString &name, int events) override
+    {
+        Q_UNUSED(path)
+
+        if (events & FileWatcher::Removed) {
+            // The directory is gone, wait for it to come back
+            m_watching = false;
+            m_timerId = startTimer(m_interval);
+        } else if (name != m_name) {
+            return;
+        }
+        check();
+    }
+
+protected:
+    void timerEvent(QTimerEvent *event) override
+    {
+        if (event->timerId() != m_timerId)
+            return;
+        check();
+    }
+
+private:
+    void statPath(struct stat *st) const
+    {
+        if (::stat(m_encodedPath.constData(), st) == -1)
+            memset(st, 0, sizeof(struct stat));
+    }
+
+    // Same fields as uv_fs_poll compares, access time is ignored
+    static bool isEqual(const struct stat &a, const struct stat &b)
+    {
+        return a.st_ctim.tv_sec == b.st_ctim.tv_sec && a.st_ctim.tv_nsec == b.st_ctim.tv_nsec
+                && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec
+                && a.st_size == b.st_size && a.st_mode == b.st_mode && a.st_uid == b.st_uid
+                && a.st_gid == b.st_gid && a.st_ino == b.st_ino && a.st_dev == b.st_dev;
+    }
+
+    void check()
+    {
+        struct stat current;
+        statPath(&current);
+        if (isEqual(current, m_previous))
+            return;
+
+        const struct stat previous = m_previous;
+        m_previous = current;
+
+        QV4::ExecutionEngine *v4 = m_v4;
+        QV4::Scope scope(v4);
+        QV4::Scoped<StatWatcher> watcher(scope, m_watcher.value());
+        QV4::ScopedCallData callData(scope, 2);
+        callData->args[0] = StatsPrototype::create(v4, current);
+        callData->args[1] = StatsPrototype::create(v4, previous);
+        // The watcher may be stopped by a listener, nothing may be accessed after this
+        emitEvent(v4, watcher->d(), QStringLiteral("change"), callData->args, 2);
+    }
+
+    QV4::ExecutionEngine * const m_v4;
+    QV4::PersistentValue m_watcher;
+
+    QString m_directory;
+    QString m_name;
+    QByteArray m_encodedPath;
+    int m_interval;
+    struct stat m_previous;
+
+    bool m_watching = false;
+    int m_timerId = 0;
+};
+
+} // namespace NodeQml
+
+namespace {
+QV4::ReturnedValue option(QV4::ExecutionEngine *v4, const QV4::Value &options, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    if (!o)
+        return QV4::Encode::undefined();
+    QV4::ScopedString s(scope, v4->newString(name));
+    return o->get(s);
+}
+
+void addListener(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+                 const QV4::Value &listener)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, emitter);
+    QV4::ScopedCallData callData(scope, 2);
+    callData->args[0] = v4->newString(event)->asReturnedValue();
+    callData->args[1] = listener;
+    callMethod(v4, o, QStringLiteral("on"), callData->args, 2);
+}
+}
+
+Heap::FSWatcher::FSWatcher(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject proto(scope, EnginePrivate::get(v4)->fsWatcherPrototype);
+    self->setPrototype(proto);
+}
+
+Heap::StatWatcher::StatWatcher(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject proto(scope, EnginePrivate::get(v4)->statWatcherPrototype);
+    self->setPrototype(proto);
+}
+
+void FSWatcher::destroy(QV4::Heap::Base *that)
+{
+    Heap::FSWatcher *watcher = static_cast<Heap::FSWatcher *>(that);
+    // The listener keeps an open watcher alive, so this only happens on engine teardown
+    delete watcher->listener;
+    watcher->~FSWatcher();
+}
+
+/*!
+  \internal
+  Implements fs.watch(). Directories report the names of changed entries, files report their own
+  name. As in Node on Linux, the \c recursive option is not supported.
+*/
+QV4::ReturnedValue FSWatcher::create(QV4::ExecutionEngine *v4, const QString &path,
+                                     const QV4::Value &options, const QV4::Value &listener)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (!initEmitterPrototype(v4, engine->fsWatcherPrototype))
+        return QV4::Encode::undefined();
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<FSWatcher> watcher(scope, v4->memoryManager->alloc<FSWatcher>(v4));
+    Heap::FSWatcher *d = watcher->d();
+    d->path = path;
+
+    QV4::ScopedValue v(scope);
+    if (options.isString()) {
+        v = options;
+    } else if (options.isObject()) {
+        v = option(v4, options, QStringLiteral("persistent"));
+        if (!v->isUndefined())
+            d->persistent = v->toBoolean();
+        v = option(v4, options, QStringLiteral("encoding"));
+    }
+    if (v->isString()) {
+        const QString encoding = v->toQStringNoThrow();
+        d->encoding = encoding == QStringLiteral("buffer") ? BufferEncoding::Raw
+                                                          : Buffer::parseEncoding(encoding);
+        if (d->encoding == BufferEncoding::Invalid)
+            return v4->throwTypeError(QString("Unknown encoding: %1").arg(encoding));
+    }
+
+    FileWatcher *fileWatcher = engine->fileWatcher();
+    d->listener = new FsWatchListener(v4, d);
+    const int error = fileWatcher ? fileWatcher->watch(path, d->listener) : ENOSYS;
+    if (error) {
+        delete d->listener;
+        d->listener = nullptr;
+        return engine->throwErrnoException(error, QStringLiteral("watch"), path);
+    }
+
+    engine->openHandle();
+    if (d->persistent)
+        engine->refHandle();
+
+    if (listener.asFunctionObject())
+        addListener(v4, d, QStringLiteral("change"), listener);
+
+    return watcher.asReturnedValue();
+}
+
+void FSWatcher::close(QV4::ExecutionEngine *v4, Heap::FSWatcher *watcher)
+{
+    if (!watcher->listener)
+        return;
+
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (FileWatcher *fileWatcher = engine->fileWatcher())
+        fileWatcher->unwatch(watcher->path, watcher->listener);
+    delete watcher->listener;
+    watcher->listener = nullptr;
+
+    engine->closeHandle();
+    if (watcher->persistent)
+        engine->unrefHandle();
+}
+
+void StatWatcher::destroy(QV4::Heap::Base *that)
+{
+    Heap::StatWatcher *watcher = static_cast<Heap::StatWatcher *>(that);
+    // Active watchers are referenced by the engine, so this only happens on engine teardown
+    delete watcher->listener;
+    watcher->~StatWatcher();
+}
+
+/*!
+  \internal
+  Implements fs.watchFile(). All calls for the same file share one watcher, \a listener is added
+  to its 'change' listeners.
+*/
+QV4::ReturnedValue StatWatcher::watch(QV4::ExecutionEngine *v4, const QString &path,
+                                      const QV4::Value &options, const QV4::Value &listener)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    if (!initEmitterPrototype(v4, engine->statWatcherPrototype))
+        return QV4::Encode::undefined();
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<StatWatcher> watcher(scope);
+
+    const QString absolutePath = QFileInfo(path).absoluteFilePath();
+    if (engine->statWatchers.contains(absolutePath)) {
+        watcher = engine->statWatchers.value(absolutePath).value();
+    } else {
+        watcher = v4->memoryManager->alloc<StatWatcher>(v4);
+        Heap::StatWatcher *d = watcher->d();
+        d->path = path;
+
+        QV4::ScopedValue v(scope, option(v4, options, QStringLiteral("persistent")));
+        if (!v->isUndefined())
+            d->persistent = v->toBoolean();
+        v = option(v4, options, QStringLiteral("interval"));
+        if (v->isNumber() && v->toInt32() > 0)
+            d->interval = v->toInt32();
+
+        d->listener = new StatWatchListener(v4, d);
+        d->listener->start();
+        engine->statWatchers[absolutePath].set(v4, watcher);
+
+        engine->openHandle();
+        if (d->persistent)
+            engine->refHandle();
+    }
+
+    addListener(v4, watcher->d(), QStringLiteral("change"), listener);
+    return watcher.asReturnedValue();
+}
+
+/*!
+  \internal
+  Implements fs.unwatchFile(). Removes \a listener, or all listeners if it is not a function,
+  and stops the watcher once it has no 'change' listeners left.
+*/
+void StatWatcher::unwatch(QV4::ExecutionEngine *v4, const QString &path, const QV4::Value &listener)
+{
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    const QString absolutePath = QFileInfo(path).absoluteFilePath();
+    if (!engine->statWatchers.contains(absolutePath))
+        return;
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<StatWatcher> watcher(scope, engine->statWatchers.value(absolutePath).value());
+    QV4::ScopedCallData callData(scope, 2);
+    callData->args[0] = v4->newString(QStringLiteral("change"))->asReturnedValue();
+    callData->args[1] = listener;
+    if (listener.asFunctionObject())
+        callMethod(v4, watcher, QStringLiteral("removeListener"), callData->args, 2);
+    else
+        callMethod(v4, watcher, QStringLiteral("removeAllListeners"), callData->args, 1);
+    if (v4->hasException)
+        return;
+
+    QV4::ScopedArrayObject listeners(scope, callMethod(v4, watcher, QStringLiteral("listeners"),
+                                                       callData->args, 1));
+    if (!listeners || !listeners->getLength())
+        stop(v4, watcher->d());
+}
+
+void StatWatcher::stop(QV4::ExecutionEngine *v4, Heap::StatWatcher *watcher)
+{
+    if (!watcher->listener)
+        return;
+
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    engine->statWatchers.remove(QFileInfo(watcher->path).absoluteFilePath());
+
+    // Stopping may happen from a 'change' listener, while the listener object is still in use
+    watcher->listener->stop();
+    watcher->listener->deleteLater();
+    watcher->listener = nullptr;
+
+    engine->closeHandle();
+    if (watcher->persistent)
+        engine->unrefHandle();
+}
+
+void FSWatcherPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("close"), method_close);
+    defineDefaultProperty(QStringLiteral("ref"), method_ref);
+    defineDefaultProperty(QStringLiteral("unref"), method_unref);
+}
+
+QV4::ReturnedValue FSWatcherPrototype::method_close(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(FSWatcher, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    FSWatcher::close(v4, self->d());
+    emitEvent(v4, self->d(), QStringLiteral("close"));
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue FSWatcherPrototype::method_ref(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(FSWatcher, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->listener && !self->d()->persistent)
+        EnginePrivate::get(v4)->refHandle();
+    self->d()->persistent = true;
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue FSWatcherPrototype::method_unref(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(FSWatcher, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->listener && self->d()->persistent)
+        EnginePrivate::get(v4)->unrefHandle();
+    self->d()->persistent = false;
+    return self.asReturnedValue();
+}
+
+void StatWatcherPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("stop"), method_stop);
+    defineDefaultProperty(QStringLiteral("ref"), method_ref);
+    defineDefaultProperty(QStringLiteral("unref"), method_unref);
+}
+
+QV4::ReturnedValue StatWatcherPrototype::method_stop(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(StatWatcher, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    StatWatcher::stop(v4, self->d());
+    emitEvent(v4, self->d(), QStringLiteral("stop"));
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue StatWatcherPrototype::method_ref(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(StatWatcher, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->listener && !self->d()->persistent)
+        EnginePrivate::get(v4)->refHandle();
+    self->d()->persistent = true;
+    return self.asReturnedValue();
+}
+
+QV4::ReturnedValue StatWatcherPrototype::method_unref(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(StatWatcher, ctx);
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->listener && self->d()->persistent)
+        EnginePrivate::get(v4)->unrefHandle();
+    self->d()->persistent = false;
+    return self.asReturnedValue();
+}
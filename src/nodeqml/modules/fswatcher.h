@@ -0,0 +1,83 @@
+#ifndef FSWATCHER_H
+#define FSWATCHER_H
+
+#include "../v4integration.h"
+#include "../types/buffer.h"
+
+#include <private/qv4object_p.h>
+
+#include <sys/stat.h>
+
+namespace NodeQml {
+
+class FsWatchListener;
+class StatWatchListener;
+
+namespace Heap {
+
+struct FSWatcher : QV4::Heap::Object {
+    FSWatcher(QV4::ExecutionEngine *v4);
+
+    QString path;
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    bool persistent = true;
+    // Owned, null once the watcher is closed
+    FsWatchListener *listener = nullptr;
+};
+
+struct StatWatcher : QV4::Heap::Object {
+    StatWatcher(QV4::ExecutionEngine *v4);
+
+    QString path;
+    int interval = 5007;
+    bool persistent = true;
+    // Owned, null once the watcher is stopped
+    StatWatchListener *listener = nullptr;
+};
+
+} // namespace Heap
+
+struct FSWatcher : QV4::Object
+{
+    NODE_V4_OBJECT(FSWatcher, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+
+    static QV4::ReturnedValue create(QV4::ExecutionEngine *v4, const QString &path,
+                                     const QV4::Value &options, const QV4::Value &listener);
+    static void close(QV4::ExecutionEngine *v4, Heap::FSWatcher *watcher);
+};
+
+struct StatWatcher : QV4::Object
+{
+    NODE_V4_OBJECT(StatWatcher, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+
+    static QV4::ReturnedValue watch(QV4::ExecutionEngine *v4, const QString &path,
+                                    const QV4::Value &options, const QV4::Value &listener);
+    static void unwatch(QV4::ExecutionEngine *v4, const QString &path, const QV4::Value &listener);
+    static void stop(QV4::ExecutionEngine *v4, Heap::StatWatcher *watcher);
+};
+
+struct FSWatcherPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_close(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_ref(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unref(QV4::CallContext *ctx);
+};
+
+struct StatWatcherPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_stop(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_ref(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unref(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // FSWATCHER_H
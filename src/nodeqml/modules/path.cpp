@@ -1,12 +1,145 @@
 #include "path.h"
 
 #include <QDir>
-#include <QFileInfo>
 
 #include <private/qv4context_p.h>
 
 using namespace NodeQml;
 
+namespace {
+const ushort Slash = '/';
+const ushort Dot = '.';
+
+/*!
+  \internal
+  Collapses slashes and resolves . and .. segments of \a path in a single pass. The result has
+  neither a leading nor a trailing slash, .. segments that would go above the start are kept if
+  \a allowAboveRoot is set and dropped otherwise.
+*/
+QString normalizeString(const QString &path, bool allowAboveRoot)
+{
+    const ushort *data = path.utf16();
+    const int size = path.size();
+
+    QString res;
+    res.reserve(size);
+    int lastSegmentLength = 0;
+    int lastSlash = -1;
+    // Number of dots of the current segment, -1 once it has any other character
+    int dots = 0;
+    ushort code = 0;
+    for (int i = 0; i <= size; ++i) {
+        if (i < size)
+            code = data[i];
+        else if (code == Slash)
+            break;
+        else
+            code = Slash;
+
+        if (code == Slash) {
+            if (lastSlash == i - 1 || dots == 1) {
+                // Empty or . segment
+            } else if (dots == 2) {
+                if (lastSegmentLength != 2 || !res.endsWith(QLatin1String(".."))) {
+                    // Drop the previous segment
+                    if (res.size() > 2) {
+                        const int lastSlashIndex = res.lastIndexOf(QLatin1Char('/'));
+                        if (lastSlashIndex == -1) {
+                            res.clear();
+                            lastSegmentLength = 0;
+                        } else {
+                            res.truncate(lastSlashIndex);
+                            lastSegmentLength = res.size() - 1 - res.lastIndexOf(QLatin1Char('/'));
+                        }
+                        lastSlash = i;
+                        dots = 0;
+                        continue;
+                    } else if (!res.isEmpty()) {
+                        res.clear();
+                        lastSegmentLength = 0;
+                        lastSlash = i;
+                        dots = 0;
+                        continue;
+                    }
+                }
+                if (allowAboveRoot) {
+                    res += res.isEmpty() ? QLatin1String("..") : QLatin1String("/..");
+                    lastSegmentLength = 2;
+                }
+            } else {
+                if (!res.isEmpty())
+                    res += QLatin1Char('/');
+                res.append(path.constData() + lastSlash + 1, i - lastSlash - 1);
+                lastSegmentLength = i - lastSlash - 1;
+            }
+            lastSlash = i;
+            dots = 0;
+        } else if (code == Dot && dots != -1) {
+            ++dots;
+        } else {
+            dots = -1;
+        }
+    }
+    return res;
+}
+
+// The last segment of a path, ignoring trailing slashes
+struct BaseName {
+    int start;
+    // -1 if the path has no segment
+    int end;
+    // Start of the extension, -1 if there is none
+    int dot;
+};
+
+// Scans \a path backwards down to \a stop for its last segment and extension
+BaseName scanBaseName(const QString &path, int stop)
+{
+    const ushort *data = path.utf16();
+    BaseName base = { 0, -1, -1 };
+    int startDot = -1;
+    bool matchedSlash = true;
+    // Characters before the last dot: 0 none, 1 only dots, -1 anything else
+    int preDotState = 0;
+    for (int i = path.size() - 1; i >= stop; --i) {
+        const ushort code = data[i];
+        if (code == Slash) {
+            if (!matchedSlash) {
+                base.start = i + 1;
+                break;
+            }
+            continue;
+        }
+        if (base.end == -1) {
+            matchedSlash = false;
+            base.end = i + 1;
+        }
+        if (code == Dot) {
+            if (startDot == -1)
+                startDot = i;
+            else if (preDotState != 1)
+                preDotState = 1;
+        } else if (startDot != -1) {
+            preDotState = -1;
+        }
+    }
+
+    // Names starting with their only dot, like .profile, and .. have no extension
+    if (startDot != -1 && base.end != -1 && preDotState != 0
+            && !(preDotState == 1 && startDot == base.end - 1 && startDot == base.start + 1))
+        base.dot = startDot;
+    return base;
+}
+
+QString stringProperty(QV4::ExecutionEngine *v4, QV4::Object *o, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newString(name));
+    QV4::ScopedValue v(scope, o->get(s));
+    return v->toBoolean() ? v->toQString() : QString();
+}
+}
+
 Heap::PathModule::PathModule(QV4::ExecutionEngine *v4) :
     QV4::Heap::Object(v4)
 {
@@ -21,8 +154,9 @@ Heap::PathModule::PathModule(QV4::ExecutionEngine *v4) :
     self->defineReadonlyProperty(QStringLiteral("delimiter"),
                               (s = v4->newString(QStringLiteral(":"))));
 #endif
-    self->defineReadonlyProperty(QStringLiteral("sep"), (s = v4->newString(QDir::separator())));
-
+    // The methods implement POSIX paths on all platforms
+    self->defineReadonlyProperty(QStringLiteral("sep"), (s = v4->newString(QStringLiteral("/"))));
+    self->defineReadonlyProperty(QStringLiteral("posix"), self);
 
     self->defineDefaultProperty(QStringLiteral("normalize"), NodeQml::PathModule::method_normalize);
     self->defineDefaultProperty(QStringLiteral("join"), NodeQml::PathModule::method_join);
@@ -31,6 +165,9 @@ Heap::PathModule::PathModule(QV4::ExecutionEngine *v4) :
     self->defineDefaultProperty(QStringLiteral("dirname"), NodeQml::PathModule::method_dirname);
     self->defineDefaultProperty(QStringLiteral("basename"), NodeQml::PathModule::method_basename);
     self->defineDefaultProperty(QStringLiteral("extname"), NodeQml::PathModule::method_extname);
+    self->defineDefaultProperty(QStringLiteral("parse"), NodeQml::PathModule::method_parse);
+    self->defineDefaultProperty(QStringLiteral("format"), NodeQml::PathModule::method_format);
+    self->defineDefaultProperty(QStringLiteral("isAbsolute"), NodeQml::PathModule::method_isAbsolute);
 }
 
 QV4::ReturnedValue PathModule::method_normalize(QV4::CallContext *ctx)
@@ -38,9 +175,9 @@ QV4::ReturnedValue PathModule::method_normalize(QV4::CallContext *ctx)
     NODE_CTX_CALLDATA(ctx);
     NODE_CTX_V4(ctx);
     if (!callData->argc || !callData->args[0].isString())
-        v4->throwTypeError(QStringLiteral("path.normalize: argument must be a string"));
+        return v4->throwTypeError(QStringLiteral("path.normalize: argument must be a string"));
 
-    return v4->newString(QDir::cleanPath(callData->args[0].toQString()))->asReturnedValue();
+    return v4->newString(normalize(callData->args[0].toQString()))->asReturnedValue();
 }
 
 QV4::ReturnedValue PathModule::method_join(QV4::CallContext *ctx)
@@ -54,7 +191,7 @@ QV4::ReturnedValue PathModule::method_join(QV4::CallContext *ctx)
 
         parts.append(callData->args[i].toQString());
     }
-    return v4->newString(QDir::cleanPath(parts.join(QLatin1Char('/'))))->asReturnedValue();
+    return v4->newString(join(parts))->asReturnedValue();
 }
 
 QV4::ReturnedValue PathModule::method_resolve(QV4::CallContext *ctx)
@@ -63,19 +200,13 @@ QV4::ReturnedValue PathModule::method_resolve(QV4::CallContext *ctx)
     NODE_CTX_V4(ctx);
 
     QStringList parts;
-    for (int i = callData->argc - 1; i >= -1; --i) {
-        if (i >= 0) {
-            if (!callData->args[i].isString())
-                return v4->throwTypeError(QStringLiteral("Arguments to path.resolve must be strings"));
-            parts.prepend(callData->args[i].toQString());
-        } else {
-            parts.prepend(QDir::currentPath());
-        }
-        if (parts.first().startsWith(QLatin1Char('/')))
-            break;
+    for (int i = 0; i < callData->argc; ++i) {
+        if (!callData->args[i].isString())
+            return v4->throwTypeError(QStringLiteral("Arguments to path.resolve must be strings"));
+        parts.append(callData->args[i].toQString());
     }
 
-    return v4->newString(QDir::cleanPath(parts.join(QLatin1Char('/'))))->asReturnedValue();
+    return v4->newString(resolve(parts))->asReturnedValue();
 }
 
 // path.relative(from, to)
@@ -85,10 +216,10 @@ QV4::ReturnedValue PathModule::method_relative(QV4::CallContext *ctx)
     NODE_CTX_V4(ctx);
 
     if (callData->argc < 2 || !callData->args[0].isString() || !callData->args[1].isString())
-        return v4->throwTypeError(QStringLiteral("Arguments to path.resolve must be strings"));
+        return v4->throwTypeError(QStringLiteral("Arguments to path.relative must be strings"));
 
-    const QDir from(callData->args[0].toQString());
-    return v4->newString(from.relativeFilePath(callData->args[1].toQString()))->asReturnedValue();
+    return v4->newString(relative(callData->args[0].toQString(),
+                                  callData->args[1].toQString()))->asReturnedValue();
 }
 
 QV4::ReturnedValue PathModule::method_dirname(QV4::CallContext *ctx)
@@ -98,10 +229,10 @@ QV4::ReturnedValue PathModule::method_dirname(QV4::CallContext *ctx)
     if (!callData->argc || !callData->args[0].isString())
         return v4->throwTypeError(QStringLiteral("path.dirname: argument must be a string"));
 
-    return v4->newString(
-                QFileInfo(callData->args[0].toQString()).absolutePath())->asReturnedValue();
+    return v4->newString(dirname(callData->args[0].toQString()))->asReturnedValue();
 }
 
+// path.basename(path, [ext])
 QV4::ReturnedValue PathModule::method_basename(QV4::CallContext *ctx)
 {
     NODE_CTX_CALLDATA(ctx);
@@ -109,16 +240,14 @@ QV4::ReturnedValue PathModule::method_basename(QV4::CallContext *ctx)
     if (!callData->argc || !callData->args[0].isString())
         return v4->throwTypeError(QStringLiteral("path.basename: argument must be a string"));
 
-    const QString path = callData->args[0].toQString();
-    const QString fileName = QFileInfo(path).fileName();
-    const QString ext = callData->argc > 1 ? callData->args[1].toQStringNoThrow() : QString();
-    QString basename;
-    if (!ext.isEmpty() && path.endsWith(ext))
-        basename = fileName.left(fileName.size() - ext.size());
-    else
-        basename = fileName;
+    QString ext;
+    if (callData->argc > 1 && !callData->args[1].isUndefined()) {
+        if (!callData->args[1].isString())
+            return v4->throwTypeError(QStringLiteral("path.basename: ext must be a string"));
+        ext = callData->args[1].toQString();
+    }
 
-    return v4->newString(basename)->asReturnedValue();
+    return v4->newString(basename(callData->args[0].toQString(), ext))->asReturnedValue();
 }
 
 QV4::ReturnedValue PathModule::method_extname(QV4::CallContext *ctx)
@@ -128,6 +257,303 @@ QV4::ReturnedValue PathModule::method_extname(QV4::CallContext *ctx)
     if (!callData->argc || !callData->args[0].isString())
         return v4->throwTypeError(QStringLiteral("path.extname: argument must be a string"));
 
-    return v4->newString(
-                QFileInfo(callData->args[0].toQStringNoThrow()).completeSuffix())->asReturnedValue();
+    return v4->newString(extname(callData->args[0].toQString()))->asReturnedValue();
+}
+
+// Returns { root, dir, base, ext, name }
+QV4::ReturnedValue PathModule::method_parse(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path.parse: argument must be a string"));
+
+    const QString path = callData->args[0].toQString();
+    QString root;
+    QString dir;
+    QString base;
+    QString ext;
+    QString name;
+    if (!path.isEmpty()) {
+        const bool absolute = path.at(0) == QLatin1Char('/');
+        if (absolute)
+            root = QStringLiteral("/");
+
+        const BaseName baseName = scanBaseName(path, absolute ? 1 : 0);
+        if (baseName.end != -1) {
+            const int start = baseName.start == 0 && absolute ? 1 : baseName.start;
+            base = path.mid(start, baseName.end - start);
+            if (baseName.dot == -1) {
+                name = base;
+            } else {
+                name = path.mid(start, baseName.dot - start);
+                ext = path.mid(baseName.dot, baseName.end - baseName.dot);
+            }
+        }
+
+        if (baseName.start > 0)
+            dir = path.left(baseName.start - 1);
+        else if (absolute)
+            dir = root;
+    }
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject result(scope, v4->newObject());
+    QV4::ScopedString s(scope);
+    QV4::ScopedValue v(scope);
+    // insertMember() to make them enumerable
+    result->insertMember((s = v4->newString(QStringLiteral("root"))).getPointer(), (v = v4->newString(root)));
+    result->insertMember((s = v4->newString(QStringLiteral("dir"))).getPointer(), (v = v4->newString(dir)));
+    result->insertMember((s = v4->newString(QStringLiteral("base"))).getPointer(), (v = v4->newString(base)));
+    result->insertMember((s = v4->newString(QStringLiteral("ext"))).getPointer(), (v = v4->newString(ext)));
+    result->insertMember((s = v4->newString(QStringLiteral("name"))).getPointer(), (v = v4->newString(name)));
+    return result.asReturnedValue();
+}
+
+// path.format({ root, dir, base, ext, name })
+QV4::ReturnedValue PathModule::method_format(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject pathObject(scope, callData->argument(0));
+    if (!pathObject)
+        return v4->throwTypeError(QStringLiteral("path.format: argument must be an object"));
+
+    const QString root = stringProperty(v4, pathObject, QStringLiteral("root"));
+    const QString dir = stringProperty(v4, pathObject, QStringLiteral("dir"));
+    const QString base = stringProperty(v4, pathObject, QStringLiteral("base"));
+    const QString name = stringProperty(v4, pathObject, QStringLiteral("name"));
+    const QString ext = stringProperty(v4, pathObject, QStringLiteral("ext"));
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
+    const QString directory = dir.isEmpty() ? root : dir;
+    const QString fileName = base.isEmpty() ? name + ext : base;
+    QString result;
+    if (directory.isEmpty())
+        result = fileName;
+    else if (directory == root)
+        result = directory + fileName;
+    else
+        result = directory + QLatin1Char('/') + fileName;
+
+    return v4->newString(result)->asReturnedValue();
+}
+
+QV4::ReturnedValue PathModule::method_isAbsolute(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("path.isAbsolute: argument must be a string"));
+
+    return QV4::Encode(callData->args[0].toQString().startsWith(QLatin1Char('/')));
+}
+
+/*!
+  \internal
+  Returns \a path with . and .. segments resolved and repeated slashes collapsed. A trailing slash
+  is kept, and an empty path normalizes to ".".
+*/
+QString PathModule::normalize(const QString &path)
+{
+    if (path.isEmpty())
+        return QStringLiteral(".");
+
+    const bool absolute = path.at(0) == QLatin1Char('/');
+    const bool trailingSlash = path.endsWith(QLatin1Char('/'));
+
+    QString result = normalizeString(path, !absolute);
+    if (result.isEmpty()) {
+        if (absolute)
+            return QStringLiteral("/");
+        return trailingSlash ? QStringLiteral("./") : QStringLiteral(".");
+    }
+    if (trailingSlash)
+        result += QLatin1Char('/');
+    if (absolute)
+        result.prepend(QLatin1Char('/'));
+    return result;
+}
+
+// Joins the non-empty \a paths and normalizes the result
+QString PathModule::join(const QStringList &paths)
+{
+    QString joined;
+    foreach (const QString &path, paths) {
+        if (path.isEmpty())
+            continue;
+        if (!joined.isEmpty())
+            joined += QLatin1Char('/');
+        joined += path;
+    }
+    return joined.isEmpty() ? QStringLiteral(".") : normalize(joined);
+}
+
+/*!
+  \internal
+  Resolves \a paths from right to left until an absolute path is formed, starting from the
+  current working directory. The result has no trailing slash unless it is the root.
+*/
+QString PathModule::resolve(const QStringList &paths)
+{
+    QString resolved;
+    bool absolute = false;
+    for (int i = paths.size() - 1; i >= -1 && !absolute; --i) {
+        const QString path = i >= 0 ? paths.at(i) : QDir::currentPath();
+        if (path.isEmpty())
+            continue;
+
+        resolved = path + QLatin1Char('/') + resolved;
+        absolute = path.at(0) == QLatin1Char('/');
+    }
+
+    resolved = normalizeString(resolved, !absolute);
+    if (absolute)
+        return resolved.prepend(QLatin1Char('/'));
+    return resolved.isEmpty() ? QStringLiteral(".") : resolved;
+}
+
+// Returns the path from \a from to \a to, both resolved first
+QString PathModule::relative(const QString &from, const QString &to)
+{
+    if (from == to)
+        return QString();
+
+    const QString fromPath = resolve(QStringList(from));
+    const QString toPath = resolve(QStringList(to));
+    if (fromPath == toPath)
+        return QString();
+
+    // Compare behind the leading slash of both
+    const ushort *fromData = fromPath.utf16() + 1;
+    const ushort *toData = toPath.utf16() + 1;
+    const int fromLength = fromPath.size() - 1;
+    const int toLength = toPath.size() - 1;
+    const int length = qMin(fromLength, toLength);
+
+    int lastCommonSlash = -1;
+    int i = 0;
+    for (; i < length; ++i) {
+        if (fromData[i] != toData[i])
+            break;
+        if (fromData[i] == Slash)
+            lastCommonSlash = i;
+    }
+
+    if (i == length) {
+        if (toLength > length) {
+            // from is a parent of to, or the root
+            if (toData[i] == Slash)
+                return toPath.mid(1 + i + 1);
+            if (i == 0)
+                return toPath.mid(1 + i);
+        } else if (fromLength > length) {
+            // to is a parent of from, or the root
+            if (fromData[i] == Slash)
+                lastCommonSlash = i;
+            else if (i == 0)
+                lastCommonSlash = 0;
+        }
+    }
+
+    QString result;
+    for (i = lastCommonSlash + 1; i <= fromLength; ++i) {
+        if (i == fromLength || fromData[i] == Slash)
+            result += result.isEmpty() ? QLatin1String("..") : QLatin1String("/..");
+    }
+    result += toPath.midRef(1 + lastCommonSlash);
+    return result;
+}
+
+// Returns \a path without its last segment, "." if it has a single relative segment
+QString PathModule::dirname(const QString &path)
+{
+    if (path.isEmpty())
+        return QStringLiteral(".");
+
+    const ushort *data = path.utf16();
+    const bool hasRoot = data[0] == Slash;
+    int end = -1;
+    bool matchedSlash = true;
+    for (int i = path.size() - 1; i >= 1; --i) {
+        if (data[i] == Slash) {
+            if (!matchedSlash) {
+                end = i;
+                break;
+            }
+        } else {
+            matchedSlash = false;
+        }
+    }
+
+    if (end == -1)
+        return hasRoot ? QStringLiteral("/") : QStringLiteral(".");
+    if (hasRoot && end == 1)
+        return QStringLiteral("//");
+    return path.left(end);
+}
+
+// Returns the last segment of \a path, without \a ext if it ends with it
+QString PathModule::basename(const QString &path, const QString &ext)
+{
+    if (ext.isEmpty() || ext.size() > path.size()) {
+        const BaseName base = scanBaseName(path, 0);
+        if (base.end == -1)
+            return QString();
+        return path.mid(base.start, base.end - base.start);
+    }
+
+    if (ext == path)
+        return QString();
+
+    // Match the extension backwards while looking for the segment, like Node does
+    const ushort *data = path.utf16();
+    const ushort *extData = ext.utf16();
+    int start = 0;
+    int end = -1;
+    int extIndex = ext.size() - 1;
+    int firstNonSlashEnd = -1;
+    bool matchedSlash = true;
+    for (int i = path.size() - 1; i >= 0; --i) {
+        const ushort code = data[i];
+        if (code == Slash) {
+            if (!matchedSlash) {
+                start = i + 1;
+                break;
+            }
+            continue;
+        }
+        if (firstNonSlashEnd == -1) {
+            matchedSlash = false;
+            firstNonSlashEnd = i + 1;
+        }
+        if (extIndex >= 0) {
+            if (code == extData[extIndex]) {
+                if (--extIndex == -1)
+                    end = i;
+            } else {
+                extIndex = -1;
+                end = firstNonSlashEnd;
+            }
+        }
+    }
+
+    // The whole segment is the extension
+    if (start == end)
+        end = firstNonSlashEnd;
+    else if (end == -1)
+        end = path.size();
+    return path.mid(start, end - start);
+}
+
+// Returns the extension of the last segment of \a path, from its last dot
+QString PathModule::extname(const QString &path)
+{
+    const BaseName base = scanBaseName(path, 0);
+    if (base.dot == -1)
+        return QString();
+    return path.mid(base.dot, base.end - base.dot);
 }
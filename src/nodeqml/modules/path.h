@@ -3,6 +3,8 @@
 
 #include "../v4integration.h"
 
+#include <QStringList>
+
 #include <private/qv4object_p.h>
 
 namespace NodeQml {
@@ -26,7 +28,17 @@ struct PathModule : QV4::Object
     static QV4::ReturnedValue method_dirname(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_basename(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_extname(QV4::CallContext *ctx);
-
+    static QV4::ReturnedValue method_parse(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_format(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isAbsolute(QV4::CallContext *ctx);
+
+    static QString normalize(const QString &path);
+    static QString join(const QStringList &paths);
+    static QString resolve(const QStringList &paths);
+    static QString relative(const QString &from, const QString &to);
+    static QString dirname(const QString &path);
+    static QString basename(const QString &path, const QString &ext = QString());
+    static QString extname(const QString &path);
 };
 
 } // namespace NodeQml
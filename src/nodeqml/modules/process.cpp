@@ -1,5 +1,6 @@
 #include "process.h"
 
+#include "workerthreads.h"
 #include "../engine_p.h"
 
 #include <QCoreApplication>
@@ -7,15 +8,91 @@
 #include <QProcess>
 
 #include <private/qv4context_p.h>
+#include <private/qv4mm_p.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
 using namespace NodeQml;
 
+DEFINE_OBJECT_VTABLE(ProcessEnv);
+
+namespace {
+const qint64 NanosecondsPerSecond = 1000000000;
+
+// Origin of process.hrtime.bigint(), which keeps its values exact in a double for 104 days
+const qint64 hrtimeOrigin = ProcessModule::hrtime();
+
+// Resident set size in bytes, the peak size where the current one is not available
+double residentSetSize()
+{
+#ifdef Q_OS_LINUX
+    const int fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        char buf[128];
+        const ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+        ::close(fd);
+        long pages = 0;
+        if (n > 0) {
+            buf[n] = 0;
+            if (sscanf(buf, "%*ld %ld", &pages) == 1)
+                return double(pages) * ::sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) < 0)
+        return 0;
+#ifdef Q_OS_DARWIN
+    return usage.ru_maxrss;
+#else
+    return double(usage.ru_maxrss) * 1024;
+#endif
+}
+
+void setNumber(QV4::ExecutionEngine *v4, QV4::Object *o, const char *name, double value)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newString(QString::fromLatin1(name)));
+    QV4::ScopedValue v(scope, QV4::Primitive::fromDouble(value));
+    // insertMember() to make it enumerable
+    o->insertMember(s.getPointer(), v);
+}
+
+// Whether \a name has been read or written before, without querying the environment
+bool isCached(const QV4::Object *env, QV4::String *name)
+{
+    return env->internalClass()->find(name) != UINT_MAX;
+}
+
+// Caches the variable \a name of the environment in \a env, returns false if it is not set
+bool loadVariable(QV4::Object *env, QV4::String *name)
+{
+    // Through Qt, which locks the environment against qputenv() of other threads
+    const QByteArray key = name->toQString().toLocal8Bit();
+    if (!qEnvironmentVariableIsSet(key.constData()))
+        return false;
+
+    QV4::ExecutionEngine *v4 = env->engine();
+    QV4::Scope scope(v4);
+    QV4::ScopedValue v(scope, v4->newString(QString::fromLocal8Bit(qgetenv(key.constData()))));
+    env->insertMember(name, v);
+    return true;
+}
+}
+
 Heap::ProcessModule::ProcessModule(QV4::ExecutionEngine *v4) :
     QV4::Heap::Object(v4)
 {
     QV4::Scope scope(v4);
     QV4::ScopedObject self(scope, this);
     QV4::ScopedValue v(scope);
+    QV4::ScopedObject o(scope);
 
     self->defineReadonlyProperty(QStringLiteral("arch"),
                                  (v = v4->newString(NodeQml::ProcessModule::arch())));
@@ -28,7 +105,8 @@ Heap::ProcessModule::ProcessModule(QV4::ExecutionEngine *v4) :
     self->defineReadonlyProperty(QStringLiteral("version"),
                                  (v = v4->newString(QStringLiteral("v0.10.33"))));
 
-    self->defineAccessorProperty(QStringLiteral("env"), NodeQml::ProcessModule::property_env_getter, nullptr);
+    self->defineDefaultProperty(QStringLiteral("env"),
+                                (o = v4->memoryManager->alloc<NodeQml::ProcessEnv>(v4)));
     self->defineAccessorProperty(QStringLiteral("pid"), NodeQml::ProcessModule::property_pid_getter, nullptr);
 
     self->defineDefaultProperty(QStringLiteral("abort"), NodeQml::ProcessModule::method_abort);
@@ -36,6 +114,13 @@ Heap::ProcessModule::ProcessModule(QV4::ExecutionEngine *v4) :
     self->defineDefaultProperty(QStringLiteral("cwd"), NodeQml::ProcessModule::method_cwd);
     self->defineDefaultProperty(QStringLiteral("exit"), NodeQml::ProcessModule::method_exit);
     self->defineDefaultProperty(QStringLiteral("nextTick"), NodeQml::ProcessModule::method_nextTick);
+    self->defineDefaultProperty(QStringLiteral("memoryUsage"), NodeQml::ProcessModule::method_memoryUsage);
+    self->defineDefaultProperty(QStringLiteral("resourceUsage"), NodeQml::ProcessModule::method_resourceUsage);
+
+    self->defineDefaultProperty(QStringLiteral("hrtime"), NodeQml::ProcessModule::method_hrtime, 1);
+    QV4::ScopedString s(scope, v4->newString(QStringLiteral("hrtime")));
+    o = self->get(s);
+    o->defineDefaultProperty(QStringLiteral("bigint"), NodeQml::ProcessModule::method_hrtimeBigint);
 }
 
 QV4::ReturnedValue ProcessModule::property_pid_getter(QV4::CallContext *ctx)
@@ -45,24 +130,6 @@ QV4::ReturnedValue ProcessModule::property_pid_getter(QV4::CallContext *ctx)
     return QV4::Primitive::fromInt32(QCoreApplication::applicationPid()).asReturnedValue();
 }
 
-QV4::ReturnedValue ProcessModule::property_env_getter(QV4::CallContext *ctx)
-{
-    /// TODO: Provide write access
-    NODE_CTX_V4(ctx);
-
-    QV4::Scope scope(ctx);
-    QV4::ScopedObject env(scope, v4->newObject());
-    QV4::ScopedString strName(scope);
-    QV4::ScopedString strValue(scope);
-
-    foreach (const QString &value, QProcess::systemEnvironment()) {
-        const QStringList v = value.split(QLatin1Char('='));
-        env->insertMember((strName = v4->newString(v[0])), (strValue = v4->newString(v[1])));
-    }
-
-    return env.asReturnedValue();
-}
-
 QV4::ReturnedValue ProcessModule::method_abort(QV4::CallContext *ctx)
 {
     Q_UNUSED(ctx);
@@ -95,7 +162,13 @@ QV4::ReturnedValue ProcessModule::method_exit(QV4::CallContext *ctx)
     NODE_CTX_CALLDATA(ctx);
 
     const int code = callData->argc ? callData->args[0].toInt32() : 0;
-    QCoreApplication::exit(code);
+    EnginePrivate *engine = EnginePrivate::get(ctx->engine());
+    engine->outputSink()->waitForWritten();
+    // Only ends the worker, once it is back in its event loop
+    if (engine->workerThread)
+        engine->workerThread->requestExit(code);
+    else
+        QCoreApplication::exit(code);
 
     return QV4::Encode::undefined();
 }
@@ -105,6 +178,109 @@ QV4::ReturnedValue ProcessModule::method_nextTick(QV4::CallContext *ctx)
     return EnginePrivate::get(ctx->engine())->nextTick(ctx);
 }
 
+// process.hrtime([time])
+QV4::ReturnedValue ProcessModule::method_hrtime(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    const qint64 now = hrtime();
+    qint64 seconds = now / NanosecondsPerSecond;
+    qint64 nanoseconds = now % NanosecondsPerSecond;
+
+    QV4::Scope scope(v4);
+    if (callData->argc && !callData->args[0].isUndefined()) {
+        QV4::ScopedArrayObject previous(scope, callData->args[0]);
+        if (!previous || previous->getLength() < 2)
+            return v4->throwTypeError(QStringLiteral("process.hrtime() only accepts an Array tuple"));
+
+        QV4::ScopedValue v(scope, previous->getIndexed(0));
+        seconds -= qint64(v->toNumber());
+        v = previous->getIndexed(1);
+        nanoseconds -= qint64(v->toNumber());
+        if (v4->hasException)
+            return QV4::Encode::undefined();
+        if (nanoseconds < 0) {
+            --seconds;
+            nanoseconds += NanosecondsPerSecond;
+        }
+    }
+
+    QV4::ScopedArrayObject result(scope, v4->newArrayObject());
+    QV4::ScopedValue v(scope);
+    result->arrayReserve(2);
+    result->arrayPut(0, (v = QV4::Primitive::fromDouble(seconds)));
+    result->arrayPut(1, (v = QV4::Primitive::fromDouble(nanoseconds)));
+    result->setArrayLengthUnchecked(2);
+    return result.asReturnedValue();
+}
+
+/*!
+  \internal
+  process.hrtime.bigint() without BigInt support in the engine: nanoseconds as a number, counted
+  from the load of the library rather than from an arbitrary point, so they stay exact.
+*/
+QV4::ReturnedValue ProcessModule::method_hrtimeBigint(QV4::CallContext *ctx)
+{
+    Q_UNUSED(ctx)
+    return QV4::Primitive::fromDouble(hrtime() - hrtimeOrigin).asReturnedValue();
+}
+
+// Returns { rss, heapTotal, heapUsed, external } in bytes
+QV4::ReturnedValue ProcessModule::method_memoryUsage(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+
+    QV4::MemoryManager *mm = v4->memoryManager;
+    const double largeItems = mm->getLargeItemsMem();
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject result(scope, v4->newObject());
+    setNumber(v4, result, "rss", residentSetSize());
+    setNumber(v4, result, "heapTotal", mm->getAllocatedMem() + largeItems);
+    setNumber(v4, result, "heapUsed", mm->getUsedMem() + largeItems);
+    setNumber(v4, result, "external", EnginePrivate::get(v4)->bufferExternalSize);
+    return result.asReturnedValue();
+}
+
+// getrusage() of the process, times in microseconds and sizes in kilobytes like Node
+QV4::ReturnedValue ProcessModule::method_resourceUsage(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) < 0)
+        return EnginePrivate::get(v4)->throwErrnoException(errno, QStringLiteral("getrusage"));
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject result(scope, v4->newObject());
+    setNumber(v4, result, "userCPUTime", double(usage.ru_utime.tv_sec) * 1000000 + usage.ru_utime.tv_usec);
+    setNumber(v4, result, "systemCPUTime", double(usage.ru_stime.tv_sec) * 1000000 + usage.ru_stime.tv_usec);
+    setNumber(v4, result, "maxRSS", usage.ru_maxrss);
+    setNumber(v4, result, "sharedMemorySize", usage.ru_ixrss);
+    setNumber(v4, result, "unsharedDataSize", usage.ru_idrss);
+    setNumber(v4, result, "unsharedStackSize", usage.ru_isrss);
+    setNumber(v4, result, "minorPageFault", usage.ru_minflt);
+    setNumber(v4, result, "majorPageFault", usage.ru_majflt);
+    setNumber(v4, result, "swappedOut", usage.ru_nswap);
+    setNumber(v4, result, "fsRead", usage.ru_inblock);
+    setNumber(v4, result, "fsWrite", usage.ru_oublock);
+    setNumber(v4, result, "ipcSent", usage.ru_msgsnd);
+    setNumber(v4, result, "ipcReceived", usage.ru_msgrcv);
+    setNumber(v4, result, "signalsCount", usage.ru_nsignals);
+    setNumber(v4, result, "voluntaryContextSwitches", usage.ru_nvcsw);
+    setNumber(v4, result, "involuntaryContextSwitches", usage.ru_nivcsw);
+    return result.asReturnedValue();
+}
+
+// Nanoseconds of CLOCK_MONOTONIC
+qint64 ProcessModule::hrtime()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * NanosecondsPerSecond + ts.tv_nsec;
+}
+
 QString ProcessModule::arch()
 {
     /// NOTE: Node supports: 'arm', 'ia32', 'x64'. Extend with all Q_PROCESSOR_*?
@@ -138,3 +314,78 @@ QString ProcessModule::platform()
     return QStringLiteral("");
 #endif
 }
+
+Heap::ProcessEnv::ProcessEnv(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+}
+
+QV4::ReturnedValue ProcessEnv::get(QV4::Managed *m, QV4::String *name, bool *hasProperty)
+{
+    ProcessEnv *env = static_cast<ProcessEnv *>(m);
+    if (name->asArrayIndex() == UINT_MAX && !isCached(env, name))
+        loadVariable(env, name);
+    return QV4::Object::get(m, name, hasProperty);
+}
+
+// Assigned values are converted to strings and written to the environment
+void ProcessEnv::put(QV4::Managed *m, QV4::String *name, const QV4::Value &value)
+{
+    ProcessEnv *env = static_cast<ProcessEnv *>(m);
+    QV4::ExecutionEngine *v4 = env->engine();
+    const QString string = value.toQString();
+    if (v4->hasException)
+        return;
+
+    qputenv(name->toQString().toLocal8Bit().constData(), string.toLocal8Bit());
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue v(scope, v4->newString(string));
+    QV4::Object::put(m, name, v);
+}
+
+QV4::PropertyAttributes ProcessEnv::query(const QV4::Managed *m, QV4::String *name)
+{
+    ProcessEnv *env = const_cast<ProcessEnv *>(static_cast<const ProcessEnv *>(m));
+    if (name->asArrayIndex() == UINT_MAX && !isCached(env, name) && loadVariable(env, name))
+        return QV4::Attr_Data;
+    return QV4::Object::query(m, name);
+}
+
+bool ProcessEnv::deleteProperty(QV4::Managed *m, QV4::String *name)
+{
+    qunsetenv(name->toQString().toLocal8Bit().constData());
+    return QV4::Object::deleteProperty(m, name);
+}
+
+/*!
+  \internal
+  Loads the variables that were not accessed yet before the first enumeration. Variables set
+  later by native code are not seen by enumerations, but still by reads.
+*/
+void ProcessEnv::advanceIterator(QV4::Managed *m, QV4::ObjectIterator *it, QV4::Heap::String **name,
+                                 uint *index, QV4::Property *p, QV4::PropertyAttributes *attributes)
+{
+    ProcessEnv *env = static_cast<ProcessEnv *>(m);
+    if (!env->d()->loaded) {
+        env->d()->loaded = true;
+
+        QV4::ExecutionEngine *v4 = env->engine();
+        QV4::Scope scope(v4);
+        QV4::ScopedString variableName(scope);
+        QV4::ScopedValue variableValue(scope);
+        foreach (const QString &variable, QProcess::systemEnvironment()) {
+            // Only the first '=' separates the name, values may contain more
+            const int separator = variable.indexOf(QLatin1Char('='));
+            if (separator <= 0)
+                continue;
+            variableName = v4->newIdentifier(variable.left(separator));
+            if (isCached(env, variableName.getPointer()))
+                continue;
+            variableValue = v4->newString(variable.mid(separator + 1));
+            env->insertMember(variableName.getPointer(), variableValue);
+        }
+    }
+
+    QV4::Object::advanceIterator(m, it, name, index, p, attributes);
+}
@@ -13,6 +13,17 @@ struct ProcessModule : QV4::Heap::Object {
     ProcessModule(QV4::ExecutionEngine *v4);
 };
 
+/*!
+  \internal
+  process.env. Variables are read with getenv() the first time they are accessed and then kept
+  as own properties. The whole environment is only loaded when the object is enumerated.
+*/
+struct ProcessEnv : QV4::Heap::Object {
+    ProcessEnv(QV4::ExecutionEngine *v4);
+
+    bool loaded = false;
+};
+
 } // namespace Heap
 
 struct ProcessModule : QV4::Object
@@ -20,7 +31,6 @@ struct ProcessModule : QV4::Object
     NODE_V4_OBJECT(ProcessModule, Object)
 
     static QV4::ReturnedValue property_pid_getter(QV4::CallContext *ctx);
-    static QV4::ReturnedValue property_env_getter(QV4::CallContext *ctx);
 
     /// TODO: Event: 'exit'
     /// TODO: Event: 'uncaughtException'
@@ -44,17 +54,32 @@ struct ProcessModule : QV4::Object
     /// TODO: process.config
     /// TODO: process.kill(pid, [signal])
     /// TODO: process.title
-    /// TODO: process.memoryUsage()
+    static QV4::ReturnedValue method_memoryUsage(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_resourceUsage(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_nextTick(QV4::CallContext *ctx);
     /// TODO: process.maxTickDepth
     /// TODO: process.umask([mask])
     /// TODO: process.uptime()
-    /// TODO: process.hrtime()
+    static QV4::ReturnedValue method_hrtime(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_hrtimeBigint(QV4::CallContext *ctx);
 
+    static qint64 hrtime();
     static QString arch();
     static QString platform();
 };
 
+struct ProcessEnv : QV4::Object
+{
+    NODE_V4_OBJECT(ProcessEnv, Object)
+
+    static QV4::ReturnedValue get(QV4::Managed *m, QV4::String *name, bool *hasProperty);
+    static void put(QV4::Managed *m, QV4::String *name, const QV4::Value &value);
+    static QV4::PropertyAttributes query(const QV4::Managed *m, QV4::String *name);
+    static bool deleteProperty(QV4::Managed *m, QV4::String *name);
+    static void advanceIterator(QV4::Managed *m, QV4::ObjectIterator *it, QV4::Heap::String **name,
+                                uint *index, QV4::Property *p, QV4::PropertyAttributes *attributes);
+};
+
 } // namespace NodeQml
 
 #endif // PROCESS_H
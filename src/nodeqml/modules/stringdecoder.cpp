@@ -0,0 +1,254 @@
+#include "stringdecoder.h"
+
+#include "../engine_p.h"
+
+#include <QtEndian>
+
+#include <private/qv4context_p.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(StringDecoderModule);
+DEFINE_OBJECT_VTABLE(StringDecoder);
+DEFINE_OBJECT_VTABLE(StringDecoderCtor);
+
+namespace {
+
+inline bool isUtf8Continuation(char c)
+{
+    return (static_cast<uchar>(c) & 0xc0) == 0x80;
+}
+
+// Returns the length of a UTF-8 sequence started by lead byte, or 0 for a continuation byte
+inline int utf8SequenceLength(char c)
+{
+    const uchar lead = static_cast<uchar>(c);
+    if (lead < 0x80)
+        return 1;
+    if ((lead & 0xc0) == 0x80)
+        return 0;
+    if ((lead & 0xe0) == 0xc0)
+        return 2;
+    if ((lead & 0xf0) == 0xe0)
+        return 3;
+    if ((lead & 0xf8) == 0xf0)
+        return 4;
+    return 1; // Invalid lead byte, will be decoded as a replacement character
+}
+
+inline bool isHighSurrogate(const char *data)
+{
+    return QChar::isHighSurrogate(qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(data)));
+}
+
+/*
+  Returns the number of bytes at the end of data that do not form a complete character, and sets
+  needed to the total number of bytes required to complete it.
+ */
+int incompleteTail(BufferEncoding encoding, const char *data, int size, int *needed)
+{
+    switch (encoding) {
+    case BufferEncoding::Utf8:
+        for (int i = 1; i <= std::min(3, size); ++i) {
+            const int length = utf8SequenceLength(data[size - i]);
+            if (!length)
+                continue;
+            if (length <= i)
+                return 0;
+            *needed = length;
+            return i;
+        }
+        return 0;
+    case BufferEncoding::Ucs2:
+    case BufferEncoding::Utf16le: {
+        int tail = size & 1;
+        if (size - tail >= 2 && isHighSurrogate(data + size - tail - 2))
+            tail += 2;
+        *needed = tail >= 2 ? 4 : 2;
+        return tail;
+    }
+    case BufferEncoding::Base64:
+        *needed = 3;
+        return size % 3;
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+Heap::StringDecoderModule::StringDecoderModule(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject ctor(scope, EnginePrivate::get(v4)->stringDecoderCtor);
+
+    self->defineDefaultProperty(QStringLiteral("StringDecoder"), ctor);
+}
+
+Heap::StringDecoder::StringDecoder(QV4::ExecutionEngine *v4, BufferEncoding encoding) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->stringDecoderPrototype.asObject()),
+    encoding(encoding)
+{
+}
+
+/*!
+  \internal
+  Decodes \a size bytes at \a data. Bytes of a character split between chunks are kept in the
+  decoder until the rest of the character arrives, so no chunk concatenation is ever needed.
+ */
+QString StringDecoder::decode(Heap::StringDecoder *decoder, const char *data, int size)
+{
+    const BufferEncoding encoding = decoder->encoding;
+
+    switch (encoding) {
+    case BufferEncoding::Utf8:
+    case BufferEncoding::Ucs2:
+    case BufferEncoding::Utf16le:
+    case BufferEncoding::Base64:
+        break;
+    default:
+        // Single byte encodings do not need any state
+        return Buffer::encodeData(data, size, encoding);
+    }
+
+    QString result;
+
+    // Complete a character left over from the previous chunk
+    if (decoder->partialSize) {
+        while (decoder->partialSize < decoder->partialNeeded && size > 0) {
+            if (encoding == BufferEncoding::Utf8 && !isUtf8Continuation(*data))
+                break;
+
+            decoder->partial[decoder->partialSize++] = *data++;
+            --size;
+
+            if (encoding != BufferEncoding::Utf8 && encoding != BufferEncoding::Base64
+                    && decoder->partialSize == 2 && isHighSurrogate(decoder->partial)) {
+                decoder->partialNeeded = 4;
+            }
+        }
+
+        if (decoder->partialSize < decoder->partialNeeded && !size)
+            return result;
+
+        result = Buffer::encodeData(decoder->partial, decoder->partialSize, encoding);
+        decoder->partialSize = 0;
+    }
+
+    int needed = 0;
+    const int tail = incompleteTail(encoding, data, size, &needed);
+
+    if (size > tail) {
+        if (result.isEmpty())
+            result = Buffer::encodeData(data, size - tail, encoding);
+        else
+            result += Buffer::encodeData(data, size - tail, encoding);
+    }
+
+    if (tail) {
+        ::memcpy(decoder->partial, data + size - tail, tail);
+        decoder->partialSize = tail;
+        decoder->partialNeeded = needed;
+    }
+
+    return result;
+}
+
+/*!
+  \internal
+  Returns whatever is left in the decoder. Incomplete characters are decoded as is, which results
+  in replacement characters for UTF-8 and padding for Base64.
+ */
+QString StringDecoder::flush(Heap::StringDecoder *decoder)
+{
+    if (!decoder->partialSize)
+        return QString();
+
+    const QString result
+            = Buffer::encodeData(decoder->partial, decoder->partialSize, decoder->encoding);
+    decoder->partialSize = 0;
+    decoder->partialNeeded = 0;
+    return result;
+}
+
+Heap::StringDecoderCtor::StringDecoderCtor(QV4::ExecutionContext *scope) :
+    QV4::Heap::FunctionObject(scope, QStringLiteral("StringDecoder"))
+{
+}
+
+// new StringDecoder([encoding])
+QV4::ReturnedValue StringDecoderCtor::construct(QV4::Managed *m, QV4::CallData *callData)
+{
+    QV4::ExecutionEngine *v4 = static_cast<QV4::Object *>(m)->engine();
+
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    if (callData->argc && !callData->args[0].isUndefined()) {
+        const QString encodingStr = callData->args[0].toQStringNoThrow();
+        encoding = Buffer::parseEncoding(encodingStr);
+        if (encoding == BufferEncoding::Invalid)
+            return v4->throwError(QString("Unknown encoding: %1").arg(encodingStr));
+    }
+
+    QV4::Scope scope(v4);
+    QV4::Scoped<StringDecoder> decoder(scope, v4->memoryManager->alloc<StringDecoder>(v4, encoding));
+    return decoder.asReturnedValue();
+}
+
+QV4::ReturnedValue StringDecoderCtor::call(QV4::Managed *that, QV4::CallData *callData)
+{
+    return construct(that, callData);
+}
+
+void StringDecoderPrototype::init(QV4::ExecutionEngine *v4, QV4::Object *ctor)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope);
+
+    ctor->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(1));
+    ctor->defineReadonlyProperty(v4->id_prototype, (o = this));
+    defineDefaultProperty(QStringLiteral("constructor"), (o = ctor));
+
+    defineDefaultProperty(QStringLiteral("write"), method_write, 1);
+    defineDefaultProperty(QStringLiteral("end"), method_end, 1);
+}
+
+// write(buffer)
+QV4::ReturnedValue StringDecoderPrototype::method_write(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(StringDecoder, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::Scoped<Buffer> buffer(scope, callData->argument(0));
+    if (!buffer)
+        return v4->throwTypeError(QStringLiteral("write: argument must be a Buffer"));
+
+    const QString str = StringDecoder::decode(self->d(), buffer->d()->data.constData(),
+                                              buffer->d()->data.size());
+    return v4->newString(str)->asReturnedValue();
+}
+
+// end([buffer])
+QV4::ReturnedValue StringDecoderPrototype::method_end(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(StringDecoder, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QString str;
+
+    QV4::Scoped<Buffer> buffer(scope, callData->argument(0));
+    if (buffer)
+        str = StringDecoder::decode(self->d(), buffer->d()->data.constData(), buffer->d()->data.size());
+
+    str += StringDecoder::flush(self->d());
+    return v4->newString(str)->asReturnedValue();
+}
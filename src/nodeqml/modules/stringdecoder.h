@@ -0,0 +1,66 @@
+#ifndef STRINGDECODER_H
+#define STRINGDECODER_H
+
+#include "../v4integration.h"
+#include "../types/buffer.h"
+
+#include <private/qv4object_p.h>
+#include <private/qv4functionobject_p.h>
+
+namespace NodeQml {
+
+namespace Heap {
+
+struct StringDecoderModule : QV4::Heap::Object {
+    StringDecoderModule(QV4::ExecutionEngine *v4);
+};
+
+struct StringDecoder : QV4::Heap::Object {
+    StringDecoder(QV4::ExecutionEngine *v4, BufferEncoding encoding);
+
+    BufferEncoding encoding;
+
+    // Bytes of an incomplete character left over from the previous chunk
+    char partial[4];
+    int partialSize = 0;
+    int partialNeeded = 0;
+};
+
+struct StringDecoderCtor : QV4::Heap::FunctionObject {
+    StringDecoderCtor(QV4::ExecutionContext *scope);
+};
+
+} // namespace Heap
+
+struct StringDecoderModule : QV4::Object
+{
+    NODE_V4_OBJECT(StringDecoderModule, Object)
+};
+
+struct StringDecoder : QV4::Object
+{
+    NODE_V4_OBJECT(StringDecoder, Object)
+
+    static QString decode(Heap::StringDecoder *decoder, const char *data, int size);
+    static QString flush(Heap::StringDecoder *decoder);
+};
+
+struct StringDecoderCtor : QV4::FunctionObject
+{
+    NODE_V4_OBJECT(StringDecoderCtor, FunctionObject)
+
+    static QV4::ReturnedValue construct(QV4::Managed *m, QV4::CallData *callData);
+    static QV4::ReturnedValue call(QV4::Managed *that, QV4::CallData *callData);
+};
+
+struct StringDecoderPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4, QV4::Object *ctor);
+
+    static QV4::ReturnedValue method_write(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_end(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // STRINGDECODER_H
@@ -1,10 +1,15 @@
 #include "util.h"
 
+#include "../engine_p.h"
+#include "../util/deepequal.h"
+#include "../util/eventemitter.h"
+#include "../util/formatcache.h"
+#include "../util/inspector.h"
+
 #include <QDateTime>
-#include <QTextStream>
-#include <QRegularExpression>
 
 #include <private/qv4context_p.h>
+#include <private/qv4errorobject_p.h>
 #include <private/qv4jsonobject_p.h>
 #include <private/qv4regexpobject_p.h>
 
@@ -24,6 +29,9 @@ Heap::UtilModule::UtilModule(QV4::ExecutionEngine *v4) :
     self->defineDefaultProperty(QStringLiteral("isDate"), NodeQml::UtilModule::method_isDate, 1);
     self->defineDefaultProperty(QStringLiteral("isError"), NodeQml::UtilModule::method_isError, 1);
     self->defineDefaultProperty(QStringLiteral("inherits"), NodeQml::UtilModule::method_inherits, 2);
+    self->defineDefaultProperty(QStringLiteral("isDeepStrictEqual"), NodeQml::UtilModule::method_isDeepStrictEqual, 2);
+    // Loose variant for assert.deepEqual()
+    self->defineDefaultProperty(QStringLiteral("_isDeepEqual"), NodeQml::UtilModule::method_isDeepEqual, 2);
 }
 
 QV4::ReturnedValue UtilModule::method_format(QV4::CallContext *ctx)
@@ -39,47 +47,62 @@ QV4::ReturnedValue UtilModule::method_format(QV4::CallContext *ctx)
         return (s = v4->newString()).asReturnedValue();
 
     if (!callData->args[0].isString()) {
-        QStringList objects;
-        for (int i = 0; i < callData->argc; ++i)
-            objects << inspect(callData->args[i]);
-        return (s = v4->newString(objects.join(QStringLiteral(" ")))).asReturnedValue();
+        // Strings are appended as they are, only other values are inspected
+        Inspector inspector(v4);
+        QString result;
+        for (int i = 0; i < callData->argc; ++i) {
+            if (i)
+                result += QLatin1Char(' ');
+            if (callData->args[i].isString())
+                result += callData->args[i].toQStringNoThrow();
+            else
+                result += inspector.inspect(callData->args[i]);
+            if (v4->hasException)
+                return QV4::Encode::undefined();
+        }
+        return (s = v4->newString(result)).asReturnedValue();
     }
 
-    const QString format = callData->args[0].toQString();
+    s = callData->args[0];
+    const QString format = s->toQString();
+    const QVector<FormatCache::Token> &tokens
+            = EnginePrivate::get(v4)->formatCache.tokens(s->d(), format);
 
     QString result;
+    result.reserve(format.size() + 16 * (callData->argc - 1));
     int i = 1;
-    int lastPos = 0;
-
-    QRegularExpression re(QStringLiteral("%[sdj%]"));
-    QRegularExpressionMatchIterator it = re.globalMatch(format);
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-
-        /// TODO: That might be slow
-        if (match.capturedStart(0))
-            result += format.mid(lastPos, match.capturedStart(0) - lastPos);
-        lastPos = match.capturedEnd(0);
-
-        const QString placeholder = match.captured(0);
-
-        if (i >= callData->argc) {
-            result += placeholder;
-        } else if (placeholder == QStringLiteral("%%")) {
-            result += QStringLiteral("%");
-        } else if (placeholder == QStringLiteral("%s") || placeholder == QStringLiteral("%d")) {
-            result += inspect(callData->args[i++]);
-        } else if (placeholder == QStringLiteral("%j")) {
-            /// TODO: Call JSON.stringify(). See: Stringify::Str() in qv4jsonobject.cpp.
-            result += QStringLiteral("[JSON]");
-            ++i;
+    QV4::ScopedValue v(scope);
+
+    // The tokens are copied by foreach, a toString() logging with another format is harmless
+    foreach (const FormatCache::Token &token, tokens) {
+        if (!token.placeholder || i >= callData->argc) {
+            result.append(format.constData() + token.start, token.length);
+        } else if (token.placeholder == '%') {
+            result += QLatin1Char('%');
+        } else if (token.placeholder == 's') {
+            result += callData->args[i++].toQStringNoThrow();
+        } else if (token.placeholder == 'd') {
+            v = QV4::Primitive::fromDouble(callData->args[i++].toNumber());
+            result += v->toQStringNoThrow();
+        } else if (token.placeholder == 'j') {
+            result += stringify(v4, callData->args[i++]);
         }
+        if (v4->hasException)
+            return QV4::Encode::undefined();
     }
 
-    result += format.mid(lastPos);
-
-    for (; i < callData->argc; ++i)
-        result += QStringLiteral(" ") + inspect(callData->args[i]);
+    if (i < callData->argc) {
+        Inspector inspector(v4);
+        for (; i < callData->argc; ++i) {
+            result += QLatin1Char(' ');
+            if (callData->args[i].isObject())
+                result += inspector.inspect(callData->args[i]);
+            else
+                result += callData->args[i].toQStringNoThrow();
+            if (v4->hasException)
+                return QV4::Encode::undefined();
+        }
+    }
 
     return (s = v4->newString(result)).asReturnedValue();
 }
@@ -89,17 +112,39 @@ QV4::ReturnedValue UtilModule::method_log(QV4::CallContext *ctx)
     const QString label = QDateTime::currentDateTime().toString(QStringLiteral("d MMM HH:mm:ss"));
     QV4::Scope scope(ctx);
     QV4::ScopedValue v(scope, method_format(ctx));
-    QTextStream(stdout) << label << QStringLiteral(" - ") << v->toQStringNoThrow() << endl;
+    EnginePrivate::get(ctx->engine())->outputSink()->writeLine(
+                OutputSink::Stdout, label + QStringLiteral(" - ") + v->toQStringNoThrow());
     return QV4::Encode::undefined();
 }
 
+// inspect(object, [options])
+// inspect(object, [showHidden], [depth])
 QV4::ReturnedValue UtilModule::method_inspect(QV4::CallContext *ctx)
 {
     NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
 
     QV4::Scope scope(ctx);
+    QV4::ScopedValue arg(scope, callData->argument(1));
+    Inspector::Options options = Inspector::parseOptions(v4, arg);
+    if (callData->argc > 2 && !arg->isObject()) {
+        // Legacy arguments, only the depth is honored
+        arg = callData->argument(2);
+        if (arg->isNull())
+            options.depth = -1;
+        else if (arg->isNumber())
+            options.depth = qMax(0, arg->toInt32());
+    }
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
+    arg = callData->argument(0);
+    const QString result = Inspector(v4, options).inspect(arg);
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
     QV4::ScopedString s(scope);
-    return (s = ctx->engine()->newString(inspect(callData->args[0]))).asReturnedValue();
+    return (s = v4->newString(result)).asReturnedValue();
 }
 
 QV4::ReturnedValue UtilModule::method_isArray(QV4::CallContext *ctx)
@@ -172,11 +217,58 @@ QV4::ReturnedValue UtilModule::method_inherits(QV4::CallContext *ctx)
     return QV4::Encode::undefined();
 }
 
-/// TODO: Real implementation (See: https://github.com/joyent/node/blob/master/lib/util.js)
-QString UtilModule::inspect(QV4::Value value)
+QV4::ReturnedValue UtilModule::method_isDeepEqual(QV4::CallContext *ctx)
 {
-    if (value.isNullOrUndefined())
-        return QStringLiteral("undefined");
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue a(scope, callData->argument(0));
+    QV4::ScopedValue b(scope, callData->argument(1));
+    const bool equal = DeepEqual(v4, DeepEqual::Loose).equals(a, b);
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+    return QV4::Encode(equal);
+}
 
-    return value.toQStringNoThrow();
+QV4::ReturnedValue UtilModule::method_isDeepStrictEqual(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_V4(ctx);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedValue a(scope, callData->argument(0));
+    QV4::ScopedValue b(scope, callData->argument(1));
+    const bool equal = DeepEqual(v4, DeepEqual::Strict).equals(a, b);
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+    return QV4::Encode(equal);
+}
+
+QString UtilModule::inspect(QV4::ExecutionEngine *v4, const QV4::Value &value)
+{
+    return Inspector(v4).inspect(value);
+}
+
+// JSON.stringify() for %j, which prints [Circular] instead of throwing on cycles. Other
+// exceptions, e.g. from toJSON(), are passed on.
+QString UtilModule::stringify(QV4::ExecutionEngine *v4, const QV4::Value &value)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newString(QStringLiteral("JSON")));
+    QV4::ScopedObject json(scope, v4->globalObject()->get(s));
+    QV4::ScopedValue result(scope, callMethod(v4, json, QStringLiteral("stringify"), &value, 1));
+    if (v4->hasException) {
+        // V4 reports a cycle with a TypeError carrying the default message
+        QV4::ScopedValue exception(scope, v4->catchException());
+        QV4::ScopedObject error(scope, exception);
+        if (error && error->as<QV4::TypeErrorObject>()) {
+            QV4::ScopedValue message(scope, error->get((s = v4->newString(QStringLiteral("message")))));
+            if (message->toQStringNoThrow() == QLatin1String("Type error"))
+                return QStringLiteral("[Circular]");
+        }
+        v4->throwError(exception);
+        return QString();
+    }
+    return result->isUndefined() ? QStringLiteral("undefined") : result->toQStringNoThrow();
 }
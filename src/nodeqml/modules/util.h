@@ -28,8 +28,11 @@ struct UtilModule : QV4::Object
     static QV4::ReturnedValue method_isError(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_isUndefined(QV4::CallContext *ctx);
     static QV4::ReturnedValue method_inherits(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isDeepEqual(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isDeepStrictEqual(QV4::CallContext *ctx);
 
-    static QString inspect(QV4::Value value);
+    static QString inspect(QV4::ExecutionEngine *v4, const QV4::Value &value);
+    static QString stringify(QV4::ExecutionEngine *v4, const QV4::Value &value);
 };
 
 } // namespace NodeQml
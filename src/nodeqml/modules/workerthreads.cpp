@@ -0,0 +1,727 @@
+#include "workerthreads.h"
+
+#include "../engine.h"
+#include "../engine_p.h"
+#include "../util/eventemitter.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QEvent>
+#include <QFileInfo>
+#include <QJSEngine>
+#include <QMutexLocker>
+#include <QObject>
+
+#include <private/qv4context_p.h>
+#include <private/qv4mm_p.h>
+#include <private/qv4persistent_p.h>
+#include <private/qv8engine_p.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(WorkerThreadsModule);
+DEFINE_OBJECT_VTABLE(Worker);
+DEFINE_OBJECT_VTABLE(WorkerCtor);
+DEFINE_OBJECT_VTABLE(MessagePort);
+
+namespace {
+
+// The main thread is 0
+QAtomicInt nextThreadId(1);
+
+class WorkerEvent : public QEvent
+{
+public:
+    enum Kind {
+        Online,
+        Message,
+        Error,
+        Exit,
+        // Delivers messages queued in a port that has just been started
+        Flush,
+        Close
+    };
+
+    WorkerEvent(Kind kind, const StructuredClone &value = StructuredClone(), int exitCode = 0) :
+        QEvent(eventType()),
+        kind(kind),
+        value(value),
+        exitCode(exitCode)
+    {
+    }
+
+    static QEvent::Type eventType()
+    {
+        static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+        return type;
+    }
+
+    const Kind kind;
+    const StructuredClone value;
+    const int exitCode;
+};
+
+} // namespace
+
+namespace NodeQml {
+
+/*!
+  \internal
+  The parent's side of a worker, owned by the Worker object. Turns what the worker posts into
+  events of the Worker object, and keeps the parent's engine running until the worker has exited.
+*/
+class WorkerHandle : public QObject
+{
+public:
+    WorkerHandle(QV4::ExecutionEngine *v4, Heap::Worker *worker, const QString &filename,
+                 const StructuredClone &workerData) :
+        m_v4(v4),
+        m_engine(EnginePrivate::get(v4)),
+        m_worker(worker),
+        m_keepAlive(v4, worker->asReturnedValue()),
+        m_thread(new WorkerThread(this, filename, workerData, worker->threadId))
+    {
+        m_thread->start();
+        m_engine->openHandle();
+        m_engine->refHandle();
+    }
+
+    ~WorkerHandle()
+    {
+        // Only on engine teardown, a worker busy running code is waited for
+        if (m_thread) {
+            m_thread->requestExit(1);
+            m_thread->wait();
+            delete m_thread;
+        }
+    }
+
+    bool isActive() const { return m_thread; }
+
+    void postMessage(const StructuredClone &message)
+    {
+        if (m_thread)
+            m_thread->postToWorker(message);
+    }
+
+    void terminate()
+    {
+        if (m_thread)
+            m_thread->requestExit(1);
+    }
+
+protected:
+    void customEvent(QEvent *event) override
+    {
+        if (event->type() != WorkerEvent::eventType())
+            return;
+
+        const WorkerEvent *e = static_cast<WorkerEvent *>(event);
+        QV4::Scope scope(m_v4);
+        QV4::ScopedValue v(scope);
+
+        switch (e->kind) {
+        case WorkerEvent::Online:
+            emitEvent(m_v4, m_worker, QStringLiteral("online"));
+            break;
+        case WorkerEvent::Message:
+            v = e->value.deserialize(m_v4);
+            emitEvent(m_v4, m_worker, QStringLiteral("message"), v.asReturnedValue(), 1);
+            break;
+        case WorkerEvent::Error:
+            v = e->value.deserialize(m_v4);
+            emitEvent(m_v4, m_worker, QStringLiteral("error"), v.asReturnedValue(), 1);
+            break;
+        case WorkerEvent::Exit:
+            exited(e->exitCode);
+            return;
+        default:
+            return;
+        }
+
+        m_engine->exceptionCheck();
+        m_engine->doneCheck();
+    }
+
+private:
+    void exited(int exitCode)
+    {
+        m_thread->wait();
+        delete m_thread;
+        m_thread = nullptr;
+
+        emitEvent(m_v4, m_worker, QStringLiteral("exit"), QV4::Encode(exitCode), 1);
+        m_engine->exceptionCheck();
+
+        m_engine->closeHandle();
+        if (m_worker->referenced)
+            m_engine->unrefHandle();
+        m_keepAlive = QV4::PersistentValue();
+        m_engine->doneCheck();
+    }
+
+    QV4::ExecutionEngine * const m_v4;
+    EnginePrivate * const m_engine;
+    Heap::Worker * const m_worker;
+    // Keeps the Worker object alive while the thread runs
+    QV4::PersistentValue m_keepAlive;
+    WorkerThread *m_thread;
+};
+
+/*!
+  \internal
+  The worker's side of parentPort, lives on the worker's thread. Messages are held back until the
+  port is started, which adding a 'message' listener does. A started port keeps the worker
+  running, unless it has been unref'd or closed.
+*/
+class PortReceiver : public QObject
+{
+public:
+    PortReceiver(QV4::ExecutionEngine *v4) :
+        m_v4(v4),
+        m_engine(EnginePrivate::get(v4))
+    {
+        QV4::Scope scope(v4);
+        QV4::Scoped<MessagePort> port(scope, v4->memoryManager->alloc<MessagePort>(v4, this));
+        m_port.set(v4, port);
+    }
+
+    ~PortReceiver()
+    {
+        setActive(false);
+        setOpen(false);
+    }
+
+    QV4::ReturnedValue port() const { return m_port.value(); }
+
+    void start()
+    {
+        if (m_started || m_closed)
+            return;
+        m_started = true;
+        updateActive();
+        if (!m_queue.isEmpty())
+            QCoreApplication::postEvent(this, new WorkerEvent(WorkerEvent::Flush));
+    }
+
+    void close()
+    {
+        if (m_closed)
+            return;
+        m_closed = true;
+        m_queue.clear();
+        updateActive();
+        QCoreApplication::postEvent(this, new WorkerEvent(WorkerEvent::Close));
+    }
+
+    void setReferenced(bool referenced)
+    {
+        m_referenced = referenced;
+        updateActive();
+    }
+
+protected:
+    void customEvent(QEvent *event) override
+    {
+        if (event->type() != WorkerEvent::eventType())
+            return;
+
+        const WorkerEvent *e = static_cast<WorkerEvent *>(event);
+        switch (e->kind) {
+        case WorkerEvent::Message:
+            if (m_closed)
+                return;
+            m_queue.append(e->value);
+            if (!m_started)
+                return;
+            break;
+        case WorkerEvent::Flush:
+            break;
+        case WorkerEvent::Close: {
+            QV4::Scope scope(m_v4);
+            QV4::ScopedObject o(scope, port());
+            emitEvent(m_v4, o->d(), QStringLiteral("close"));
+            m_engine->exceptionCheck();
+            m_engine->doneCheck();
+            return;
+        }
+        default:
+            return;
+        }
+
+        flush();
+        m_engine->doneCheck();
+    }
+
+private:
+    void flush()
+    {
+        QV4::Scope scope(m_v4);
+        QV4::ScopedObject o(scope, port());
+        QV4::ScopedValue v(scope);
+        // A listener can close the port
+        while (!m_queue.isEmpty() && m_started && !m_closed) {
+            v = m_queue.takeFirst().deserialize(m_v4);
+            emitEvent(m_v4, o->d(), QStringLiteral("message"), v.asReturnedValue(), 1);
+            m_engine->exceptionCheck();
+        }
+    }
+
+    void updateActive()
+    {
+        setOpen(m_started && !m_closed);
+        setActive(m_started && m_referenced && !m_closed);
+    }
+
+    void setOpen(bool open)
+    {
+        if (open == m_open)
+            return;
+        m_open = open;
+        if (open)
+            m_engine->openHandle();
+        else
+            m_engine->closeHandle();
+    }
+
+    void setActive(bool active)
+    {
+        if (active == m_active)
+            return;
+        m_active = active;
+        if (active)
+            m_engine->refHandle();
+        else
+            m_engine->unrefHandle();
+    }
+
+    QV4::ExecutionEngine * const m_v4;
+    EnginePrivate * const m_engine;
+    QV4::PersistentValue m_port;
+    QList<StructuredClone> m_queue;
+    bool m_started = false;
+    bool m_referenced = true;
+    bool m_closed = false;
+    bool m_open = false;
+    bool m_active = false;
+};
+
+} // namespace NodeQml
+
+WorkerThread::WorkerThread(QObject *handle, const QString &filename,
+                           const StructuredClone &workerData, int threadId) :
+    m_handle(handle),
+    m_filename(filename),
+    m_workerData(workerData),
+    m_threadId(threadId)
+{
+}
+
+void WorkerThread::postToWorker(const StructuredClone &message)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_finished)
+        return;
+    if (!m_receiver) {
+        m_pending.append(message);
+        return;
+    }
+    QCoreApplication::postEvent(m_receiver, new WorkerEvent(WorkerEvent::Message, message));
+}
+
+void WorkerThread::postToParent(const StructuredClone &message)
+{
+    QCoreApplication::postEvent(m_handle, new WorkerEvent(WorkerEvent::Message, message));
+}
+
+/*!
+  \internal
+  Sends an uncaught exception to the parent, where it is emitted as 'error'.
+*/
+void WorkerThread::reportError(QV4::ExecutionEngine *v4, const QV4::Value &error)
+{
+    StructuredClone clone;
+    if (!clone.serialize(v4, error, QV4::Primitive::undefinedValue())) {
+        v4->catchException();
+        QV4::Scope scope(v4);
+        QV4::ScopedValue message(scope, v4->newString(error.toQStringNoThrow()));
+        clone.serialize(v4, message, QV4::Primitive::undefinedValue());
+    }
+    QCoreApplication::postEvent(m_handle, new WorkerEvent(WorkerEvent::Error, clone));
+}
+
+/*!
+  \internal
+  Ends the worker's event loop. Code running at the time is not interrupted, the worker exits
+  once it returns to the event loop.
+*/
+void WorkerThread::requestExit(int code)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_exitRequested)
+        return;
+    m_exitRequested = true;
+    m_exitCode = code;
+    // Also ends exec() if called before it started
+    exit(code);
+}
+
+void WorkerThread::run()
+{
+    {
+        QJSEngine jsEngine;
+        Engine engine(&jsEngine);
+        QV4::ExecutionEngine *v4 = QV8Engine::getV4(&jsEngine);
+        EnginePrivate *enginePrivate = EnginePrivate::get(v4);
+        enginePrivate->workerThread = this;
+
+        QObject::connect(&engine, &Engine::quit, [this](int code) {
+            requestExit(code);
+        });
+
+        // Cannot fail unless the bundled events module is broken
+        initEmitterPrototype(v4, enginePrivate->messagePortPrototype);
+        PortReceiver receiver(v4);
+        bool terminated;
+        {
+            QMutexLocker locker(&m_mutex);
+            m_receiver = &receiver;
+            foreach (const StructuredClone &message, m_pending)
+                QCoreApplication::postEvent(&receiver, new WorkerEvent(WorkerEvent::Message, message));
+            m_pending.clear();
+            terminated = m_exitRequested;
+        }
+
+        if (!terminated) {
+            QV4::Scope scope(v4);
+            QV4::ScopedValue port(scope, receiver.port());
+            QV4::ScopedValue workerData(scope, m_workerData.deserialize(v4));
+            WorkerThreadsModule::initWorker(v4, port, workerData, m_threadId);
+            QCoreApplication::postEvent(m_handle, new WorkerEvent(WorkerEvent::Online));
+
+            engine.require(m_filename);
+            exec();
+        }
+
+        QMutexLocker locker(&m_mutex);
+        m_receiver = nullptr;
+        m_finished = true;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    QCoreApplication::postEvent(m_handle, new WorkerEvent(WorkerEvent::Exit, StructuredClone(),
+                                                          m_exitCode));
+}
+
+Heap::WorkerThreadsModule::WorkerThreadsModule(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject o(scope);
+
+    self->defineDefaultProperty(QStringLiteral("Worker"), (o = EnginePrivate::get(v4)->workerCtor.asObject()));
+    self->defineDefaultProperty(QStringLiteral("isMainThread"), QV4::Primitive::fromBoolean(true));
+    self->defineDefaultProperty(QStringLiteral("threadId"), QV4::Primitive::fromInt32(0));
+    self->defineDefaultProperty(QStringLiteral("parentPort"), QV4::Primitive::nullValue());
+    self->defineDefaultProperty(QStringLiteral("workerData"), QV4::Primitive::nullValue());
+}
+
+/*!
+  \internal
+  Turns the worker_threads module of \a v4 into that of a worker.
+*/
+void WorkerThreadsModule::initWorker(QV4::ExecutionEngine *v4, const QV4::Value &parentPort,
+                                     const QV4::Value &workerData, int threadId)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject module(scope, EnginePrivate::get(v4)->nativeModule(QStringLiteral("worker_threads")));
+    QV4::ScopedString s(scope);
+    QV4::ScopedValue v(scope);
+
+    s = v4->newString(QStringLiteral("isMainThread"));
+    module->put(s, (v = QV4::Primitive::fromBoolean(false)));
+    s = v4->newString(QStringLiteral("threadId"));
+    module->put(s, (v = QV4::Primitive::fromInt32(threadId)));
+    s = v4->newString(QStringLiteral("parentPort"));
+    module->put(s, parentPort);
+    s = v4->newString(QStringLiteral("workerData"));
+    module->put(s, workerData);
+}
+
+Heap::Worker::Worker(QV4::ExecutionEngine *v4) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->workerPrototype.asObject())
+{
+}
+
+void Worker::destroy(QV4::Heap::Base *that)
+{
+    Heap::Worker *worker = static_cast<Heap::Worker *>(that);
+    // The handle keeps a running worker alive, so this only happens on engine teardown
+    delete worker->handle;
+    worker->~Worker();
+}
+
+Heap::WorkerCtor::WorkerCtor(QV4::ExecutionContext *scope) :
+    QV4::Heap::FunctionObject(scope, QStringLiteral("Worker"))
+{
+}
+
+// new Worker(filename, [options])
+QV4::ReturnedValue WorkerCtor::construct(QV4::Managed *m, QV4::CallData *callData)
+{
+    QV4::ExecutionEngine *v4 = static_cast<QV4::Object *>(m)->engine();
+    EnginePrivate *engine = EnginePrivate::get(v4);
+
+    if (!callData->argc || !callData->args[0].isString())
+        return v4->throwTypeError(QStringLiteral("Worker: filename must be a string"));
+    // Relative to the working directory, as in Node
+    const QString filename = QFileInfo(callData->args[0].toQStringNoThrow()).absoluteFilePath();
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject options(scope, callData->argument(1));
+    QV4::ScopedValue workerData(scope);
+    QV4::ScopedValue transferList(scope);
+    if (options) {
+        QV4::ScopedString s(scope, v4->newString(QStringLiteral("workerData")));
+        workerData = options->get(s);
+        s = v4->newString(QStringLiteral("transferList"));
+        transferList = options->get(s);
+        if (v4->hasException)
+            return QV4::Encode::undefined();
+    } else {
+        workerData = QV4::Primitive::nullValue();
+    }
+
+    StructuredClone clone;
+    if (!clone.serialize(v4, workerData, transferList))
+        return QV4::Encode::undefined();
+
+    if (!initEmitterPrototype(v4, engine->workerPrototype))
+        return QV4::Encode::undefined();
+
+    QV4::Scoped<Worker> worker(scope, v4->memoryManager->alloc<Worker>(v4));
+    worker->d()->threadId = nextThreadId.fetchAndAddRelaxed(1);
+    worker->d()->handle = new WorkerHandle(v4, worker->d(), filename, clone);
+    return worker.asReturnedValue();
+}
+
+QV4::ReturnedValue WorkerCtor::call(QV4::Managed *that, QV4::CallData *callData)
+{
+    Q_UNUSED(callData)
+    QV4::ExecutionEngine *v4 = static_cast<QV4::Object *>(that)->engine();
+    return v4->throwTypeError(QStringLiteral("Class constructor Worker cannot be invoked without 'new'"));
+}
+
+Heap::MessagePort::MessagePort(QV4::ExecutionEngine *v4, PortReceiver *receiver) :
+    QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->messagePortPrototype.asObject()),
+    receiver(receiver)
+{
+}
+
+void WorkerPrototype::init(QV4::ExecutionEngine *v4, QV4::Object *ctor)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope);
+
+    ctor->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(2));
+    ctor->defineReadonlyProperty(v4->id_prototype, (o = this));
+    defineDefaultProperty(QStringLiteral("constructor"), (o = ctor));
+
+    defineDefaultProperty(QStringLiteral("postMessage"), method_postMessage, 2);
+    defineDefaultProperty(QStringLiteral("terminate"), method_terminate, 1);
+    defineDefaultProperty(QStringLiteral("ref"), method_ref);
+    defineDefaultProperty(QStringLiteral("unref"), method_unref);
+
+    defineAccessorProperty(QStringLiteral("threadId"), property_threadId_getter, nullptr);
+}
+
+// postMessage(value, [transferList])
+QV4::ReturnedValue WorkerPrototype::method_postMessage(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(Worker, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedValue value(scope, callData->argument(0));
+    QV4::ScopedValue transferList(scope, callData->argument(1));
+    StructuredClone clone;
+    if (!clone.serialize(v4, value, transferList))
+        return QV4::Encode::undefined();
+
+    self->d()->handle->postMessage(clone);
+    return QV4::Encode::undefined();
+}
+
+// terminate([callback]), the callback is called with the exit code
+QV4::ReturnedValue WorkerPrototype::method_terminate(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(Worker, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (!self->d()->handle->isActive())
+        return QV4::Encode::undefined();
+
+    if (callData->argc && callData->args[0].asFunctionObject())
+        once(v4, self->d(), QStringLiteral("exit"), callData->args[0]);
+    self->d()->handle->terminate();
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue WorkerPrototype::method_ref(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(Worker, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->handle->isActive() && !self->d()->referenced)
+        EnginePrivate::get(v4)->refHandle();
+    self->d()->referenced = true;
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue WorkerPrototype::method_unref(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(Worker, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    if (self->d()->handle->isActive() && self->d()->referenced)
+        EnginePrivate::get(v4)->unrefHandle();
+    self->d()->referenced = false;
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue WorkerPrototype::property_threadId_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(Worker, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    return QV4::Encode(self->d()->threadId);
+}
+
+void MessagePortPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("on"), method_on, 2);
+    defineDefaultProperty(QStringLiteral("addListener"), method_on, 2);
+    defineDefaultProperty(QStringLiteral("postMessage"), method_postMessage, 2);
+    defineDefaultProperty(QStringLiteral("start"), method_start);
+    defineDefaultProperty(QStringLiteral("close"), method_close);
+    defineDefaultProperty(QStringLiteral("ref"), method_ref);
+    defineDefaultProperty(QStringLiteral("unref"), method_unref);
+}
+
+// on(event, listener), adding a 'message' listener starts the port
+QV4::ReturnedValue MessagePortPrototype::method_on(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(MessagePort, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    // EventEmitter.prototype.on
+    QV4::ScopedObject emitterPrototype(scope, EnginePrivate::get(v4)->messagePortPrototype.asObject()->prototype());
+    QV4::ScopedString s(scope, v4->newString(QStringLiteral("on")));
+    QV4::ScopedFunctionObject on(scope, emitterPrototype->get(s));
+    if (!on)
+        return v4->throwTypeError();
+
+    QV4::ScopedCallData args(scope, callData->argc);
+    args->thisObject = callData->thisObject;
+    for (int i = 0; i < callData->argc; ++i)
+        args->args[i] = callData->args[i];
+    QV4::ScopedValue result(scope, on->call(args));
+    if (v4->hasException)
+        return QV4::Encode::undefined();
+
+    if (callData->argc && callData->args[0].toQStringNoThrow() == QStringLiteral("message"))
+        self->d()->receiver->start();
+
+    return result.asReturnedValue();
+}
+
+// postMessage(value, [transferList])
+QV4::ReturnedValue MessagePortPrototype::method_postMessage(QV4::CallContext *ctx)
+{
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(MessagePort, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedValue value(scope, callData->argument(0));
+    QV4::ScopedValue transferList(scope, callData->argument(1));
+    StructuredClone clone;
+    if (!clone.serialize(v4, value, transferList))
+        return QV4::Encode::undefined();
+
+    EnginePrivate::get(v4)->workerThread->postToParent(clone);
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue MessagePortPrototype::method_start(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(MessagePort, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->receiver->start();
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue MessagePortPrototype::method_close(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(MessagePort, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->receiver->close();
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue MessagePortPrototype::method_ref(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(MessagePort, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->receiver->setReferenced(true);
+    return QV4::Encode::undefined();
+}
+
+QV4::ReturnedValue MessagePortPrototype::method_unref(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(MessagePort, ctx);
+    NODE_CTX_V4(ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    self->d()->receiver->setReferenced(false);
+    return QV4::Encode::undefined();
+}
@@ -0,0 +1,145 @@
+#ifndef WORKERTHREADS_H
+#define WORKERTHREADS_H
+
+#include "../v4integration.h"
+#include "../util/structuredclone.h"
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+
+#include <private/qv4object_p.h>
+#include <private/qv4functionobject_p.h>
+
+namespace NodeQml {
+
+class PortReceiver;
+class WorkerHandle;
+
+/*!
+  \internal
+  Runs the engine of a worker, which has its own QJSEngine and event loop. Messages to the worker
+  are queued until its engine is ready. Messages, errors and the exit of the worker are posted to
+  the handle of the Worker object in the parent.
+*/
+class WorkerThread : public QThread
+{
+public:
+    WorkerThread(QObject *handle, const QString &filename, const StructuredClone &workerData,
+                 int threadId);
+
+    void postToWorker(const StructuredClone &message);
+
+    // Called by the worker
+    void postToParent(const StructuredClone &message);
+    void reportError(QV4::ExecutionEngine *v4, const QV4::Value &error);
+
+    // Called by either side, the first exit code wins
+    void requestExit(int code);
+
+protected:
+    void run() override;
+
+private:
+    QObject * const m_handle;
+    const QString m_filename;
+    const StructuredClone m_workerData;
+    const int m_threadId;
+
+    QMutex m_mutex;
+    // Lives on this thread while the engine runs
+    PortReceiver *m_receiver = nullptr;
+    // Messages posted before the engine was ready
+    QList<StructuredClone> m_pending;
+    bool m_finished = false;
+    bool m_exitRequested = false;
+    int m_exitCode = 0;
+};
+
+namespace Heap {
+
+struct WorkerThreadsModule : QV4::Heap::Object {
+    WorkerThreadsModule(QV4::ExecutionEngine *v4);
+};
+
+struct Worker : QV4::Heap::Object {
+    Worker(QV4::ExecutionEngine *v4);
+
+    int threadId = 0;
+    bool referenced = true;
+    // Owned, lives as long as this object
+    WorkerHandle *handle = nullptr;
+};
+
+struct WorkerCtor : QV4::Heap::FunctionObject {
+    WorkerCtor(QV4::ExecutionContext *scope);
+};
+
+/*!
+  \internal
+  parentPort of a worker.
+*/
+struct MessagePort : QV4::Heap::Object {
+    MessagePort(QV4::ExecutionEngine *v4, PortReceiver *receiver);
+
+    // Outlives the engine's event loop
+    PortReceiver *receiver;
+};
+
+} // namespace Heap
+
+struct WorkerThreadsModule : QV4::Object
+{
+    NODE_V4_OBJECT(WorkerThreadsModule, Object)
+
+    static void initWorker(QV4::ExecutionEngine *v4, const QV4::Value &parentPort,
+                           const QV4::Value &workerData, int threadId);
+};
+
+struct Worker : QV4::Object
+{
+    NODE_V4_OBJECT(Worker, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+};
+
+struct WorkerCtor : QV4::FunctionObject
+{
+    NODE_V4_OBJECT(WorkerCtor, FunctionObject)
+
+    static QV4::ReturnedValue construct(QV4::Managed *m, QV4::CallData *callData);
+    static QV4::ReturnedValue call(QV4::Managed *that, QV4::CallData *callData);
+};
+
+struct MessagePort : QV4::Object
+{
+    NODE_V4_OBJECT(MessagePort, Object)
+};
+
+struct WorkerPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4, QV4::Object *ctor);
+
+    static QV4::ReturnedValue method_postMessage(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_terminate(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_ref(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unref(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue property_threadId_getter(QV4::CallContext *ctx);
+};
+
+struct MessagePortPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_on(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_postMessage(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_start(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_close(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_ref(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_unref(QV4::CallContext *ctx);
+};
+
+} // namespace NodeQml
+
+#endif // WORKERTHREADS_H
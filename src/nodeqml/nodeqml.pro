@@ -7,41 +7,86 @@ TEMPLATE = lib
 DEFINES += NODEQML_LIBRARY
 
 SOURCES += \
+    asyncwork.cpp \
     engine.cpp \
+    enginepool.cpp \
+    filewatcher.cpp \
     globalextensions.cpp \
+    iouring.cpp \
     moduleobject.cpp \
+    outputsink.cpp \
+    modules/childprocess.cpp \
     modules/console.cpp \
     modules/dns.cpp \
+    modules/events.cpp \
     modules/filesystem.cpp \
+    modules/fsdir.cpp \
+    modules/fsrequest.cpp \
+    modules/fsstream.cpp \
+    modules/fswatcher.cpp \
     modules/os.cpp \
     modules/path.cpp \
     modules/process.cpp \
+    modules/stringdecoder.cpp \
     modules/util.cpp \
+    modules/workerthreads.cpp \
     types/buffer.cpp \
-    types/errnoexception.cpp
+    types/direntry.cpp \
+    types/errnoexception.cpp \
+    types/stats.cpp \
+    util/bufferpool.cpp \
+    util/deepequal.cpp \
+    util/formatcache.cpp \
+    util/inspector.cpp \
+    util/structuredclone.cpp \
+    util/eventemitter.cpp
 
 HEADERS_PUBLIC += \
     nodeqml_global.h \
-    engine.h
+    engine.h \
+    enginepool.h
 
 HEADERS_PRIVATE += \
+    asyncwork.h \
     engine_p.h \
+    filewatcher.h \
     globalextensions.h \
+    iouring.h \
+    outputsink.h \
     v4integration.h \
     moduleobject.h \
+    modules/childprocess.h \
     modules/console.h \
     modules/dns.h \
+    modules/events.h \
     modules/filesystem.h \
+    modules/fsdir.h \
+    modules/fsrequest.h \
+    modules/fsstream.h \
+    modules/fswatcher.h \
     modules/os.h \
     modules/path.h \
     modules/process.h \
+    modules/stringdecoder.h \
     modules/util.h \
+    modules/workerthreads.h \
     types/buffer.h \
+    types/direntry.h \
     types/errnoexception.h \
+    types/stats.h \
+    util/bufferpool.h \
+    util/deepequal.h \
+    util/formatcache.h \
+    util/inspector.h \
+    util/structuredclone.h \
+    util/eventemitter.h \
     util/qarraydataslice.h
 
 HEADERS += $$HEADERS_PUBLIC $$HEADERS_PRIVATE
 
+# io_uring is used when the kernel supports it at runtime
+linux:exists(/usr/include/linux/io_uring.h): DEFINES += NODEQML_HAVE_IO_URING
+
 RESOURCES += \
     js.qrc
 
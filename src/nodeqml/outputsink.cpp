@@ -0,0 +1,272 @@
+#include "outputsink.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace NodeQml;
+
+namespace {
+
+QEvent::Type flushEventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+// Appends \a text to \a out as UTF-8, without an intermediate QByteArray
+void appendUtf8(QByteArray *out, const QString &text)
+{
+    const int offset = out->size();
+    out->resize(offset + text.size() * 3);
+    uchar *dst = reinterpret_cast<uchar *>(out->data()) + offset;
+
+    const ushort *src = text.utf16();
+    const ushort *end = src + text.size();
+    while (src < end) {
+        uint c = *src++;
+        if (c < 0x80) {
+            *dst++ = c;
+            continue;
+        }
+        if (c < 0x800) {
+            *dst++ = 0xc0 | (c >> 6);
+            *dst++ = 0x80 | (c & 0x3f);
+            continue;
+        }
+        if (QChar::isHighSurrogate(c) && src < end && QChar::isLowSurrogate(*src)) {
+            c = QChar::surrogateToUcs4(c, *src++);
+            *dst++ = 0xf0 | (c >> 18);
+            *dst++ = 0x80 | ((c >> 12) & 0x3f);
+        } else {
+            // Lone surrogates are replaced, as QString::toUtf8() does
+            if (QChar::isSurrogate(c))
+                c = QChar::ReplacementCharacter;
+            *dst++ = 0xe0 | (c >> 12);
+        }
+        *dst++ = 0x80 | ((c >> 6) & 0x3f);
+        *dst++ = 0x80 | (c & 0x3f);
+    }
+
+    out->resize(dst - reinterpret_cast<uchar *>(out->data()));
+}
+
+void writeAll(int fd, const char *data, qint64 size)
+{
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            // The descriptor may have been made non-blocking by another process sharing it
+            if (errno == EAGAIN) {
+                struct pollfd pfd = { fd, POLLOUT, 0 };
+                ::poll(&pfd, 1, -1);
+                continue;
+            }
+            // Nowhere to report the error, output is dropped like console.log() does in Node.js
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+bool isPipe(int fd)
+{
+    struct stat st;
+    return !::fstat(fd, &st) && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode));
+}
+
+} // namespace
+
+namespace NodeQml {
+
+/*!
+  \internal
+  Writes the segments handed over by an OutputSink on its own thread, in order.
+*/
+class OutputWriter : public QThread
+{
+public:
+    void enqueue(QList<OutputSink::Segment> *segments);
+    void waitForWritten();
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_queued;
+    QWaitCondition m_written;
+    QList<OutputSink::Segment> m_queue;
+    bool m_writing = false;
+    bool m_stopping = false;
+};
+
+} // namespace NodeQml
+
+void OutputWriter::enqueue(QList<OutputSink::Segment> *segments)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(*segments);
+    segments->clear();
+    m_queued.wakeOne();
+}
+
+void OutputWriter::waitForWritten()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_writing || !m_queue.isEmpty())
+        m_written.wait(&m_mutex);
+}
+
+void OutputWriter::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_queued.wakeOne();
+    }
+    wait();
+}
+
+void OutputWriter::run()
+{
+    QMutexLocker locker(&m_mutex);
+    for (;;) {
+        while (m_queue.isEmpty() && !m_stopping)
+            m_queued.wait(&m_mutex);
+        // Everything queued is written before stopping
+        if (m_queue.isEmpty())
+            break;
+
+        QList<OutputSink::Segment> segments;
+        segments.swap(m_queue);
+        m_writing = true;
+        locker.unlock();
+        OutputSink::writeSegments(segments);
+        locker.relock();
+        m_writing = false;
+        m_written.wakeAll();
+    }
+}
+
+OutputSink::OutputSink(QObject *parent) :
+    QObject(parent)
+{
+    if (isPipe(Stdout) && qEnvironmentVariableIsEmpty("NODEQML_SYNC_STDIO"))
+        setWriterThreadEnabled(true);
+}
+
+OutputSink::~OutputSink()
+{
+    setWriterThreadEnabled(false);
+    flush();
+}
+
+void OutputSink::write(Stream stream, const QString &text)
+{
+    QByteArray *out = buffer(stream);
+    const int size = out->size();
+    appendUtf8(out, text);
+    m_size += out->size() - size;
+
+    if (m_size >= FlushThreshold) {
+        flush();
+    } else if (!m_flushPosted) {
+        // Flush at the end of the current tick, after the events already posted
+        m_flushPosted = true;
+        qApp->postEvent(this, new QEvent(flushEventType()), Qt::LowEventPriority);
+    }
+}
+
+void OutputSink::writeLine(Stream stream, const QString &text)
+{
+    write(stream, text + QLatin1Char('\n'));
+}
+
+/*!
+  \internal
+  Hands everything buffered to the writer thread, or writes it right away when there is none.
+*/
+void OutputSink::flush()
+{
+    if (m_segments.isEmpty())
+        return;
+
+    if (m_writer)
+        m_writer->enqueue(&m_segments);
+    else
+        writeSegments(m_segments);
+    m_segments.clear();
+    m_size = 0;
+}
+
+/*!
+  \internal
+  Flushes and blocks until all output reached the file descriptors, e.g. before exiting or before
+  writing to them by other means.
+*/
+void OutputSink::waitForWritten()
+{
+    flush();
+    if (m_writer)
+        m_writer->waitForWritten();
+}
+
+/*!
+  \internal
+  Starts or stops writing on a background thread. Returns whether the thread is running.
+*/
+bool OutputSink::setWriterThreadEnabled(bool enabled)
+{
+    if (enabled == bool(m_writer))
+        return enabled;
+
+    if (!enabled) {
+        flush();
+        m_writer->stop();
+        delete m_writer;
+        m_writer = nullptr;
+        return false;
+    }
+
+    m_writer = new OutputWriter;
+    m_writer->start();
+    return true;
+}
+
+void OutputSink::writeSegments(const QList<Segment> &segments)
+{
+    foreach (const Segment &segment, segments)
+        writeAll(segment.fd, segment.data.constData(), segment.data.size());
+}
+
+void OutputSink::customEvent(QEvent *event)
+{
+    if (event->type() != flushEventType()) {
+        QObject::customEvent(event);
+        return;
+    }
+
+    event->accept();
+    m_flushPosted = false;
+    flush();
+}
+
+// Output goes to the last segment as long as it is for the same stream, keeping the order
+QByteArray *OutputSink::buffer(Stream stream)
+{
+    if (m_segments.isEmpty() || m_segments.last().fd != stream)
+        m_segments.append(Segment { stream, QByteArray() });
+    return &m_segments.last().data;
+}
@@ -0,0 +1,62 @@
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+
+namespace NodeQml {
+
+class OutputWriter;
+
+/*!
+  \internal
+  Buffers what console and util write to stdout and stderr. Text is encoded to UTF-8 straight into
+  the buffer, which is written out once it grows past a threshold, at the end of the current tick,
+  or on exit. When stdout is a pipe, writing happens on a background thread so that a slow reader
+  does not stall the engine. Output to both streams is kept in the order it was written.
+*/
+class OutputSink : public QObject
+{
+public:
+    // Values are the file descriptors
+    enum Stream {
+        Stdout = 1,
+        Stderr = 2
+    };
+
+    explicit OutputSink(QObject *parent = 0);
+    ~OutputSink();
+
+    void write(Stream stream, const QString &text);
+    void writeLine(Stream stream, const QString &text);
+
+    void flush();
+    void waitForWritten();
+
+    bool setWriterThreadEnabled(bool enabled);
+
+    static const int FlushThreshold = 64 * 1024;
+
+    struct Segment {
+        int fd;
+        QByteArray data;
+    };
+
+    static void writeSegments(const QList<Segment> &segments);
+
+protected:
+    void customEvent(QEvent *event) override;
+
+private:
+    QByteArray *buffer(Stream stream);
+
+    QList<Segment> m_segments;
+    int m_size = 0;
+    bool m_flushPosted = false;
+    OutputWriter *m_writer = nullptr;
+};
+
+} // namespace NodeQml
+
+#endif // OUTPUTSINK_H
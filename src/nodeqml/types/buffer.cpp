@@ -5,28 +5,26 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QtEndian>
+#include <QVarLengthArray>
+
+#include <cmath>
 
 #include <private/qstringiterator_p.h>
 #include <private/qv4engine_p.h>
 #include <private/qv4jsonobject_p.h>
+#include <private/qv4typedarray_p.h>
 
 using namespace NodeQml;
 
 DEFINE_OBJECT_VTABLE(BufferCtor);
 DEFINE_OBJECT_VTABLE(Buffer);
 
-/// NOTE: This is a result of V8 memory allocation limitations. It would make sense to lift
-/// such limit in the future.
-namespace {
-const size_t kMaxLength = 0x3fffffff;
-}
-
 /// TODO: Document no buf.parent property support (see test-buffer.js)
 
 Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, size_t length) :
     QV4::Heap::Object(v4->emptyClass, EnginePrivate::get(v4)->bufferPrototype.asObject())
 {
-    if (length > kMaxLength) {
+    if (length > kMaxBufferLength) {
         v4->throwRangeError(QStringLiteral("Attempt to allocate Buffer larger than maximum size: 0x3fffffff bytes"));
         return;
     }
@@ -39,6 +37,7 @@ Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, size_t length) :
     QV4::Scope scope(v4);
     QV4::ScopedObject o(scope, this);
     o->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(length));
+    EnginePrivate::get(v4)->retainBufferData(data);
 }
 
 Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, QV4::ArrayObject *array) :
@@ -50,7 +49,7 @@ Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, QV4::ArrayObject *array) :
 
     const uint length = a->getLength();
 
-    if (length > kMaxLength) {
+    if (length > kMaxBufferLength) {
         v4->throwRangeError(QStringLiteral("Attempt to allocate Buffer larger than maximum size: 0x3fffffff bytes"));
         return;
     }
@@ -67,6 +66,7 @@ Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, QV4::ArrayObject *array) :
 
     QV4::ScopedObject o(scope, this);
     o->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(length));
+    EnginePrivate::get(v4)->retainBufferData(data);
 }
 
 Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, const QByteArray &ba) :
@@ -85,6 +85,7 @@ Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, const QByteArray &ba) :
     QV4::Scope scope(v4);
     QV4::ScopedObject o(scope, this);
     o->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(length));
+    EnginePrivate::get(v4)->retainBufferData(data);
 }
 
 Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, const QTypedArrayDataSlice<char> &slice) :
@@ -94,6 +95,7 @@ Heap::Buffer::Buffer(QV4::ExecutionEngine *v4, const QTypedArrayDataSlice<char>
     QV4::Scope scope(v4);
     QV4::ScopedObject o(scope, this);
     o->defineReadonlyProperty(v4->id_length, QV4::Primitive::fromInt32(data.size()));
+    EnginePrivate::get(v4)->retainBufferData(data);
 }
 
 bool Heap::Buffer::allocateData(size_t length)
@@ -113,6 +115,31 @@ bool Heap::Buffer::allocateData(size_t length)
     return true;
 }
 
+void Buffer::destroy(QV4::Heap::Base *that)
+{
+    Heap::Buffer *self = static_cast<Heap::Buffer *>(that);
+    // The Node engine is gone when the V4 engine is destroyed
+    if (EnginePrivate *engine = EnginePrivate::get(self->internalClass->engine))
+        engine->releaseBufferData(self->data);
+    self->data.clearData();
+}
+
+/*!
+  \internal
+  Releases the data of \a buffer, which becomes empty. Done to Buffers transferred to another
+  thread, like Node detaches a transferred ArrayBuffer.
+ */
+void Buffer::neuter(QV4::ExecutionEngine *v4, Heap::Buffer *buffer)
+{
+    EnginePrivate::get(v4)->releaseBufferData(buffer->data);
+    buffer->data.clearData();
+
+    // length is read-only for scripts
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, buffer);
+    o->insertMember(v4->id_length, QV4::Primitive::fromInt32(0), QV4::Attr_ReadOnly);
+}
+
 bool Buffer::isEqualTo(QV4::Managed *m, QV4::Managed *other)
 {
     QV4::Scope scope(static_cast<QV4::Object *>(m)->engine());
@@ -279,6 +306,173 @@ QByteArray Buffer::decodeString(const QString &str, BufferEncoding encoding, int
     return ba;
 }
 
+namespace {
+inline int hexDigitValue(ushort c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+}
+
+/*!
+  \internal
+  Encodes \a str directly into \a dst, writing at most \a capacity bytes. Unlike
+  \l decodeString no intermediate QByteArray is created (except for \c Base64). UTF-8 output is
+  never truncated in the middle of a character. Returns the number of bytes written.
+ */
+int Buffer::decodeStringInto(const QString &str, BufferEncoding encoding, char *dst, int capacity)
+{
+    if (capacity <= 0)
+        return 0;
+
+    const QChar *chars = str.constData();
+    int written = 0;
+
+    switch (encoding) {
+    case BufferEncoding::Ascii:
+    case BufferEncoding::Binary:
+    case BufferEncoding::Raw:
+        written = std::min(str.size(), capacity);
+        for (int i = 0; i < written; ++i)
+            dst[i] = chars[i].cell();
+        break;
+    case BufferEncoding::Base64: {
+        const QByteArray ba = decodeString(str, encoding, capacity);
+        written = ba.size();
+        ::memcpy(dst, ba.constData(), written);
+        break;
+    }
+    case BufferEncoding::Hex: {
+        const int byteCount = std::min(str.size() >> 1, capacity);
+        for (; written < byteCount; ++written) {
+            const int hi = hexDigitValue(chars[2 * written].unicode());
+            const int lo = hexDigitValue(chars[2 * written + 1].unicode());
+            if (hi < 0 || lo < 0)
+                break;
+            dst[written] = static_cast<char>((hi << 4) | lo);
+        }
+        break;
+    }
+    case BufferEncoding::Ucs2:
+    case BufferEncoding::Utf16le: {
+        const int charCount = std::min(str.size(), capacity >> 1);
+        for (int i = 0; i < charCount; ++i) {
+            dst[2 * i] = chars[i].cell();
+            dst[2 * i + 1] = chars[i].row();
+        }
+        written = charCount << 1;
+        break;
+    }
+    case BufferEncoding::Utf8:
+    case BufferEncoding::Invalid:
+    default: {
+        QStringIterator it(str);
+        while (it.hasNext()) {
+            const uint ch = it.next();
+            if (ch < 0x80) {
+                if (written + 1 > capacity)
+                    break;
+                dst[written++] = static_cast<char>(ch);
+            } else if (ch < 0x800) {
+                if (written + 2 > capacity)
+                    break;
+                dst[written++] = static_cast<char>(0xc0 | (ch >> 6));
+                dst[written++] = static_cast<char>(0x80 | (ch & 0x3f));
+            } else if (ch < 0x10000) {
+                if (written + 3 > capacity)
+                    break;
+                dst[written++] = static_cast<char>(0xe0 | (ch >> 12));
+                dst[written++] = static_cast<char>(0x80 | ((ch >> 6) & 0x3f));
+                dst[written++] = static_cast<char>(0x80 | (ch & 0x3f));
+            } else {
+                if (written + 4 > capacity)
+                    break;
+                dst[written++] = static_cast<char>(0xf0 | (ch >> 18));
+                dst[written++] = static_cast<char>(0x80 | ((ch >> 12) & 0x3f));
+                dst[written++] = static_cast<char>(0x80 | ((ch >> 6) & 0x3f));
+                dst[written++] = static_cast<char>(0x80 | (ch & 0x3f));
+            }
+        }
+    }
+    }
+
+    return written;
+}
+
+/*!
+  \internal
+  Returns an upper bound of the number of bytes \l decodeStringInto can produce for \a str. Unlike
+  \l byteLength it does not scan the string.
+ */
+int Buffer::maxDecodedLength(const QString &str, BufferEncoding encoding)
+{
+    switch (encoding) {
+    case BufferEncoding::Ascii:
+    case BufferEncoding::Binary:
+    case BufferEncoding::Raw:
+        return str.size();
+    case BufferEncoding::Base64:
+        return (str.size() * 3) / 4 + 3;
+    case BufferEncoding::Hex:
+        return str.size() >> 1;
+    case BufferEncoding::Ucs2:
+    case BufferEncoding::Utf16le:
+        return str.size() * 2;
+    case BufferEncoding::Utf8:
+    case BufferEncoding::Invalid:
+    default:
+        // Surrogate pairs take 4 bytes for 2 QChars, so 3 bytes per QChar is enough
+        return str.size() * 3;
+    }
+}
+
+/*!
+  \internal
+  Converts \a size bytes at \a data into a string according to \a encoding. This is the reverse
+  operation of \l decodeString.
+ */
+QString Buffer::encodeData(const char *data, int size, BufferEncoding encoding)
+{
+    const QByteArray ba = QByteArray::fromRawData(data, size);
+    QString str;
+
+    switch (encoding) {
+    case BufferEncoding::Ascii:
+    case BufferEncoding::Binary:
+    case BufferEncoding::Raw: {
+        // Node.js just masks off the highest bit
+        str.resize(size);
+        QChar *chars = str.data();
+        for (int i = 0; i < size; ++i)
+            chars[i] = QLatin1Char(static_cast<char>(data[i] & 0x7f));
+        break;
+    }
+    case BufferEncoding::Base64:
+        str = ba.toBase64();
+        break;
+    case BufferEncoding::Hex:
+        str = ba.toHex();
+        break;
+    case BufferEncoding::Ucs2:
+    case BufferEncoding::Utf16le:
+        str = QString::fromUtf16(reinterpret_cast<const ushort *>(data), size >> 1);
+        break;
+    case BufferEncoding::Utf8:
+        str = QString::fromUtf8(data, size);
+        break;
+    case BufferEncoding::Invalid:
+        // Should never happen
+        break;
+    }
+
+    return str;
+}
+
 QTypedArrayData<char> *Buffer::fromString(const QByteArray &data)
 {
     QTypedArrayData<char> *arrayData = QTypedArrayData<char>::allocate(data.size() + 1);
@@ -509,6 +703,36 @@ void BufferPrototype::init(QV4::ExecutionEngine *v4, QV4::Object *ctor)
     defineDefaultProperty(QStringLiteral("writeDoubleLE"), method_writeFloatingPoint<double>);
     defineDefaultProperty(QStringLiteral("writeDoubleBE"), method_writeFloatingPoint<double, false>);
 
+    defineDefaultProperty(QStringLiteral("readInt8Array"), method_readArray<qint8>, 2);
+    defineDefaultProperty(QStringLiteral("readUInt8Array"), method_readArray<quint8>, 2);
+    defineDefaultProperty(QStringLiteral("readInt16LEArray"), method_readArray<qint16>, 2);
+    defineDefaultProperty(QStringLiteral("readInt16BEArray"), method_readArray<qint16, false>, 2);
+    defineDefaultProperty(QStringLiteral("readUInt16LEArray"), method_readArray<quint16>, 2);
+    defineDefaultProperty(QStringLiteral("readUInt16BEArray"), method_readArray<quint16, false>, 2);
+    defineDefaultProperty(QStringLiteral("readInt32LEArray"), method_readArray<qint32>, 2);
+    defineDefaultProperty(QStringLiteral("readInt32BEArray"), method_readArray<qint32, false>, 2);
+    defineDefaultProperty(QStringLiteral("readUInt32LEArray"), method_readArray<quint32>, 2);
+    defineDefaultProperty(QStringLiteral("readUInt32BEArray"), method_readArray<quint32, false>, 2);
+    defineDefaultProperty(QStringLiteral("readFloatLEArray"), method_readArray<float>, 2);
+    defineDefaultProperty(QStringLiteral("readFloatBEArray"), method_readArray<float, false>, 2);
+    defineDefaultProperty(QStringLiteral("readDoubleLEArray"), method_readArray<double>, 2);
+    defineDefaultProperty(QStringLiteral("readDoubleBEArray"), method_readArray<double, false>, 2);
+
+    defineDefaultProperty(QStringLiteral("writeInt8Array"), method_writeArray<qint8>, 2);
+    defineDefaultProperty(QStringLiteral("writeUInt8Array"), method_writeArray<quint8>, 2);
+    defineDefaultProperty(QStringLiteral("writeInt16LEArray"), method_writeArray<qint16>, 2);
+    defineDefaultProperty(QStringLiteral("writeInt16BEArray"), method_writeArray<qint16, false>, 2);
+    defineDefaultProperty(QStringLiteral("writeUInt16LEArray"), method_writeArray<quint16>, 2);
+    defineDefaultProperty(QStringLiteral("writeUInt16BEArray"), method_writeArray<quint16, false>, 2);
+    defineDefaultProperty(QStringLiteral("writeInt32LEArray"), method_writeArray<qint32>, 2);
+    defineDefaultProperty(QStringLiteral("writeInt32BEArray"), method_writeArray<qint32, false>, 2);
+    defineDefaultProperty(QStringLiteral("writeUInt32LEArray"), method_writeArray<quint32>, 2);
+    defineDefaultProperty(QStringLiteral("writeUInt32BEArray"), method_writeArray<quint32, false>, 2);
+    defineDefaultProperty(QStringLiteral("writeFloatLEArray"), method_writeArray<float>, 2);
+    defineDefaultProperty(QStringLiteral("writeFloatBEArray"), method_writeArray<float, false>, 2);
+    defineDefaultProperty(QStringLiteral("writeDoubleLEArray"), method_writeArray<double>, 2);
+    defineDefaultProperty(QStringLiteral("writeDoubleBEArray"), method_writeArray<double, false>, 2);
+
     v4->globalObject()->defineDefaultProperty(QStringLiteral("Buffer"), (o = ctor));
     v4->globalObject()->defineDefaultProperty(QStringLiteral("SlowBuffer"), (o = ctor));
 }
@@ -532,12 +756,55 @@ int BufferPrototype::compare(const QTypedArrayDataSlice<char> &a, const QTypedAr
 
 bool BufferPrototype::checkRange(size_t bufferSize, size_t offset, size_t length)
 {
-    return offset < kMaxLength
-            && length < kMaxLength
-            && offset + length < kMaxLength
+    return offset < kMaxBufferLength
+            && length < kMaxBufferLength
+            && offset + length < kMaxBufferLength
             && offset + length <= bufferSize;
 }
 
+/*!
+  \internal
+  Fills \a length bytes at \a dst with repetitions of \a pattern. Single byte patterns go straight
+  to memset, patterns dividing 8 bytes are stored a machine word at a time, everything else is
+  replicated with doubling memcpy() rounds. \a pattern must not overlap \a dst.
+ */
+void BufferPrototype::fillPattern(char *dst, size_t length, const char *pattern, size_t patternLength)
+{
+    if (!length || !patternLength)
+        return;
+
+    if (patternLength == 1) {
+        ::memset(dst, *pattern, length);
+        return;
+    }
+
+    if (patternLength >= length) {
+        ::memcpy(dst, pattern, length);
+        return;
+    }
+
+    if (8 % patternLength == 0) {
+        quint64 word;
+        for (size_t i = 0; i < sizeof(word); i += patternLength)
+            ::memcpy(reinterpret_cast<char *>(&word) + i, pattern, patternLength);
+
+        char *ptr = dst;
+        char * const wordsEnd = dst + (length & ~size_t(7));
+        for (; ptr < wordsEnd; ptr += sizeof(word))
+            ::memcpy(ptr, &word, sizeof(word));
+        ::memcpy(ptr, &word, length & 7);
+        return;
+    }
+
+    ::memcpy(dst, pattern, patternLength);
+    size_t filled = patternLength;
+    while (filled <= length - filled) {
+        ::memcpy(dst + filled, dst, filled);
+        filled *= 2;
+    }
+    ::memcpy(dst + filled, dst, length - filled);
+}
+
 QV4::ReturnedValue BufferPrototype::method_inspect(QV4::CallContext *ctx)
 {
     NODE_CTX_SELF(Buffer, ctx);
@@ -683,39 +950,7 @@ QV4::ReturnedValue BufferPrototype::method_toString(QV4::CallContext *ctx)
     if (end <= start)
         return QV4::ScopedString(scope, v4->newString()).asReturnedValue();
 
-    const char *startPtr = self->d()->data.data() + start;
-    const int size = end - start;
-
-    const QByteArray data = QByteArray::fromRawData(startPtr, size);
-    QString str;
-
-    switch (encoding) {
-    case BufferEncoding::Ascii:
-    case BufferEncoding::Binary:
-    case BufferEncoding::Raw: {
-        // Node.js just masks off the highest bit
-        for (int i = 0; i < data.size(); ++i)
-            str.append(data[i] & 0x7f);
-        break;
-    }
-    case BufferEncoding::Base64:
-        str = data.toBase64();
-        break;
-    case BufferEncoding::Hex:
-        str = data.toHex();
-        break;
-    case BufferEncoding::Ucs2:
-    case BufferEncoding::Utf16le:
-        str = QString::fromUtf16(reinterpret_cast<const ushort *>(startPtr), size >> 1);
-        break;
-    case BufferEncoding::Utf8:
-        str = QString::fromUtf8(data);
-        break;
-    case BufferEncoding::Invalid:
-        // Should never happen
-        break;
-    }
-
+    const QString str = Buffer::encodeData(self->d()->data.constData() + start, end - start, encoding);
     return v4->newString(str)->asReturnedValue();
 }
 
@@ -793,71 +1028,108 @@ QV4::ReturnedValue BufferPrototype::method_copy(QV4::CallContext *ctx)
     return QV4::Primitive::fromUInt32(to_copy).asReturnedValue();
 }
 
-// fill(value, [offset], [end])
+// fill(value, [offset], [end], [encoding])
 QV4::ReturnedValue BufferPrototype::method_fill(QV4::CallContext *ctx)
 {
     NODE_CTX_CALLDATA(ctx);
     NODE_CTX_SELF(Buffer, ctx);
     NODE_CTX_V4(ctx);
 
-    /// TODO: SLICE_START_END (https://github.com/joyent/node/blob/master/src/node_buffer.cc#L52)
+    if (!self)
+        return v4->throwTypeError();
 
     int offset = 0;
     int end = self->d()->data.size();
+    QString encodingStr;
 
     if (!callData->argc)
         return self.asReturnedValue();
 
-    if (callData->argc > 1) {
-        if (!callData->args[1].isNumber())
-            return v4->throwTypeError(QStringLiteral("Bad argument"));
-        offset = callData->args[1].toInt32();
-        if (offset < 0)
-            return v4->throwRangeError(QStringLiteral("Out of range index"));
-    }
+    // Buffer#fill(value, encoding)
+    if (callData->argc == 2 && callData->args[1].isString()) {
+        encodingStr = callData->args[1].toQString();
+    } else {
+        if (callData->argc > 1 && !callData->args[1].isUndefined()) {
+            if (!callData->args[1].isNumber())
+                return v4->throwTypeError(QStringLiteral("Bad argument"));
+            offset = callData->args[1].toInt32();
+            if (offset < 0)
+                return v4->throwRangeError(QStringLiteral("Out of range index"));
+        }
 
-    if (callData->argc > 2) {
-        if (!callData->args[2].isNumber())
-            return v4->throwTypeError(QStringLiteral("Bad argument"));
-        end = callData->args[2].toInt32();
-        if (end < 0)
-            return v4->throwRangeError(QStringLiteral("Out of range index"));
+        if (callData->argc > 2 && !callData->args[2].isUndefined()) {
+            if (!callData->args[2].isNumber())
+                return v4->throwTypeError(QStringLiteral("Bad argument"));
+            end = callData->args[2].toInt32();
+            if (end < 0 || end > self->d()->data.size())
+                return v4->throwRangeError(QStringLiteral("Out of range index"));
+        }
+
+        if (callData->argc > 3 && !callData->args[3].isUndefined())
+            encodingStr = callData->args[3].toQStringNoThrow();
     }
 
-    const int length = end - offset;
+    if (end <= offset)
+        return self.asReturnedValue();
+
+    const size_t length = end - offset;
     char * const startPtr = self->d()->data.data() + offset;
 
     if (callData->args[0].isNumber()) {
-        const quint8 value = callData->args[0].toUInt32() & 0xff;
-        ::memset(startPtr, value, length);
+        ::memset(startPtr, callData->args[0].toUInt32() & 0xff, length);
+        return self.asReturnedValue();
+    }
+
+    if (callData->args[0].as<Buffer>()) {
+        QV4::Scoped<Buffer> pattern(scope, callData->args[0].as<Buffer>());
+        const char *patternPtr = pattern->d()->data.constData();
+        const size_t patternLength = pattern->d()->data.size();
+        if (!patternLength)
+            return v4->throwTypeError(QStringLiteral("fill: The argument 'value' is invalid"));
+
+        // Slices may share storage with the target range
+        if (patternPtr < startPtr + length && startPtr < patternPtr + patternLength) {
+            QVarLengthArray<char, 256> copy(patternLength);
+            ::memcpy(copy.data(), patternPtr, patternLength);
+            fillPattern(startPtr, length, copy.constData(), patternLength);
+        } else {
+            fillPattern(startPtr, length, patternPtr, patternLength);
+        }
         return self.asReturnedValue();
     }
 
     if (!callData->args[0].isString())
         return v4->throwTypeError(QStringLiteral("fill: value is not a number"));
 
-    const QByteArray value = callData->args[0].toQString().toUtf8();
+    BufferEncoding encoding = BufferEncoding::Utf8;
+    if (!encodingStr.isEmpty()) {
+        encoding = Buffer::parseEncoding(encodingStr);
+        if (encoding == BufferEncoding::Invalid)
+            return v4->throwTypeError(QString("Unknown encoding: %1").arg(encodingStr));
+    }
 
-    // optimize single ascii character case
-    if (value.size() == 1) {
-        ::memset(startPtr, value.at(0), length);
+    const QString value = callData->args[0].toQString();
+
+    // As in Node, an empty string zero-fills
+    if (value.isEmpty()) {
+        ::memset(startPtr, 0, length);
         return self.asReturnedValue();
     }
 
-    int in_there = value.size();
-    char * ptr = startPtr + value.size();
-    ::memcpy(startPtr, value.constData(), std::min(value.size(), length));
-    if (value.size() >= length)
+    // Single ASCII character is the most common case
+    if (value.size() == 1 && value.at(0).unicode() < 0x80
+            && (encoding == BufferEncoding::Utf8 || encoding == BufferEncoding::Ascii
+                || encoding == BufferEncoding::Binary || encoding == BufferEncoding::Raw)) {
+        ::memset(startPtr, value.at(0).cell(), length);
         return self.asReturnedValue();
-
-    while (in_there < length - in_there) {
-        ::memcpy(ptr, startPtr, in_there);
-        ptr += in_there;
-        in_there *= 2;
     }
 
-    if (in_there < length)
-        ::memcpy(ptr, startPtr, length - in_there);
+    QVarLengthArray<char, 256> pattern(Buffer::maxDecodedLength(value, encoding));
+    const int patternLength = Buffer::decodeStringInto(value, encoding, pattern.data(), pattern.size());
+    // E.g. invalid hex or base64, which would leave the buffer untouched
+    if (patternLength <= 0)
+        return v4->throwTypeError(QStringLiteral("fill: The argument 'value' is invalid"));
+    fillPattern(startPtr, length, pattern.constData(), patternLength);
 
     return self.asReturnedValue();
 }
@@ -893,6 +1165,14 @@ QV4::ReturnedValue BufferPrototype::method_slice(QV4::CallContext *ctx)
 
     QTypedArrayDataSlice<char> slice(self->d()->data, start, end - start);
     QV4::Scoped<Buffer> newBuffer(scope, v4->memoryManager->alloc<Buffer>(v4, slice));
+
+    EnginePrivate *engine = EnginePrivate::get(v4);
+    const int allocatedSize = slice.allocatedSize();
+    if (engine->sliceCompactionMinSize > 0 && allocatedSize >= engine->sliceCompactionMinSize
+            && slice.size() <= allocatedSize * engine->sliceCompactionRatio) {
+        engine->addCompactionCandidate(newBuffer->d());
+    }
+
     return newBuffer.asReturnedValue();
 }
 
@@ -1028,3 +1308,226 @@ QV4::ReturnedValue BufferPrototype::method_writeFloatingPoint(QV4::CallContext *
 
     return QV4::Encode(static_cast<uint>(offset + sizeof(T)));
 }
+
+namespace {
+
+template <int Size> struct RawType;
+template <> struct RawType<1> { typedef quint8 Type; };
+template <> struct RawType<2> { typedef quint16 Type; };
+template <> struct RawType<4> { typedef quint32 Type; };
+template <> struct RawType<8> { typedef quint64 Type; };
+
+template <typename T> struct TypedArrayType;
+template <> struct TypedArrayType<qint8> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::Int8Array; };
+template <> struct TypedArrayType<quint8> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::UInt8Array; };
+template <> struct TypedArrayType<qint16> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::Int16Array; };
+template <> struct TypedArrayType<quint16> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::UInt16Array; };
+template <> struct TypedArrayType<qint32> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::Int32Array; };
+template <> struct TypedArrayType<quint32> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::UInt32Array; };
+template <> struct TypedArrayType<float> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::Float32Array; };
+template <> struct TypedArrayType<double> { static const QV4::Heap::TypedArray::Type value = QV4::Heap::TypedArray::Float64Array; };
+
+inline QV4::Primitive toPrimitive(qint8 value) { return QV4::Primitive::fromInt32(value); }
+inline QV4::Primitive toPrimitive(quint8 value) { return QV4::Primitive::fromInt32(value); }
+inline QV4::Primitive toPrimitive(qint16 value) { return QV4::Primitive::fromInt32(value); }
+inline QV4::Primitive toPrimitive(quint16 value) { return QV4::Primitive::fromInt32(value); }
+inline QV4::Primitive toPrimitive(qint32 value) { return QV4::Primitive::fromInt32(value); }
+inline QV4::Primitive toPrimitive(quint32 value) { return QV4::Primitive::fromUInt32(value); }
+inline QV4::Primitive toPrimitive(float value) { return QV4::Primitive::fromDouble(value); }
+inline QV4::Primitive toPrimitive(double value) { return QV4::Primitive::fromDouble(value); }
+
+inline bool isHostByteOrder(bool littleEndian)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return littleEndian;
+#else
+    return !littleEndian;
+#endif
+}
+
+/*
+  Converts count elements between buffer and native byte order. The loop body is a load, a byte
+  swap and a store of a fixed-width integer, which the compiler turns into vector shuffles.
+ */
+template <typename T, bool LE>
+void copyElements(T *dst, const char *src, size_t count)
+{
+    typedef typename RawType<sizeof(T)>::Type Raw;
+
+    if (sizeof(T) == 1 || isHostByteOrder(LE)) {
+        ::memcpy(dst, src, count * sizeof(T));
+        return;
+    }
+
+    Raw *out = reinterpret_cast<Raw *>(dst);
+    for (size_t i = 0; i < count; ++i) {
+        Raw raw;
+        ::memcpy(&raw, src + i * sizeof(T), sizeof(raw));
+        out[i] = qbswap(raw);
+    }
+}
+
+template <typename T, bool LE>
+void copyElements(char *dst, const T *src, size_t count)
+{
+    typedef typename RawType<sizeof(T)>::Type Raw;
+
+    if (sizeof(T) == 1 || isHostByteOrder(LE)) {
+        ::memcpy(dst, src, count * sizeof(T));
+        return;
+    }
+
+    const Raw *in = reinterpret_cast<const Raw *>(src);
+    for (size_t i = 0; i < count; ++i) {
+        const Raw raw = qbswap(in[i]);
+        ::memcpy(dst + i * sizeof(T), &raw, sizeof(raw));
+    }
+}
+
+template <typename T, bool LE>
+inline T loadElement(const char *src)
+{
+    T value;
+    copyElements<T, LE>(&value, src, 1);
+    return value;
+}
+
+template <typename T>
+inline T *typedArrayData(QV4::TypedArray *array)
+{
+    return reinterpret_cast<T *>(array->d()->buffer->data->data() + array->d()->byteOffset);
+}
+
+// Offsets and counts must be non-negative integers, anything else would not convert to size_t
+bool toIndex(const QV4::Value &value, size_t *index)
+{
+    const double number = value.toNumber();
+    if (!(number >= 0 && number <= kMaxBufferLength) || number != std::floor(number))
+        return false;
+    *index = static_cast<size_t>(number);
+    return true;
+}
+
+// Compares count against the elements left after offset, as count * sizeof(T) could wrap
+template <typename T>
+inline bool elementsFit(size_t bufferSize, size_t offset, size_t count)
+{
+    return offset <= bufferSize && count <= (bufferSize - offset) / sizeof(T);
+}
+
+} // namespace
+
+// readXXXArray(offset, count, [target])
+template <typename T, bool LE>
+QV4::ReturnedValue BufferPrototype::method_readArray(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(Buffer, ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    const size_t size = self->d()->data.size();
+    size_t offset = 0;
+    if (callData->argc && callData->args[0].isNumber() && !toIndex(callData->args[0], &offset))
+        return v4->throwRangeError(QStringLiteral("offset must be a non-negative integer"));
+    if (offset > size)
+        return v4->throwRangeError(QStringLiteral("index out of range"));
+
+    size_t count = (size - offset) / sizeof(T);
+    if (callData->argc > 1 && callData->args[1].isNumber()) {
+        if (!toIndex(callData->args[1], &count))
+            return v4->throwRangeError(QStringLiteral("count must be a non-negative integer"));
+        if (!elementsFit<T>(size, offset, count))
+            return v4->throwRangeError(QStringLiteral("index out of range"));
+    }
+
+    QV4::Scoped<QV4::TypedArray> typedArray(scope, callData->argument(2));
+    if (typedArray) {
+        if (typedArray->d()->arrayType != TypedArrayType<T>::value)
+            return v4->throwTypeError(QStringLiteral("target has a wrong element type"));
+        if (typedArray->d()->byteLength < count * sizeof(T))
+            return v4->throwRangeError(QStringLiteral("target is too small"));
+
+        copyElements<T, LE>(typedArrayData<T>(typedArray.getPointer()),
+                            self->d()->data.constData() + offset, count);
+        return typedArray.asReturnedValue();
+    }
+
+    QV4::ScopedArrayObject array(scope, callData->argument(2));
+    if (!array)
+        array = v4->newArrayObject();
+
+    // Growing the array allocates on the JS heap, so the source is looked up for every element
+    // rather than held across the allocations
+    array->arrayReserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const char *src = self->d()->data.constData() + offset;
+        array->arrayPut(i, toPrimitive(loadElement<T, LE>(src + i * sizeof(T))));
+    }
+    if (array->getLength() < count)
+        array->setArrayLengthUnchecked(count);
+
+    return array.asReturnedValue();
+}
+
+// writeXXXArray(values, [offset])
+template <typename T, bool LE>
+QV4::ReturnedValue BufferPrototype::method_writeArray(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_CALLDATA(ctx);
+    NODE_CTX_SELF(Buffer, ctx);
+
+    if (!self)
+        return v4->throwTypeError();
+
+    QV4::ScopedObject values(scope, callData->argument(0));
+    if (!values)
+        return v4->throwTypeError(QStringLiteral("values must be an array or a typed array"));
+
+    size_t offset = 0;
+    if (callData->argc > 1 && callData->args[1].isNumber() && !toIndex(callData->args[1], &offset))
+        return v4->throwRangeError(QStringLiteral("offset must be a non-negative integer"));
+
+    QV4::Scoped<QV4::TypedArray> typedArray(scope, values);
+    const size_t count = typedArray && typedArray->d()->arrayType == TypedArrayType<T>::value
+            ? typedArray->d()->byteLength / sizeof(T) : values->getLength();
+
+    if (!elementsFit<T>(self->d()->data.size(), offset, count))
+        return v4->throwRangeError(QStringLiteral("index out of range"));
+
+    if (typedArray && typedArray->d()->arrayType == TypedArrayType<T>::value) {
+        copyElements<T, LE>(self->d()->data.data() + offset,
+                            typedArrayData<T>(typedArray.getPointer()), count);
+        return QV4::Encode(static_cast<uint>(offset + count * sizeof(T)));
+    }
+
+    // Getters and valueOf() may run JS code and throw, so every element is converted and checked
+    // before the buffer is touched
+    QVarLengthArray<T, 256> converted(count);
+    QV4::ScopedValue v(scope);
+    for (size_t i = 0; i < count; ++i) {
+        v = values->getIndexed(i);
+        if (v4->hasException)
+            return QV4::Encode::undefined();
+        double value = v->toNumber();
+        if (v4->hasException)
+            return QV4::Encode::undefined();
+        if (std::numeric_limits<T>::is_integer) {
+            if (std::isnan(value))
+                value = 0;
+            else if (value < std::numeric_limits<T>::lowest() || value > std::numeric_limits<T>::max())
+                return v4->throwRangeError(QStringLiteral("value is out of bounds"));
+        }
+        converted[i] = static_cast<T>(value);
+    }
+
+    // A getter may have transferred the buffer to a worker, which empties it
+    if (!elementsFit<T>(self->d()->data.size(), offset, count))
+        return v4->throwRangeError(QStringLiteral("index out of range"));
+    copyElements<T, LE>(self->d()->data.data() + offset, converted.constData(), count);
+
+    return QV4::Encode(static_cast<uint>(offset + count * sizeof(T)));
+}
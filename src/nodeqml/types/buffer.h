@@ -9,6 +9,10 @@
 
 namespace NodeQml {
 
+/// NOTE: This is a result of V8 memory allocation limitations. It would make sense to lift
+/// such limit in the future.
+const size_t kMaxBufferLength = 0x3fffffff;
+
 enum class BufferEncoding {
     Invalid,
     Ascii,
@@ -43,6 +47,7 @@ struct Buffer : QV4::Object
 {
     NODE_V4_OBJECT(Buffer, Object)
 
+    static void destroy(QV4::Heap::Base *that);
     static bool isEqualTo(QV4::Managed *m, QV4::Managed *other);
 
     static QV4::ReturnedValue getIndexed(QV4::Managed *m, quint32 index, bool *hasProperty);
@@ -53,7 +58,11 @@ struct Buffer : QV4::Object
     static bool isEncoding(const QString &str);
     static int byteLength(const QString &str, BufferEncoding encoding);
     static QByteArray decodeString(const QString &str, BufferEncoding encoding, int limit = -1);
+    static int decodeStringInto(const QString &str, BufferEncoding encoding, char *dst, int capacity);
+    static int maxDecodedLength(const QString &str, BufferEncoding encoding);
+    static QString encodeData(const char *data, int size, BufferEncoding encoding);
     static QTypedArrayData<char> *fromString(const QByteArray &data);
+    static void neuter(QV4::ExecutionEngine *v4, Heap::Buffer *buffer);
 };
 
 struct BufferCtor : QV4::FunctionObject
@@ -76,6 +85,7 @@ struct BufferPrototype : QV4::Object
 
     static int compare(const QTypedArrayDataSlice<char> &a, const QTypedArrayDataSlice<char> &b);
     static inline bool checkRange(size_t bufferSize, size_t offset, size_t length = 0);
+    static void fillPattern(char *dst, size_t length, const char *pattern, size_t patternLength);
 
     static QV4::ReturnedValue method_inspect(QV4::CallContext *ctx);
 
@@ -101,6 +111,12 @@ struct BufferPrototype : QV4::Object
 
     template <typename T, bool LE = true>
     static QV4::ReturnedValue method_writeFloatingPoint(QV4::CallContext *ctx);
+
+    template <typename T, bool LE = true>
+    static QV4::ReturnedValue method_readArray(QV4::CallContext *ctx);
+
+    template <typename T, bool LE = true>
+    static QV4::ReturnedValue method_writeArray(QV4::CallContext *ctx);
 };
 
 } // namespace NodeQml
@@ -0,0 +1,105 @@
+#include "direntry.h"
+
+#include "../engine_p.h"
+
+#include <private/qv4context_p.h>
+
+#include <dirent.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(Dirent);
+
+Heap::Dirent::Dirent(QV4::ExecutionEngine *v4, const QString &name, const QString &parentPath,
+                     unsigned char type) :
+    QV4::Heap::Object(v4),
+    name(name),
+    parentPath(parentPath),
+    type(type)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject proto(scope, EnginePrivate::get(v4)->direntPrototype);
+    self->setPrototype(proto);
+}
+
+void Dirent::destroy(QV4::Heap::Base *that)
+{
+    static_cast<Heap::Dirent *>(that)->~Dirent();
+}
+
+void DirentPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("isFile"), method_isFile);
+    defineDefaultProperty(QStringLiteral("isDirectory"), method_isDirectory);
+    defineDefaultProperty(QStringLiteral("isBlockDevice"), method_isBlockDevice);
+    defineDefaultProperty(QStringLiteral("isCharacterDevice"), method_isCharacterDevice);
+    defineDefaultProperty(QStringLiteral("isSymbolicLink"), method_isSymbolicLink);
+    defineDefaultProperty(QStringLiteral("isFIFO"), method_isFIFO);
+    defineDefaultProperty(QStringLiteral("isSocket"), method_isSocket);
+
+    defineAccessorProperty(QStringLiteral("name"), property_name_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("parentPath"), property_parentPath_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("path"), property_parentPath_getter, nullptr);
+}
+
+bool DirentPrototype::isType(QV4::CallContext *ctx, unsigned char type)
+{
+    NODE_CTX_SELF(Dirent, ctx);
+    return self && self->d()->type == type;
+}
+
+QV4::ReturnedValue DirentPrototype::method_isFile(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_REG));
+}
+
+QV4::ReturnedValue DirentPrototype::method_isDirectory(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_DIR));
+}
+
+QV4::ReturnedValue DirentPrototype::method_isBlockDevice(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_BLK));
+}
+
+QV4::ReturnedValue DirentPrototype::method_isCharacterDevice(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_CHR));
+}
+
+QV4::ReturnedValue DirentPrototype::method_isSymbolicLink(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_LNK));
+}
+
+QV4::ReturnedValue DirentPrototype::method_isFIFO(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_FIFO));
+}
+
+QV4::ReturnedValue DirentPrototype::method_isSocket(QV4::CallContext *ctx)
+{
+    return QV4::Encode(isType(ctx, DT_SOCK));
+}
+
+QV4::ReturnedValue DirentPrototype::property_name_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(Dirent, ctx);
+    if (!self)
+        return v4->throwTypeError();
+    return v4->newString(self->d()->name)->asReturnedValue();
+}
+
+QV4::ReturnedValue DirentPrototype::property_parentPath_getter(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    NODE_CTX_SELF(Dirent, ctx);
+    if (!self)
+        return v4->throwTypeError();
+    return v4->newString(self->d()->parentPath)->asReturnedValue();
+}
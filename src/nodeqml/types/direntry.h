@@ -0,0 +1,51 @@
+#ifndef DIRENTRY_H
+#define DIRENTRY_H
+
+#include "../v4integration.h"
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+namespace Heap {
+
+struct Dirent : QV4::Heap::Object {
+    Dirent(QV4::ExecutionEngine *v4, const QString &name, const QString &parentPath,
+           unsigned char type);
+
+    QString name;
+    QString parentPath;
+    unsigned char type; // DT_* value of the entry
+};
+
+} // namespace Heap
+
+struct Dirent : QV4::Object
+{
+    NODE_V4_OBJECT(Dirent, Object)
+
+    static void destroy(QV4::Heap::Base *that);
+};
+
+struct DirentPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue method_isFile(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isDirectory(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isBlockDevice(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isCharacterDevice(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isSymbolicLink(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isFIFO(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isSocket(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue property_name_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_parentPath_getter(QV4::CallContext *ctx);
+
+private:
+    static bool isType(QV4::CallContext *ctx, unsigned char type);
+};
+
+} // namespace NodeQml
+
+#endif // DIRENTRY_H
@@ -0,0 +1,255 @@
+#include "stats.h"
+
+#include "../engine_p.h"
+
+#include <QDateTime>
+
+#include <private/qv4context_p.h>
+#include <private/qv4dateobject_p.h>
+
+using namespace NodeQml;
+
+DEFINE_OBJECT_VTABLE(Stats);
+
+namespace {
+inline double toMsecs(const struct timespec &ts)
+{
+    return double(ts.tv_sec) * 1000 + double(ts.tv_nsec) / 1000000;
+}
+
+QV4::ReturnedValue newDate(QV4::ExecutionEngine *v4, const struct timespec &ts)
+{
+    const qint64 msecs = qint64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    return v4->newDateObject(QDateTime::fromMSecsSinceEpoch(msecs))->asReturnedValue();
+}
+}
+
+Heap::Stats::Stats(QV4::ExecutionEngine *v4, const struct stat &st) :
+    QV4::Heap::Object(v4),
+    st(st)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject self(scope, this);
+    QV4::ScopedObject proto(scope, EnginePrivate::get(v4)->statsPrototype);
+    self->setPrototype(proto);
+}
+
+void Stats::markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e)
+{
+    Heap::Stats *stats = static_cast<Heap::Stats *>(that);
+    if (stats->atime)
+        stats->atime->mark(e);
+    if (stats->mtime)
+        stats->mtime->mark(e);
+    if (stats->ctime)
+        stats->ctime->mark(e);
+
+    QV4::Object::markObjects(that, e);
+}
+
+void StatsPrototype::init(QV4::ExecutionEngine *v4)
+{
+    Q_UNUSED(v4)
+
+    defineDefaultProperty(QStringLiteral("isFile"), method_isFile);
+    defineDefaultProperty(QStringLiteral("isDirectory"), method_isDirectory);
+    defineDefaultProperty(QStringLiteral("isBlockDevice"), method_isBlockDevice);
+    defineDefaultProperty(QStringLiteral("isCharacterDevice"), method_isCharacterDevice);
+    defineDefaultProperty(QStringLiteral("isSymbolicLink"), method_isSymbolicLink);
+    defineDefaultProperty(QStringLiteral("isFIFO"), method_isFIFO);
+    defineDefaultProperty(QStringLiteral("isSocket"), method_isSocket);
+    defineDefaultProperty(QStringLiteral("toJSON"), method_toJSON);
+
+    defineAccessorProperty(QStringLiteral("dev"), property_dev_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("ino"), property_ino_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("mode"), property_mode_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("nlink"), property_nlink_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("uid"), property_uid_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("gid"), property_gid_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("rdev"), property_rdev_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("size"), property_size_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("blksize"), property_blksize_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("blocks"), property_blocks_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("atimeMs"), property_atimeMs_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("mtimeMs"), property_mtimeMs_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("ctimeMs"), property_ctimeMs_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("atime"), property_atime_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("mtime"), property_mtime_getter, nullptr);
+    defineAccessorProperty(QStringLiteral("ctime"), property_ctime_getter, nullptr);
+}
+
+/*!
+  \internal
+  Returns a Stats object keeping \a st as is. Fields are converted on access, and the Date objects
+  of atime, mtime and ctime are only created when read.
+*/
+QV4::ReturnedValue StatsPrototype::create(QV4::ExecutionEngine *v4, const struct stat &st)
+{
+    return v4->memoryManager->alloc<Stats>(v4, st)->asReturnedValue();
+}
+
+/*!
+  \internal
+  Returns the fields of \a st as a plain array of numbers, for callers that need no methods and
+  no Date objects: [dev, ino, mode, nlink, uid, gid, rdev, size, blksize, blocks, atimeMs,
+  mtimeMs, ctimeMs].
+*/
+QV4::ReturnedValue StatsPrototype::createCompact(QV4::ExecutionEngine *v4, const struct stat &st)
+{
+    const double values[] = {
+        double(st.st_dev), double(st.st_ino), double(st.st_mode), double(st.st_nlink),
+        double(st.st_uid), double(st.st_gid), double(st.st_rdev), double(st.st_size),
+        double(st.st_blksize), double(st.st_blocks),
+        toMsecs(st.st_atim), toMsecs(st.st_mtim), toMsecs(st.st_ctim)
+    };
+    const uint count = sizeof(values) / sizeof(values[0]);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject array(scope, v4->newArrayObject());
+    array->arrayReserve(count);
+    for (uint i = 0; i < count; ++i)
+        array->arrayPut(i, QV4::Primitive::fromDouble(values[i]));
+    array->setArrayLengthUnchecked(count);
+    return array.asReturnedValue();
+}
+
+const struct stat *StatsPrototype::statBuf(QV4::CallContext *ctx)
+{
+    NODE_CTX_SELF(Stats, ctx);
+    return self ? &self->d()->st : nullptr;
+}
+
+QV4::ReturnedValue StatsPrototype::date(QV4::CallContext *ctx, const struct timespec &ts,
+                                        QV4::Heap::Object *Heap::Stats::*cache)
+{
+    NODE_CTX_SELF(Stats, ctx);
+    if (!(self->d()->*cache)) {
+        QV4::ScopedObject dateObject(scope, newDate(ctx->engine(), ts));
+        self->d()->*cache = dateObject->d();
+    }
+    return (self->d()->*cache)->asReturnedValue();
+}
+
+#define STATS_GETTER(name, expression) \
+    QV4::ReturnedValue StatsPrototype::property_##name##_getter(QV4::CallContext *ctx) \
+    { \
+        const struct stat *st = statBuf(ctx); \
+        if (!st) \
+            return ctx->engine()->throwTypeError(); \
+        return QV4::Encode(expression); \
+    }
+
+STATS_GETTER(dev, double(st->st_dev))
+STATS_GETTER(ino, double(st->st_ino))
+STATS_GETTER(mode, uint(st->st_mode))
+STATS_GETTER(nlink, double(st->st_nlink))
+STATS_GETTER(uid, uint(st->st_uid))
+STATS_GETTER(gid, uint(st->st_gid))
+STATS_GETTER(rdev, double(st->st_rdev))
+STATS_GETTER(size, double(st->st_size))
+STATS_GETTER(blksize, double(st->st_blksize))
+STATS_GETTER(blocks, double(st->st_blocks))
+STATS_GETTER(atimeMs, toMsecs(st->st_atim))
+STATS_GETTER(mtimeMs, toMsecs(st->st_mtim))
+STATS_GETTER(ctimeMs, toMsecs(st->st_ctim))
+
+#undef STATS_GETTER
+
+QV4::ReturnedValue StatsPrototype::property_atime_getter(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    if (!st)
+        return ctx->engine()->throwTypeError();
+    return date(ctx, st->st_atim, &Heap::Stats::atime);
+}
+
+QV4::ReturnedValue StatsPrototype::property_mtime_getter(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    if (!st)
+        return ctx->engine()->throwTypeError();
+    return date(ctx, st->st_mtim, &Heap::Stats::mtime);
+}
+
+QV4::ReturnedValue StatsPrototype::property_ctime_getter(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    if (!st)
+        return ctx->engine()->throwTypeError();
+    return date(ctx, st->st_ctim, &Heap::Stats::ctime);
+}
+
+/*!
+  \internal
+  Fields live on the prototype, so JSON.stringify() needs them collected into a plain object.
+*/
+QV4::ReturnedValue StatsPrototype::method_toJSON(QV4::CallContext *ctx)
+{
+    NODE_CTX_V4(ctx);
+    const struct stat *st = statBuf(ctx);
+    if (!st)
+        return v4->throwTypeError();
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, v4->newObject());
+    QV4::ScopedValue v(scope);
+    o->defineDefaultProperty(QStringLiteral("dev"), QV4::Primitive::fromDouble(st->st_dev));
+    o->defineDefaultProperty(QStringLiteral("mode"), QV4::Primitive::fromUInt32(st->st_mode));
+    o->defineDefaultProperty(QStringLiteral("nlink"), QV4::Primitive::fromDouble(st->st_nlink));
+    o->defineDefaultProperty(QStringLiteral("uid"), QV4::Primitive::fromUInt32(st->st_uid));
+    o->defineDefaultProperty(QStringLiteral("gid"), QV4::Primitive::fromUInt32(st->st_gid));
+    o->defineDefaultProperty(QStringLiteral("rdev"), QV4::Primitive::fromDouble(st->st_rdev));
+    o->defineDefaultProperty(QStringLiteral("blksize"), QV4::Primitive::fromDouble(st->st_blksize));
+    o->defineDefaultProperty(QStringLiteral("ino"), QV4::Primitive::fromDouble(st->st_ino));
+    o->defineDefaultProperty(QStringLiteral("size"), QV4::Primitive::fromDouble(st->st_size));
+    o->defineDefaultProperty(QStringLiteral("blocks"), QV4::Primitive::fromDouble(st->st_blocks));
+    o->defineDefaultProperty(QStringLiteral("atimeMs"), QV4::Primitive::fromDouble(toMsecs(st->st_atim)));
+    o->defineDefaultProperty(QStringLiteral("mtimeMs"), QV4::Primitive::fromDouble(toMsecs(st->st_mtim)));
+    o->defineDefaultProperty(QStringLiteral("ctimeMs"), QV4::Primitive::fromDouble(toMsecs(st->st_ctim)));
+    o->defineDefaultProperty(QStringLiteral("atime"), (v = property_atime_getter(ctx)));
+    o->defineDefaultProperty(QStringLiteral("mtime"), (v = property_mtime_getter(ctx)));
+    o->defineDefaultProperty(QStringLiteral("ctime"), (v = property_ctime_getter(ctx)));
+    return o.asReturnedValue();
+}
+
+QV4::ReturnedValue StatsPrototype::method_isFile(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISREG(st->st_mode));
+}
+
+QV4::ReturnedValue StatsPrototype::method_isDirectory(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISDIR(st->st_mode));
+}
+
+QV4::ReturnedValue StatsPrototype::method_isBlockDevice(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISBLK(st->st_mode));
+}
+
+QV4::ReturnedValue StatsPrototype::method_isCharacterDevice(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISCHR(st->st_mode));
+}
+
+QV4::ReturnedValue StatsPrototype::method_isSymbolicLink(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISLNK(st->st_mode));
+}
+
+QV4::ReturnedValue StatsPrototype::method_isFIFO(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISFIFO(st->st_mode));
+}
+
+QV4::ReturnedValue StatsPrototype::method_isSocket(QV4::CallContext *ctx)
+{
+    const struct stat *st = statBuf(ctx);
+    return QV4::Encode(st && S_ISSOCK(st->st_mode));
+}
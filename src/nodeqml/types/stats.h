@@ -0,0 +1,75 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "../v4integration.h"
+
+#include <private/qv4object_p.h>
+
+#include <sys/stat.h>
+
+namespace NodeQml {
+
+namespace Heap {
+
+struct Stats : QV4::Heap::Object {
+    Stats(QV4::ExecutionEngine *v4, const struct stat &st);
+
+    struct stat st;
+
+    // Date objects, created on first access
+    QV4::Heap::Object *atime = nullptr;
+    QV4::Heap::Object *mtime = nullptr;
+    QV4::Heap::Object *ctime = nullptr;
+};
+
+} // namespace Heap
+
+struct Stats : QV4::Object
+{
+    NODE_V4_OBJECT(Stats, Object)
+
+    static void markObjects(QV4::Heap::Base *that, QV4::ExecutionEngine *e);
+};
+
+struct StatsPrototype : QV4::Object
+{
+    void init(QV4::ExecutionEngine *v4);
+
+    static QV4::ReturnedValue create(QV4::ExecutionEngine *v4, const struct stat &st);
+    static QV4::ReturnedValue createCompact(QV4::ExecutionEngine *v4, const struct stat &st);
+
+    static QV4::ReturnedValue method_isFile(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isDirectory(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isBlockDevice(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isCharacterDevice(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isSymbolicLink(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isFIFO(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_isSocket(QV4::CallContext *ctx);
+    static QV4::ReturnedValue method_toJSON(QV4::CallContext *ctx);
+
+    static QV4::ReturnedValue property_dev_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_ino_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_mode_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_nlink_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_uid_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_gid_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_rdev_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_size_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_blksize_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_blocks_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_atimeMs_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_mtimeMs_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_ctimeMs_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_atime_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_mtime_getter(QV4::CallContext *ctx);
+    static QV4::ReturnedValue property_ctime_getter(QV4::CallContext *ctx);
+
+private:
+    static const struct stat *statBuf(QV4::CallContext *ctx);
+    static QV4::ReturnedValue date(QV4::CallContext *ctx, const struct timespec &ts,
+                                   QV4::Heap::Object *Heap::Stats::*cache);
+};
+
+} // namespace NodeQml
+
+#endif // STATS_H
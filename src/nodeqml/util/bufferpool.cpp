@@ -0,0 +1,88 @@
+#include "bufferpool.h"
+
+using namespace NodeQml;
+
+namespace {
+const int MaxRetiredPools = 4;
+
+inline int alignedSize(int size)
+{
+    return (size + 7) & ~7;
+}
+
+QTypedArrayDataSlice<char> allocateChunk(int size)
+{
+    QTypedArrayData<char> *arrayData = QTypedArrayData<char>::allocate(size);
+    if (!arrayData)
+        return QTypedArrayDataSlice<char>();
+    arrayData->size = size;
+
+    const QTypedArrayDataSlice<char> slice(arrayData);
+    arrayData->ref.deref(); // Disown data
+    return slice;
+}
+}
+
+BufferPool::BufferPool(int poolSize) :
+    m_poolSize(poolSize)
+{
+}
+
+/*!
+  \internal
+  Returns \a size bytes of writable memory. Requests larger than the pool size get their own
+  allocation. Returns a null slice if memory could not be allocated.
+*/
+QTypedArrayDataSlice<char> BufferPool::reserve(int size)
+{
+    if (size > m_poolSize)
+        return allocateChunk(size);
+
+    if (m_current.isNull() || m_offset + size > m_current.size()) {
+        m_current = takePool();
+        m_offset = 0;
+        if (m_current.isNull())
+            return QTypedArrayDataSlice<char>();
+    }
+
+    const QTypedArrayDataSlice<char> chunk(m_current, m_offset, size);
+    m_offset += alignedSize(size);
+    return chunk;
+}
+
+/*!
+  \internal
+  Gives back the unused tail of \a reserved after \a used bytes have been filled. This is only
+  possible while \a reserved is the latest reservation from the current pool.
+*/
+void BufferPool::release(const QTypedArrayDataSlice<char> &reserved, int used)
+{
+    if (m_current.isNull() || reserved.isNull())
+        return;
+
+    const char *poolData = m_current.constData();
+    const int start = reserved.constData() - poolData;
+    if (start < 0 || start >= m_current.size() || m_offset != alignedSize(start + reserved.size()))
+        return;
+
+    m_offset = alignedSize(start + used);
+}
+
+QTypedArrayDataSlice<char> BufferPool::takePool()
+{
+    // The current pool is exhausted, but chunks may still point into it
+    if (!m_current.isNull()) {
+        m_retired.append(m_current);
+        m_current.clearData();
+    }
+
+    for (int i = 0; i < m_retired.size(); ++i) {
+        if (!m_retired.at(i).isShared())
+            return m_retired.takeAt(i);
+    }
+
+    while (m_retired.size() > MaxRetiredPools)
+        m_retired.removeFirst();
+
+    return allocateChunk(m_poolSize);
+}
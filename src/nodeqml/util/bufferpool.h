@@ -0,0 +1,37 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include "qarraydataslice.h"
+
+#include <QList>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  Hands out chunks of large shared allocations, so that streams reading many small chunks do not
+  allocate for every read. A pool is reused once no chunk taken from it is referenced anymore.
+*/
+class BufferPool
+{
+public:
+    explicit BufferPool(int poolSize = 512 * 1024);
+
+    QTypedArrayDataSlice<char> reserve(int size);
+    void release(const QTypedArrayDataSlice<char> &reserved, int used);
+
+    int poolSize() const { return m_poolSize; }
+
+private:
+    QTypedArrayDataSlice<char> takePool();
+
+    const int m_poolSize;
+    QTypedArrayDataSlice<char> m_current;
+    int m_offset = 0;
+    // Exhausted pools that may still be referenced by chunks
+    QList<QTypedArrayDataSlice<char>> m_retired;
+};
+
+} // namespace NodeQml
+
+#endif // BUFFERPOOL_H
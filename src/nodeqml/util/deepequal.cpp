@@ -0,0 +1,216 @@
+#include "deepequal.h"
+
+#include "../types/buffer.h"
+
+#include <QDateTime>
+
+#include <private/qv4dateobject_p.h>
+#include <private/qv4functionobject_p.h>
+#include <private/qv4objectiterator_p.h>
+#include <private/qv4regexpobject_p.h>
+#include <private/qv4runtime_p.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace NodeQml;
+
+namespace {
+
+// SameValue of Object.is(), NaN equals NaN and 0 differs from -0
+bool sameValue(const QV4::Value &a, const QV4::Value &b)
+{
+    if (!a.isNumber() || !b.isNumber())
+        return QV4::RuntimeHelpers::strictEqual(a, b);
+
+    const double x = a.toNumber();
+    const double y = b.toNumber();
+    if (std::isnan(x) || std::isnan(y))
+        return std::isnan(x) && std::isnan(y);
+    return x == y && std::signbit(x) == std::signbit(y);
+}
+
+} // namespace
+
+DeepEqual::DeepEqual(QV4::ExecutionEngine *v4, Mode mode) :
+    m_v4(v4),
+    m_mode(mode)
+{
+}
+
+/*!
+  \internal
+  Returns whether \a a and \a b are deeply equal. Returns false if a getter threw, the exception
+  is left pending on the engine.
+*/
+bool DeepEqual::equals(const QV4::Value &a, const QV4::Value &b)
+{
+    if (m_mode == Strict ? sameValue(a, b) : QV4::RuntimeHelpers::strictEqual(a, b))
+        return true;
+
+    QV4::Scope scope(m_v4);
+    QV4::ScopedObject objectA(scope, a);
+    QV4::ScopedObject objectB(scope, b);
+
+    // Values whose typeof is not 'object' compare like primitives
+    const bool primitiveA = !a.isNull() && (!objectA || objectA->asFunctionObject());
+    const bool primitiveB = !b.isNull() && (!objectB || objectB->asFunctionObject());
+    if (primitiveA && primitiveB)
+        return m_mode == Loose && QV4::Runtime::compareEqual(a, b);
+    if (!objectA || !objectB)
+        return false;
+
+    Buffer *bufferA = objectA->as<Buffer>();
+    Buffer *bufferB = objectB->as<Buffer>();
+    if (bufferA && bufferB)
+        return BufferPrototype::compare(bufferA->d()->data, bufferB->d()->data) == 0;
+
+    QV4::DateObject *dateA = objectA->asDateObject();
+    QV4::DateObject *dateB = objectB->asDateObject();
+    if (dateA && dateB) {
+        const QDateTime dateTimeA = dateA->toQDateTime();
+        const QDateTime dateTimeB = dateB->toQDateTime();
+        // Invalid dates have a NaN time, which equals nothing
+        return dateTimeA.isValid() && dateTimeB.isValid()
+                && dateTimeA.toMSecsSinceEpoch() == dateTimeB.toMSecsSinceEpoch();
+    }
+
+    QV4::RegExpObject *regExpA = objectA->as<QV4::RegExpObject>();
+    QV4::RegExpObject *regExpB = objectB->as<QV4::RegExpObject>();
+    if (regExpA && regExpB) {
+        // The source and the flags
+        if (regExpA->toString() != regExpB->toString())
+            return false;
+        QV4::ScopedString lastIndex(scope, m_v4->newString(QStringLiteral("lastIndex")));
+        QV4::ScopedValue lastIndexA(scope, objectA->get(lastIndex));
+        QV4::ScopedValue lastIndexB(scope, objectB->get(lastIndex));
+        return !m_v4->hasException && QV4::RuntimeHelpers::strictEqual(lastIndexA, lastIndexB);
+    }
+
+    const QPair<QV4::Heap::Base *, QV4::Heap::Base *> pair(objectA->d(), objectB->d());
+    // Either equal or still being compared, a difference would already have ended the comparison
+    if (m_compared.contains(pair))
+        return true;
+    m_compared.insert(pair);
+
+    return objectEquals(objectA, objectB);
+}
+
+bool DeepEqual::objectEquals(QV4::Object *a, QV4::Object *b)
+{
+    QV4::Scope scope(m_v4);
+    QV4::ScopedValue prototypeA(scope, a->get(m_v4->id_prototype));
+    QV4::ScopedValue prototypeB(scope, b->get(m_v4->id_prototype));
+    if (m_v4->hasException || !QV4::RuntimeHelpers::strictEqual(prototypeA, prototypeB))
+        return false;
+
+    if (m_mode == Strict && a->prototype() != b->prototype())
+        return false;
+
+    const bool arguments = a->isArgumentsObject();
+    if (arguments != b->isArgumentsObject())
+        return false;
+
+    // Only the elements of arguments objects are compared
+    if (arguments)
+        return indexesEqual(a, b);
+
+    if (a->asArrayObject() && b->asArrayObject())
+        return indexesEqual(a, b) && propertiesEqual(a, b, true);
+
+    return propertiesEqual(a, b, false);
+}
+
+// Compares elements up to the longer length, holes only equal holes
+bool DeepEqual::indexesEqual(QV4::Object *a, QV4::Object *b)
+{
+    QV4::Scope scope(m_v4);
+    QV4::ScopedValue valueA(scope);
+    QV4::ScopedValue valueB(scope);
+
+    const uint length = qMax(a->getLength(), b->getLength());
+    for (uint i = 0; i < length; ++i) {
+        bool hasA = false;
+        bool hasB = false;
+        valueA = a->getIndexed(i, &hasA);
+        valueB = b->getIndexed(i, &hasB);
+        if (m_v4->hasException || hasA != hasB)
+            return false;
+        if (hasA && !equals(valueA, valueB))
+            return false;
+    }
+    return true;
+}
+
+// Compares own enumerable properties, skipping array indexes if \a skipIndexes is set
+bool DeepEqual::propertiesEqual(QV4::Object *a, QV4::Object *b, bool skipIndexes)
+{
+    QV4::Scope scope(m_v4);
+    QV4::ObjectIterator itA(scope, a, QV4::ObjectIterator::EnumerableOnly);
+    QV4::ObjectIterator itB(scope, b, QV4::ObjectIterator::EnumerableOnly);
+    QV4::ScopedValue name(scope);
+    QV4::ScopedValue valueA(scope);
+    QV4::ScopedValue valueB(scope);
+    QV4::ScopedString keyA(scope);
+    QV4::ScopedString keyB(scope);
+
+    auto next = [&](QV4::ObjectIterator &it, QV4::ScopedString &key, QV4::ScopedValue &value) {
+        for (;;) {
+            name = it.nextPropertyNameAsString(value);
+            key = name;
+            if (!key || !skipIndexes || key->asArrayIndex() == UINT_MAX)
+                return;
+        }
+    };
+
+    // Objects created the same way list their keys in the same order
+    for (;;) {
+        next(itA, keyA, valueA);
+        next(itB, keyB, valueB);
+        if (m_v4->hasException)
+            return false;
+        if (!keyA || !keyB)
+            return !keyA && !keyB;
+        if (keyA->toQString() != keyB->toQString())
+            break;
+        if (!equals(valueA, valueB))
+            return false;
+    }
+
+    QStringList keysA;
+    QStringList keysB;
+    for (; keyA && !m_v4->hasException; next(itA, keyA, valueA))
+        keysA.append(keyA->toQString());
+    for (; keyB && !m_v4->hasException; next(itB, keyB, valueB))
+        keysB.append(keyB->toQString());
+    if (m_v4->hasException)
+        return false;
+
+    return sortedPropertiesEqual(a, b, keysA, keysB);
+}
+
+// Compares the properties of \a a and \a b whose keys did not come in the same order
+bool DeepEqual::sortedPropertiesEqual(QV4::Object *a, QV4::Object *b, QStringList keysA,
+                                      QStringList keysB)
+{
+    if (keysA.size() != keysB.size())
+        return false;
+
+    std::sort(keysA.begin(), keysA.end());
+    std::sort(keysB.begin(), keysB.end());
+    if (keysA != keysB)
+        return false;
+
+    QV4::Scope scope(m_v4);
+    QV4::ScopedString key(scope);
+    QV4::ScopedValue valueA(scope);
+    QV4::ScopedValue valueB(scope);
+    foreach (const QString &k, keysA) {
+        key = m_v4->newString(k);
+        valueA = a->get(key);
+        valueB = b->get(key);
+        if (m_v4->hasException || !equals(valueA, valueB))
+            return false;
+    }
+    return true;
+}
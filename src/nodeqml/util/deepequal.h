@@ -0,0 +1,46 @@
+#ifndef DEEPEQUAL_H
+#define DEEPEQUAL_H
+
+#include <QPair>
+#include <QSet>
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  Native deep equality of assert.deepEqual() and util.isDeepStrictEqual(). Buffers are compared
+  with memcmp, array elements by index and properties of objects created the same way in a single
+  pass over both objects. Pairs of objects already being compared are assumed equal, which makes
+  cyclic structures terminate.
+*/
+class DeepEqual
+{
+public:
+    enum Mode {
+        // Primitives compare with ==, prototypes are ignored
+        Loose,
+        // Primitives compare with Object.is(), prototypes must be identical
+        Strict
+    };
+
+    DeepEqual(QV4::ExecutionEngine *v4, Mode mode);
+
+    bool equals(const QV4::Value &a, const QV4::Value &b);
+
+private:
+    bool objectEquals(QV4::Object *a, QV4::Object *b);
+    bool indexesEqual(QV4::Object *a, QV4::Object *b);
+    bool propertiesEqual(QV4::Object *a, QV4::Object *b, bool skipIndexes);
+    bool sortedPropertiesEqual(QV4::Object *a, QV4::Object *b, QStringList keysA, QStringList keysB);
+
+    QV4::ExecutionEngine *m_v4;
+    const Mode m_mode;
+    // Pairs of objects compared so far, or being compared
+    QSet<QPair<QV4::Heap::Base *, QV4::Heap::Base *> > m_compared;
+};
+
+} // namespace NodeQml
+
+#endif // DEEPEQUAL_H
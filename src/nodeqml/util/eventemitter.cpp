@@ -0,0 +1,84 @@
+#include "eventemitter.h"
+
+#include "../engine_p.h"
+
+#include <private/qv4functionobject_p.h>
+
+namespace NodeQml {
+
+QV4::ReturnedValue callMethod(QV4::ExecutionEngine *v4, const QV4::Value &object,
+                              const QString &name, const QV4::Value *args, int argc)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, object);
+    if (!o)
+        return QV4::Encode::undefined();
+    QV4::ScopedString s(scope, v4->newString(name));
+    QV4::ScopedFunctionObject f(scope, o->get(s));
+    if (!f)
+        return QV4::Encode::undefined();
+
+    QV4::ScopedCallData callData(scope, argc);
+    callData->thisObject = o.asReturnedValue();
+    for (int i = 0; i < argc; ++i)
+        callData->args[i] = args[i];
+    return f->call(callData);
+}
+
+bool emitEvent(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+               QV4::ReturnedValue arg, int argc)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, emitter);
+    QV4::ScopedCallData callData(scope, argc + 1);
+    callData->args[0] = v4->newString(event)->asReturnedValue();
+    if (argc)
+        callData->args[1] = arg;
+
+    callMethod(v4, o, QStringLiteral("emit"), callData->args, argc + 1);
+    return !v4->hasException;
+}
+
+bool emitEvent(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+               const QV4::Value *args, int argc)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, emitter);
+    QV4::ScopedCallData callData(scope, argc + 1);
+    callData->args[0] = v4->newString(event)->asReturnedValue();
+    for (int i = 0; i < argc; ++i)
+        callData->args[i + 1] = args[i];
+
+    callMethod(v4, o, QStringLiteral("emit"), callData->args, argc + 1);
+    return !v4->hasException;
+}
+
+void once(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+          const QV4::Value &listener)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, emitter);
+    QV4::ScopedCallData callData(scope, 2);
+    callData->args[0] = v4->newString(event)->asReturnedValue();
+    callData->args[1] = listener;
+    callMethod(v4, o, QStringLiteral("once"), callData->args, 2);
+}
+
+/*!
+  \internal
+  Makes \a prototype inherit from EventEmitter.prototype, the first time an object using
+  \a prototype is created.
+*/
+bool initEmitterPrototype(QV4::ExecutionEngine *v4, const QV4::Value &prototype)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject proto(scope, prototype);
+    if (proto->prototype() != v4->objectPrototype.asObject()->d())
+        return true;
+
+    QV4::ScopedObject emitterPrototype(scope, EnginePrivate::get(v4)->eventEmitterPrototype);
+    proto->setPrototype(emitterPrototype);
+    return true;
+}
+
+} // namespace NodeQml
@@ -0,0 +1,30 @@
+#ifndef EVENTEMITTER_H
+#define EVENTEMITTER_H
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+/*
+  Helpers for native objects that inherit from the EventEmitter of events.js
+ */
+
+QV4::ReturnedValue callMethod(QV4::ExecutionEngine *v4, const QV4::Value &object,
+                              const QString &name, const QV4::Value *args = nullptr, int argc = 0);
+
+// Calls emitter.emit(event, [arg]). Returns false if a listener threw.
+bool emitEvent(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+               QV4::ReturnedValue arg = QV4::Encode::undefined(), int argc = 0);
+// Calls emitter.emit(event, args...). Returns false if a listener threw.
+bool emitEvent(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+               const QV4::Value *args, int argc);
+
+// Registers listener for a single emission of event, e.g. 'close' for stream.close(callback)
+void once(QV4::ExecutionEngine *v4, QV4::Heap::Object *emitter, const QString &event,
+          const QV4::Value &listener);
+
+bool initEmitterPrototype(QV4::ExecutionEngine *v4, const QV4::Value &prototype);
+
+} // namespace NodeQml
+
+#endif // EVENTEMITTER_H
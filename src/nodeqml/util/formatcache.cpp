@@ -0,0 +1,74 @@
+#include "formatcache.h"
+
+using namespace NodeQml;
+
+FormatCache::FormatCache(int capacity) :
+    m_capacity(capacity)
+{
+    m_entries.reserve(capacity);
+}
+
+/*!
+  \internal
+  Returns the tokens of \a format, which is the text of the V4 string \a key. The returned vector
+  is valid until the next call.
+*/
+const QVector<FormatCache::Token> &FormatCache::tokens(const void *key, const QString &format)
+{
+    int index = m_index.value(key, -1);
+    if (index != -1) {
+        Entry &entry = m_entries[index];
+        // The string may have been collected and another one allocated at the same address
+        if (entry.format.constData() == format.constData() && entry.format.size() == format.size()) {
+            entry.lastUse = ++m_clock;
+            return entry.tokens;
+        }
+        m_index.remove(key);
+    } else if (m_entries.size() < m_capacity) {
+        index = m_entries.size();
+        m_entries.append(Entry());
+    } else {
+        // Evict the least recently used entry
+        index = 0;
+        for (int i = 1; i < m_entries.size(); ++i) {
+            if (m_entries.at(i).lastUse < m_entries.at(index).lastUse)
+                index = i;
+        }
+        m_index.remove(m_entries.at(index).key);
+    }
+
+    Entry &entry = m_entries[index];
+    entry.key = key;
+    entry.format = format;
+    entry.lastUse = ++m_clock;
+    tokenize(format, &entry.tokens);
+    m_index.insert(key, index);
+    return entry.tokens;
+}
+
+// Splits \a format into literal runs and the %s, %d, %j and %% placeholders in a single pass
+void FormatCache::tokenize(const QString &format, QVector<Token> *tokens)
+{
+    tokens->clear();
+
+    const ushort *data = format.utf16();
+    const int size = format.size();
+    int literalStart = 0;
+    for (int i = 0; i < size - 1; ++i) {
+        if (data[i] != '%')
+            continue;
+
+        const ushort c = data[i + 1];
+        if (c != 's' && c != 'd' && c != 'j' && c != '%')
+            continue;
+
+        if (i > literalStart)
+            tokens->append(Token { literalStart, i - literalStart, 0 });
+        tokens->append(Token { i, 2, c });
+        ++i;
+        literalStart = i + 1;
+    }
+
+    if (literalStart < size)
+        tokens->append(Token { literalStart, size - literalStart, 0 });
+}
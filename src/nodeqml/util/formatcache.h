@@ -0,0 +1,48 @@
+#ifndef FORMATCACHE_H
+#define FORMATCACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  Keeps the most recently used util.format() strings split into literal runs and placeholders, so
+  that logging with the same format string over and over scans it only once.
+*/
+class FormatCache
+{
+public:
+    struct Token {
+        int start;
+        int length;
+        // 's', 'd', 'j' or '%' for placeholders, 0 for literal text
+        ushort placeholder;
+    };
+
+    explicit FormatCache(int capacity = 64);
+
+    const QVector<Token> &tokens(const void *key, const QString &format);
+
+    static void tokenize(const QString &format, QVector<Token> *tokens);
+
+private:
+    struct Entry {
+        const void *key;
+        // Shares the data of the V4 string, which tells a reused key apart
+        QString format;
+        QVector<Token> tokens;
+        quint64 lastUse;
+    };
+
+    const int m_capacity;
+    QVector<Entry> m_entries;
+    QHash<const void *, int> m_index;
+    quint64 m_clock = 0;
+};
+
+} // namespace NodeQml
+
+#endif // FORMATCACHE_H
@@ -0,0 +1,398 @@
+#include "inspector.h"
+
+#include "../modules/util.h"
+#include "../types/buffer.h"
+
+#include <QDateTime>
+
+#include <private/qv4dateobject_p.h>
+#include <private/qv4errorobject_p.h>
+#include <private/qv4functionobject_p.h>
+#include <private/qv4objectiterator_p.h>
+#include <private/qv4regexpobject_p.h>
+
+#include <cmath>
+
+using namespace NodeQml;
+
+namespace {
+// Same as INSPECT_MAX_BYTES of the buffer module
+const int InspectMaxBytes = 50;
+
+QV4::ReturnedValue property(QV4::ExecutionEngine *v4, QV4::Object *o, const QString &name)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedString s(scope, v4->newString(name));
+    return o->get(s);
+}
+
+// Reads a numeric option, where null and Infinity lift the limit
+int limitOption(QV4::ExecutionEngine *v4, const QV4::Value &options, const QString &name,
+                int defaultValue, int unlimited)
+{
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    QV4::ScopedValue v(scope, property(v4, o, name));
+    if (v->isUndefined())
+        return defaultValue;
+    if (v->isNull())
+        return unlimited;
+    const double d = v->toNumber();
+    if (std::isnan(d))
+        return defaultValue;
+    if (std::isinf(d) || d > INT_MAX)
+        return unlimited;
+    return qMax(0, int(d));
+}
+
+bool isIdentifier(const QString &key)
+{
+    if (key.isEmpty())
+        return false;
+    for (int i = 0; i < key.size(); ++i) {
+        const ushort c = key.at(i).unicode();
+        const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        if (!letter && (!i || c < '0' || c > '9'))
+            return false;
+    }
+    return true;
+}
+}
+
+Inspector::Inspector(QV4::ExecutionEngine *v4) :
+    m_v4(v4)
+{
+}
+
+Inspector::Inspector(QV4::ExecutionEngine *v4, const Options &options) :
+    m_v4(v4),
+    m_options(options)
+{
+}
+
+/*!
+  \internal
+  Returns the string representation of \a value. Custom inspect() methods and getters may throw,
+  the caller has to check for an exception.
+*/
+QString Inspector::inspect(const QV4::Value &value)
+{
+    m_out.clear();
+    m_out.reserve(64);
+    m_seen.clear();
+    formatValue(value, 0);
+    return m_out;
+}
+
+// Options of util.inspect(): depth, breakLength, maxArrayLength and customInspect
+Inspector::Options Inspector::parseOptions(QV4::ExecutionEngine *v4, const QV4::Value &options)
+{
+    Options result;
+    if (!options.isObject())
+        return result;
+
+    result.depth = limitOption(v4, options, QStringLiteral("depth"), result.depth, -1);
+    result.breakLength = limitOption(v4, options, QStringLiteral("breakLength"),
+                                     result.breakLength, INT_MAX);
+    result.maxArrayLength = limitOption(v4, options, QStringLiteral("maxArrayLength"),
+                                        result.maxArrayLength, INT_MAX);
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, options);
+    QV4::ScopedValue customInspect(scope, property(v4, o, QStringLiteral("customInspect")));
+    if (!customInspect->isUndefined())
+        result.customInspect = customInspect->toBoolean();
+    return result;
+}
+
+// Appends \a str in single quotes, escaped like a JavaScript string literal
+void Inspector::appendQuoted(QString *out, const QString &str)
+{
+    out->reserve(out->size() + str.size() + 2);
+    *out += QLatin1Char('\'');
+    for (int i = 0; i < str.size(); ++i) {
+        const QChar c = str.at(i);
+        switch (c.unicode()) {
+        case '\'': *out += QLatin1String("\\'"); break;
+        case '\\': *out += QLatin1String("\\\\"); break;
+        case '\n': *out += QLatin1String("\\n"); break;
+        case '\r': *out += QLatin1String("\\r"); break;
+        case '\t': *out += QLatin1String("\\t"); break;
+        case '\b': *out += QLatin1String("\\b"); break;
+        case '\f': *out += QLatin1String("\\f"); break;
+        default:
+            if (c.unicode() < 0x20)
+                *out += QStringLiteral("\\u%1").arg(c.unicode(), 4, 16, QLatin1Char('0'));
+            else
+                *out += c;
+        }
+    }
+    *out += QLatin1Char('\'');
+}
+
+void Inspector::formatValue(const QV4::Value &value, int level)
+{
+    if (!value.isObject()) {
+        formatPrimitive(value);
+        return;
+    }
+
+    QV4::Scope scope(m_v4);
+    QV4::ScopedObject o(scope, value);
+    formatObject(o, level);
+}
+
+void Inspector::formatPrimitive(const QV4::Value &value)
+{
+    if (value.isUndefined())
+        m_out += QLatin1String("undefined");
+    else if (value.isNull())
+        m_out += QLatin1String("null");
+    else if (value.isString())
+        appendQuoted(&m_out, value.toQStringNoThrow());
+    else if (value.isNumber() && value.toNumber() == 0 && std::signbit(value.toNumber()))
+        m_out += QLatin1String("-0");
+    else
+        m_out += value.toQStringNoThrow();
+}
+
+void Inspector::formatObject(QV4::Object *o, int level)
+{
+    if (m_seen.contains(o->d())) {
+        m_out += QLatin1String("[Circular]");
+        return;
+    }
+
+    if (o->as<Buffer>()) {
+        formatBuffer(o);
+        return;
+    }
+
+    QV4::Scope scope(m_v4);
+
+    if (m_options.customInspect) {
+        QV4::ScopedFunctionObject inspectFunction(scope, property(m_v4, o, QStringLiteral("inspect")));
+        if (m_v4->hasException)
+            return;
+        // util.inspect() itself, e.g. on the util module, is not a custom inspect()
+        QV4::BuiltinFunction *builtin = inspectFunction ? inspectFunction->as<QV4::BuiltinFunction>()
+                                                        : nullptr;
+        if (inspectFunction && !(builtin && builtin->d()->code == UtilModule::method_inspect)) {
+            QV4::ScopedCallData callData(scope, 1);
+            callData->thisObject = o->asReturnedValue();
+            if (m_options.depth < 0)
+                callData->args[0] = QV4::Primitive::nullValue();
+            else
+                callData->args[0] = QV4::Primitive::fromInt32(m_options.depth - level);
+            QV4::ScopedValue result(scope, inspectFunction->call(callData));
+            if (m_v4->hasException)
+                return;
+            if (result->isString())
+                m_out += result->toQStringNoThrow();
+            else
+                formatValue(result, level);
+            return;
+        }
+    }
+
+    QV4::ScopedArrayObject array(scope, o->asReturnedValue());
+    const QString base = baseString(o);
+    if (m_v4->hasException)
+        return;
+
+    QV4::ObjectIterator it(scope, o, QV4::ObjectIterator::EnumerableOnly);
+    QV4::ScopedValue name(scope);
+    QV4::ScopedValue value(scope);
+    QV4::ScopedString key(scope);
+
+    // Indexes of arrays are printed in order, not through the iterator
+    auto nextKey = [&]() {
+        for (;;) {
+            name = it.nextPropertyNameAsString(value);
+            key = name;
+            if (!key || !array || key->asArrayIndex() == UINT_MAX)
+                return;
+        }
+    };
+    nextKey();
+    if (m_v4->hasException)
+        return;
+
+    const uint length = array ? array->getLength() : 0;
+    if (!key && !length) {
+        if (array)
+            m_out += QLatin1String("[]");
+        else if (!base.isEmpty())
+            m_out += base;
+        else
+            m_out += QLatin1String("{}");
+        return;
+    }
+
+    if (m_options.depth >= 0 && level > m_options.depth) {
+        if (o->as<QV4::RegExpObject>())
+            m_out += base;
+        else
+            m_out += array ? QLatin1String("[Array]") : QLatin1String("[Object]");
+        return;
+    }
+
+    m_seen.insert(o->d());
+
+    const int start = m_out.size();
+    QVector<QPair<int, int> > entries;
+    auto beginEntry = [&]() {
+        if (!entries.isEmpty())
+            m_out += QLatin1String(", ");
+        entries.append(qMakePair(m_out.size(), 0));
+    };
+
+    const uint shown = qMin(length, uint(m_options.maxArrayLength));
+    for (uint i = 0; i < shown && !m_v4->hasException; ++i) {
+        beginEntry();
+        bool hasProperty = false;
+        value = array->getIndexed(i, &hasProperty);
+        if (hasProperty)
+            formatValue(value, level + 1);
+        entries.last().second = m_out.size();
+    }
+    if (shown < length) {
+        beginEntry();
+        m_out += QString("... %1 more item%2").arg(length - shown).arg(length - shown > 1 ? "s" : "");
+        entries.last().second = m_out.size();
+    }
+
+    while (key && !m_v4->hasException) {
+        beginEntry();
+        formatKey(key->toQString());
+        m_out += QLatin1String(": ");
+        formatValue(value, level + 1);
+        entries.last().second = m_out.size();
+        nextKey();
+    }
+
+    m_seen.remove(o->d());
+    if (m_v4->hasException)
+        return;
+
+    finishEntries(start, entries, base, array ? "[" : "{", array ? "]" : "}");
+}
+
+void Inspector::formatKey(const QString &key)
+{
+    if (isIdentifier(key))
+        m_out += key;
+    else
+        appendQuoted(&m_out, key);
+}
+
+void Inspector::formatBuffer(QV4::Object *o)
+{
+    const QTypedArrayDataSlice<char> &data = o->as<Buffer>()->d()->data;
+    static const char hexDigits[] = "0123456789abcdef";
+
+    m_out += QLatin1String("<Buffer");
+    const int size = qMin(data.size(), InspectMaxBytes);
+    for (int i = 0; i < size; ++i) {
+        const uchar byte = data.at(i);
+        m_out += QLatin1Char(' ');
+        m_out += QLatin1Char(hexDigits[byte >> 4]);
+        m_out += QLatin1Char(hexDigits[byte & 0xf]);
+    }
+    if (data.size() > InspectMaxBytes)
+        m_out += QLatin1String(" ... ");
+    m_out += QLatin1Char('>');
+}
+
+// Returns how functions, regular expressions, dates and errors print before their properties
+QString Inspector::baseString(QV4::Object *o)
+{
+    if (o->asFunctionObject()) {
+        QV4::Scope scope(m_v4);
+        QV4::ScopedValue name(scope, property(m_v4, o, QStringLiteral("name")));
+        const QString nameString = name->isString() ? name->toQStringNoThrow() : QString();
+        if (nameString.isEmpty())
+            return QStringLiteral("[Function]");
+        return QStringLiteral("[Function: %1]").arg(nameString);
+    }
+
+    if (QV4::RegExpObject *re = o->as<QV4::RegExpObject>())
+        return re->toString();
+
+    if (QV4::DateObject *date = o->asDateObject()) {
+        const QDateTime dateTime = date->toQDateTime();
+        if (!dateTime.isValid())
+            return QStringLiteral("Invalid Date");
+        return dateTime.toUTC().toString(QStringLiteral("yyyy-MM-ddTHH:mm:ss.zzzZ"));
+    }
+
+    if (o->asErrorObject()) {
+        QV4::Scope scope(m_v4);
+        QV4::ScopedValue name(scope, property(m_v4, o, QStringLiteral("name")));
+        QV4::ScopedValue message(scope, property(m_v4, o, QStringLiteral("message")));
+        const QString nameString = name->isUndefined() ? QStringLiteral("Error")
+                                                        : name->toQStringNoThrow();
+        const QString messageString = message->isUndefined() ? QString()
+                                                              : message->toQStringNoThrow();
+        if (messageString.isEmpty())
+            return QStringLiteral("[%1]").arg(nameString);
+        if (nameString.isEmpty())
+            return QStringLiteral("[%1]").arg(messageString);
+        return QStringLiteral("[%1: %2]").arg(nameString, messageString);
+    }
+
+    return QString();
+}
+
+/*!
+  \internal
+  Wraps the entries written since \a start in braces. Entries stay on one line when they fit into
+  breakLength, otherwise the segment is rewritten with one entry per line.
+*/
+void Inspector::finishEntries(int start, const QVector<QPair<int, int> > &entries,
+                              const QString &base, const char *open, const char *close)
+{
+    int length = base.size();
+    bool multiLine = false;
+    for (int i = 0; i < entries.size() && !multiLine; ++i) {
+        length += entries.at(i).second - entries.at(i).first + 1;
+        multiLine = length > m_options.breakLength
+                || m_out.midRef(entries.at(i).first, entries.at(i).second - entries.at(i).first)
+                       .contains(QLatin1Char('\n'));
+    }
+
+    if (!multiLine) {
+        QString prefix = QLatin1String(open);
+        if (!base.isEmpty())
+            prefix += QLatin1Char(' ') + base;
+        prefix += QLatin1Char(' ');
+        m_out.insert(start, prefix);
+        m_out += QLatin1Char(' ');
+        m_out += QLatin1String(close);
+        return;
+    }
+
+    const QString segment = m_out.mid(start);
+    m_out.truncate(start);
+    m_out += QLatin1String(open);
+    if (!base.isEmpty()) {
+        m_out += QLatin1Char(' ');
+        m_out += base;
+        m_out += QLatin1String("\n ");
+    }
+    m_out += QLatin1Char(' ');
+    for (int i = 0; i < entries.size(); ++i) {
+        if (i)
+            m_out += QLatin1String(",\n  ");
+        // Nested entries spanning several lines are indented one more level
+        const int end = entries.at(i).second - start;
+        int from = entries.at(i).first - start;
+        for (int to; (to = segment.indexOf(QLatin1Char('\n'), from)) != -1 && to < end; from = to + 1) {
+            m_out.append(segment.constData() + from, to + 1 - from);
+            m_out += QLatin1String("  ");
+        }
+        m_out.append(segment.constData() + from, end - from);
+    }
+    m_out += QLatin1Char(' ');
+    m_out += QLatin1String(close);
+}
@@ -0,0 +1,57 @@
+#ifndef INSPECTOR_H
+#define INSPECTOR_H
+
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  Native util.inspect(). Objects, arrays, Buffers, errors, dates and regular expressions are
+  written into a single growing string. Nesting is limited by depth and long arrays by
+  maxArrayLength, references back to an object being printed show up as [Circular].
+*/
+class Inspector
+{
+public:
+    struct Options {
+        // -1 for no limit
+        int depth = 2;
+        int breakLength = 60;
+        int maxArrayLength = 100;
+        bool customInspect = true;
+    };
+
+    explicit Inspector(QV4::ExecutionEngine *v4);
+    Inspector(QV4::ExecutionEngine *v4, const Options &options);
+
+    QString inspect(const QV4::Value &value);
+
+    static Options parseOptions(QV4::ExecutionEngine *v4, const QV4::Value &options);
+    static void appendQuoted(QString *out, const QString &str);
+
+private:
+    void formatValue(const QV4::Value &value, int level);
+    void formatPrimitive(const QV4::Value &value);
+    void formatObject(QV4::Object *o, int level);
+    void formatKey(const QString &key);
+    void formatBuffer(QV4::Object *o);
+    QString baseString(QV4::Object *o);
+    void finishEntries(int start, const QVector<QPair<int, int> > &entries, const QString &base,
+                       const char *open, const char *close);
+
+    QV4::ExecutionEngine *m_v4;
+    const Options m_options;
+    QString m_out;
+    // Objects currently being printed
+    QSet<QV4::Heap::Base *> m_seen;
+};
+
+} // namespace NodeQml
+
+#endif // INSPECTOR_H
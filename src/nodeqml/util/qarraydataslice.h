@@ -22,6 +22,9 @@ public:
     bool isNull() const { return !m_arrayData; }
 
     int size() const { return m_size; }
+    int allocatedSize() const { return m_arrayData ? m_arrayData->size : 0; }
+    bool isShared() const { return m_arrayData && m_arrayData->ref.isShared(); }
+    const QTypedArrayData<T> *arrayData() const { return m_arrayData; }
 
     inline T *data();
     inline const T *constData() const;
@@ -32,6 +35,7 @@ public:
 
     void clearData();
     void setData(QTypedArrayData<T> *arrayData, int offset = 0, int size = -1);
+    bool detach();
 
 private:
     QTypedArrayData<T> *m_arrayData = nullptr;
@@ -73,6 +77,12 @@ QTypedArrayDataSlice<T>::~QTypedArrayDataSlice()
 template<typename T>
 QTypedArrayDataSlice<T> &QTypedArrayDataSlice<T>::operator=(const QTypedArrayDataSlice &other)
 {
+    if (this == &other)
+        return *this;
+    if (!other.m_arrayData) {
+        clearData();
+        return *this;
+    }
     const int offset = other.m_begin - other.m_arrayData->data();
     setData(other.m_arrayData, offset, other.m_size);
     return *this;
@@ -145,4 +155,31 @@ void QTypedArrayDataSlice<T>::setData(QTypedArrayData<T> *arrayData, int offset,
     m_size = size == -1 ? arrayData->size : size;
 }
 
+/*!
+  Moves the slice into its own allocation of exactly size() elements, releasing the reference to
+  the original array data. Returns false if memory could not be allocated.
+*/
+template<typename T>
+bool QTypedArrayDataSlice<T>::detach()
+{
+    if (!m_arrayData || m_size == m_arrayData->size)
+        return true;
+
+    QTypedArrayData<T> *arrayData = QTypedArrayData<T>::allocate(m_size);
+    if (!arrayData)
+        return false;
+
+    if (QTypeInfo<T>::isComplex) {
+        for (int i = 0; i < m_size; ++i)
+            new (arrayData->data() + i) T(m_begin[i]);
+    } else {
+        ::memcpy(arrayData->data(), m_begin, m_size * sizeof(T));
+    }
+    arrayData->size = m_size;
+
+    setData(arrayData);
+    arrayData->ref.deref(); // Disown data
+    return true;
+}
+
 #endif // QARRAYDATASLICE_H
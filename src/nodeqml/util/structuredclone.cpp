@@ -0,0 +1,278 @@
+#include "structuredclone.h"
+
+#include "../types/buffer.h"
+
+#include <QDateTime>
+
+#include <private/qv4dateobject_p.h>
+#include <private/qv4errorobject_p.h>
+#include <private/qv4functionobject_p.h>
+#include <private/qv4mm_p.h>
+#include <private/qv4objectiterator_p.h>
+#include <private/qv4regexpobject_p.h>
+
+#include <qnumeric.h>
+#include <string.h>
+
+using namespace NodeQml;
+
+namespace {
+
+QTypedArrayDataSlice<char> copyData(const QTypedArrayDataSlice<char> &slice)
+{
+    QTypedArrayData<char> *arrayData = QTypedArrayData<char>::allocate(slice.size());
+    if (!arrayData)
+        return QTypedArrayDataSlice<char>();
+
+    ::memcpy(arrayData->data(), slice.constData(), slice.size());
+    arrayData->size = slice.size();
+
+    const QTypedArrayDataSlice<char> copy(arrayData);
+    arrayData->ref.deref(); // Disown data
+    return copy;
+}
+
+} // namespace
+
+/*!
+  \internal
+  Copies \a value. The data of Buffers in the \a transferList array is handed over instead of
+  copied, unless other Buffers share it, and the Buffers are left empty. Returns false and throws a DataCloneError if \a value
+  contains a function.
+*/
+bool StructuredClone::serialize(QV4::ExecutionEngine *v4, const QV4::Value &value,
+                                const QV4::Value &transferList)
+{
+    m_nodes.clear();
+
+    QV4::Scope scope(v4);
+    QV4::ScopedArrayObject transfer(scope, transferList);
+    if (transfer) {
+        QV4::ScopedObject o(scope);
+        const uint length = transfer->getLength();
+        for (uint i = 0; i < length; ++i) {
+            o = transfer->getIndexed(i);
+            if (o && o->as<Buffer>())
+                m_transfer.insert(o->d());
+        }
+    }
+
+    const bool ok = write(v4, value, QString());
+    if (ok) {
+        foreach (QV4::Heap::Base *buffer, m_transfer)
+            Buffer::neuter(v4, static_cast<Heap::Buffer *>(buffer));
+    }
+    m_objectIds.clear();
+    m_transfer.clear();
+    if (!ok)
+        m_nodes.clear();
+    return ok;
+}
+
+/*!
+  \internal
+  Creates the cloned value in \a v4.
+*/
+QV4::ReturnedValue StructuredClone::deserialize(QV4::ExecutionEngine *v4) const
+{
+    if (m_nodes.isEmpty())
+        return QV4::Encode::undefined();
+
+    QV4::Scope scope(v4);
+    // Created objects in order of appearance, both for references and to keep them alive
+    QV4::ScopedObject objects(scope, v4->newArrayObject());
+    int index = 0;
+    return read(v4, &index, objects);
+}
+
+bool StructuredClone::write(QV4::ExecutionEngine *v4, const QV4::Value &value,
+                            const QString &name)
+{
+    Node node;
+    node.name = name;
+
+    if (value.isUndefined()) {
+        node.type = Node::Undefined;
+    } else if (value.isNull()) {
+        node.type = Node::Null;
+    } else if (value.isBoolean()) {
+        node.type = Node::Boolean;
+        node.number = value.booleanValue();
+    } else if (value.isNumber()) {
+        node.type = Node::Number;
+        node.number = value.toNumber();
+    } else if (value.isString()) {
+        node.type = Node::String;
+        node.string = value.toQStringNoThrow();
+    }
+    if (!value.isObject()) {
+        m_nodes.append(node);
+        return true;
+    }
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope, value);
+    if (o->asFunctionObject()) {
+        v4->throwError(QStringLiteral("DataCloneError: %1 could not be cloned.")
+                       .arg(value.toQStringNoThrow()));
+        return false;
+    }
+
+    const auto id = m_objectIds.constFind(o->d());
+    if (id != m_objectIds.constEnd()) {
+        node.type = Node::Reference;
+        node.number = *id;
+        m_nodes.append(node);
+        return true;
+    }
+    // Numbered in the order deserialize() creates them
+    m_objectIds.insert(o->d(), m_objectIds.size());
+
+    if (Buffer *buffer = o->as<Buffer>()) {
+        const QTypedArrayDataSlice<char> &data = buffer->d()->data;
+        node.type = Node::Bytes;
+        // Slices, their parent and pooled Buffers share the allocation, which the other thread
+        // must not see, so only a Buffer owning all of it hands it over
+        const bool owned = !data.isShared() && data.size() == data.allocatedSize();
+        node.data = owned && m_transfer.contains(o->d()) ? data : copyData(data);
+        m_nodes.append(node);
+        return true;
+    }
+
+    if (QV4::DateObject *date = o->asDateObject()) {
+        const QDateTime dateTime = date->toQDateTime();
+        node.type = Node::Date;
+        node.number = dateTime.isValid() ? double(dateTime.toMSecsSinceEpoch()) : qQNaN();
+        m_nodes.append(node);
+        return true;
+    }
+
+    if (QV4::RegExpObject *regExp = o->as<QV4::RegExpObject>()) {
+        node.type = Node::RegExp;
+        node.string = regExp->source();
+        node.number = regExp->flags();
+        m_nodes.append(node);
+        return true;
+    }
+
+    const int nodeIndex = m_nodes.size();
+    m_nodes.append(node);
+    QV4::ScopedValue v(scope);
+
+    if (o->asErrorObject()) {
+        m_nodes[nodeIndex].type = Node::Error;
+        m_nodes[nodeIndex].number = 3;
+        QV4::ScopedString s(scope);
+        static const char *const properties[] = { "name", "message", "stack" };
+        for (const char *property : properties) {
+            s = v4->newString(QString::fromLatin1(property));
+            v = o->get(s);
+            if (v4->hasException)
+                return false;
+            if (!v->isUndefined())
+                v = v->toString(v4)->asReturnedValue();
+            if (v4->hasException || !write(v4, v, s->toQString()))
+                return false;
+        }
+        return true;
+    }
+
+    if (o->asArrayObject()) {
+        const uint length = o->getLength();
+        m_nodes[nodeIndex].type = Node::Array;
+        m_nodes[nodeIndex].number = length;
+        // Holes become undefined
+        for (uint i = 0; i < length; ++i) {
+            v = o->getIndexed(i);
+            if (v4->hasException || !write(v4, v, QString()))
+                return false;
+        }
+        return true;
+    }
+
+    // Other objects keep their own enumerable properties, but not their prototype
+    m_nodes[nodeIndex].type = Node::Object;
+    QV4::ObjectIterator it(scope, o, QV4::ObjectIterator::EnumerableOnly);
+    QV4::ScopedValue key(scope);
+    int count = 0;
+    for (;;) {
+        key = it.nextPropertyNameAsString(v);
+        if (v4->hasException)
+            return false;
+        if (key->isNull())
+            break;
+        if (!write(v4, v, key->toQStringNoThrow()))
+            return false;
+        ++count;
+    }
+    m_nodes[nodeIndex].number = count;
+    return true;
+}
+
+QV4::ReturnedValue StructuredClone::read(QV4::ExecutionEngine *v4, int *index,
+                                         QV4::Object *objects) const
+{
+    const Node &node = m_nodes.at((*index)++);
+
+    switch (node.type) {
+    case Node::Undefined:
+        return QV4::Encode::undefined();
+    case Node::Null:
+        return QV4::Encode::null();
+    case Node::Boolean:
+        return QV4::Encode(node.number != 0);
+    case Node::Number:
+        return QV4::Encode(node.number);
+    case Node::String:
+        return v4->newString(node.string)->asReturnedValue();
+    case Node::Reference:
+        return objects->getIndexed(uint(node.number));
+    default:
+        break;
+    }
+
+    QV4::Scope scope(v4);
+    QV4::ScopedObject o(scope);
+    switch (node.type) {
+    case Node::Bytes:
+        o = v4->memoryManager->alloc<Buffer>(v4, node.data);
+        break;
+    case Node::Date:
+        o = v4->newDateObject(QV4::Primitive::fromDouble(node.number));
+        break;
+    case Node::RegExp:
+        o = v4->newRegExpObject(node.string, int(node.number));
+        break;
+    case Node::Error:
+        o = v4->newErrorObject(QString());
+        break;
+    case Node::Array:
+        o = v4->newArrayObject();
+        break;
+    default:
+        o = v4->newObject();
+        break;
+    }
+    objects->push_back(o);
+
+    QV4::ScopedValue v(scope);
+    if (node.type == Node::Array) {
+        const uint length = uint(node.number);
+        for (uint i = 0; i < length; ++i) {
+            v = read(v4, index, objects);
+            o->putIndexed(i, v);
+        }
+    } else if (node.type == Node::Error || node.type == Node::Object) {
+        QV4::ScopedString s(scope);
+        const int count = int(node.number);
+        for (int i = 0; i < count; ++i) {
+            s = v4->newString(m_nodes.at(*index).name);
+            v = read(v4, index, objects);
+            if (node.type == Node::Error && v->isUndefined())
+                continue;
+            o->put(s, v);
+        }
+    }
+
+    return o.asReturnedValue();
+}
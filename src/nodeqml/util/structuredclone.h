@@ -0,0 +1,79 @@
+#ifndef STRUCTUREDCLONE_H
+#define STRUCTUREDCLONE_H
+
+#include "qarraydataslice.h"
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include <private/qv4object_p.h>
+
+namespace NodeQml {
+
+/*!
+  \internal
+  A copy of a JS value that can be recreated in another engine, on another thread, as done by
+  worker.postMessage(). The clone holds no engine values, only implicitly shared Qt data, so it can
+  be handed between threads. Objects are stored as a flat list of nodes in pre-order; an object
+  reached a second time becomes a reference to its first occurrence, which keeps shared and cyclic
+  structures intact.
+
+  Buffers are copied, unless listed in the transfer list, in which case the clone takes over their
+  reference counted data if no other Buffer shares it, and the Buffers are emptied.
+*/
+class StructuredClone
+{
+public:
+    bool serialize(QV4::ExecutionEngine *v4, const QV4::Value &value,
+                   const QV4::Value &transferList);
+    QV4::ReturnedValue deserialize(QV4::ExecutionEngine *v4) const;
+
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+
+private:
+    struct Node {
+        enum Type : quint8 {
+            Undefined,
+            Null,
+            Boolean,
+            Number,
+            String,
+            Date,
+            RegExp,
+            Bytes,
+            // Followed by its name, message and stack
+            Error,
+            // Followed by its elements
+            Array,
+            // Followed by its own enumerable properties
+            Object,
+            // An object seen before
+            Reference
+        };
+
+        Type type = Undefined;
+        // Booleans, numbers, dates, RegExp flags, the length of arrays, the property count of
+        // errors and objects, and the index of referenced objects in order of appearance
+        double number = 0;
+        // Strings and RegExp sources
+        QString string;
+        // The property name of an object's or error's properties
+        QString name;
+        QTypedArrayDataSlice<char> data;
+    };
+
+    bool write(QV4::ExecutionEngine *v4, const QV4::Value &value, const QString &name);
+    QV4::ReturnedValue read(QV4::ExecutionEngine *v4, int *index, QV4::Object *objects) const;
+
+    QVector<Node> m_nodes;
+
+    // Only used while serializing
+    QHash<QV4::Heap::Base *, int> m_objectIds;
+    QSet<QV4::Heap::Base *> m_transfer;
+};
+
+} // namespace NodeQml
+
+#endif // STRUCTUREDCLONE_H
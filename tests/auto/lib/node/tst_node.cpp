@@ -1,17 +1,1067 @@
 #include <nodeqml/engine.h>
 
+#include <QJSEngine>
 #include <QtTest/QtTest>
 
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
 class tst_node: public QObject
 {
     Q_OBJECT
 private slots:
-    void run();
+    void init();
+    void cleanup();
+
+    void path_data();
+    void path();
+
+    void bufferFill_data();
+    void bufferFill();
+    void bufferWriteArray();
+    void bufferArrayRange_data();
+    void bufferArrayRange();
+    void bufferExternalMemory();
+    void bufferSliceCompaction();
+
+    void stringDecoder_data();
+    void stringDecoder();
+
+    void fsAsync();
+    void fsIoUring();
+    void readFileSync();
+    void fileStreams();
+    void vectoredIo();
+
+    void copyFile();
+
+    void stats();
+    void readdir();
+    void walk();
+
+    void format_data();
+    void format();
+    void formatRepeated();
+
+    void eventEmitterOnce();
+    void eventEmitterMaxListenersGetter();
+
+    void isDeepStrictEqual_data();
+    void isDeepStrictEqual();
+
+    void processEnv();
+
+    void consoleOutput();
+
+    void childOutputWithoutListener();
+    void childOutputToOnceListener();
+
+    void fsWatch();
+    void fsWatchFile();
+    void resetWithUnrefdWatcher();
+
+    void workerMessage();
+    void workerTransferSlice();
+
+    void multipleEngines();
+
+private:
+    QJSValue evaluate(const QString &program);
+    bool startEchoWorker(QTemporaryDir *dir);
+    QJSValue startFileOperations(const QString &dir);
+    QByteArray captureOutput(const QString &program);
+
+    QJSEngine *m_jsEngine = nullptr;
+    NodeQml::Engine *m_engine = nullptr;
 };
 
-void tst_node::run()
+void tst_node::init()
+{
+    m_jsEngine = new QJSEngine();
+    m_engine = new NodeQml::Engine(m_jsEngine);
+}
+
+void tst_node::cleanup()
+{
+    delete m_engine;
+    m_engine = nullptr;
+    delete m_jsEngine;
+    m_jsEngine = nullptr;
+}
+
+// Runs program in the global scope, where require() is available
+QJSValue tst_node::evaluate(const QString &program)
+{
+    return m_jsEngine->evaluate(program);
+}
+
+/*
+  Runs program with stdout and stderr redirected into one pipe, and returns what was written
+  once the engine has been reset, which waits for buffered output.
+*/
+QByteArray tst_node::captureOutput(const QString &program)
+{
+    int fds[2];
+    if (::pipe(fds))
+        return QByteArray();
+    // Large enough for everything the tests write, the pipe is only read afterwards
+    ::fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+
+    fflush(stdout);
+    fflush(stderr);
+    const int savedStdout = ::dup(STDOUT_FILENO);
+    const int savedStderr = ::dup(STDERR_FILENO);
+    ::dup2(fds[1], STDOUT_FILENO);
+    ::dup2(fds[1], STDERR_FILENO);
+    ::close(fds[1]);
+
+    evaluate(program);
+    m_engine->reset();
+
+    ::dup2(savedStdout, STDOUT_FILENO);
+    ::dup2(savedStderr, STDERR_FILENO);
+    ::close(savedStdout);
+    ::close(savedStderr);
+
+    QByteArray output;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::read(fds[0], buffer, sizeof(buffer))) > 0)
+        output.append(buffer, n);
+    ::close(fds[0]);
+    return output;
+}
+
+// The log left by startFileOperations()
+const char *const FileOperationsLog =
+        "writeFile null|readFile hello|open number|read 5 hello|write 1|fstat 5|fsync null|"
+        "close null|readFile Jello|stat stat 2|rename null|unlink null|done";
+
+// Runs asynchronous fs calls in dir one after another, appending their results to the global log
+QJSValue tst_node::startFileOperations(const QString &dir)
+{
+    m_jsEngine->globalObject().setProperty("dir", dir);
+    return evaluate(
+            "var fs = require('fs'), file = dir + '/file', log = [], fd;"
+            "var steps = ["
+            "    function(next) { fs.writeFile(file, 'hello', function(err) {"
+            "        log.push('writeFile ' + err); next(); }); },"
+            "    function(next) { fs.readFile(file, 'utf8', function(err, data) {"
+            "        log.push('readFile ' + data); next(); }); },"
+            "    function(next) { fs.open(file, 'r+', function(err, result) {"
+            "        fd = result; log.push('open ' + (typeof fd)); next(); }); },"
+            "    function(next) { fs.read(fd, new Buffer(8), 0, 8, 0, function(err, n, buffer) {"
+            "        log.push('read ' + n + ' ' + buffer.toString('utf8', 0, n)); next(); }); },"
+            "    function(next) { fs.write(fd, new Buffer('J'), 0, 1, 0, function(err, n) {"
+            "        log.push('write ' + n); next(); }); },"
+            "    function(next) { fs.fstat(fd, function(err, stats) {"
+            "        log.push('fstat ' + stats.size); next(); }); },"
+            "    function(next) { fs.fsync(fd, function(err) { log.push('fsync ' + err); next(); }); },"
+            "    function(next) { fs.close(fd, function(err) { log.push('close ' + err); next(); }); },"
+            "    function(next) { fs.readFile(file, function(err, data) {"
+            "        log.push('readFile ' + data.toString()); next(); }); },"
+            "    function(next) { fs.stat(dir + '/missing', function(err) {"
+            "        log.push('stat ' + err.syscall + ' ' + err.errno); next(); }); },"
+            "    function(next) { fs.rename(file, dir + '/renamed', function(err) {"
+            "        log.push('rename ' + err); next(); }); },"
+            "    function(next) { fs.unlink(dir + '/renamed', function(err) {"
+            "        log.push('unlink ' + err); next(); }); }"
+            "];"
+            "(function next() { var step = steps.shift(); if (step) step(next); else log.push('done'); })();");
+}
+
+// Starts a worker as the global worker, which posts back each message it receives
+bool tst_node::startEchoWorker(QTemporaryDir *dir)
+{
+    QFile file(dir->filePath("echo.js"));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write("var parentPort = require('worker_threads').parentPort;\n"
+               "parentPort.on('message', function(message) { parentPort.postMessage(message); });\n");
+    file.close();
+
+    m_jsEngine->globalObject().setProperty("workerFile", file.fileName());
+    const QJSValue result = evaluate(
+            "var replies = [];"
+            "var worker = new (require('worker_threads').Worker)(workerFile);"
+            "worker.on('message', function(message) { replies.push(message); });");
+    return !result.isError();
+}
+
+// Expected results are those of Node's path.posix
+void tst_node::path_data()
+{
+    QTest::addColumn<QString>("function");
+    QTest::addColumn<QStringList>("arguments");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("normalize(\"\")")
+            << QString("normalize") << QStringList{""} << QString(".");
+    QTest::newRow("normalize(\".\")")
+            << QString("normalize") << QStringList{"."} << QString(".");
+    QTest::newRow("normalize(\"/\")")
+            << QString("normalize") << QStringList{"/"} << QString("/");
+    QTest::newRow("normalize(\"//a//b/\")")
+            << QString("normalize") << QStringList{"//a//b/"} << QString("/a/b/");
+    QTest::newRow("normalize(\"a/../..\")")
+            << QString("normalize") << QStringList{"a/../.."} << QString("..");
+    QTest::newRow("normalize(\"/a/../..\")")
+            << QString("normalize") << QStringList{"/a/../.."} << QString("/");
+    QTest::newRow("normalize(\"./a/./b/../c\")")
+            << QString("normalize") << QStringList{"./a/./b/../c"} << QString("a/c");
+    QTest::newRow("normalize(\"a/b/../../../c/\")")
+            << QString("normalize") << QStringList{"a/b/../../../c/"} << QString("../c/");
+    QTest::newRow("normalize(\"...\")")
+            << QString("normalize") << QStringList{"..."} << QString("...");
+    QTest::newRow("normalize(\"/..a/..b\")")
+            << QString("normalize") << QStringList{"/..a/..b"} << QString("/..a/..b");
+    QTest::newRow("join()")
+            << QString("join") << QStringList{} << QString(".");
+    QTest::newRow("join(\"\", \"\")")
+            << QString("join") << QStringList{"", ""} << QString(".");
+    QTest::newRow("join(\"a\", \"b\")")
+            << QString("join") << QStringList{"a", "b"} << QString("a/b");
+    QTest::newRow("join(\"/a\", \"../b\", \"c/\")")
+            << QString("join") << QStringList{"/a", "../b", "c/"} << QString("/b/c/");
+    QTest::newRow("join(\"a\", \"\", \"..\", \"..\")")
+            << QString("join") << QStringList{"a", "", "..", ".."} << QString("..");
+    QTest::newRow("join(\".\", \"/\")")
+            << QString("join") << QStringList{".", "/"} << QString("./");
+    QTest::newRow("resolve(\"/a/b\", \"./c\")")
+            << QString("resolve") << QStringList{"/a/b", "./c"} << QString("/a/b/c");
+    QTest::newRow("resolve(\"/a/b\", \"/c\", \"d\")")
+            << QString("resolve") << QStringList{"/a/b", "/c", "d"} << QString("/c/d");
+    QTest::newRow("resolve(\"/\", \"..\", \"x\")")
+            << QString("resolve") << QStringList{"/", "..", "x"} << QString("/x");
+    QTest::newRow("resolve(\"/a/b/\", \"../\")")
+            << QString("resolve") << QStringList{"/a/b/", "../"} << QString("/a");
+    QTest::newRow("relative(\"/a/b/c\", \"/a/d\")")
+            << QString("relative") << QStringList{"/a/b/c", "/a/d"} << QString("../../d");
+    QTest::newRow("relative(\"/a/b\", \"/a/b\")")
+            << QString("relative") << QStringList{"/a/b", "/a/b"} << QString("");
+    QTest::newRow("relative(\"/a\", \"/a/b/c\")")
+            << QString("relative") << QStringList{"/a", "/a/b/c"} << QString("b/c");
+    QTest::newRow("relative(\"/a/bc\", \"/a/b\")")
+            << QString("relative") << QStringList{"/a/bc", "/a/b"} << QString("../b");
+    QTest::newRow("relative(\"/\", \"/a\")")
+            << QString("relative") << QStringList{"/", "/a"} << QString("a");
+    QTest::newRow("relative(\"/a\", \"/\")")
+            << QString("relative") << QStringList{"/a", "/"} << QString("..");
+    QTest::newRow("dirname(\"\")")
+            << QString("dirname") << QStringList{""} << QString(".");
+    QTest::newRow("dirname(\"/\")")
+            << QString("dirname") << QStringList{"/"} << QString("/");
+    QTest::newRow("dirname(\"a\")")
+            << QString("dirname") << QStringList{"a"} << QString(".");
+    QTest::newRow("dirname(\"/a\")")
+            << QString("dirname") << QStringList{"/a"} << QString("/");
+    QTest::newRow("dirname(\"/a/b/\")")
+            << QString("dirname") << QStringList{"/a/b/"} << QString("/a");
+    QTest::newRow("dirname(\"a//b\")")
+            << QString("dirname") << QStringList{"a//b"} << QString("a/");
+    QTest::newRow("dirname(\"//a\")")
+            << QString("dirname") << QStringList{"//a"} << QString("//");
+    QTest::newRow("basename(\"/a/b.js\")")
+            << QString("basename") << QStringList{"/a/b.js"} << QString("b.js");
+    QTest::newRow("basename(\"/a/b.js\", \".js\")")
+            << QString("basename") << QStringList{"/a/b.js", ".js"} << QString("b");
+    QTest::newRow("basename(\"/a/b/\")")
+            << QString("basename") << QStringList{"/a/b/"} << QString("b");
+    QTest::newRow("basename(\"b.js\", \"b.js\")")
+            << QString("basename") << QStringList{"b.js", "b.js"} << QString("");
+    QTest::newRow("basename(\"\")")
+            << QString("basename") << QStringList{""} << QString("");
+    QTest::newRow("basename(\"/\")")
+            << QString("basename") << QStringList{"/"} << QString("");
+    QTest::newRow("basename(\"a/b.js\", \"js\")")
+            << QString("basename") << QStringList{"a/b.js", "js"} << QString("b.");
+    QTest::newRow("extname(\"a.b.c\")")
+            << QString("extname") << QStringList{"a.b.c"} << QString(".c");
+    QTest::newRow("extname(\".bashrc\")")
+            << QString("extname") << QStringList{".bashrc"} << QString("");
+    QTest::newRow("extname(\"a.\")")
+            << QString("extname") << QStringList{"a."} << QString(".");
+    QTest::newRow("extname(\"a\")")
+            << QString("extname") << QStringList{"a"} << QString("");
+    QTest::newRow("extname(\"a/.b\")")
+            << QString("extname") << QStringList{"a/.b"} << QString("");
+    QTest::newRow("extname(\"..\")")
+            << QString("extname") << QStringList{".."} << QString("");
+    QTest::newRow("extname(\"a.b/\")")
+            << QString("extname") << QStringList{"a.b/"} << QString(".b");
+    QTest::newRow("extname(\".a.b\")")
+            << QString("extname") << QStringList{".a.b"} << QString(".b");
+    QTest::newRow("isAbsolute(\"/a\")")
+            << QString("isAbsolute") << QStringList{"/a"} << QString("true");
+    QTest::newRow("isAbsolute(\"a\")")
+            << QString("isAbsolute") << QStringList{"a"} << QString("false");
+    QTest::newRow("isAbsolute(\"\")")
+            << QString("isAbsolute") << QStringList{""} << QString("false");
+}
+
+void tst_node::path()
+{
+    QFETCH(QString, function);
+    QFETCH(QStringList, arguments);
+    QFETCH(QString, expected);
+
+    QJSValue path = m_engine->require(QStringLiteral("path"));
+    QVERIFY(path.isObject());
+
+    QJSValueList args;
+    foreach (const QString &argument, arguments)
+        args.append(argument);
+    const QJSValue result = path.property(function).callWithInstance(path, args);
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), expected);
+}
+
+void tst_node::bufferFill_data()
+{
+    QTest::addColumn<QString>("arguments");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("empty string") << QString("''") << QString("00000000");
+    QTest::newRow("empty hex string") << QString("'', 'hex'") << QString("00000000");
+    QTest::newRow("hex") << QString("'abz', 'hex'") << QString("abababab");
+    QTest::newRow("character") << QString("'a'") << QString("61616161");
+    QTest::newRow("invalid hex") << QString("'zz', 'hex'") << QString();
+    QTest::newRow("odd hex") << QString("'a', 'hex'") << QString();
+    QTest::newRow("invalid base64") << QString("'!!!!', 'base64'") << QString();
+    QTest::newRow("empty buffer") << QString("new Buffer(0)") << QString();
+}
+
+void tst_node::bufferFill()
+{
+    QFETCH(QString, arguments);
+    QFETCH(QString, expected);
+
+    const QJSValue result = evaluate(QString(
+            "var b = new Buffer(4); b.fill('x'); b.fill(%1).toString('hex');").arg(arguments));
+    if (expected.isEmpty()) {
+        QVERIFY(result.isError());
+    } else {
+        QVERIFY2(!result.isError(), qPrintable(result.toString()));
+        QCOMPARE(result.toString(), expected);
+    }
+}
+
+void tst_node::bufferWriteArray()
+{
+    QJSValue result = evaluate(
+            "var b = new Buffer(8); b.fill(0);"
+            "b.writeDoubleLEArray([1e300]); b.readDoubleLEArray(0, 1)[0];");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toNumber(), 1e300);
+
+    result = evaluate("b.writeFloatBEArray([1.5, -2.25]); b.readFloatBEArray(0, 2).join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("1.5,-2.25"));
+
+    // A failing element leaves the buffer untouched
+    evaluate("b.fill(0);");
+    result = evaluate("b.writeInt8Array([1, 2, 300]);");
+    QVERIFY(result.isError());
+    QCOMPARE(evaluate("b.toString('hex')").toString(), QString("0000000000000000"));
+
+    result = evaluate("b.writeInt8Array([1, { valueOf: function() { throw new Error('x'); } }]);");
+    QVERIFY(result.isError());
+    QCOMPARE(evaluate("b.toString('hex')").toString(), QString("0000000000000000"));
+}
+
+void tst_node::bufferArrayRange_data()
+{
+    QTest::addColumn<QString>("call");
+
+    QTest::newRow("negative offset") << QString("readInt8Array(-1, 1)");
+    QTest::newRow("fractional offset") << QString("readInt8Array(0.5, 1)");
+    QTest::newRow("NaN offset") << QString("readInt8Array(NaN, 1)");
+    QTest::newRow("offset past the end") << QString("readInt8Array(9)");
+    QTest::newRow("negative count") << QString("readInt8Array(0, -1)");
+    QTest::newRow("infinite count") << QString("readInt8Array(0, Infinity)");
+    QTest::newRow("huge count") << QString("readDoubleLEArray(0, Math.pow(2, 61))");
+    QTest::newRow("count past the end") << QString("readInt32BEArray(4, 2)");
+    QTest::newRow("negative write offset") << QString("writeInt8Array([1], -1)");
+    QTest::newRow("huge write offset") << QString("writeInt8Array([1], Math.pow(2, 64))");
+    QTest::newRow("write past the end") << QString("writeDoubleBEArray([1, 2], 1)");
+}
+
+void tst_node::bufferArrayRange()
+{
+    QFETCH(QString, call);
+
+    const QJSValue result = evaluate(QString("new Buffer(8).%1").arg(call));
+    QVERIFY(result.isError());
+    QCOMPARE(result.property("name").toString(), QString("RangeError"));
+}
+
+void tst_node::bufferExternalMemory()
+{
+    // Slices and views share the allocation of their parent, which is counted once
+    const QJSValue result = evaluate(
+            "var before = process.memoryUsage().external;"
+            "var b = new Buffer(1048576), views = [new Buffer(b)];"
+            "for (var i = 0; i < 10; ++i) views.push(b.slice(i, i + 10));"
+            "process.memoryUsage().external - before;");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toInt(), 1048576);
+}
+
+void tst_node::bufferSliceCompaction()
+{
+    m_engine->setSliceCompaction(4096, 0.25);
+
+    // Slicing in a loop keeps one candidate, the last slice, which is compacted once the parent
+    // has been collected
+    const QJSValue result = evaluate(
+            "var parent = new Buffer(65536);"
+            "for (var i = 0; i < 1000; ++i) parent.slice(i, i + 16);"
+            "var kept = parent.slice(0, 16);"
+            "parent = null;");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    m_jsEngine->collectGarbage();
+
+    QTRY_COMPARE(m_engine->sliceCompactionReclaimed(), qint64(65536 - 16));
+    QCOMPARE(evaluate("kept.length").toInt(), 16);
+}
+
+void tst_node::stringDecoder_data()
+{
+    QTest::addColumn<QString>("encoding");
+    QTest::addColumn<QString>("chunks");
+    QTest::addColumn<QString>("expected");
+
+    // The results of each write() and of end(), separated by |
+    QTest::newRow("utf8") << QString("utf8") << QString("'e2', '82ac', '61'")
+                          << QString::fromUtf8("|\xe2\x82\xac|a|");
+    QTest::newRow("utf8 four bytes") << QString("utf8") << QString("'f09f', '98', '80'")
+                                     << QString::fromUtf8("||\xf0\x9f\x98\x80|");
+    QTest::newRow("utf8 incomplete") << QString("utf8") << QString("'61e282'")
+                                     << QString::fromUtf8("a|\xef\xbf\xbd");
+    QTest::newRow("utf8 interrupted") << QString("utf8") << QString("'e2', '61'")
+                                      << QString::fromUtf8("|\xef\xbf\xbda|");
+    QTest::newRow("ucs2") << QString("ucs2") << QString("'61', '00ac', '20'")
+                          << QString::fromUtf8("|a|\xe2\x82\xac|");
+    QTest::newRow("ucs2 surrogates") << QString("ucs2") << QString("'3dd8', '00de'")
+                                     << QString::fromUtf8("|\xf0\x9f\x98\x80|");
+    QTest::newRow("base64") << QString("base64") << QString("'6162', '6364'")
+                            << QString("|YWJj|ZA==");
+    QTest::newRow("hex") << QString("hex") << QString("'ab', 'cd'") << QString("ab|cd|");
+}
+
+void tst_node::stringDecoder()
+{
+    QFETCH(QString, encoding);
+    QFETCH(QString, chunks);
+    QFETCH(QString, expected);
+
+    const QJSValue result = evaluate(QString(
+            "var decoder = new (require('string_decoder').StringDecoder)('%1');"
+            "[%2].map(function(chunk) { return decoder.write(new Buffer(chunk, 'hex')); })"
+            "    .concat(decoder.end()).join('|');").arg(encoding, chunks));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), expected);
+}
+
+void tst_node::fsAsync()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // Everything on the thread pool
+    m_engine->setIoUringEnabled(false);
+    m_engine->setThreadPoolSize(2);
+    const QJSValue result = startFileOperations(dir.path());
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_COMPARE(evaluate("log.join('|')").toString(), QString(FileOperationsLog));
+    QVERIFY(!QFile::exists(dir.filePath("renamed")));
+}
+
+void tst_node::fsIoUring()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    if (!m_engine->setIoUringEnabled(true))
+        QSKIP("io_uring is not available");
+    const QJSValue result = startFileOperations(dir.path());
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_COMPARE(evaluate("log.join('|')").toString(), QString(FileOperationsLog));
+    QVERIFY(!QFile::exists(dir.filePath("renamed")));
+}
+
+void tst_node::readFileSync()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile file(dir.filePath("large"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QByteArray data(100000, 'a');
+    data[99999] = 'z';
+    file.write(data);
+    file.close();
+    file.setFileName(dir.filePath("text"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("h\xc3\xa9llo");
+    file.close();
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    QJSValue result = evaluate(
+            "var fs = require('fs'), data = fs.readFileSync(dir + '/large');"
+            "data.length + ' ' + String.fromCharCode(data[99999]);");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("100000 z"));
+
+    result = evaluate("fs.readFileSync(dir + '/text', 'utf8');");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString::fromUtf8("h\xc3\xa9llo"));
+
+    result = evaluate("fs.readFileSync(dir + '/text', { encoding: 'hex' });");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("68c3a96c6c6f"));
+
+    // Files reporting a size of 0 are read until their end
+    result = evaluate("fs.readFileSync('/proc/self/stat', 'binary').length > 0;");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QVERIFY(result.toBool());
+
+    result = evaluate("try { fs.readFileSync(dir + '/missing'); 'no error'; }"
+                      "catch (e) { e.syscall + ' ' + e.errno + ' ' + e.path; }");
+    QCOMPARE(result.toString(), QString("open 2 %1/missing").arg(dir.path()));
+}
+
+void tst_node::fileStreams()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    // write() reports backpressure past the high water mark until 'drain', then the file is read
+    // back in chunks of the high water mark and piped into a copy
+    const QJSValue result = evaluate(
+            "var fs = require('fs'), log = [];"
+            "var out = fs.createWriteStream(dir + '/out', { highWaterMark: 16 });"
+            "log.push(out.write('0123456789'), out.write('abcdefghij'));"
+            "out.on('drain', function() { log.push('drain'); out.end('!'); });"
+            "out.on('finish', function() {"
+            "    log.push('finish ' + fs.readFileSync(dir + '/out', 'utf8'));"
+            "    var chunks = [], input = fs.createReadStream(dir + '/out', { highWaterMark: 8 });"
+            "    input.on('data', function(chunk) { chunks.push(chunk.length); });"
+            "    input.on('end', function() {"
+            "        log.push('chunks ' + chunks.join());"
+            "        var copy = fs.createWriteStream(dir + '/copy', { highWaterMark: 4 });"
+            "        copy.on('finish', function() {"
+            "            log.push('copy ' + fs.readFileSync(dir + '/copy', 'utf8'));"
+            "        });"
+            "        fs.createReadStream(dir + '/out', { highWaterMark: 4 }).pipe(copy);"
+            "    });"
+            "});");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_COMPARE(evaluate("log.join('|')").toString(),
+                 QString("true|false|drain|finish 0123456789abcdefghij!|chunks 8,8,5|"
+                         "copy 0123456789abcdefghij!"));
+}
+
+void tst_node::vectoredIo()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    // Buffers are filled and drained in order, continuing at the given position
+    const QJSValue result = evaluate(
+            "var fs = require('fs'), log = [];"
+            "fs.open(dir + '/v', 'w+', function(err, fd) {"
+            "    log.push(fs.writevSync(fd, [new Buffer('ab'), new Buffer('cde')], 0));"
+            "    var a = new Buffer(3), b = new Buffer(1);"
+            "    log.push(fs.readvSync(fd, [a, b], 1), a.toString() + b.toString());"
+            "    fs.writev(fd, [new Buffer('fg'), new Buffer('h')], 5, function(err, written, buffers) {"
+            "        log.push(err, written, buffers.length);"
+            "        var c = new Buffer(4), d = new Buffer(4);"
+            "        fs.readv(fd, [c, d], 0, function(err, read) {"
+            "            log.push(err, read, c.toString() + d.toString());"
+            "            fs.close(fd, function(err) { log.push('close ' + err); });"
+            "        });"
+            "    });"
+            "});");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_COMPARE(evaluate("log.join('|')").toString(),
+                 QString("5|4|bcde|null|3|2|null|8|abcdefgh|close null"));
+}
+
+void tst_node::copyFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString source = dir.filePath("source");
+    const QString destination = dir.filePath("destination");
+
+    QFile file(source);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("hello");
+    file.close();
+    file.setFileName(destination);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("longer contents");
+    file.close();
+
+    QJSValue fs = m_engine->require(QStringLiteral("fs"));
+    QJSValue copyFileSync = fs.property("copyFileSync");
+
+    // Copying a file onto itself must not truncate it
+    QJSValue result = copyFileSync.callWithInstance(fs, QJSValueList() << source << source);
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArray("hello"));
+    file.close();
+
+    result = copyFileSync.callWithInstance(fs, QJSValueList() << source << destination);
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    file.setFileName(destination);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArray("hello"));
+}
+
+void tst_node::stats()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile file(dir.filePath("a"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write("hello"), qint64(5));
+    file.close();
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    QJSValue result = evaluate(
+            "var fs = require('fs'), st = fs.statSync(dir + '/a');"
+            "[st.size, st.isFile(), st.isDirectory(), fs.statSync(dir).isDirectory(),"
+            " st.mtime instanceof Date, st.mtime === st.mtime,"
+            " Math.abs(st.mtime.getTime() - st.mtimeMs) < 1,"
+            " JSON.parse(JSON.stringify(st)).size].join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("5,true,false,true,true,true,true,5"));
+
+    // [dev, ino, mode, nlink, uid, gid, rdev, size, blksize, blocks, atimeMs, mtimeMs, ctimeMs]
+    result = evaluate(
+            "var compact = fs.statSync(dir + '/a', { compact: true });"
+            "[Array.isArray(compact), compact.length, compact[1] == st.ino, compact[2] == st.mode,"
+            " compact[7], compact[11] == st.mtimeMs].join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("true,13,true,true,5,true"));
+
+    result = evaluate(
+            "var log = [];"
+            "fs.stat(dir + '/a', { compact: true }, function(err, st) {"
+            "    log.push(err, Array.isArray(st) ? st[7] : st);"
+            "    fs.stat(dir + '/a', function(err, st) { log.push(err, st.size, st.isFile()); });"
+            "});");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QTRY_COMPARE(evaluate("log.join('|')").toString(), QString("null|5|null|5|true"));
+}
+
+void tst_node::readdir()
 {
-    QVERIFY(true);
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir(dir.path()).mkpath("sub"));
+    QFile a(dir.filePath("a"));
+    QVERIFY(a.open(QIODevice::WriteOnly));
+    a.close();
+    QFile b(dir.filePath("sub/b"));
+    QVERIFY(b.open(QIODevice::WriteOnly));
+    b.close();
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    QJSValue result = evaluate("var fs = require('fs'); fs.readdirSync(dir).sort().join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("a,sub"));
+
+    result = evaluate("fs.readdirSync(dir, { recursive: true }).sort().join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("a,sub,sub/b"));
+
+    result = evaluate(
+            "fs.readdirSync(dir, { withFileTypes: true, recursive: true }).map(function(entry) {"
+            "    return (entry.parentPath == dir ? '' : entry.parentPath.slice(dir.length + 1) + '/')"
+            "            + entry.name + (entry.isDirectory() ? ':d' : entry.isFile() ? ':f' : ':?');"
+            "}).sort().join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("a:f,sub/b:f,sub:d"));
+
+    result = evaluate("try { fs.readdirSync(dir + '/missing'); } catch (e) { e.errno; }");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toInt(), 2); // ENOENT
+
+    result = evaluate(
+            "var log = [];"
+            "fs.readdir(dir, { withFileTypes: true }, function(err, entries) {"
+            "    log.push(err, entries.map(function(entry) { return entry.name; }).sort().join());"
+            "});");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QTRY_COMPARE(evaluate("log.join('|')").toString(), QString("null|a,sub"));
+}
+
+void tst_node::walk()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir(dir.path()).mkpath("sub/sub"));
+    for (const char *name : { "a", "sub/b", "sub/sub/c" }) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    // Each batch is a single 'data' event, the next one is read after it has been emitted
+    const QJSValue result = evaluate(
+            "var paths = [], batches = 0, ended = false;"
+            "var walker = require('fs').walk(dir, { batchSize: 2 });"
+            "walker.on('data', function(entries) { ++batches; paths = paths.concat(entries); });"
+            "walker.on('end', function() { ended = true; });");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_VERIFY(evaluate("ended").toBool());
+    QCOMPARE(evaluate("paths.sort().join()").toString(),
+             QString("a,sub,sub/b,sub/sub,sub/sub/c"));
+    QVERIFY(evaluate("batches").toInt() >= 3);
+}
+
+void tst_node::format_data()
+{
+    QTest::addColumn<QString>("arguments");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("object and string") << QString("{ a: 1 }, 'x'") << QString("{ a: 1 } x");
+    QTest::newRow("number and string") << QString("1, 'x', 2") << QString("1 x 2");
+    QTest::newRow("placeholders") << QString("'%s=%d', 'a', 1") << QString("a=1");
+    QTest::newRow("extra arguments") << QString("'%s', 'a', 'b', { c: 2 }")
+                                     << QString("a b { c: 2 }");
+    QTest::newRow("json") << QString("'%j', { a: [1] }") << QString("{\"a\":[1]}");
+    QTest::newRow("json cycle") << QString("'%j', (function() { var o = {}; o.o = o; return o; })()")
+                                << QString("[Circular]");
+    QTest::newRow("json throwing") << QString("'%j', { toJSON: function() { throw new Error('x'); } }")
+                                   << QString();
+    QTest::newRow("escaped percent") << QString("'100%% %s', 'a'") << QString("100% a");
+    QTest::newRow("placeholders past the arguments") << QString("'%s %d %%', 'a'")
+                                                     << QString("a %d %%");
+    QTest::newRow("trailing percent") << QString("'50%', 1") << QString("50% 1");
+    QTest::newRow("unknown placeholder") << QString("'%x %s', 'a'") << QString("%x a");
+    QTest::newRow("adjacent placeholders") << QString("'%s%d%s', 'a', 1, 'b'") << QString("a1b");
+}
+
+void tst_node::format()
+{
+    QFETCH(QString, arguments);
+    QFETCH(QString, expected);
+
+    const QJSValue result = evaluate(QString("require('util').format(%1)").arg(arguments));
+    if (expected.isEmpty()) {
+        QVERIFY(result.isError());
+    } else {
+        QVERIFY2(!result.isError(), qPrintable(result.toString()));
+        QCOMPARE(result.toString(), expected);
+    }
+}
+
+void tst_node::formatRepeated()
+{
+    // Formats are tokenized once per string, more formats than are cached are evicted and
+    // tokenized again, and equal strings built at runtime are tokenized like literals
+    const QJSValue result = evaluate(
+            "var format = require('util').format, results = [];"
+            "for (var i = 0; i < 3; ++i)"
+            "    results.push(format('%s:%d', 'a' + i, i));"
+            "for (var i = 0; i < 100; ++i) {"
+            "    if (format('%s' + i + '%%', 'x') != 'x' + i + '%')"
+            "        results.push('mismatch ' + i);"
+            "}"
+            "results.push(format('%s:%d', 'b', 3), format(['%', 's'].join(''), 'c'));"
+            "results.join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("a0:0,a1:1,a2:2,b:3,c"));
+}
+
+void tst_node::eventEmitterOnce()
+{
+    // The once registration is removed, not the later one of the same function
+    QJSValue result = evaluate(
+            "var EventEmitter = require('events');"
+            "var e = new EventEmitter(), calls = [];"
+            "function f(n) { calls.push(n); }"
+            "e.once('x', f); e.on('x', f); e.emit('x', 1); e.emit('x', 2);"
+            "calls.join() + ' ' + e.listenerCount('x');");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("1,1,2 1"));
+
+    // A once listener called by a nested emit is not called again
+    result = evaluate(
+            "e = new EventEmitter(); calls = [];"
+            "e.once('y', function() { calls.push('a'); e.emit('y'); });"
+            "e.once('y', function() { calls.push('b'); });"
+            "e.emit('y'); calls.join();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("a,b"));
+}
+
+void tst_node::eventEmitterMaxListenersGetter()
+{
+    // The getter adds events of other types while the leak check looks at 'x'
+    const QJSValue result = evaluate(
+            "var e = new (require('events'))(), added = 0;"
+            "e.on('x', function() {});"
+            "Object.defineProperty(e, '_maxListeners', { get: function() {"
+            "    for (var i = 0; i < 32; ++i) e.on('y' + added++, function() {});"
+            "    return 1;"
+            "} });"
+            "e.on('x', function() {}); e.on('x', function() {});"
+            "e.listenerCount('x') + ' ' + e.listenerCount('y0');");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("3 1"));
+}
+
+void tst_node::isDeepStrictEqual_data()
+{
+    QTest::addColumn<QString>("a");
+    QTest::addColumn<QString>("b");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("NaN") << QString("NaN") << QString("NaN") << true;
+    QTest::newRow("zeros") << QString("0") << QString("-0") << false;
+    QTest::newRow("numbers") << QString("1.5") << QString("1.5") << true;
+    QTest::newRow("strings") << QString("'a'") << QString("'a'") << true;
+    QTest::newRow("number and string") << QString("1") << QString("'1'") << false;
+    QTest::newRow("NaN properties") << QString("{ a: NaN }") << QString("{ a: NaN }") << true;
+    QTest::newRow("zero elements") << QString("[-0]") << QString("[0]") << false;
+}
+
+void tst_node::isDeepStrictEqual()
+{
+    QFETCH(QString, a);
+    QFETCH(QString, b);
+    QFETCH(bool, expected);
+
+    const QJSValue result = evaluate(
+            QString("require('util').isDeepStrictEqual(%1, %2)").arg(a, b));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toBool(), expected);
+}
+
+void tst_node::processEnv()
+{
+    qputenv("NODEQML_TEST_VARIABLE", "value");
+    qputenv("NODEQML_TEST_EMPTY", "");
+    qunsetenv("NODEQML_TEST_UNSET");
+
+    QCOMPARE(evaluate("process.env.NODEQML_TEST_VARIABLE").toString(), QString("value"));
+    QCOMPARE(evaluate("process.env.NODEQML_TEST_EMPTY").toString(), QString(""));
+    QVERIFY(evaluate("process.env.NODEQML_TEST_UNSET").isUndefined());
+
+    qunsetenv("NODEQML_TEST_VARIABLE");
+    qunsetenv("NODEQML_TEST_EMPTY");
+}
+
+void tst_node::consoleOutput()
+{
+    // Both streams keep the order of the calls
+    QByteArray output = captureOutput(
+            "console.log('a'); console.error('b'); console.log('\\u00fc'); console.warn('\\ud83d');"
+            "require('util').log('d');");
+    QVERIFY2(output.startsWith("a\nb\n\xc3\xbc\n\xef\xbf\xbd\n"), output.constData());
+    QVERIFY2(output.endsWith(" - d\n"), output.constData());
+
+    // Output past the flush threshold is written right away, still in order
+    output = captureOutput(
+            "var line = new Array(100001).join('x');"
+            "console.log('a'); console.log(line); console.error('b');");
+    QCOMPARE(output.size(), 2 + 100001 + 2);
+    QVERIFY(output.startsWith("a\nxxx"));
+    QVERIFY(output.endsWith("xxx\nb\n"));
+}
+
+void tst_node::childOutputWithoutListener()
+{
+    // Output read before the 'data' listener is attached is kept for it
+    const QJSValue result = evaluate(
+            "var output = '', ended = false;"
+            "var child = require('child_process').spawn('echo', ['hello']);"
+            "setTimeout(function() {"
+            "    child.stdout.on('end', function() { ended = true; });"
+            "    child.stdout.on('data', function(data) { output += data; });"
+            "}, 200);");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_VERIFY(evaluate("ended").toBool());
+    QCOMPARE(evaluate("output").toString(), QString("hello\n"));
+}
+
+void tst_node::childOutputToOnceListener()
+{
+    // once() gets the held back output too, and 'close' waits until stdout has ended
+    const QJSValue result = evaluate(
+            "var output = '', events = [];"
+            "var child = require('child_process').spawn('echo', ['hello']);"
+            "child.on('close', function() { events.push('close'); });"
+            "setTimeout(function() {"
+            "    child.stdout.once('data', function(data) { output += data; events.push('data'); });"
+            "    child.stdout.on('end', function() { events.push('end'); });"
+            "}, 200);");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QTRY_COMPARE(evaluate("events.join()").toString(), QString("data,end,close"));
+    QCOMPARE(evaluate("output").toString(), QString("hello\n"));
+}
+
+void tst_node::fsWatch()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    QFile a(dir.filePath("a"));
+    QVERIFY(a.open(QIODevice::WriteOnly));
+
+    // The directory watcher names the changed entry, the file watcher its own name
+    const QJSValue result = evaluate(
+            "var fs = require('fs'), events = { dir: [], file: [] };"
+            "var dirWatcher = fs.watch(dir, function(type, name) { events.dir.push(name); });"
+            "var fileWatcher = fs.watch(dir + '/a', function(type, name) {"
+            "    events.file.push(name);"
+            "});"
+            "fileWatcher.on('close', function() { events.closed = true; });");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QCOMPARE(a.write("a"), qint64(1));
+    a.close();
+    QFile c(dir.filePath("c"));
+    QVERIFY(c.open(QIODevice::WriteOnly));
+    c.close();
+
+    QTRY_VERIFY(evaluate("events.dir.indexOf('c') != -1").toBool());
+    QVERIFY(evaluate("events.dir.indexOf('a') != -1").toBool());
+    QTRY_VERIFY(evaluate("events.file.length > 0").toBool());
+    QVERIFY(evaluate("events.file.every(function(name) { return name == 'a'; })").toBool());
+
+    QVERIFY(!evaluate("dirWatcher.close(); fileWatcher.close();").isError());
+    QVERIFY(evaluate("events.closed").toBool());
+    QVERIFY(m_engine->reset());
+}
+
+void tst_node::fsWatchFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    // The file does not exist yet, so the previous stats are zeroed
+    const QJSValue result = evaluate(
+            "var fs = require('fs'), log = [];"
+            "fs.watchFile(dir + '/a', { interval: 20 }, function(current, previous) {"
+            "    log.push(previous.size + '>' + current.size);"
+            "    fs.unwatchFile(dir + '/a');"
+            "});");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    QFile a(dir.filePath("a"));
+    QVERIFY(a.open(QIODevice::WriteOnly));
+    QCOMPARE(a.write("abc"), qint64(3));
+    a.close();
+
+    QTRY_COMPARE(evaluate("log.join()").toString(), QString("0>3"));
+    QVERIFY(m_engine->reset());
+}
+
+void tst_node::resetWithUnrefdWatcher()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    m_jsEngine->globalObject().setProperty("dir", dir.path());
+
+    QJSValue result = evaluate("var watcher = require('fs').watch(dir, { persistent: false });");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QVERIFY(!m_engine->reset());
+
+    result = evaluate("watcher.close();");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QVERIFY(m_engine->reset());
+}
+
+void tst_node::workerMessage()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(startEchoWorker(&dir));
+
+    const QJSValue result = evaluate(
+            "var b = new Buffer('abc');"
+            "var message = { text: 'hi', list: [1, null], data: b };"
+            "message.self = message;"
+            "worker.postMessage(message, [b]);"
+            "b.length;");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toInt(), 0);
+
+    QTRY_COMPARE(evaluate("replies.length").toInt(), 1);
+    QCOMPARE(evaluate("var r = replies[0]; [r.text, r.list.join(), r.data.toString(),"
+                      " r.self === r].join(' ')").toString(),
+             QString("hi 1, abc true"));
+    evaluate("worker.terminate();");
+}
+
+void tst_node::workerTransferSlice()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(startEchoWorker(&dir));
+
+    // The slice shares its parent's memory, so it is copied, not handed to the worker
+    const QJSValue result = evaluate(
+            "var parent = new Buffer(8); parent.fill(1);"
+            "var slice = parent.slice(0, 4);"
+            "worker.postMessage(slice, [slice]);"
+            "parent.fill(2);"
+            "slice.length;");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toInt(), 0);
+
+    QTRY_COMPARE(evaluate("replies.length").toInt(), 1);
+    QCOMPARE(evaluate("replies[0].toString('hex')").toString(), QString("01010101"));
+    QCOMPARE(evaluate("parent.toString('hex')").toString(), QString("0202020202020202"));
+    evaluate("worker.terminate();");
+}
+
+void tst_node::multipleEngines()
+{
+    // Timers of interleaved engines call back into their own engine
+    QScopedPointer<QJSEngine> otherJsEngine(new QJSEngine);
+    QScopedPointer<NodeQml::Engine> otherEngine(new NodeQml::Engine(otherJsEngine.data()));
+    const QString program = QStringLiteral(
+            "var log = [];"
+            "setTimeout(function() { log.push(require('path').basename('/a/%1')); }, 10);"
+            "setTimeout(function() { log.push(typeof require('fs').statSync); }, 0);");
+    QVERIFY(!evaluate(program.arg("first")).isError());
+    QVERIFY(!otherJsEngine->evaluate(program.arg("second")).isError());
+
+    QTRY_COMPARE(evaluate("log.join()").toString(), QString("function,first"));
+    QTRY_COMPARE(otherJsEngine->evaluate("log.join()").toString(), QString("function,second"));
+
+    // An engine created after another was destroyed may reuse its address
+    otherEngine.reset();
+    otherJsEngine.reset(new QJSEngine);
+    otherEngine.reset(new NodeQml::Engine(otherJsEngine.data()));
+    QVERIFY(!otherJsEngine->evaluate(program.arg("third")).isError());
+    QTRY_COMPARE(otherJsEngine->evaluate("log.join()").toString(), QString("function,third"));
+    QCOMPARE(evaluate("log.join()").toString(), QString("function,first"));
+
+    // The main engine is still found after the other one is gone
+    otherEngine.reset();
+    otherJsEngine.reset();
+    QVERIFY(!evaluate("setTimeout(function() { log.push('again'); }, 0);").isError());
+    QTRY_COMPARE(evaluate("log.join()").toString(), QString("function,first,again"));
 }
 
 QTEST_MAIN(tst_node)